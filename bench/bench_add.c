@@ -0,0 +1,169 @@
+/*!
+ * \file            bench_add.c
+ * \brief           Benchmark for adding durations to a struct tm.
+ * \details         Adds durations of mixed days, hours, minutes and
+ * seconds, from a few seconds to several centuries, with the chain of
+ * tm_increment_day(), tm_increment_hour(), tm_increment_minute() and
+ * tm_increment_second(), with a single tm_add_duration(), and with
+ * tm_add_seconds() given the total, and compares them with timegm() and
+ * gmtime_r(). Checks that they all agree.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+
+
+/*  Number of additions in each run, and number of runs  */
+
+#define NUM_TIMES 1000000
+#define NUM_RUNS 10
+
+
+/*  A duration in mixed units  */
+
+struct duration {
+    int days;
+    int hours;
+    int minutes;
+    int seconds;
+};
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Prints a result line.
+ * \param name      The name of the method.
+ * \param elapsed   The total elapsed time for all runs, in seconds.
+ * \param baseline  The elapsed time for the baseline method.
+ */
+
+static void
+report(const char *name, const double elapsed, const double baseline) {
+    const double ns_per_op = elapsed * 1e9 / ((double) NUM_TIMES * NUM_RUNS);
+    printf("%-36s %10.2f ns/op %10.2fx\n", name, ns_per_op,
+           baseline / elapsed);
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    struct tm *start_tms = malloc(NUM_TIMES * sizeof *start_tms);
+    struct tm *expected = malloc(NUM_TIMES * sizeof *expected);
+    struct tm *results = malloc(NUM_TIMES * sizeof *results);
+    struct duration *durations = malloc(NUM_TIMES * sizeof *durations);
+    int64_t *totals = malloc(NUM_TIMES * sizeof *totals);
+    if ( !start_tms || !expected || !results || !durations || !totals ) {
+        fprintf(stderr, "bench_add: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        const time_t utc_ts = (time_t) (rand() % 200) * 31556952 +
+                              rand() % 31556952 - 2208988800;
+        get_utc_tm(utc_ts, &start_tms[i]);
+
+        durations[i].days = rand() % 200000 - 100000;
+        durations[i].hours = rand() % 2000 - 1000;
+        durations[i].minutes = rand() % 20000 - 10000;
+        durations[i].seconds = rand() % 200000 - 100000;
+        totals[i] = durations[i].days * INT64_C(86400) +
+                    durations[i].hours * INT64_C(3600) +
+                    durations[i].minutes * INT64_C(60) +
+                    durations[i].seconds;
+    }
+
+    double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            struct tm utc_tm = start_tms[i];
+            const time_t utc_ts = timegm(&utc_tm) + (time_t) totals[i];
+            gmtime_r(&utc_ts, &expected[i]);
+        }
+    }
+    const double baseline = now_secs() - start;
+    report("timegm + gmtime_r", baseline, baseline);
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            results[i] = start_tms[i];
+            tm_increment_day(&results[i], durations[i].days);
+            tm_increment_hour(&results[i], durations[i].hours);
+            tm_increment_minute(&results[i], durations[i].minutes);
+            tm_increment_second(&results[i], durations[i].seconds);
+        }
+    }
+    report("tm_increment_* chain", now_secs() - start, baseline);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        if ( tm_compare(&results[i], &expected[i]) ) {
+            fprintf(stderr, "bench_add: chain results differ.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            results[i] = start_tms[i];
+            tm_add_duration(&results[i], durations[i].days,
+                            durations[i].hours, durations[i].minutes,
+                            durations[i].seconds);
+        }
+    }
+    report("tm_add_duration", now_secs() - start, baseline);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        if ( tm_compare(&results[i], &expected[i]) ) {
+            fprintf(stderr, "bench_add: tm_add_duration results differ.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            results[i] = start_tms[i];
+            tm_add_seconds(&results[i], totals[i]);
+        }
+    }
+    report("tm_add_seconds", now_secs() - start, baseline);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        if ( tm_compare(&results[i], &expected[i]) ) {
+            fprintf(stderr, "bench_add: tm_add_seconds results differ.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(start_tms);
+    free(expected);
+    free(results);
+    free(durations);
+    free(totals);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+/*!
+ * \file            bench_batch.c
+ * \brief           Benchmark for the batch conversions.
+ * \details         Compares looping over get_utc_timestamp() with
+ * get_utc_timestamps() and get_utc_timestamps_columns(), and looping over
+ * get_utc_tm() with get_utc_tms() and get_utc_tms_columns() on sorted and
+ * random timestamps, under each kernel the CPU supports. Checks that they
+ * all agree.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_batch.h"
+
+
+/*  Number of times converted in each run, and number of runs  */
+
+#define NUM_TIMES 1000000
+#define NUM_RUNS 10
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Prints a result line.
+ * \param name      The name of the method.
+ * \param elapsed   The total elapsed time for all runs, in seconds.
+ * \param baseline  The elapsed time for the baseline method.
+ */
+
+static void
+report(const char *name, const double elapsed, const double baseline) {
+    const double ns_per_op = elapsed * 1e9 / ((double) NUM_TIMES * NUM_RUNS);
+    printf("%-36s %10.2f ns/op %10.2fx\n", name, ns_per_op,
+           baseline / elapsed);
+}
+
+
+/*!
+ * \brief           Compares two time_t values for qsort().
+ * \param first     The first value.
+ * \param second    The second value.
+ * \returns         Less than, equal to or greater than zero.
+ */
+
+static int
+compare_time_t(const void *first, const void *second) {
+    const time_t a = *(const time_t *) first;
+    const time_t b = *(const time_t *) second;
+    return (a > b) - (a < b);
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    static const struct {
+        enum batch_kernel kernel;
+        const char *name;
+    } kernels[] = {
+        {BATCH_KERNEL_SCALAR, "scalar"},
+        {BATCH_KERNEL_SSE41, "sse4.1"},
+        {BATCH_KERNEL_AVX2, "avx2"}
+    };
+
+    struct tm *utc_tms = malloc(NUM_TIMES * sizeof *utc_tms);
+    time_t *expected = malloc(NUM_TIMES * sizeof *expected);
+    time_t *results = malloc(NUM_TIMES * sizeof *results);
+    int *columns = malloc(6 * NUM_TIMES * sizeof *columns);
+    if ( !utc_tms || !expected || !results || !columns ) {
+        fprintf(stderr, "bench_batch: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    const struct tm_columns utc_columns = {
+        columns, columns + NUM_TIMES, columns + 2 * NUM_TIMES,
+        columns + 3 * NUM_TIMES, columns + 4 * NUM_TIMES,
+        columns + 5 * NUM_TIMES
+    };
+
+    srand(1);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        const time_t utc_ts = (time_t) (rand() % 200) * 31556952 +
+                              rand() % 31556952 - 2208988800;
+        get_utc_tm(utc_ts, &utc_tms[i]);
+        utc_columns.tm_year[i] = utc_tms[i].tm_year;
+        utc_columns.tm_mon[i] = utc_tms[i].tm_mon;
+        utc_columns.tm_mday[i] = utc_tms[i].tm_mday;
+        utc_columns.tm_hour[i] = utc_tms[i].tm_hour;
+        utc_columns.tm_min[i] = utc_tms[i].tm_min;
+        utc_columns.tm_sec[i] = utc_tms[i].tm_sec;
+    }
+
+    double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            expected[i] = get_utc_timestamp(&utc_tms[i]);
+        }
+    }
+    const double baseline = now_secs() - start;
+    report("get_utc_timestamp loop", baseline, baseline);
+
+    for ( size_t k = 0; k < sizeof kernels / sizeof kernels[0]; ++k ) {
+        char name[64];
+
+        if ( !batch_select_kernel(kernels[k].kernel) ) {
+            printf("%-36s not supported\n", kernels[k].name);
+            continue;
+        }
+
+        memset(results, 0, NUM_TIMES * sizeof *results);
+        start = now_secs();
+        for ( int run = 0; run < NUM_RUNS; ++run ) {
+            get_utc_timestamps(utc_tms, results, NUM_TIMES);
+        }
+        snprintf(name, sizeof name, "get_utc_timestamps (%s)",
+                 kernels[k].name);
+        report(name, now_secs() - start, baseline);
+        if ( memcmp(results, expected, NUM_TIMES * sizeof *results) ) {
+            fprintf(stderr, "bench_batch: %s results differ.\n", name);
+            return EXIT_FAILURE;
+        }
+
+        memset(results, 0, NUM_TIMES * sizeof *results);
+        start = now_secs();
+        for ( int run = 0; run < NUM_RUNS; ++run ) {
+            get_utc_timestamps_columns(&utc_columns, results, NUM_TIMES);
+        }
+        snprintf(name, sizeof name, "get_utc_timestamps_columns (%s)",
+                 kernels[k].name);
+        report(name, now_secs() - start, baseline);
+        if ( memcmp(results, expected, NUM_TIMES * sizeof *results) ) {
+            fprintf(stderr, "bench_batch: %s results differ.\n", name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    //  The reverse direction, first with random and then with sorted
+    //  timestamps one second to a few minutes apart.
+
+    for ( int sorted = 0; sorted < 2; ++sorted ) {
+        const char *order = sorted ? "sorted" : "random";
+        char name[64];
+
+        if ( sorted ) {
+            expected[0] = 1356998400;
+            for ( size_t i = 1; i < NUM_TIMES; ++i ) {
+                expected[i] = expected[i - 1] + 1 + rand() % 300;
+            }
+        } else {
+            qsort(expected, NUM_TIMES, sizeof *expected, compare_time_t);
+            for ( size_t i = NUM_TIMES - 1; i > 0; --i ) {
+                const size_t j = (size_t) rand() % (i + 1);
+                const time_t swap = expected[i];
+                expected[i] = expected[j];
+                expected[j] = swap;
+            }
+        }
+
+        start = now_secs();
+        for ( int run = 0; run < NUM_RUNS; ++run ) {
+            for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+                get_utc_tm(expected[i], &utc_tms[i]);
+            }
+        }
+        const double tm_baseline = now_secs() - start;
+        snprintf(name, sizeof name, "get_utc_tm loop (%s)", order);
+        report(name, tm_baseline, tm_baseline);
+
+        for ( size_t k = 0; k < sizeof kernels / sizeof kernels[0]; ++k ) {
+            struct tm *batch_tms = malloc(NUM_TIMES * sizeof *batch_tms);
+            if ( !batch_tms ) {
+                fprintf(stderr, "bench_batch: couldn't allocate memory.\n");
+                return EXIT_FAILURE;
+            }
+
+            if ( !batch_select_kernel(kernels[k].kernel) ) {
+                free(batch_tms);
+                continue;
+            }
+
+            start = now_secs();
+            for ( int run = 0; run < NUM_RUNS; ++run ) {
+                get_utc_tms(expected, batch_tms, NUM_TIMES);
+            }
+            snprintf(name, sizeof name, "get_utc_tms (%s, %s)",
+                     kernels[k].name, order);
+            report(name, now_secs() - start, tm_baseline);
+
+            start = now_secs();
+            for ( int run = 0; run < NUM_RUNS; ++run ) {
+                get_utc_tms_columns(expected, &utc_columns, NUM_TIMES);
+            }
+            snprintf(name, sizeof name, "get_utc_tms_columns (%s, %s)",
+                     kernels[k].name, order);
+            report(name, now_secs() - start, tm_baseline);
+
+            for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+                if ( tm_compare(&batch_tms[i], &utc_tms[i]) ||
+                     batch_tms[i].tm_wday != utc_tms[i].tm_wday ||
+                     batch_tms[i].tm_yday != utc_tms[i].tm_yday ||
+                     utc_columns.tm_sec[i] != utc_tms[i].tm_sec ) {
+                    fprintf(stderr, "bench_batch: %s results differ.\n",
+                            name);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            free(batch_tms);
+        }
+    }
+
+    free(utc_tms);
+    free(expected);
+    free(results);
+    free(columns);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*!
+ * \file            bench_bucket.c
+ * \brief           Benchmark for counting timestamps in buckets.
+ * \details         Counts sorted and unsorted timestamps in one-hour
+ * buckets with bucket_count(), using each batch kernel, and with a
+ * hand-written division loop for comparison. Then counts them in calendar
+ * months with bucket_count_calendar() and with gmtime_r(). Checks that
+ * the counts agree.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime_batch.h"
+#include "pgtime_bucket.h"
+
+
+/*  Number of timestamps in each run, and number of runs  */
+
+#define NUM_TIMES 1000000
+#define NUM_RUNS 20
+
+/*  Number of one-hour and one-month buckets, and the first bucket  */
+
+#define NUM_HOURS (24 * 365 * 24)
+#define NUM_MONTHS 240
+#define ORIGIN 1356998400
+
+/*  The bucket width, volatile so that the compiler cannot replace the
+ *  division in the baseline with a multiplication, as it could not in a
+ *  program which reads the width from its configuration  */
+
+static volatile int64_t hour_secs = 3600;
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Prints a result line.
+ * \param name      The name of the method.
+ * \param elapsed   The total elapsed time for all runs, in seconds.
+ * \param baseline  The elapsed time for the baseline method.
+ */
+
+static void
+report(const char *name, const double elapsed, const double baseline) {
+    const double ns_per_op = elapsed * 1e9 / ((double) NUM_TIMES * NUM_RUNS);
+    printf("%-40s %8.2f ns/op %8.2fx\n", name, ns_per_op,
+           baseline / elapsed);
+}
+
+
+/*!
+ * \brief               Counts timestamps in one-hour buckets with a
+ * division loop, as a baseline.
+ * \param utc_ts        The timestamps.
+ * \param counts        The bucket counts to add to.
+ * \returns             The elapsed time for all runs, in seconds.
+ */
+
+static double
+run_division(const time_t *utc_ts, uint64_t *counts) {
+    const int64_t interval = hour_secs;
+    const double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            const time_t offset = utc_ts[i] - ORIGIN;
+            if ( offset >= 0 && offset / interval < NUM_HOURS ) {
+                ++counts[offset / interval];
+            }
+        }
+    }
+    return now_secs() - start;
+}
+
+
+/*!
+ * \brief               Counts timestamps in calendar months with
+ * gmtime_r(), as a baseline.
+ * \param utc_ts        The timestamps.
+ * \param counts        The bucket counts to add to.
+ * \returns             The elapsed time for all runs, in seconds.
+ */
+
+static double
+run_gmtime(const time_t *utc_ts, uint64_t *counts) {
+    const double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            struct tm utc_tm;
+            gmtime_r(&utc_ts[i], &utc_tm);
+            const int month = (utc_tm.tm_year - 113) * 12 + utc_tm.tm_mon;
+            if ( month >= 0 && month < NUM_MONTHS ) {
+                ++counts[month];
+            }
+        }
+    }
+    return now_secs() - start;
+}
+
+
+/*!
+ * \brief           Runs the benchmarks for one set of timestamps.
+ * \param label     A description of the timestamps.
+ * \param utc_ts    The timestamps.
+ * \returns         `true` if all the methods agreed, `false` otherwise.
+ */
+
+static bool
+run_all(const char *label, const time_t *utc_ts) {
+    static const struct {
+        enum batch_kernel kernel;
+        const char *name;
+    } kernels[] = {
+        {BATCH_KERNEL_SCALAR, "bucket_count (scalar)"},
+        {BATCH_KERNEL_AVX2, "bucket_count (AVX2)"}
+    };
+    static uint64_t expected[NUM_HOURS];
+    static uint64_t counts[NUM_HOURS];
+
+    printf("%s:\n", label);
+
+    memset(expected, 0, sizeof expected);
+    const double baseline = run_division(utc_ts, expected);
+    report("division loop", baseline, baseline);
+
+    for ( size_t k = 0; k < sizeof kernels / sizeof kernels[0]; ++k ) {
+        if ( !batch_select_kernel(kernels[k].kernel) ) {
+            continue;
+        }
+
+        memset(counts, 0, sizeof counts);
+        const double start = now_secs();
+        for ( int run = 0; run < NUM_RUNS; ++run ) {
+            bucket_count(utc_ts, NUM_TIMES, ORIGIN, hour_secs, counts,
+                         NUM_HOURS);
+        }
+        report(kernels[k].name, now_secs() - start, baseline);
+        if ( memcmp(counts, expected, sizeof counts) ) {
+            fprintf(stderr, "bench_bucket: hour counts differ.\n");
+            return false;
+        }
+    }
+    batch_select_kernel(BATCH_KERNEL_AUTO);
+
+    memset(expected, 0, sizeof expected);
+    const double month_baseline = run_gmtime(utc_ts, expected);
+    report("gmtime_r months", month_baseline, month_baseline);
+
+    memset(counts, 0, sizeof counts);
+    const double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        bucket_count_calendar(utc_ts, NUM_TIMES, ORIGIN, CALENDAR_MONTH,
+                              counts, NUM_MONTHS);
+    }
+    report("bucket_count_calendar months", now_secs() - start,
+           month_baseline);
+    if ( memcmp(counts, expected, sizeof counts) ) {
+        fprintf(stderr, "bench_bucket: month counts differ.\n");
+        return false;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    time_t *utc_ts = malloc(NUM_TIMES * sizeof *utc_ts);
+    if ( !utc_ts ) {
+        fprintf(stderr, "bench_bucket: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    //  Sorted timestamps a little under a second apart, as from a log,
+    //  with some before and after the one-hour buckets.
+
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        utc_ts[i] = ORIGIN - 3600 + (time_t) (i * 13 / 10);
+    }
+    if ( !run_all("Sorted", utc_ts) ) {
+        return EXIT_FAILURE;
+    }
+
+    //  Unsorted timestamps over twenty-four years.
+
+    srand(1);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        utc_ts[i] = ORIGIN - 31556952 +
+                    (time_t) rand() % (24 * 31556952);
+    }
+    if ( !run_all("Unsorted", utc_ts) ) {
+        return EXIT_FAILURE;
+    }
+
+    free(utc_ts);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+/*!
+ * \file            bench_clock.c
+ * \brief           Benchmark for the cached clock.
+ * \details         Reads the current time on 1, 2, 4 and so on up to the
+ * number of online processors, with time() and gmtime_r(), with
+ * timespec_get(), gmtime_r() and strftime() to get everything a snapshot
+ * holds, and with coarse_clock_now() and coarse_clock_time() while the
+ * updater thread ticks every millisecond. Then has every thread tick the
+ * clock itself as well, racing the updater and each other. Reports the
+ * total throughput for each thread count, and checks that every snapshot
+ * read is consistent and that no thread sees the clock go backwards.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pgtime.h"
+#include "pgtime_clock.h"
+#include "pgtime_iso.h"
+
+
+/*  Number of reads each thread makes  */
+
+#define OPS_PER_THREAD 2000000L
+
+/*  Number of threads ticking the clock in the stress check, which is more
+ *  than most machines have processors  */
+
+#define STRESS_THREADS 16
+
+
+/*  The ways of reading the current time  */
+
+enum method {
+    METHOD_GMTIME,
+    METHOD_STRFTIME,
+    METHOD_SNAPSHOT,
+    METHOD_TIME,
+    METHOD_TICK
+};
+
+static const char *method_names[] = {
+    "time + gmtime_r",
+    "timespec_get + gmtime_r + strftime",
+    "coarse_clock_now",
+    "coarse_clock_time",
+    "coarse_clock_tick + coarse_clock_now"
+};
+
+
+/*  Arguments passed to each worker thread  */
+
+struct worker_args {
+    enum method method;
+    long checksum;
+    long failures;
+};
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Checks that a snapshot is consistent.
+ * \param snapshot  The snapshot to check.
+ * \returns         1 if any member disagrees with the timestamp, 0
+ * otherwise.
+ */
+
+static long
+check_snapshot(const struct clock_snapshot *snapshot) {
+    struct tm utc_tm;
+    time_t parsed;
+    long nanoseconds;
+    const char *end = snapshot->iso8601 + strlen(snapshot->iso8601);
+
+    get_utc_tm(snapshot->utc_ts, &utc_tm);
+    if ( tm_compare(&utc_tm, &snapshot->utc_tm) ||
+         parse_iso8601_timestamp(snapshot->iso8601,
+                                 end - snapshot->iso8601, &parsed,
+                                 &nanoseconds) != end ||
+         parsed != snapshot->utc_ts ||
+         nanoseconds / 1000000 != snapshot->nanoseconds / 1000000 ) {
+        return 1;
+    }
+    return 0;
+}
+
+
+/*!
+ * \brief           Worker thread function.
+ * \param arg       A pointer to a struct worker_args.
+ * \returns         A null pointer.
+ */
+
+static void *
+worker(void *arg) {
+    struct worker_args *args = arg;
+    struct clock_snapshot last = {0};
+
+    for ( long i = 0; i < OPS_PER_THREAD; ++i ) {
+        switch ( args->method ) {
+            case METHOD_GMTIME: {
+                const time_t utc_ts = time(0);
+                struct tm utc_tm;
+                gmtime_r(&utc_ts, &utc_tm);
+                args->checksum += utc_tm.tm_sec;
+                break;
+            }
+
+            case METHOD_STRFTIME: {
+                struct timespec now;
+                struct tm utc_tm;
+                char buffer[PGTIME_ISO8601_BUFSIZE];
+                timespec_get(&now, TIME_UTC);
+                gmtime_r(&now.tv_sec, &utc_tm);
+                strftime(buffer, sizeof buffer, "%Y-%m-%dT%H:%M:%S",
+                         &utc_tm);
+                args->checksum += utc_tm.tm_sec + buffer[18];
+                break;
+            }
+
+            case METHOD_SNAPSHOT: {
+                struct clock_snapshot snapshot;
+                coarse_clock_now(&snapshot);
+                args->checksum += snapshot.utc_tm.tm_sec;
+                if ( i % 64 == 0 ) {
+                    args->failures += check_snapshot(&snapshot);
+                }
+                break;
+            }
+
+            case METHOD_TIME: {
+                const time_t utc_ts = coarse_clock_time();
+                args->checksum += (long) utc_ts;
+                args->failures += utc_ts < last.utc_ts;
+                last.utc_ts = utc_ts;
+                break;
+            }
+
+            case METHOD_TICK: {
+
+                //  Whichever tick wins, a later read must never see an
+                //  earlier time than this thread has already seen.
+
+                struct clock_snapshot snapshot;
+                coarse_clock_tick();
+                coarse_clock_now(&snapshot);
+                args->checksum += snapshot.utc_tm.tm_sec;
+                if ( snapshot.utc_ts < last.utc_ts ||
+                     (snapshot.utc_ts == last.utc_ts &&
+                      snapshot.nanoseconds < last.nanoseconds) ) {
+                    ++args->failures;
+                }
+                last = snapshot;
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*!
+ * \brief               Runs one method on a number of threads.
+ * \param method        The method to run.
+ * \param num_threads   The number of threads.
+ * \returns             The number of inconsistent or out of order
+ * snapshots, or -1 if a thread could not be created.
+ */
+
+static long
+run(const enum method method, const long num_threads) {
+    pthread_t threads[num_threads];
+    struct worker_args args[num_threads];
+
+    const double start = now_secs();
+    for ( long t = 0; t < num_threads; ++t ) {
+        args[t] = (struct worker_args) {method, 0, 0};
+        if ( pthread_create(&threads[t], 0, worker, &args[t]) ) {
+            return -1;
+        }
+    }
+
+    long failures = 0;
+    for ( long t = 0; t < num_threads; ++t ) {
+        pthread_join(threads[t], 0);
+        failures += args[t].failures;
+    }
+    const double elapsed = now_secs() - start;
+
+    printf("%2ld threads  %-36s %8.2f Mops/s %8.2f ns/op\n", num_threads,
+           method_names[method],
+           num_threads * OPS_PER_THREAD / elapsed / 1e6,
+           elapsed * 1e9 / OPS_PER_THREAD);
+    return failures;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if ( max_threads < 1 ) {
+        max_threads = 1;
+    }
+
+    if ( !coarse_clock_start(1000000) ) {
+        fprintf(stderr, "bench_clock: couldn't start the clock.\n");
+        return EXIT_FAILURE;
+    }
+
+    long failures = 0;
+    for ( long n = 1; ; n *= 2 ) {
+        const long num_threads = n < max_threads ? n : max_threads;
+        for ( int method = METHOD_GMTIME; method <= METHOD_TICK;
+              ++method ) {
+            const long result = run(method, num_threads);
+            if ( result < 0 ) {
+                fprintf(stderr, "bench_clock: couldn't create thread.\n");
+                return EXIT_FAILURE;
+            }
+            failures += result;
+        }
+        if ( num_threads == max_threads ) {
+            break;
+        }
+    }
+
+    //  With more ticking threads than processors, ticks are preempted
+    //  part way through, which is when an old time could be published
+    //  over a newer one.
+
+    const long result = run(METHOD_TICK, STRESS_THREADS);
+    if ( result < 0 ) {
+        fprintf(stderr, "bench_clock: couldn't create thread.\n");
+        return EXIT_FAILURE;
+    }
+    failures += result;
+
+    coarse_clock_stop();
+
+    if ( failures ) {
+        fprintf(stderr, "bench_clock: %ld inconsistent or out of order "
+                "snapshots.\n",
+                failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
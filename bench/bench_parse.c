@@ -0,0 +1,203 @@
+/*!
+ * \file            bench_parse.c
+ * \brief           Benchmark for the ISO 8601 timestamp parser and
+ * formatter.
+ * \details         Parses a buffer of newline-separated timestamps with
+ * parse_iso8601_timestamp(), and with sscanf() or strptime() followed by
+ * validate_date() and get_utc_timestamp() for comparison, and reports the
+ * throughput of each in GB/s. Then formats log-style timestamps, several
+ * to a second, with format_iso8601_timestamp() and with gmtime_r() and
+ * strftime().
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_iso.h"
+
+
+/*  Number of timestamps in the buffer, and number of runs  */
+
+#define NUM_TIMES 1000000
+#define NUM_RUNS 10
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Prints a result line.
+ * \param name      The name of the method.
+ * \param elapsed   The total elapsed time for all runs, in seconds.
+ * \param bytes     The number of bytes parsed or written in each run.
+ * \param checksum  The sum of the parsed timestamps, to check for
+ * agreement between methods.
+ */
+
+static void
+report(const char *name, const double elapsed, const size_t bytes,
+       const long long checksum) {
+    printf("%-32s %8.3f GB/s %10.2f ns/op  checksum %lld\n", name,
+           (double) bytes * NUM_RUNS / elapsed / 1e9,
+           elapsed * 1e9 / ((double) NUM_TIMES * NUM_RUNS), checksum);
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    static const char *formats[] = {
+        "%04d-%02d-%02dT%02d:%02d:%02dZ\n",
+        "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\n",
+        "%04d-%02d-%02d %02d:%02d:%02d.%06d+00:00\n"
+    };
+
+    char *buffer = malloc(NUM_TIMES * 40);
+    if ( !buffer ) {
+        fprintf(stderr, "bench_parse: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t bytes = 0;
+    srand(1);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        struct tm utc_tm;
+        get_utc_tm((time_t) rand() * 2, &utc_tm);
+        bytes += sprintf(buffer + bytes, formats[i % 3],
+                         utc_tm.tm_year + 1900, utc_tm.tm_mon + 1,
+                         utc_tm.tm_mday, utc_tm.tm_hour, utc_tm.tm_min,
+                         utc_tm.tm_sec, rand() % 1000);
+    }
+
+    const char *const buffer_end = buffer + bytes;
+    long long checksum = 0;
+    double start = now_secs();
+
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        const char *p = buffer;
+        checksum = 0;
+        while ( p < buffer_end ) {
+            time_t utc_ts;
+            long nsec;
+            p = parse_iso8601_timestamp(p, buffer_end - p, &utc_ts, &nsec);
+            if ( !p ) {
+                fprintf(stderr, "bench_parse: parse failed.\n");
+                return EXIT_FAILURE;
+            }
+            checksum += utc_ts;
+            ++p;
+        }
+    }
+    report("parse_iso8601_timestamp", now_secs() - start, bytes, checksum);
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        const char *p = buffer;
+        checksum = 0;
+        while ( p < buffer_end ) {
+
+            //  sscanf() calls strlen() on its input, so give it one line
+            //  at a time rather than the rest of the buffer.
+
+            const char *const line_end = strchr(p, '\n');
+            char line[64];
+            memcpy(line, p, line_end - p);
+            line[line_end - p] = '\0';
+
+            struct tm utc_tm = {0};
+            if ( sscanf(line, "%4d-%2d-%2d%*c%2d:%2d:%2d", &utc_tm.tm_year,
+                        &utc_tm.tm_mon, &utc_tm.tm_mday, &utc_tm.tm_hour,
+                        &utc_tm.tm_min, &utc_tm.tm_sec) != 6 ) {
+                fprintf(stderr, "bench_parse: sscanf failed.\n");
+                return EXIT_FAILURE;
+            }
+            utc_tm.tm_year -= 1900;
+            utc_tm.tm_mon -= 1;
+            if ( validate_date(&utc_tm) ) {
+                checksum += get_utc_timestamp(&utc_tm);
+            }
+            p = line_end + 1;
+        }
+    }
+    report("sscanf + validate_date", now_secs() - start, bytes, checksum);
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        const char *p = buffer;
+        checksum = 0;
+        while ( p < buffer_end ) {
+            struct tm utc_tm = {0};
+            const char *end = strptime(p, "%Y-%m-%d%n%H:%M:%S", &utc_tm);
+            if ( !end ) {
+                end = strptime(p, "%Y-%m-%dT%H:%M:%S", &utc_tm);
+            }
+            if ( !end ) {
+                fprintf(stderr, "bench_parse: strptime failed.\n");
+                return EXIT_FAILURE;
+            }
+            if ( validate_date(&utc_tm) ) {
+                checksum += get_utc_timestamp(&utc_tm);
+            }
+            p = strchr(end, '\n') + 1;
+        }
+    }
+    report("strptime + validate_date", now_secs() - start, bytes, checksum);
+
+    //  Format timestamps about a millisecond apart, so most calls fall in
+    //  the same second as the one before.
+
+    char *const out_end = buffer + NUM_TIMES * 40 - PGTIME_ISO8601_BUFSIZE;
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        char *p = buffer;
+        for ( long i = 0; i < NUM_TIMES && p < out_end; ++i ) {
+            p += format_iso8601_timestamp(p, PGTIME_ISO8601_BUFSIZE,
+                                          1356998400 + i / 1000,
+                                          i % 1000 * 1000000 + 123, 6,
+                                          ISO_FORMAT_RFC3339);
+            *p++ = '\n';
+        }
+        bytes = (size_t) (p - buffer);
+    }
+    report("format_iso8601_timestamp", now_secs() - start, bytes, 0);
+
+    start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        char *p = buffer;
+        for ( long i = 0; i < NUM_TIMES && p < out_end; ++i ) {
+            const time_t utc_ts = 1356998400 + i / 1000;
+            struct tm utc_tm;
+            gmtime_r(&utc_ts, &utc_tm);
+            p += strftime(p, PGTIME_ISO8601_BUFSIZE, "%Y-%m-%dT%H:%M:%S",
+                          &utc_tm);
+            p += sprintf(p, ".%06ldZ\n", i % 1000 * 1000);
+        }
+        bytes = (size_t) (p - buffer);
+    }
+    report("gmtime_r + strftime", now_secs() - start, bytes, 0);
+
+    free(buffer);
+
+    return EXIT_SUCCESS;
+}
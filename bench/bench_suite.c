@@ -0,0 +1,664 @@
+/*!
+ * \file            bench_suite.c
+ * \brief           Benchmark suite covering every function in pgtime.h.
+ * \details         Times each function, and timegm(), gmtime_r() and
+ * mktime() as baselines, on sorted and on random timestamps, or with small
+ * and with huge increments, on one thread and on one thread per online
+ * processor. The conversion functions are run again with a date table.
+ * Functions which use shared storage are only run on one thread. Each
+ * result is the best of several runs, and the results are written to
+ * standard output as JSON, so that runs can be compared to find
+ * regressions.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pgtime.h"
+
+
+/*  Number of inputs in each set, which must be a power of two, number of
+ *  operations in each run, and number of runs to take the best of  */
+
+#define INPUT_SIZE 16384
+#define OPS_PER_RUN 1000000
+#define NUM_RUNS 3
+
+/*  The range of random timestamps, 1900 to 2100, and the start of the
+ *  sorted ones, 2013-01-01  */
+
+#define RANDOM_FIRST_TS INT64_C(-2208988800)
+#define RANDOM_SPAN_TS INT64_C(6311433600)
+#define SORTED_FIRST_TS INT64_C(1356998400)
+
+/*  Largest small and huge increments, in the units of the function  */
+
+#define SMALL_QUANTITY 100
+#define HUGE_QUANTITY 1000000
+
+
+/*  A set of inputs  */
+
+struct input_set {
+    time_t utc_ts[INPUT_SIZE];          /*!<  Timestamps  */
+    struct tm utc_tms[INPUT_SIZE];      /*!<  The timestamps broken down  */
+    struct tm other_tms[INPUT_SIZE];    /*!<  Unrelated times to compare  */
+    packed_tm packed[INPUT_SIZE];       /*!<  The times packed  */
+    int quantity[INPUT_SIZE];           /*!<  Increments  */
+};
+
+
+/*  The distributions of inputs  */
+
+enum distribution {
+    DIST_NONE,
+    DIST_SORTED,
+    DIST_RANDOM,
+    DIST_SMALL,
+    DIST_HUGE
+};
+
+static const char *distribution_names[] = {
+    "none", "sorted", "random", "small", "huge"
+};
+
+
+/*  What a benchmark takes as input  */
+
+enum input_kind {
+    INPUT_CONSTANT,     /*!<  Nothing that varies  */
+    INPUT_TIMES,        /*!<  Sorted or random times  */
+    INPUT_SPANS         /*!<  Small or huge increments of random times  */
+};
+
+
+/*  A benchmark, which runs OPS_PER_RUN operations and returns a checksum
+ *  of the results  */
+
+typedef uint64_t (*bench_fn)(const struct input_set *in);
+
+struct benchmark {
+    const char *name;
+    bench_fn fn;
+    enum input_kind kind;
+    bool single_thread;         /*!<  Uses shared storage  */
+    bool date_table;            /*!<  Also run with a date table  */
+};
+
+
+/*  Arguments passed to each worker thread  */
+
+struct worker_args {
+    bench_fn fn;
+    const struct input_set *in;
+    uint64_t checksum;
+};
+
+
+/*  Defines a benchmark function, which runs the statements once for each
+ *  operation with `i` the index of the input, adding to `sum`  */
+
+#define DEFINE_BENCH(name, ...) \
+    static uint64_t \
+    name(const struct input_set *in) { \
+        uint64_t sum = 0; \
+        for ( size_t op = 0; op < OPS_PER_RUN; ++op ) { \
+            const size_t i = op & (INPUT_SIZE - 1); \
+            (void) i; \
+            __VA_ARGS__ \
+        } \
+        (void) in; \
+        return sum; \
+    }
+
+
+/*  Baselines  */
+
+DEFINE_BENCH(bench_timegm,
+    struct tm utc_tm = in->utc_tms[i];
+    sum += (uint64_t) timegm(&utc_tm);
+)
+
+DEFINE_BENCH(bench_gmtime_r,
+    struct tm utc_tm;
+    gmtime_r(&in->utc_ts[i], &utc_tm);
+    sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_yday);
+)
+
+DEFINE_BENCH(bench_mktime,
+    struct tm local_tm = in->utc_tms[i];
+    local_tm.tm_isdst = -1;
+    sum += (uint64_t) mktime(&local_tm);
+)
+
+
+/*  Intervals and status messages  */
+
+DEFINE_BENCH(bench_get_day_diff,
+    sum += (uint64_t) get_day_diff();
+)
+
+DEFINE_BENCH(bench_get_hour_diff,
+    sum += (uint64_t) get_hour_diff();
+)
+
+DEFINE_BENCH(bench_get_sec_diff,
+    sum += (uint64_t) get_sec_diff();
+)
+
+DEFINE_BENCH(bench_get_day_diff_checked,
+    time_t diff = 0;
+    sum += (uint64_t) get_day_diff_checked(&diff) + (uint64_t) diff;
+)
+
+DEFINE_BENCH(bench_get_hour_diff_checked,
+    time_t diff = 0;
+    sum += (uint64_t) get_hour_diff_checked(&diff) + (uint64_t) diff;
+)
+
+DEFINE_BENCH(bench_get_sec_diff_checked,
+    time_t diff = 0;
+    sum += (uint64_t) get_sec_diff_checked(&diff) + (uint64_t) diff;
+)
+
+DEFINE_BENCH(bench_pgtime_status_message,
+    sum += (uint64_t) pgtime_status_message((enum pgtime_status)
+                                            (i % 5))[0];
+)
+
+
+/*  Validation, comparison and packing  */
+
+DEFINE_BENCH(bench_validate_date,
+    sum += validate_date(&in->utc_tms[i]);
+)
+
+DEFINE_BENCH(bench_tm_compare,
+    sum += (uint64_t) tm_compare(&in->utc_tms[i], &in->other_tms[i]);
+)
+
+DEFINE_BENCH(bench_pack_tm,
+    sum += pack_tm(&in->utc_tms[i]);
+)
+
+DEFINE_BENCH(bench_unpack_tm,
+    struct tm utc_tm;
+    unpack_tm(in->packed[i], &utc_tm);
+    sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_yday);
+)
+
+DEFINE_BENCH(bench_packed_tm_compare,
+    sum += (uint64_t) packed_tm_compare(in->packed[i],
+                                        in->packed[(i + 1) &
+                                                   (INPUT_SIZE - 1)]);
+)
+
+DEFINE_BENCH(bench_tm_intraday_secs_diff,
+    sum += (uint64_t) tm_intraday_secs_diff(&in->utc_tms[i],
+                                            &in->other_tms[i]);
+)
+
+DEFINE_BENCH(bench_tm_secs_diff,
+    sum += (uint64_t) tm_secs_diff(&in->utc_tms[i], &in->other_tms[i]);
+)
+
+DEFINE_BENCH(bench_tm_days_diff,
+    sum += (uint64_t) tm_days_diff(&in->utc_tms[i], &in->other_tms[i]);
+)
+
+
+/*  Calendar calculations  */
+
+DEFINE_BENCH(bench_is_leap_year,
+    sum += is_leap_year(in->utc_tms[i].tm_year + 1900);
+)
+
+DEFINE_BENCH(bench_days_from_civil,
+    sum += (uint64_t) days_from_civil(in->utc_tms[i].tm_year +
+                                      (int64_t) 1900,
+                                      in->utc_tms[i].tm_mon + 1,
+                                      in->utc_tms[i].tm_mday);
+)
+
+DEFINE_BENCH(bench_civil_from_days,
+    int64_t year;
+    int month;
+    int day;
+    civil_from_days(in->utc_ts[i] / 86400, &year, &month, &day);
+    sum += (uint64_t) (year + month + day);
+)
+
+DEFINE_BENCH(bench_day_of_week,
+    sum += (uint64_t) day_of_week(in->utc_tms[i].tm_year + (int64_t) 1900,
+                                  in->utc_tms[i].tm_mon + 1,
+                                  in->utc_tms[i].tm_mday);
+)
+
+DEFINE_BENCH(bench_day_of_year,
+    sum += (uint64_t) day_of_year(in->utc_tms[i].tm_year + (int64_t) 1900,
+                                  in->utc_tms[i].tm_mon + 1,
+                                  in->utc_tms[i].tm_mday);
+)
+
+DEFINE_BENCH(bench_iso_week_number,
+    int64_t iso_year;
+    sum += (uint64_t) iso_week_number(in->utc_tms[i].tm_year +
+                                      (int64_t) 1900,
+                                      in->utc_tms[i].tm_mon + 1,
+                                      in->utc_tms[i].tm_mday, &iso_year) +
+           (uint64_t) iso_year;
+)
+
+
+/*  Arithmetic  */
+
+DEFINE_BENCH(bench_tm_add_seconds,
+    struct tm utc_tm = in->utc_tms[i];
+    tm_add_seconds(&utc_tm, in->quantity[i] * INT64_C(86400) +
+                            in->quantity[i]);
+    sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_sec);
+)
+
+DEFINE_BENCH(bench_tm_add_duration,
+    struct tm utc_tm = in->utc_tms[i];
+    tm_add_duration(&utc_tm, in->quantity[i], -in->quantity[i] / 2,
+                    in->quantity[i] / 3, -in->quantity[i]);
+    sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_sec);
+)
+
+#define DEFINE_STEP_BENCH(function) \
+    DEFINE_BENCH(bench_##function, \
+        struct tm utc_tm = in->utc_tms[i]; \
+        function(&utc_tm, in->quantity[i]); \
+        sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_sec); \
+    )
+
+#define DEFINE_MONTH_BENCH(function) \
+    DEFINE_BENCH(bench_##function, \
+        struct tm utc_tm = in->utc_tms[i]; \
+        function(&utc_tm, in->quantity[i], MONTH_DAY_CLAMP); \
+        sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_year); \
+    )
+
+DEFINE_STEP_BENCH(tm_increment_day)
+DEFINE_STEP_BENCH(tm_increment_hour)
+DEFINE_STEP_BENCH(tm_increment_minute)
+DEFINE_STEP_BENCH(tm_increment_second)
+DEFINE_STEP_BENCH(tm_decrement_day)
+DEFINE_STEP_BENCH(tm_decrement_hour)
+DEFINE_STEP_BENCH(tm_decrement_minute)
+DEFINE_STEP_BENCH(tm_decrement_second)
+DEFINE_MONTH_BENCH(tm_increment_month)
+DEFINE_MONTH_BENCH(tm_increment_year)
+DEFINE_MONTH_BENCH(tm_decrement_month)
+DEFINE_MONTH_BENCH(tm_decrement_year)
+
+
+/*  Conversions  */
+
+DEFINE_BENCH(bench_check_utc_timestamp,
+    int secs_diff;
+    sum += check_utc_timestamp(in->utc_ts[i], &secs_diff, &in->utc_tms[i]);
+)
+
+DEFINE_BENCH(bench_check_utc_timestamp_r,
+    int secs_diff;
+    struct tm utc_buf;
+    sum += check_utc_timestamp_r(in->utc_ts[i], &secs_diff,
+                                 &in->utc_tms[i], &utc_buf);
+)
+
+DEFINE_BENCH(bench_check_utc_timestamp_checked,
+    int secs_diff;
+    struct tm utc_buf;
+    sum += (uint64_t) check_utc_timestamp_checked(in->utc_ts[i], &secs_diff,
+                                                  &in->utc_tms[i],
+                                                  &utc_buf);
+)
+
+DEFINE_BENCH(bench_get_utc_timestamp,
+    sum += (uint64_t) get_utc_timestamp(&in->utc_tms[i]);
+)
+
+DEFINE_BENCH(bench_get_utc_timestamp_checked,
+    time_t utc_ts = 0;
+    sum += (uint64_t) get_utc_timestamp_checked(&in->utc_tms[i], &utc_ts) +
+           (uint64_t) utc_ts;
+)
+
+DEFINE_BENCH(bench_get_utc_tm,
+    struct tm utc_tm;
+    get_utc_tm(in->utc_ts[i], &utc_tm);
+    sum += (uint64_t) (utc_tm.tm_mday + utc_tm.tm_yday);
+)
+
+DEFINE_BENCH(bench_get_utc_timestamp_sec_diff,
+    sum += (uint64_t) get_utc_timestamp_sec_diff(in->utc_ts[i],
+                                                 &in->other_tms[i]);
+)
+
+DEFINE_BENCH(bench_get_utc_timestamp_sec_diff_r,
+    struct tm utc_buf;
+    sum += (uint64_t) get_utc_timestamp_sec_diff_r(in->utc_ts[i],
+                                                   &in->other_tms[i],
+                                                   &utc_buf);
+)
+
+DEFINE_BENCH(bench_get_utc_timestamp_sec_diff_checked,
+    struct tm utc_buf;
+    int secs_diff = 0;
+    sum += (uint64_t) get_utc_timestamp_sec_diff_checked(in->utc_ts[i],
+                                                         &in->other_tms[i],
+                                                         &utc_buf,
+                                                         &secs_diff) +
+           (uint64_t) secs_diff;
+)
+
+
+/*  The benchmarks, in the order they are run  */
+
+static const struct benchmark benchmarks[] = {
+    {"timegm", bench_timegm, INPUT_TIMES, false, false},
+    {"gmtime_r", bench_gmtime_r, INPUT_TIMES, false, false},
+    {"mktime", bench_mktime, INPUT_TIMES, false, false},
+    {"get_day_diff", bench_get_day_diff, INPUT_CONSTANT, false, false},
+    {"get_hour_diff", bench_get_hour_diff, INPUT_CONSTANT, false, false},
+    {"get_sec_diff", bench_get_sec_diff, INPUT_CONSTANT, false, false},
+    {"get_day_diff_checked", bench_get_day_diff_checked, INPUT_CONSTANT,
+     false, false},
+    {"get_hour_diff_checked", bench_get_hour_diff_checked, INPUT_CONSTANT,
+     false, false},
+    {"get_sec_diff_checked", bench_get_sec_diff_checked, INPUT_CONSTANT,
+     false, false},
+    {"pgtime_status_message", bench_pgtime_status_message, INPUT_CONSTANT,
+     false, false},
+    {"validate_date", bench_validate_date, INPUT_TIMES, false, false},
+    {"tm_compare", bench_tm_compare, INPUT_TIMES, false, false},
+    {"pack_tm", bench_pack_tm, INPUT_TIMES, false, false},
+    {"unpack_tm", bench_unpack_tm, INPUT_TIMES, false, true},
+    {"packed_tm_compare", bench_packed_tm_compare, INPUT_TIMES, false,
+     false},
+    {"tm_intraday_secs_diff", bench_tm_intraday_secs_diff, INPUT_TIMES,
+     false, false},
+    {"tm_secs_diff", bench_tm_secs_diff, INPUT_TIMES, false, true},
+    {"tm_days_diff", bench_tm_days_diff, INPUT_TIMES, false, true},
+    {"is_leap_year", bench_is_leap_year, INPUT_TIMES, false, false},
+    {"days_from_civil", bench_days_from_civil, INPUT_TIMES, false, true},
+    {"civil_from_days", bench_civil_from_days, INPUT_TIMES, false, true},
+    {"day_of_week", bench_day_of_week, INPUT_TIMES, false, false},
+    {"day_of_year", bench_day_of_year, INPUT_TIMES, false, false},
+    {"iso_week_number", bench_iso_week_number, INPUT_TIMES, false, false},
+    {"tm_add_seconds", bench_tm_add_seconds, INPUT_SPANS, false, true},
+    {"tm_add_duration", bench_tm_add_duration, INPUT_SPANS, false, true},
+    {"tm_increment_day", bench_tm_increment_day, INPUT_SPANS, false, true},
+    {"tm_increment_hour", bench_tm_increment_hour, INPUT_SPANS, false,
+     true},
+    {"tm_increment_minute", bench_tm_increment_minute, INPUT_SPANS, false,
+     true},
+    {"tm_increment_second", bench_tm_increment_second, INPUT_SPANS, false,
+     true},
+    {"tm_decrement_day", bench_tm_decrement_day, INPUT_SPANS, false, true},
+    {"tm_decrement_hour", bench_tm_decrement_hour, INPUT_SPANS, false,
+     true},
+    {"tm_decrement_minute", bench_tm_decrement_minute, INPUT_SPANS, false,
+     true},
+    {"tm_decrement_second", bench_tm_decrement_second, INPUT_SPANS, false,
+     true},
+    {"tm_increment_month", bench_tm_increment_month, INPUT_SPANS, false,
+     true},
+    {"tm_increment_year", bench_tm_increment_year, INPUT_SPANS, false,
+     true},
+    {"tm_decrement_month", bench_tm_decrement_month, INPUT_SPANS, false,
+     true},
+    {"tm_decrement_year", bench_tm_decrement_year, INPUT_SPANS, false,
+     true},
+    {"check_utc_timestamp", bench_check_utc_timestamp, INPUT_TIMES, true,
+     false},
+    {"check_utc_timestamp_r", bench_check_utc_timestamp_r, INPUT_TIMES,
+     false, true},
+    {"check_utc_timestamp_checked", bench_check_utc_timestamp_checked,
+     INPUT_TIMES, false, true},
+    {"get_utc_timestamp", bench_get_utc_timestamp, INPUT_TIMES, false,
+     true},
+    {"get_utc_timestamp_checked", bench_get_utc_timestamp_checked,
+     INPUT_TIMES, false, true},
+    {"get_utc_tm", bench_get_utc_tm, INPUT_TIMES, false, true},
+    {"get_utc_timestamp_sec_diff", bench_get_utc_timestamp_sec_diff,
+     INPUT_TIMES, true, false},
+    {"get_utc_timestamp_sec_diff_r", bench_get_utc_timestamp_sec_diff_r,
+     INPUT_TIMES, false, true},
+    {"get_utc_timestamp_sec_diff_checked",
+     bench_get_utc_timestamp_sec_diff_checked, INPUT_TIMES, false, true}
+};
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The generator state, updated on each call.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Fills a set of inputs.
+ * \param in        The set to fill.
+ * \param sorted    `true` for sorted timestamps a few seconds apart,
+ * `false` for random timestamps between 1900 and 2100.
+ * \param max_quantity The largest increment, either way.
+ * \param seed      The random seed.
+ */
+
+static void
+fill_inputs(struct input_set *in, const bool sorted, const int max_quantity,
+            uint64_t seed) {
+    time_t sorted_ts = SORTED_FIRST_TS;
+
+    for ( size_t i = 0; i < INPUT_SIZE; ++i ) {
+        if ( sorted ) {
+            sorted_ts += (time_t) (next_random(&seed) % 120);
+            in->utc_ts[i] = sorted_ts;
+        } else {
+            in->utc_ts[i] = (time_t) (RANDOM_FIRST_TS +
+                                      (int64_t) (next_random(&seed) %
+                                                 RANDOM_SPAN_TS));
+        }
+        gmtime_r(&in->utc_ts[i], &in->utc_tms[i]);
+        in->packed[i] = pack_tm(&in->utc_tms[i]);
+
+        const time_t other_ts = (time_t) (RANDOM_FIRST_TS +
+                                          (int64_t) (next_random(&seed) %
+                                                     RANDOM_SPAN_TS));
+        gmtime_r(&other_ts, &in->other_tms[i]);
+
+        in->quantity[i] = (int) (next_random(&seed) %
+                                 (2 * (uint64_t) max_quantity + 1)) -
+                          max_quantity;
+    }
+}
+
+
+/*!
+ * \brief           Worker thread function.
+ * \param arg       A pointer to a struct worker_args.
+ * \returns         A null pointer.
+ */
+
+static void *
+worker(void *arg) {
+    struct worker_args *args = arg;
+    args->checksum = args->fn(args->in);
+    return 0;
+}
+
+
+/*!
+ * \brief               Runs a benchmark and prints the result as a JSON
+ * object.
+ * \param bench         The benchmark.
+ * \param in            The inputs.
+ * \param dist          The distribution of the inputs.
+ * \param date_table    Whether the date table is active.
+ * \param num_threads   The number of threads.
+ * \param first         `true` if this is the first result printed.
+ * \returns             `true` on success, `false` if a thread could not be
+ * created.
+ */
+
+static bool
+run(const struct benchmark *bench, const struct input_set *in,
+    const enum distribution dist, const bool date_table,
+    const long num_threads, const bool first) {
+    pthread_t threads[num_threads];
+    struct worker_args args[num_threads];
+    double best = 0;
+    uint64_t checksum = 0;
+
+    for ( int r = 0; r < NUM_RUNS; ++r ) {
+        const double start = now_secs();
+        for ( long t = 0; t < num_threads; ++t ) {
+            args[t] = (struct worker_args) {bench->fn, in, 0};
+            if ( pthread_create(&threads[t], 0, worker, &args[t]) ) {
+                return false;
+            }
+        }
+        for ( long t = 0; t < num_threads; ++t ) {
+            pthread_join(threads[t], 0);
+            checksum += args[t].checksum;
+        }
+        const double elapsed = now_secs() - start;
+        if ( r == 0 || elapsed < best ) {
+            best = elapsed;
+        }
+    }
+
+    printf("%s    {\"function\": \"%s\", \"distribution\": \"%s\", "
+           "\"date_table\": %s, \"threads\": %ld, \"ns_per_op\": %.3f, "
+           "\"mops_per_sec\": %.3f, \"checksum\": %llu}",
+           first ? "" : ",\n", bench->name, distribution_names[dist],
+           date_table ? "true" : "false", num_threads,
+           best * 1e9 / OPS_PER_RUN,
+           num_threads * (double) OPS_PER_RUN / best / 1e6,
+           (unsigned long long) checksum);
+    return true;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if ( max_threads < 1 ) {
+        max_threads = 1;
+    }
+
+    struct input_set *sorted_set = malloc(sizeof *sorted_set);
+    struct input_set *random_set = malloc(sizeof *random_set);
+    struct input_set *huge_set = malloc(sizeof *huge_set);
+    if ( !sorted_set || !random_set || !huge_set ) {
+        fprintf(stderr, "bench_suite: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    fill_inputs(sorted_set, true, SMALL_QUANTITY, 1);
+    fill_inputs(random_set, false, SMALL_QUANTITY, 2);
+    fill_inputs(huge_set, false, HUGE_QUANTITY, 3);
+
+    printf("{\n  \"library\": \"pgtime\",\n  \"ops_per_run\": %d,\n"
+           "  \"runs\": %d,\n  \"max_threads\": %ld,\n  \"results\": [\n",
+           OPS_PER_RUN, NUM_RUNS, max_threads);
+
+    bool first = true;
+    const size_t num_benchmarks = sizeof benchmarks / sizeof benchmarks[0];
+
+    for ( int pass = 0; pass < 2; ++pass ) {
+        const bool date_table = pass == 1;
+        if ( date_table && !date_table_init(1900, 2100) ) {
+            fprintf(stderr, "bench_suite: couldn't build date table.\n");
+            return EXIT_FAILURE;
+        }
+
+        for ( size_t b = 0; b < num_benchmarks; ++b ) {
+            const struct benchmark *bench = &benchmarks[b];
+            if ( date_table && !bench->date_table ) {
+                continue;
+            }
+
+            //  Each kind of input has two distributions, or only one if
+            //  nothing varies.
+
+            enum distribution dists[2] = {DIST_NONE, DIST_NONE};
+            const struct input_set *inputs[2] = {random_set, random_set};
+            int num_dists = 1;
+            if ( bench->kind == INPUT_TIMES ) {
+                dists[0] = DIST_SORTED;
+                dists[1] = DIST_RANDOM;
+                inputs[0] = sorted_set;
+                num_dists = 2;
+            } else if ( bench->kind == INPUT_SPANS ) {
+                dists[0] = DIST_SMALL;
+                dists[1] = DIST_HUGE;
+                inputs[1] = huge_set;
+                num_dists = 2;
+            }
+
+            const long thread_counts[2] = {1, max_threads};
+            const int num_counts = max_threads > 1 &&
+                                   !bench->single_thread ? 2 : 1;
+
+            for ( int d = 0; d < num_dists; ++d ) {
+                for ( int c = 0; c < num_counts; ++c ) {
+                    if ( !run(bench, inputs[d], dists[d], date_table,
+                              thread_counts[c], first) ) {
+                        fprintf(stderr, "bench_suite: couldn't create "
+                                "thread.\n");
+                        return EXIT_FAILURE;
+                    }
+                    first = false;
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    date_table_free();
+    free(sorted_set);
+    free(random_set);
+    free(huge_set);
+
+    return EXIT_SUCCESS;
+}
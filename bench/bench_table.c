@@ -0,0 +1,227 @@
+/*!
+ * \file            bench_table.c
+ * \brief           Benchmark for the date table.
+ * \details         Runs civil_from_days(), days_from_civil(),
+ * get_utc_tm(), get_utc_timestamp() and tm_increment_day() on random
+ * dates between 1970 and 2100, first calculating them, then with a date
+ * table for 1970 to 2100, and then on dates between 2200 and 2300, which
+ * the table does not cover. Checks that the table gives the same results.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+
+
+/*  Number of dates in each run, and number of runs  */
+
+#define NUM_TIMES 1000000
+#define NUM_RUNS 20
+
+/*  The years the table covers  */
+
+#define FIRST_YEAR 1970
+#define LAST_YEAR 2100
+
+
+/*  The operations to time  */
+
+enum operation {
+    OP_CIVIL_FROM_DAYS,
+    OP_DAYS_FROM_CIVIL,
+    OP_GET_UTC_TM,
+    OP_GET_UTC_TIMESTAMP,
+    OP_INCREMENT_DAY
+};
+
+static const char *operation_names[] = {
+    "civil_from_days",
+    "days_from_civil",
+    "get_utc_tm",
+    "get_utc_timestamp",
+    "tm_increment_day"
+};
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Prints a result line.
+ * \param name      The name of the method.
+ * \param elapsed   The total elapsed time for all runs, in seconds.
+ * \param baseline  The elapsed time for the baseline method.
+ */
+
+static void
+report(const char *name, const double elapsed, const double baseline) {
+    const double ns_per_op = elapsed * 1e9 / ((double) NUM_TIMES * NUM_RUNS);
+    printf("%-40s %8.2f ns/op %8.2fx\n", name, ns_per_op,
+           baseline / elapsed);
+}
+
+
+/*!
+ * \brief           Runs an operation on every date.
+ * \param op        The operation.
+ * \param utc_ts    The dates as timestamps.
+ * \param utc_tms   The dates broken down.
+ * \param checksum  Modified to contain a checksum of the results.
+ * \returns         The elapsed time for all runs, in seconds.
+ */
+
+static double
+run(const enum operation op, const time_t *utc_ts, const struct tm *utc_tms,
+    uint64_t *checksum) {
+    uint64_t sum = 0;
+
+    const double start = now_secs();
+    for ( int run = 0; run < NUM_RUNS; ++run ) {
+        for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+            switch ( op ) {
+                case OP_CIVIL_FROM_DAYS: {
+                    int64_t year;
+                    int month;
+                    int day;
+                    civil_from_days(utc_ts[i] / 86400, &year, &month, &day);
+                    sum = sum * 31 + (uint64_t) (year * 512 + month * 32 +
+                                                 day);
+                    break;
+                }
+
+                case OP_DAYS_FROM_CIVIL:
+                    sum = sum * 31 +
+                          (uint64_t) days_from_civil(utc_tms[i].tm_year +
+                                                     (int64_t) 1900,
+                                                     utc_tms[i].tm_mon + 1,
+                                                     utc_tms[i].tm_mday);
+                    break;
+
+                case OP_GET_UTC_TM: {
+                    struct tm result;
+                    get_utc_tm(utc_ts[i], &result);
+                    sum = sum * 31 + (uint64_t) pack_tm(&result) +
+                          (uint64_t) (result.tm_wday * 512 + result.tm_yday);
+                    break;
+                }
+
+                case OP_GET_UTC_TIMESTAMP:
+                    sum = sum * 31 + (uint64_t) get_utc_timestamp(&utc_tms[i]);
+                    break;
+
+                case OP_INCREMENT_DAY: {
+                    struct tm result = utc_tms[i];
+                    tm_increment_day(&result, (int) (i % 61) - 30);
+                    sum = sum * 31 + (uint64_t) pack_tm(&result) +
+                          (uint64_t) (result.tm_wday * 512 + result.tm_yday);
+                    break;
+                }
+            }
+        }
+    }
+    const double elapsed = now_secs() - start;
+
+    *checksum = sum;
+    return elapsed;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    static const time_t secs_in_year = 31556952;
+    static const time_t first_in_range = 0;
+    static const time_t first_out_of_range = 7258118400;
+
+    time_t *in_range_ts = malloc(NUM_TIMES * sizeof *in_range_ts);
+    time_t *out_of_range_ts = malloc(NUM_TIMES * sizeof *out_of_range_ts);
+    struct tm *in_range_tms = malloc(NUM_TIMES * sizeof *in_range_tms);
+    struct tm *out_of_range_tms = malloc(NUM_TIMES *
+                                         sizeof *out_of_range_tms);
+    if ( !in_range_ts || !out_of_range_ts || !in_range_tms ||
+         !out_of_range_tms ) {
+        fprintf(stderr, "bench_table: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for ( size_t i = 0; i < NUM_TIMES; ++i ) {
+        const time_t offset = (time_t) (rand() % 100) * secs_in_year +
+                              rand() % secs_in_year;
+        in_range_ts[i] = first_in_range + offset;
+        out_of_range_ts[i] = first_out_of_range + offset;
+        gmtime_r(&in_range_ts[i], &in_range_tms[i]);
+        gmtime_r(&out_of_range_ts[i], &out_of_range_tms[i]);
+    }
+
+    for ( int op = OP_CIVIL_FROM_DAYS; op <= OP_INCREMENT_DAY; ++op ) {
+        uint64_t expected;
+        uint64_t checksum;
+        char name[64];
+
+        date_table_free();
+        const double baseline = run(op, in_range_ts, in_range_tms,
+                                    &expected);
+        snprintf(name, sizeof name, "%s, calculated", operation_names[op]);
+        report(name, baseline, baseline);
+
+        if ( !date_table_init(FIRST_YEAR, LAST_YEAR) ) {
+            fprintf(stderr, "bench_table: couldn't build table.\n");
+            return EXIT_FAILURE;
+        }
+        snprintf(name, sizeof name, "%s, table", operation_names[op]);
+        report(name, run(op, in_range_ts, in_range_tms, &checksum),
+               baseline);
+        if ( checksum != expected ) {
+            fprintf(stderr, "bench_table: %s results differ.\n",
+                    operation_names[op]);
+            return EXIT_FAILURE;
+        }
+
+        //  Dates outside the table should cost little more than they did
+        //  without one.
+
+        date_table_free();
+        const double outside_baseline = run(op, out_of_range_ts,
+                                            out_of_range_tms, &expected);
+        date_table_init(FIRST_YEAR, LAST_YEAR);
+        snprintf(name, sizeof name, "%s, outside table",
+                 operation_names[op]);
+        report(name, run(op, out_of_range_ts, out_of_range_tms, &checksum),
+               outside_baseline);
+        if ( checksum != expected ) {
+            fprintf(stderr, "bench_table: %s results differ outside "
+                    "the table.\n", operation_names[op]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    date_table_free();
+    free(in_range_ts);
+    free(out_of_range_ts);
+    free(in_range_tms);
+    free(out_of_range_tms);
+
+    return EXIT_SUCCESS;
+}
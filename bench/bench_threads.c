@@ -0,0 +1,176 @@
+/*!
+ * \file            bench_threads.c
+ * \brief           Multithreaded stress benchmark for the reentrant
+ * UTC functions.
+ * \details         Runs a fixed number of timestamp round trips on 1, 2, 4
+ * and so on up to the number of online processors, and reports the total
+ * throughput for each thread count. The reentrant functions are run
+ * without any locking, and check_utc_timestamp() is run behind a mutex
+ * for comparison, since that is how it has to be used from more than one
+ * thread.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pgtime.h"
+
+
+/*  Number of round trips each thread makes  */
+
+#define OPS_PER_THREAD 2000000L
+
+
+/*  Arguments passed to each worker thread  */
+
+struct worker_args {
+    bool locked;
+    time_t start;
+    long failures;
+};
+
+static pthread_mutex_t gmtime_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*!
+ * \brief           Returns the current monotonic time in seconds.
+ * \returns         The current monotonic time in seconds.
+ */
+
+static double
+now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*!
+ * \brief           Worker thread function.
+ * \details         Breaks down a sequence of timestamps, converts them
+ * back, and checks the round trip.
+ * \param arg       A pointer to a struct worker_args.
+ * \returns         A null pointer.
+ */
+
+static void *
+worker(void *arg) {
+    struct worker_args *args = arg;
+    time_t check_time = args->start;
+
+    for ( long i = 0; i < OPS_PER_THREAD; ++i ) {
+        struct tm utc_tm;
+        struct tm utc_buf;
+        int secs_diff;
+        bool agrees;
+
+        get_utc_tm(check_time, &utc_tm);
+        const time_t utc_ts = get_utc_timestamp(&utc_tm);
+
+        if ( args->locked ) {
+            pthread_mutex_lock(&gmtime_mutex);
+            agrees = check_utc_timestamp(utc_ts, &secs_diff, &utc_tm);
+            pthread_mutex_unlock(&gmtime_mutex);
+        } else {
+            agrees = check_utc_timestamp_r(utc_ts, &secs_diff,
+                                           &utc_tm, &utc_buf);
+        }
+
+        if ( !agrees ) {
+            ++args->failures;
+        }
+
+        check_time += 7919;
+    }
+
+    return 0;
+}
+
+
+/*!
+ * \brief           Runs the benchmark for one thread count.
+ * \param num_threads The number of threads to run.
+ * \param locked    `true` to use check_utc_timestamp() behind a mutex,
+ * `false` to use check_utc_timestamp_r() without locking.
+ * \returns         The total throughput, in operations per second.
+ */
+
+static double
+run(const int num_threads, const bool locked) {
+    pthread_t threads[num_threads];
+    struct worker_args args[num_threads];
+
+    const double start = now_secs();
+
+    for ( int i = 0; i < num_threads; ++i ) {
+        args[i].locked = locked;
+        args[i].start = 86400 * 365 * (time_t) i;
+        args[i].failures = 0;
+        if ( pthread_create(&threads[i], 0, worker, &args[i]) != 0 ) {
+            fprintf(stderr, "bench_threads: couldn't create thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    long failures = 0;
+    for ( int i = 0; i < num_threads; ++i ) {
+        pthread_join(threads[i], 0);
+        failures += args[i].failures;
+    }
+
+    const double elapsed = now_secs() - start;
+
+    if ( failures ) {
+        fprintf(stderr, "bench_threads: %ld round trips failed.\n", failures);
+        exit(EXIT_FAILURE);
+    }
+
+    return num_threads * OPS_PER_THREAD / elapsed;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if ( max_threads < 1 ) {
+        max_threads = 1;
+    }
+
+    printf("%8s %16s %10s %16s %10s\n", "threads",
+           "reentrant op/s", "scaling", "mutex op/s", "scaling");
+
+    double reentrant_base = 0;
+    double locked_base = 0;
+
+    for ( int num_threads = 1; num_threads <= max_threads;
+          num_threads = num_threads < max_threads &&
+                        num_threads * 2 > max_threads ?
+                        max_threads : num_threads * 2 ) {
+        const double reentrant = run(num_threads, false);
+        const double locked = run(num_threads, true);
+
+        if ( num_threads == 1 ) {
+            reentrant_base = reentrant;
+            locked_base = locked;
+        }
+
+        printf("%8d %16.0f %9.2fx %16.0f %9.2fx\n", num_threads,
+               reentrant, reentrant / reentrant_base,
+               locked, locked / locked_base);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -7,40 +7,185 @@
  */
 
 
+#define __STDC_WANT_LIB_EXT1__ 1
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+//  Give the functions in pgtime_inline.h external linkage here.
+
+#define PGTIME_INLINE_LINKAGE
 #include "pgtime.h"
+#include "pgtime_inline.h"
+#include "pgtime_internal.h"
+
+
+/*
+ *  Layout of a packed_tm, from the most significant bit down. The year is
+ *  stored with its sign bit flipped, so that negative years sort before
+ *  positive ones. The low six bits are unused, and always zero.
+ */
+
+#define PACKED_YEAR_SHIFT 32
+#define PACKED_YEAR_BIAS 0x80000000u
+#define PACKED_MON_SHIFT 28
+#define PACKED_MON_MASK 0xF
+#define PACKED_MDAY_SHIFT 23
+#define PACKED_MDAY_MASK 0x1F
+#define PACKED_HOUR_SHIFT 18
+#define PACKED_HOUR_MASK 0x1F
+#define PACKED_MIN_SHIFT 12
+#define PACKED_MIN_MASK 0x3F
+#define PACKED_SEC_SHIFT 6
+#define PACKED_SEC_MASK 0x3F
+
+/*  Largest span in days that tm_add_seconds() and tm_add_duration()
+ *  accept. Anything longer overflows tm_year.  */
+
+#define MAX_SHIFT_DAYS (INT64_C(1) << 40)
+
+/*
+ *  Layout of a day in the date table, from the least significant bit up.
+ *  The year is stored as an offset from the first year of the table, so a
+ *  table can cover at most DATE_TABLE_MAX_YEARS years.
+ */
+
+#define DATE_YDAY_MASK 0x1FF
+#define DATE_WDAY_SHIFT 9
+#define DATE_WDAY_MASK 0x7
+#define DATE_MDAY_SHIFT 12
+#define DATE_MDAY_MASK 0x1F
+#define DATE_MON_SHIFT 17
+#define DATE_MON_MASK 0xF
+#define DATE_YEAR_SHIFT 21
+#define DATE_TABLE_MAX_YEARS 2048
+
+
+#if !defined(PGTIME_POSIX_TIME_T) && !defined(__STDC_NO_THREADS__)
+#include <threads.h>
+#endif
+
+
+/*  Days in each month of a common year  */
+
+static const int days_in_month[12] = {31, 28, 31, 30, 31, 30,
+                                      31, 31, 30, 31, 30, 31};
+
+/*  Days in the year before the start of each month, in common and in
+ *  leap years  */
+
+static const int days_before_month[2][12] = {
+    {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334},
+    {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335}
+};
+
+/*  Day of the week offsets for each month, for day_of_week(), with
+ *  January and February counted at the end of the previous year  */
+
+static const int month_wday_offsets[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+
+
+/*!
+ * \brief       A precomputed table of dates over a range of years.
+ * \details     `days` holds the packed date of every day in the range,
+ * and `month_starts` the first day of every month, with one more entry
+ * for the day after the range ends. Both count days from `first_day`.
+ */
+
+struct date_table {
+    int64_t first_day;              /*!<  Serial day of the first day  */
+    int64_t first_year;             /*!<  First year covered  */
+    uint64_t num_days;              /*!<  Number of days covered  */
+    uint64_t num_years;             /*!<  Number of years covered  */
+    const uint32_t *month_starts;   /*!<  First day of each month  */
+    const uint32_t *days;           /*!<  Packed date of each day  */
+};
+
+/*  The date table set up by date_table_init(), or a null pointer  */
+
+static _Atomic(struct date_table *) active_date_table;
+
+
+/*!
+ * \brief           Returns the active date table.
+ * \returns         A pointer to the table, or a null pointer if
+ * date_table_init() has not been called.
+ */
+
+static inline const struct date_table *
+get_date_table(void) {
+    return atomic_load_explicit(&active_date_table, memory_order_acquire);
+}
 
 
 /*!
- * \brief           Checks whether a supplied date is valid.
- * \details         This function does not support leap seconds, and will
- * return false if `check_tm->tm_sec == 60`.
+ * \brief           Returns a description of a status code.
+ * \param status    The status code.
+ * \returns         A string describing the status, without a final full
+ * stop.
+ */
+
+const char *
+pgtime_status_message(const enum pgtime_status status) {
+    switch ( status ) {
+        case PGTIME_OK:
+            return "success";
+        case PGTIME_INVALID_DATE:
+            return "invalid date";
+        case PGTIME_OUT_OF_RANGE:
+            return "couldn't get UTC time";
+        case PGTIME_NO_CALENDAR:
+            return "couldn't get calendar time";
+        case PGTIME_INACCURATE:
+            return "UTC timestamp is inaccurate";
+    }
+    return "unknown status";
+}
+
+
+/*!
+ * \brief           Reports a failure and exits.
+ * \details         This is the only place the library writes to stderr or
+ * exits, and is only reached from the functions which shadow the checked
+ * interface. It is marked cold, so that the failure paths are kept out of
+ * the way of the hot paths.
+ * \param file      The source file of the failure.
+ * \param line      The source line of the failure.
+ * \param status    The status describing the failure.
+ */
+
+static _Noreturn void PGTIME_COLD
+fail(const char *file, const int line, const enum pgtime_status status) {
+    fprintf(stderr, "pgtime:%s:%d: %s.\n", file, line,
+            pgtime_status_message(status));
+    exit(EXIT_FAILURE);
+}
+
+
+/*!
+ * \brief           Compares a struct tm with the UTC time for a timestamp.
+ * \param utc_tm    The UTC time for the timestamp.
+ * \param secs_diff Modified to contain the difference, in seconds.
  * \param check_tm  A pointer to a struct tm containing the date to check.
- * \returns         true if the date if valid, false otherwise.
+ * \returns         PGTIME_OK if they agree, PGTIME_INACCURATE otherwise.
  */
 
-bool
-validate_date(const struct tm *check_tm) {
-    static const int days_in_month[] = {31, 28, 31, 30, 31, 30,
-                                        31, 31, 30, 31, 30, 31};
-
-    if ( ( check_tm->tm_year == -1900 ) ||
-         ( check_tm->tm_mon < 0 || check_tm->tm_mon > 11 ) ||
-         ( check_tm->tm_mday < 1 ) ||
-         ( check_tm->tm_mday > days_in_month[check_tm->tm_mon] &&
-                !(check_tm->tm_mon == 1 &&
-                  check_tm->tm_mday == 29 &&
-                  is_leap_year(check_tm->tm_year + 1900)) ) ||
-         ( check_tm->tm_hour < 0 || check_tm->tm_hour > 23 ) ||
-         ( check_tm->tm_min < 0 || check_tm->tm_min > 59 ) ||
-         ( check_tm->tm_sec < 0 || check_tm->tm_sec > 59 ) ) {
-        return false;
+static enum pgtime_status
+compare_utc_tm(const struct tm *utc_tm, int *secs_diff,
+               const struct tm *check_tm) {
+    if ( tm_compare(check_tm, utc_tm) ) {
+        *secs_diff = tm_intraday_secs_diff(check_tm, utc_tm);
+        return PGTIME_INACCURATE;
     }
-    return true;
+
+    *secs_diff = 0;
+    return PGTIME_OK;
 }
 
 
@@ -55,7 +200,7 @@ validate_date(const struct tm *check_tm) {
  * calendar changes occur. We therefore need a method to check if the
  * returned timestamp is accurate. Other functions provided in this
  * library call this function, so the user should not normally need to
- * call it.
+ * call it. The program exits if gmtime() fails.
  * \param check_time The time_t timestamp to check
  * \param secs_diff Modified to contain the difference, in seconds
  * \param check_tm  A pointer to a struct tm containing the date to check.
@@ -65,50 +210,118 @@ validate_date(const struct tm *check_tm) {
 bool
 check_utc_timestamp(const time_t check_time, int * secs_diff,
                     const struct tm *check_tm) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_CHECK_TIMESTAMP);
+    PGTIME_COUNT(PGTIME_COUNTER_GMTIME);
     struct tm *ptm = gmtime(&check_time);
     if ( ptm == 0 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get UTC time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        fail(__FILE__, __LINE__, PGTIME_OUT_OF_RANGE);
     }
 
     struct tm compare_tm = *ptm;
+    const bool agrees = compare_utc_tm(&compare_tm, secs_diff, check_tm) ==
+                        PGTIME_OK;
+    PGTIME_PROBE_END(PGTIME_PROBE_CHECK_TIMESTAMP, start);
+    return agrees;
+}
 
-    bool agrees = tm_compare(check_tm, &compare_tm) ? false : true; 
-    if ( agrees ) {
-        *secs_diff = 0;
-    } else {
-        *secs_diff = tm_intraday_secs_diff(check_tm, &compare_tm);
+
+/*!
+ * \brief       Checks if a UTC timestamp is accurate, without using any
+ * shared storage.
+ * \details     This is a reentrant version of check_utc_timestamp(). The
+ * timestamp is broken down with get_utc_tm() into the caller-supplied
+ * `utc_buf` rather than with gmtime(), so it is safe to call from any
+ * number of threads at once, wherever get_utc_tm() is. The program exits
+ * if the timestamp cannot be broken down; check_utc_timestamp_checked()
+ * reports that instead.
+ * \param check_time The time_t timestamp to check
+ * \param secs_diff Modified to contain the difference, in seconds
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \param utc_buf   Modified to contain the UTC time for `check_time`.
+ * \returns     true if the supplied timestamp is accurate, false otherwise
+ */
+
+bool
+check_utc_timestamp_r(const time_t check_time, int * secs_diff,
+                      const struct tm *check_tm, struct tm *utc_buf) {
+    const enum pgtime_status status =
+        check_utc_timestamp_checked(check_time, secs_diff, check_tm,
+                                    utc_buf);
+    if ( status == PGTIME_OUT_OF_RANGE ) {
+        fail(__FILE__, __LINE__, status);
     }
 
-    return agrees;
+    return status == PGTIME_OK;
 }
 
 
 /*!
- * \brief       Returns a time_t interval representing one day.
- * \details     Returns a time_t interval representing one day. The C
- * standard does not define the units in which a time_t value is measured.
- * On POSIX-compliant systems it is measured in seconds, but we cannot
- * assume this for full portability.
- * \returns     A time_t interval representing one day.
- * \throws      bad_time if the current time cannot be obtained.
+ * \brief           Checks if a UTC timestamp is accurate, and returns a
+ * status code.
+ * \details         This is check_utc_timestamp_r(), but never prints or
+ * exits.
+ * \param check_time The time_t timestamp to check
+ * \param secs_diff Modified to contain the difference, in seconds
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \param utc_buf   Modified to contain the UTC time for `check_time`.
+ * \returns         PGTIME_OK if the timestamp is accurate,
+ * PGTIME_INACCURATE if it is not, and PGTIME_OUT_OF_RANGE if it cannot be
+ * broken down, in which case `secs_diff` is unchanged.
+ */
+
+enum pgtime_status
+check_utc_timestamp_checked(const time_t check_time, int *secs_diff,
+                            const struct tm *check_tm, struct tm *utc_buf) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_CHECK_TIMESTAMP);
+    enum pgtime_status status = PGTIME_OUT_OF_RANGE;
+
+    if ( get_utc_tm(check_time, utc_buf) ) {
+        status = compare_utc_tm(utc_buf, secs_diff, check_tm);
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_CHECK_TIMESTAMP, start);
+    return status;
+}
+
+
+#ifndef PGTIME_POSIX_TIME_T
+
+/*  Intervals measured by calibrate_diffs(), and whether it succeeded  */
+
+static time_t cached_day_diff;
+static time_t cached_hour_diff;
+static time_t cached_sec_diff;
+static enum pgtime_status cached_diffs_status;
+
+#ifndef __STDC_NO_THREADS__
+static once_flag diffs_calibrated = ONCE_FLAG_INIT;
+#endif
+
+
+/*!
+ * \brief       Returns the time_t interval between a datum time and a
+ * time offset from it.
+ * \param days  The number of days to offset the datum by.
+ * \param hours The number of hours to offset the datum by.
+ * \param secs  The number of seconds to offset the datum by.
+ * \param result Modified to contain the time_t interval.
+ * \returns     PGTIME_OK on success, or PGTIME_NO_CALENDAR if mktime()
+ * fails.
  */
 
 /*
- *  The function works by setting up two struct tms a day apart and
- *  calculating the difference between the values that mktime() yields.
+ *  The function works by setting up two struct tms a fixed interval apart
+ *  and calculating the difference between the values that mktime() yields.
  *
  *  We've picked January 2 and January 3 as the dates to use, since
  *  we're likely clear of any DST or other weirdness on these dates.
  *  Since mktime() will modify the struct we pass to it if it represents
  *  a bad date, and since we reuse it, it should be good anyway.
- *
- *  The get_hour_diff() and get_sec_diff() functions work in a similar way.
  */
 
-time_t
-get_day_diff(void) {
+static enum pgtime_status
+get_datum_diff(const int days, const int hours, const int secs,
+               time_t *result) {
     struct tm datum_day;
     datum_day.tm_sec = 0;
     datum_day.tm_min = 0;
@@ -118,23 +331,88 @@ get_day_diff(void) {
     datum_day.tm_year = 30;
     datum_day.tm_isdst = -1;
 
+    PGTIME_COUNT(PGTIME_COUNTER_MKTIME);
     const time_t datum_time = mktime(&datum_day);
     if ( datum_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return PGTIME_NO_CALENDAR;
     }
 
-    datum_day.tm_mday += 1;
+    datum_day.tm_mday += days;
+    datum_day.tm_hour += hours;
+    datum_day.tm_sec += secs;
+
+    PGTIME_COUNT(PGTIME_COUNTER_MKTIME);
+    const time_t offset_time = mktime(&datum_day);
+    if ( offset_time == -1 ) {
+        return PGTIME_NO_CALENDAR;
+    }
+
+    *result = offset_time - datum_time;
+    return PGTIME_OK;
+}
+
+
+/*!
+ * \brief       Measures the time_t intervals for one day, one hour and
+ * one second.
+ * \details     This is called once only, the first time any of the
+ * intervals is needed. The intervals are fixed for the process's time_t
+ * encoding, so there is no need to call mktime() again after that.
+ */
 
-    const time_t tomorrow_time = mktime(&datum_day);
-    if ( tomorrow_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+static void
+calibrate_diffs(void) {
+    enum pgtime_status status = get_datum_diff(1, 0, 0, &cached_day_diff);
+    if ( status == PGTIME_OK ) {
+        status = get_datum_diff(0, 1, 0, &cached_hour_diff);
     }
+    if ( status == PGTIME_OK ) {
+        status = get_datum_diff(0, 0, 1, &cached_sec_diff);
+    }
+    cached_diffs_status = status;
+}
+
 
-    return (tomorrow_time - datum_time);
+/*!
+ * \brief       Makes sure calibrate_diffs() has been called.
+ * \details     Where C11 threads are available, this uses call_once() so
+ * that it is safe to call from any thread. Elsewhere, the intervals are
+ * measured again on each call.
+ * \returns     The status of the calibration.
+ */
+
+static enum pgtime_status
+ensure_diffs_calibrated(void) {
+#ifndef __STDC_NO_THREADS__
+    call_once(&diffs_calibrated, calibrate_diffs);
+#else
+    calibrate_diffs();
+#endif
+    return cached_diffs_status;
+}
+
+#endif          /*  PGTIME_POSIX_TIME_T  */
+
+
+/*!
+ * \brief       Returns a time_t interval representing one day.
+ * \details     Returns a time_t interval representing one day. The C
+ * standard does not define the units in which a time_t value is measured.
+ * On POSIX-compliant systems it is measured in seconds, and this function
+ * returns a constant. Elsewhere the interval is measured with mktime() the
+ * first time it is needed, and the cached value is returned thereafter.
+ * The program exits if mktime() fails.
+ * \returns     A time_t interval representing one day.
+ */
+
+time_t
+get_day_diff(void) {
+    time_t diff;
+    const enum pgtime_status status = get_day_diff_checked(&diff);
+    if ( status != PGTIME_OK ) {
+        fail(__FILE__, __LINE__, status);
+    }
+    return diff;
 }
 
 
@@ -142,40 +420,21 @@ get_day_diff(void) {
  * \brief       Returns a time_t interval representing one hour.
  * \details     Returns a time_t interval representing one hour. The C
  * standard does not define the units in which a time_t value is measured.
- * On POSIX-compliant systems it is measured in seconds, but we cannot
- * assume this for full portability.
+ * On POSIX-compliant systems it is measured in seconds, and this function
+ * returns a constant. Elsewhere the interval is measured with mktime() the
+ * first time it is needed, and the cached value is returned thereafter.
+ * The program exits if mktime() fails.
  * \returns     A time_t interval representing one hour.
- * \throws      bad_time if the current time cannot be obtained.
  */
 
 time_t
 get_hour_diff(void) {
-    struct tm datum_day;
-    datum_day.tm_sec = 0;
-    datum_day.tm_min = 0;
-    datum_day.tm_hour = 12;
-    datum_day.tm_mday = 2;
-    datum_day.tm_mon = 0;
-    datum_day.tm_year = 30;
-    datum_day.tm_isdst = -1;
-
-    const time_t datum_time = mktime(&datum_day);
-    if ( datum_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+    time_t diff;
+    const enum pgtime_status status = get_hour_diff_checked(&diff);
+    if ( status != PGTIME_OK ) {
+        fail(__FILE__, __LINE__, status);
     }
-
-    datum_day.tm_hour += 1;
-
-    const time_t nexthour_time = mktime(&datum_day);
-    if ( nexthour_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
-    }
-
-    return (nexthour_time - datum_time);
+    return diff;
 }
 
 
@@ -183,75 +442,255 @@ get_hour_diff(void) {
  * \brief       Returns a time_t interval representing one second.
  * \details     Returns a time_t interval representing one second. The C
  * standard does not define the units in which a time_t value is measured.
- * On POSIX-compliant systems it is measured in seconds, but we cannot
- * assume this for full portability.
+ * On POSIX-compliant systems it is measured in seconds, and this function
+ * returns a constant. Elsewhere the interval is measured with mktime() the
+ * first time it is needed, and the cached value is returned thereafter.
+ * The program exits if mktime() fails.
  * \returns     A time_t interval representing one second.
- * \throws      bad_time if the current time cannot be obtained.
  */
 
 time_t
 get_sec_diff(void) {
-    struct tm datum_day;
-    datum_day.tm_sec = 0;
-    datum_day.tm_min = 0;
-    datum_day.tm_hour = 12;
-    datum_day.tm_mday = 2;
-    datum_day.tm_mon = 0;
-    datum_day.tm_year = 30;
-    datum_day.tm_isdst = -1;
+    time_t diff;
+    const enum pgtime_status status = get_sec_diff_checked(&diff);
+    if ( status != PGTIME_OK ) {
+        fail(__FILE__, __LINE__, status);
+    }
+    return diff;
+}
 
-    const time_t datum_time = mktime(&datum_day);
-    if ( datum_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+
+/*!
+ * \brief           Gets a time_t interval representing one day, and
+ * returns a status code.
+ * \param result    Modified to contain the interval.
+ * \returns         PGTIME_OK on success, or PGTIME_NO_CALENDAR if the
+ * interval could not be measured, in which case `result` is unchanged.
+ */
+
+enum pgtime_status
+get_day_diff_checked(time_t *result) {
+#ifdef PGTIME_POSIX_TIME_T
+    static const time_t secs_in_day = 86400;
+
+    *result = secs_in_day;
+    return PGTIME_OK;
+#else
+    const enum pgtime_status status = ensure_diffs_calibrated();
+    if ( status == PGTIME_OK ) {
+        *result = cached_day_diff;
+    }
+    return status;
+#endif
+}
+
+
+/*!
+ * \brief           Gets a time_t interval representing one hour, and
+ * returns a status code.
+ * \param result    Modified to contain the interval.
+ * \returns         PGTIME_OK on success, or PGTIME_NO_CALENDAR if the
+ * interval could not be measured, in which case `result` is unchanged.
+ */
+
+enum pgtime_status
+get_hour_diff_checked(time_t *result) {
+#ifdef PGTIME_POSIX_TIME_T
+    static const time_t secs_in_hour = 3600;
+
+    *result = secs_in_hour;
+    return PGTIME_OK;
+#else
+    const enum pgtime_status status = ensure_diffs_calibrated();
+    if ( status == PGTIME_OK ) {
+        *result = cached_hour_diff;
+    }
+    return status;
+#endif
+}
+
+
+/*!
+ * \brief           Gets a time_t interval representing one second, and
+ * returns a status code.
+ * \param result    Modified to contain the interval.
+ * \returns         PGTIME_OK on success, or PGTIME_NO_CALENDAR if the
+ * interval could not be measured, in which case `result` is unchanged.
+ */
+
+enum pgtime_status
+get_sec_diff_checked(time_t *result) {
+#ifdef PGTIME_POSIX_TIME_T
+    *result = 1;
+    return PGTIME_OK;
+#else
+    const enum pgtime_status status = ensure_diffs_calibrated();
+    if ( status == PGTIME_OK ) {
+        *result = cached_sec_diff;
+    }
+    return status;
+#endif
+}
+
+
+/*!
+ * \brief       Packs a struct tm into a packed_tm.
+ * \details     The year, month, day, hour, minute and second are packed
+ * into a single 64-bit integer, most significant field first, so that
+ * comparing two packed_tm values as ordinary unsigned integers gives the
+ * same ordering as tm_compare(). All years that fit in `tm_year` are
+ * supported. The other fields must be in their normal ranges, as checked
+ * by validate_date(), except that `tm_sec` may be 60 for a leap second.
+ * Any timezone or DST information is ignored.
+ * \param src   The struct tm to pack.
+ * \returns     The packed date and time.
+ */
+
+packed_tm
+pack_tm(const struct tm *src) {
+    return ((uint64_t) ((uint32_t) src->tm_year ^ PACKED_YEAR_BIAS)
+                << PACKED_YEAR_SHIFT) |
+           ((uint64_t) src->tm_mon << PACKED_MON_SHIFT) |
+           ((uint64_t) src->tm_mday << PACKED_MDAY_SHIFT) |
+           ((uint64_t) src->tm_hour << PACKED_HOUR_SHIFT) |
+           ((uint64_t) src->tm_min << PACKED_MIN_SHIFT) |
+           ((uint64_t) src->tm_sec << PACKED_SEC_SHIFT);
+}
+
+
+/*!
+ * \brief       Returns true if a year is a leap year.
+ * \details     This is is_leap_year() for years that may not fit in an int.
+ * \param year  The year, e.g. 2013.
+ * \returns     `true` if `year` is a leap year, `false` otherwise.
+ */
+
+static bool
+is_leap_year_64(const int64_t year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+
+/*!
+ * \brief       Sets the day of the week and day of the year of a struct tm.
+ * \details     Both are found in constant time, the first from the serial
+ * day number and the second from a table, so there is no need to call
+ * mktime() to normalize them.
+ * \param date  The struct tm, with `tm_year`, `tm_mon` and `tm_mday` in
+ * their normal ranges.
+ * \param days  The serial day number of the date.
+ */
+
+static void
+tm_set_wday_yday(struct tm *date, const int64_t days) {
+    static const int days_in_week = 7;
+
+    //  1970-01-01 was a Thursday.
+
+    static const int epoch_wday = 4;
+
+    const bool leap = is_leap_year_64(date->tm_year + (int64_t) 1900);
+
+    date->tm_wday = (int) (days + epoch_wday -
+                           floor_div(days + epoch_wday, days_in_week) *
+                           days_in_week);
+    date->tm_yday = days_before_month[leap][date->tm_mon] + date->tm_mday - 1;
+}
+
+
+/*!
+ * \brief           Sets the date of a struct tm from a serial day number.
+ * \details         Sets `tm_year`, `tm_mon`, `tm_mday`, `tm_wday` and
+ * `tm_yday`, with a single lookup for days in the date table.
+ * \param date      The struct tm to set.
+ * \param days      The number of days since 1970-01-01.
+ * \returns         `true` on success, or `false` if the year cannot be
+ * represented in a struct tm, in which case `date` is unchanged.
+ */
+
+static bool
+tm_set_date(struct tm *date, const int64_t days) {
+    const struct date_table *table = get_date_table();
+    if ( table ) {
+        const uint64_t index = (uint64_t) days - (uint64_t) table->first_day;
+        if ( index < table->num_days ) {
+            const uint32_t packed = table->days[index];
+            date->tm_year = (int) (table->first_year - 1900 +
+                                   (packed >> DATE_YEAR_SHIFT));
+            date->tm_mon = (int) (packed >> DATE_MON_SHIFT & DATE_MON_MASK);
+            date->tm_mday = (int) (packed >> DATE_MDAY_SHIFT &
+                                   DATE_MDAY_MASK);
+            date->tm_wday = (int) (packed >> DATE_WDAY_SHIFT &
+                                   DATE_WDAY_MASK);
+            date->tm_yday = (int) (packed & DATE_YDAY_MASK);
+            PGTIME_COUNT(PGTIME_COUNTER_TABLE_HIT);
+            return true;
+        }
+        PGTIME_COUNT(PGTIME_COUNTER_TABLE_MISS);
     }
 
-    datum_day.tm_sec += 1;
+    int64_t year;
+    int month;
+    int day;
 
-    const time_t nextsec_time = mktime(&datum_day);
-    if ( nextsec_time == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+    civil_from_days(days, &year, &month, &day);
+    if ( year - 1900 > INT_MAX || year - 1900 < INT_MIN ) {
+        PGTIME_COUNT(PGTIME_COUNTER_OVERFLOW);
+        return false;
     }
 
-    return (nextsec_time - datum_time);
+    date->tm_year = (int) (year - 1900);
+    date->tm_mon = month - 1;
+    date->tm_mday = day;
+    tm_set_wday_yday(date, days);
+
+    return true;
 }
 
 
 /*!
- * \brief       Compares two struct tm structs.
- * \details     Compares two struct tm structs. Only the year, month, day,
- * hour, minute and second are compared. Any timezone or DST information
- * is ignored.
- * \param first The first struct tm struct.
- * \param second The second struct tm struct.
+ * \brief           Unpacks a packed_tm into a struct tm.
+ * \details         The year, month, day, hour, minute and second are
+ * restored exactly as they were passed to pack_tm(). `tm_wday` and
+ * `tm_yday` are calculated from the date, and `tm_isdst` is set to zero.
+ * \param packed    The packed date and time.
+ * \param result    A pointer to a struct tm to receive the unpacked time.
+ * \returns         `result`.
+ */
+
+struct tm*
+unpack_tm(const packed_tm packed, struct tm *result) {
+    result->tm_year = (int) ((uint32_t) (packed >> PACKED_YEAR_SHIFT) ^
+                             PACKED_YEAR_BIAS);
+    result->tm_mon = (int) (packed >> PACKED_MON_SHIFT & PACKED_MON_MASK);
+    result->tm_mday = (int) (packed >> PACKED_MDAY_SHIFT & PACKED_MDAY_MASK);
+    result->tm_hour = (int) (packed >> PACKED_HOUR_SHIFT & PACKED_HOUR_MASK);
+    result->tm_min = (int) (packed >> PACKED_MIN_SHIFT & PACKED_MIN_MASK);
+    result->tm_sec = (int) (packed >> PACKED_SEC_SHIFT & PACKED_SEC_MASK);
+
+    tm_set_wday_yday(result, days_from_civil(result->tm_year + (int64_t) 1900,
+                                             result->tm_mon + 1,
+                                             result->tm_mday));
+    result->tm_isdst = 0;
+
+    return result;
+}
+
+
+/*!
+ * \brief       Compares two packed_tm values.
+ * \details     This gives the same result as tm_compare() on the unpacked
+ * values, without any branches. Where only a less-than or equality test is
+ * needed, the packed values can simply be compared directly.
+ * \param first The first packed_tm.
+ * \param second The second packed_tm.
  * \returns     -1 if `first` is earlier than `second`, 1 if `first` is later
  * than `second`, and 0 if `first` is equal to `second`.
  */
 
 int
-tm_compare(const struct tm *first, const struct tm *second) {
-    int compare_result;
-
-    if ( first->tm_year != second->tm_year ) {
-        compare_result = first->tm_year > second->tm_year ? 1 : -1;
-    } else if ( first->tm_mon != second->tm_mon ) {
-        compare_result = first->tm_mon > second->tm_mon ? 1 : -1;
-    } else if ( first->tm_mday != second->tm_mday ) {
-        compare_result = first->tm_mday > second->tm_mday ? 1 : -1;
-    } else if ( first->tm_hour != second->tm_hour ) {
-        compare_result = first->tm_hour > second->tm_hour ? 1 : -1;
-    } else if ( first->tm_min != second->tm_min ) {
-        compare_result = first->tm_min > second->tm_min ? 1 : -1;
-    } else if ( first->tm_sec != second->tm_sec ) {
-        compare_result = first->tm_sec > second->tm_sec ? 1 : -1;
-    } else {
-        compare_result = 0;
-    }
-
-    return compare_result;
+packed_tm_compare(const packed_tm first, const packed_tm second) {
+    return (first > second) - (first < second);
 }
 
 
@@ -297,448 +736,870 @@ tm_intraday_secs_diff(const struct tm *first, const struct tm *second) {
 
 
 /*!
- * \brief           Checks if the supplied year is a leap year.
- * \details         Checks if the supplied year is a leap year.
- * \param year      A year
- * \returns         `true` if `year` is a leap year, `false` otherwise.
+ * \brief       Returns the serial day number of the date in a struct tm.
+ * \param date  The struct tm. The fields need not be in their normal
+ * ranges.
+ * \returns     The number of days since 1970-01-01.
  */
 
-bool
-is_leap_year(const int year) {
-    bool leap_year;
-    if ( year % 4 == 0 &&
-         (year % 100 != 0 ||
-          year % 400 == 0) ) {
-        leap_year = true;
-    } else {
-        leap_year = false;
-    }
-    return leap_year;
+static int64_t
+tm_serial_days(const struct tm *date) {
+    return days_from_civil(date->tm_year + (int64_t) 1900,
+                           (int64_t) date->tm_mon + 1, date->tm_mday);
 }
 
 
 /*!
- * \brief               Adds one or more days to a struct tm, incrementing
- * the month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to increment. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of days to add
- * \returns             A pointer to the same struct tm.
+ * \brief       Returns the exact difference in seconds between two struct
+ * tm structs.
+ * \details     Unlike tm_intraday_secs_diff(), the structs may be any
+ * distance apart. The difference is computed directly from the fields with
+ * serial day numbers, in constant time, without converting either struct
+ * to a time_t. The fields need not be in their normal ranges. Leap seconds
+ * are not counted.
+ * \param first The first struct tm struct
+ * \param second The second struct tm struct
+ * \returns     The difference, in seconds, between the two struct tm
+ * structs. The difference is positive if `first` is earlier than `second`,
+ * and negative if `second` is earlier than `first`.
  */
 
-struct tm*
-tm_increment_day(struct tm *changing_tm, const int quantity) {
-    enum months {january, february, march, april, may, june, july,
-                 august, september, october, november, december};
+int64_t
+tm_secs_diff(const struct tm *first, const struct tm *second) {
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
 
-    if ( quantity < 0 ) {
-        tm_decrement_day(changing_tm, -quantity);
-    } else {
-        int num_days = quantity;
-
-        while ( num_days-- ) {
-            changing_tm->tm_mday += 1;
-            switch ( changing_tm->tm_mon ) {
-                case january:
-                case march:
-                case may:
-                case july:
-                case august:
-                case october:
-                    if ( changing_tm->tm_mday > 31 ) {
-                        changing_tm->tm_mday = 1;
-                        changing_tm->tm_mon += 1;
-                    }
-                    break;
-
-                case december:
-                    if ( changing_tm->tm_mday > 31 ) {
-                        changing_tm->tm_mday = 1;
-                        changing_tm->tm_mon = 0;
-                        if ( changing_tm->tm_year == -1 ) {
-                            changing_tm->tm_year = 1;
-                        } else {
-                            changing_tm->tm_year += 1;
-                        }
-                    }
-                    break;
-
-                case april:
-                case june:
-                case september:
-                case november:
-                    if ( changing_tm->tm_mday > 30 ) {
-                        changing_tm->tm_mday = 1;
-                        changing_tm->tm_mon +=1;
-                    }
-                    break;
-
-                case 1:
-                    if ( changing_tm->tm_mday > 29 ) {
-                        changing_tm->tm_mday = 1;
-                        changing_tm->tm_mon += 1;
-                    } else if ( changing_tm->tm_mday > 28 &&
-                                !is_leap_year(changing_tm->tm_year) ) {
-                        changing_tm->tm_mday = 1;
-                        changing_tm->tm_mon += 1;
-                    }
-                    break;
-
-                default:
-                    assert(false);
-                    break;
-            }
+    return (tm_serial_days(second) - tm_serial_days(first)) * secs_in_day +
+           (second->tm_hour - (int64_t) first->tm_hour) * secs_in_hour +
+           (second->tm_min - (int64_t) first->tm_min) * secs_in_min +
+           (second->tm_sec - (int64_t) first->tm_sec);
+}
+
+
+/*!
+ * \brief       Returns the difference in calendar days between two struct
+ * tm structs.
+ * \details     Only the dates are compared, and the times of day are
+ * ignored, so 23:00 on one day and 01:00 on the next are one day apart.
+ * This runs in constant time for any two dates.
+ * \param first The first struct tm struct
+ * \param second The second struct tm struct
+ * \returns     The difference, in days, between the two dates. The
+ * difference is positive if `first` is earlier than `second`, and negative
+ * if `second` is earlier than `first`.
+ */
+
+int64_t
+tm_days_diff(const struct tm *first, const struct tm *second) {
+    return tm_serial_days(second) - tm_serial_days(first);
+}
+
+
+/*!
+ * \brief           Returns the serial day number of a civil date.
+ * \details         The serial day number is the number of days since
+ * 1970-01-01 in the proleptic Gregorian calendar, using astronomical
+ * year numbering (so the year before 1 is year 0). The month is
+ * not required to be in range, and is carried into the year in the same
+ * way that mktime() would. It is 64 bits wide, so that `tm_mon + 1`
+ * can be passed for any `tm_mon` without overflow. The calculation runs
+ * in constant time regardless of how far the date is from 1970, and is a
+ * single table lookup for dates in the range of the date table, if there
+ * is one.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The serial day number, which is negative for dates
+ * before 1970-01-01.
+ */
+
+int64_t
+days_from_civil(const int64_t year, const int64_t month, const int day) {
+    static const int months_in_year = 12;
+    static const int days_in_era = 146097;
+    static const int years_in_era = 400;
+    static const int epoch_offset = 719468;
+
+    const struct date_table *table = get_date_table();
+    if ( table && month >= 1 && month <= months_in_year ) {
+        const uint64_t year_index = (uint64_t) year -
+                                    (uint64_t) table->first_year;
+        if ( year_index < table->num_years ) {
+            PGTIME_COUNT(PGTIME_COUNTER_TABLE_HIT);
+            return table->first_day +
+                   table->month_starts[year_index * months_in_year +
+                                       (uint64_t) (month - 1)] + day - 1;
         }
+        PGTIME_COUNT(PGTIME_COUNTER_TABLE_MISS);
     }
 
-    return changing_tm;
+    int64_t y = year + floor_div(month - 1, months_in_year);
+    const int m = (int) (month - 1 - floor_div(month - 1, months_in_year) *
+                         months_in_year) + 1;
+
+    //  Count years from March, so that February's leap day is always
+    //  the last day of the year.
+
+    y -= m <= 2;
+    const int64_t era = floor_div(y, years_in_era);
+    const int64_t yoe = y - era * years_in_era;
+    const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + day - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * days_in_era + doe - epoch_offset;
 }
 
 
 /*!
- * \brief               Adds one or more hours to a struct tm, incrementing
- * the day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to increment. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of hours to add
- * \returns             A pointer to the same struct tm.
+ * \brief           Returns the civil date for a serial day number.
+ * \details         This is the inverse of days_from_civil(), and likewise
+ * runs in constant time, or looks the date up in the date table.
+ * \param days      The number of days since 1970-01-01.
+ * \param year      Modified to contain the year, e.g. 2013.
+ * \param month     Modified to contain the month, from 1 to 12.
+ * \param day       Modified to contain the day of the month, from 1 to 31.
  */
 
-struct tm*
-tm_increment_hour(struct tm *changing_tm, const int quantity) {
-    static const int hours_in_day = 24;
-
-    if ( quantity < 0 ) {
-        tm_decrement_hour(changing_tm, -quantity);
-    } else {
-        int num_hours = quantity;
-
-        if ( num_hours >= hours_in_day ||
-             num_hours >= hours_in_day - changing_tm->tm_hour ) {
-            int num_days = quantity / hours_in_day;
-            num_hours -= num_days * hours_in_day;
-            if ( num_hours >= hours_in_day - changing_tm->tm_hour ) {
-                ++num_days;
-                num_hours -= hours_in_day - changing_tm->tm_hour;
-                changing_tm->tm_hour = num_hours;
-            }
-            tm_increment_day(changing_tm, num_days);
+void
+civil_from_days(const int64_t days, int64_t *year, int *month, int *day) {
+    static const int days_in_era = 146097;
+    static const int years_in_era = 400;
+    static const int epoch_offset = 719468;
+
+    const struct date_table *table = get_date_table();
+    if ( table ) {
+        const uint64_t index = (uint64_t) days - (uint64_t) table->first_day;
+        if ( index < table->num_days ) {
+            const uint32_t date = table->days[index];
+            *day = (int) (date >> DATE_MDAY_SHIFT & DATE_MDAY_MASK);
+            *month = (int) (date >> DATE_MON_SHIFT & DATE_MON_MASK) + 1;
+            *year = table->first_year + (date >> DATE_YEAR_SHIFT);
+            PGTIME_COUNT(PGTIME_COUNTER_TABLE_HIT);
+            return;
         }
-
-        changing_tm->tm_hour += num_hours;
+        PGTIME_COUNT(PGTIME_COUNTER_TABLE_MISS);
     }
 
-    return changing_tm;
+    const int64_t z = days + epoch_offset;
+    const int64_t era = floor_div(z, days_in_era);
+    const int64_t doe = z - era * days_in_era;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    const int m = (int) (mp < 10 ? mp + 3 : mp - 9);
+
+    *day = (int) (doy - (153 * mp + 2) / 5 + 1);
+    *month = m;
+    *year = yoe + era * years_in_era + (m <= 2);
 }
 
 
 /*!
- * \brief               Adds one or more minutes to a struct tm, incrementing
- * the hour, day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to increment. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of minutes to add
- * \returns             A pointer to the same struct tm.
+ * \brief               Builds a table of dates to speed up conversions.
+ * \details             Once the table is built, days_from_civil(),
+ * civil_from_days(), get_utc_tm(), get_utc_timestamp() and the struct tm
+ * arithmetic functions look up dates in the range instead of calculating
+ * them, and calculate dates outside it as before. The table takes four
+ * bytes per day and per month, about 190KB for 1970 to 2100. This
+ * function is safe to call while other threads are converting dates, but
+ * only one table can be active at once.
+ * \param first_year    The first year to cover, e.g. 1970.
+ * \param last_year     The last year to cover, e.g. 2100. At most 2048
+ * years can be covered.
+ * \returns             `true` on success, `false` if the range is invalid,
+ * memory could not be allocated, or a table is already active.
  */
 
-struct tm*
-tm_increment_minute(struct tm *changing_tm, const int quantity) {
-    static const int mins_in_hour = 60;
+bool
+date_table_init(const int64_t first_year, const int64_t last_year) {
+    static const int months_in_year = 12;
+    static const int days_in_week = 7;
+
+    if ( first_year > last_year ||
+         last_year - first_year >= DATE_TABLE_MAX_YEARS ||
+         first_year < INT_MIN + (int64_t) 1900 ||
+         last_year > INT_MAX + (int64_t) 1900 ) {
+        return false;
+    }
 
-    if ( quantity < 0 ) {
-        tm_decrement_minute(changing_tm, -quantity);
-    } else {
-        int num_mins = quantity;
-
-        if ( num_mins >= mins_in_hour ||
-             num_mins >= mins_in_hour - changing_tm->tm_min ) {
-            int num_hours = quantity / mins_in_hour;
-            num_mins -= num_hours * mins_in_hour;
-            if ( num_mins >= mins_in_hour - changing_tm->tm_min ) {
-                ++num_hours;
-                changing_tm->tm_min += num_mins - mins_in_hour;
-                num_mins = 0;
+    const uint64_t num_years = (uint64_t) (last_year - first_year + 1);
+    const int64_t first_day = days_from_civil(first_year, 1, 1);
+    const uint64_t num_days = (uint64_t) (days_from_civil(last_year + 1, 1,
+                                                          1) - first_day);
+    const uint64_t num_months = num_years * months_in_year;
+
+    //  The table and its arrays share one block, so it is freed with a
+    //  single call to free().
+
+    struct date_table *table = malloc(sizeof *table +
+                                      (num_months + 1 + num_days) *
+                                      sizeof(uint32_t));
+    if ( !table ) {
+        return false;
+    }
+
+    uint32_t *const month_starts = (uint32_t *) (table + 1);
+    uint32_t *const days = month_starts + num_months + 1;
+    int wday = day_of_week(first_year, 1, 1);
+    uint64_t index = 0;
+
+    for ( uint64_t y = 0; y < num_years; ++y ) {
+        const bool leap = is_leap_year_64(first_year + (int64_t) y);
+        for ( int mon = 0; mon < months_in_year; ++mon ) {
+            const int month_len = days_in_month[mon] + (mon == 1 && leap);
+            month_starts[y * months_in_year + (uint64_t) mon] =
+                (uint32_t) index;
+            for ( int mday = 1; mday <= month_len; ++mday ) {
+                const int yday = days_before_month[leap][mon] + mday - 1;
+                days[index++] = (uint32_t) y << DATE_YEAR_SHIFT |
+                                (uint32_t) mon << DATE_MON_SHIFT |
+                                (uint32_t) mday << DATE_MDAY_SHIFT |
+                                (uint32_t) wday << DATE_WDAY_SHIFT |
+                                (uint32_t) yday;
+                wday = (wday + 1) % days_in_week;
             }
-            tm_increment_hour(changing_tm, num_hours);
         }
-
-        changing_tm->tm_min += num_mins;
     }
-    return changing_tm;
+    month_starts[num_months] = (uint32_t) index;
+
+    table->first_day = first_day;
+    table->first_year = first_year;
+    table->num_days = num_days;
+    table->num_years = num_years;
+    table->month_starts = month_starts;
+    table->days = days;
+
+    struct date_table *expected = 0;
+    if ( !atomic_compare_exchange_strong_explicit(&active_date_table,
+                                                  &expected, table,
+                                                  memory_order_release,
+                                                  memory_order_relaxed) ) {
+        free(table);
+        return false;
+    }
+
+    return true;
 }
 
 
 /*!
- * \brief               Adds one or more seconds to a struct tm, incrementing
- * the minute, hour, day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to increment. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of seconds to add
- * \returns             A pointer to the same struct tm.
+ * \brief       Frees the table built by date_table_init().
+ * \details     Dates are calculated again afterwards. This function must
+ * not be called while any other thread might be converting dates, since
+ * they could still be reading the table. It does nothing if there is no
+ * table.
  */
 
-struct tm*
-tm_increment_second(struct tm *changing_tm, const int quantity) {
-    static const int secs_in_min = 60;
+void
+date_table_free(void) {
+    free(atomic_exchange_explicit(&active_date_table, 0,
+                                  memory_order_acq_rel));
+}
 
-    if ( quantity < 0 ) {
-        tm_decrement_second(changing_tm, -quantity);
-    } else {
-        int num_secs = quantity;
-
-        if ( num_secs >= secs_in_min ||
-             num_secs >= secs_in_min - changing_tm->tm_sec ) {
-            int num_mins = quantity / secs_in_min;
-            num_secs -= num_mins * secs_in_min;
-            if ( num_secs >= secs_in_min - changing_tm->tm_sec ) {
-                ++num_mins;
-                changing_tm->tm_sec += num_secs - secs_in_min;
-                num_secs = 0;
-            }
-            tm_increment_minute(changing_tm, num_mins);
-        }
 
-        changing_tm->tm_sec += num_secs;
+/*!
+ * \brief           Returns the day of the week of a civil date.
+ * \details         This uses a table of month offsets rather than mktime(),
+ * and runs in constant time.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The day of the week, from 0 for Sunday to 6 for
+ * Saturday, as in `tm_wday`.
+ */
+
+int
+day_of_week(const int64_t year, const int month, const int day) {
+    static const int days_in_week = 7;
+
+    //  Count January and February as months of the previous year, so
+    //  that a leap day comes at the end.
+
+    const int64_t y = year - (month < 3);
+    const int64_t sum = y + floor_div(y, 4) - floor_div(y, 100) +
+                        floor_div(y, 400) + month_wday_offsets[month - 1] +
+                        day;
+
+    return (int) (sum - floor_div(sum, days_in_week) * days_in_week);
+}
+
+
+/*!
+ * \brief           Returns the day of the year of a civil date.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The day of the year, from 0 for January 1 to 365, as in
+ * `tm_yday`.
+ */
+
+int
+day_of_year(const int64_t year, const int month, const int day) {
+    return days_before_month[is_leap_year_64(year)][month - 1] + day - 1;
+}
+
+
+/*!
+ * \brief           Returns the number of ISO 8601 weeks in a year.
+ * \details         A year has 53 weeks if it starts on a Thursday, or is a
+ * leap year starting on a Wednesday, and 52 otherwise.
+ * \param year      The year, e.g. 2013.
+ * \returns         52 or 53.
+ */
+
+static int
+iso_weeks_in_year(const int64_t year) {
+    static const int wednesday = 3;
+    static const int thursday = 4;
+    const int jan_first = day_of_week(year, 1, 1);
+
+    return jan_first == thursday ||
+           (jan_first == wednesday && is_leap_year_64(year)) ? 53 : 52;
+}
+
+
+/*!
+ * \brief           Returns the ISO 8601 week number of a civil date.
+ * \details         ISO weeks start on Monday, and week 1 of a year is the
+ * week containing its first Thursday, so the first few days of January can
+ * fall in the last week of the previous year, and the last few days of
+ * December in week 1 of the next year.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \param iso_year  If not null, modified to contain the ISO week-numbering
+ * year the week belongs to.
+ * \returns         The week number, from 1 to 53.
+ */
+
+int
+iso_week_number(const int64_t year, const int month, const int day,
+                int64_t *iso_year) {
+    static const int days_in_week = 7;
+
+    //  Monday is 1 and Sunday is 7 in ISO 8601.
+
+    const int iso_wday = (day_of_week(year, month, day) + 6) % days_in_week +
+                         1;
+    int week = (day_of_year(year, month, day) + 1 - iso_wday + 10) /
+               days_in_week;
+    int64_t week_year = year;
+
+    if ( week < 1 ) {
+        week_year = year - 1;
+        week = iso_weeks_in_year(week_year);
+    } else if ( week > iso_weeks_in_year(year) ) {
+        week_year = year + 1;
+        week = 1;
     }
 
-    return changing_tm;
+    if ( iso_year ) {
+        *iso_year = week_year;
+    }
+
+    return week;
 }
 
 
 /*!
- * \brief               Deducts one or more days from a struct tm,
- * decrementing the month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to decrement. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of days to deduct
- * \returns             A pointer to the same struct tm.
+ * \brief               Does the work of tm_add_seconds().
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param num_secs      The number of seconds to add, negative to subtract.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm.
  */
 
-struct tm*
-tm_decrement_day(struct tm *changing_tm, const int quantity) {
-    enum months {january, february, march, april, may, june, july,
-                 august, september, october, november, december};
+static struct tm *
+add_seconds(struct tm *changing_tm, const int64_t num_secs) {
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
 
-    if ( quantity < 0 ) {
-        tm_increment_day(changing_tm, -quantity);
-    } else {
-        int num_days = quantity;
+    //  Reject spans that must overflow tm_year before doing any
+    //  arithmetic that might overflow int64_t.
 
-        while ( num_days-- ) {
-            if ( changing_tm->tm_mday > 1 ) {
-                changing_tm->tm_mday -= 1;
-            } else {
-                switch ( changing_tm->tm_mon ) {
-                    case january:
-                        changing_tm->tm_mday = 31;
-                        changing_tm->tm_mon = 11;
-                        if ( changing_tm->tm_year == 1 ) {
-                            changing_tm->tm_year = -1;
-                        } else {
-                            changing_tm->tm_year -= 1;
-                        }
-                        break;
-
-                    case february: 
-                    case april:
-                    case june:
-                    case august:
-                    case september:
-                    case november:
-                        changing_tm->tm_mday = 31;
-                        changing_tm->tm_mon -= 1;
-                        break;
-
-                    case may:
-                    case july:
-                    case october:
-                    case december:
-                        changing_tm->tm_mday = 30;
-                        changing_tm->tm_mon -= 1;
-                        break;
-
-                    case march:
-                        if ( is_leap_year(changing_tm->tm_year) ) {
-                            changing_tm->tm_mday = 29;
-                        } else {
-                            changing_tm->tm_mday = 28;
-                        }
-                        changing_tm->tm_mon -= 1;
-                        break;
-
-                    default:
-                        assert(false);
-                        break;
-                }
-            }
-        }
+    if ( num_secs < -MAX_SHIFT_DAYS * secs_in_day ||
+         num_secs > MAX_SHIFT_DAYS * secs_in_day ) {
+        PGTIME_COUNT(PGTIME_COUNTER_OVERFLOW);
+        return 0;
+    }
+
+    const int64_t secs = changing_tm->tm_hour * (int64_t) secs_in_hour +
+                         changing_tm->tm_min * (int64_t) secs_in_min +
+                         changing_tm->tm_sec + num_secs;
+    const int64_t num_days = floor_div(secs, secs_in_day);
+    const int secs_of_day = (int) (secs - num_days * secs_in_day);
+    const int64_t days = days_from_civil(changing_tm->tm_year +
+                                         (int64_t) 1900,
+                                         (int64_t) changing_tm->tm_mon + 1,
+                                         changing_tm->tm_mday) + num_days;
+
+    if ( !tm_set_date(changing_tm, days) ) {
+        return 0;
     }
 
+    changing_tm->tm_hour = secs_of_day / secs_in_hour;
+    changing_tm->tm_min = secs_of_day % secs_in_hour / secs_in_min;
+    changing_tm->tm_sec = secs_of_day % secs_in_min;
+
     return changing_tm;
 }
 
 
 /*!
- * \brief               Deducts one or more hours from a struct tm,
- * decrementing the day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to decrement. The
- * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of hours to deduct
- * \returns             A pointer to the same struct tm.
+ * \brief               Adds a signed number of seconds to a struct tm.
+ * \details             All the fields are normalized in a single pass: the
+ * time of day is converted to seconds and moved, and any whole days
+ * carried over move the serial day number of the date, so this takes the
+ * same time for any number of seconds. The members of `changing_tm` need
+ * not be in their normal ranges, and `tm_wday` and `tm_yday` are updated
+ * too, so the result never needs normalizing with mktime().
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param num_secs      The number of seconds to add, negative to subtract.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing_tm` is unchanged.
  */
 
-struct tm*
-tm_decrement_hour(struct tm *changing_tm, const int quantity) {
+struct tm *
+tm_add_seconds(struct tm *changing_tm, const int64_t num_secs) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TM_ADD_SECONDS);
+    struct tm *const result = add_seconds(changing_tm, num_secs);
+    PGTIME_PROBE_END(PGTIME_PROBE_TM_ADD_SECONDS, start);
+    return result;
+}
+
+
+/*!
+ * \brief               Adds a signed duration in mixed units to a struct
+ * tm.
+ * \details             The units are combined into one number of seconds
+ * and added with tm_add_seconds(), so the fields are normalized once
+ * rather than once per unit. The units may have different signs.
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param days          The number of days to add.
+ * \param hours         The number of hours to add.
+ * \param minutes       The number of minutes to add.
+ * \param seconds       The number of seconds to add.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing_tm` is unchanged.
+ */
+
+struct tm *
+tm_add_duration(struct tm *changing_tm, const int64_t days,
+                const int64_t hours, const int64_t minutes,
+                const int64_t seconds) {
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
     static const int hours_in_day = 24;
+    static const int mins_in_day = 1440;
+
+    //  With each unit limited like this the total cannot overflow, and
+    //  any unit beyond its limit would overflow tm_year on its own.
+
+    if ( days < -MAX_SHIFT_DAYS || days > MAX_SHIFT_DAYS ||
+         hours < -MAX_SHIFT_DAYS * hours_in_day ||
+         hours > MAX_SHIFT_DAYS * hours_in_day ||
+         minutes < -MAX_SHIFT_DAYS * mins_in_day ||
+         minutes > MAX_SHIFT_DAYS * mins_in_day ||
+         seconds < -MAX_SHIFT_DAYS * secs_in_day ||
+         seconds > MAX_SHIFT_DAYS * secs_in_day ) {
+        return 0;
+    }
 
-    if ( quantity < 0 ) {
-        tm_increment_hour(changing_tm, -quantity);
-    } else {
-        int num_hours = quantity;
-
-        if ( num_hours >= hours_in_day || num_hours > changing_tm->tm_hour ) {
-            int num_days = quantity / hours_in_day;
-            num_hours -= num_days * hours_in_day;
-            if ( num_hours > changing_tm->tm_hour ) {
-                ++num_days;
-                num_hours -= changing_tm->tm_hour;
-                changing_tm->tm_hour = hours_in_day;
-            }
-            tm_decrement_day(changing_tm, num_days);
-        }
+    return tm_add_seconds(changing_tm, days * secs_in_day +
+                                       hours * secs_in_hour +
+                                       minutes * secs_in_min + seconds);
+}
+
+
+/*!
+ * \brief               Adds a signed number of months to a struct tm.
+ * \details             The year and month are combined into a count of
+ * months and moved in one step, so this takes the same time for any
+ * number of months. The time of day is unchanged.
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param num_months    The number of months to add, negative to subtract.
+ * \param policy        What to do if the day of the month does not exist
+ * in the new month.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing_tm` is unchanged.
+ */
 
-        changing_tm->tm_hour -= num_hours;
+static struct tm *
+tm_add_months(struct tm *changing_tm, const int64_t num_months,
+              const enum month_day_policy policy) {
+    static const int months_in_year = 12;
+    static const int february = 1;
+
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TM_ADD_MONTHS);
+    const int64_t months = changing_tm->tm_year * (int64_t) months_in_year +
+                           changing_tm->tm_mon + num_months;
+    const int64_t new_tm_year = floor_div(months, months_in_year);
+    const int new_mon = (int) (months - new_tm_year * months_in_year);
+    const int month_len = days_in_month[new_mon] +
+                          (new_mon == february &&
+                           is_leap_year_64(new_tm_year + 1900));
+    int mday = changing_tm->tm_mday;
+
+    if ( policy == MONTH_DAY_CLAMP && mday > month_len ) {
+        mday = month_len;
     }
 
-    return changing_tm;
+    //  Any days past the end of the month, or a day out of its normal
+    //  range to begin with, are carried over through the serial day.
+
+    const int64_t days = days_from_civil(new_tm_year + 1900, new_mon + 1,
+                                         mday);
+
+    struct tm *const result = tm_set_date(changing_tm, days) ? changing_tm :
+                                                                0;
+    PGTIME_PROBE_END(PGTIME_PROBE_TM_ADD_MONTHS, start);
+    return result;
 }
 
 
 /*!
- * \brief               Deducts one or more minutes from a struct tm,
- * decrementing the hour, day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm to decrement. The
+ * \brief               Adds one or more months to a struct tm,
+ * incrementing the year as necessary.
+ * \details             January 31 plus one month is February 28 or 29
+ * with MONTH_DAY_CLAMP, and March 3 or 2 with MONTH_DAY_OVERFLOW.
+ * \param changing_tm   A pointer to the struct tm to increment. The
  * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of minutes to deduct
- * \returns             A pointer to the same struct tm.
+ * \param quantity      The number of months to add
+ * \param policy        What to do if the day of the month does not exist
+ * in the new month.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented.
  */
 
-struct tm*
-tm_decrement_minute(struct tm *changing_tm, const int quantity) {
-    static const int mins_in_hour = 60;
+struct tm *
+tm_increment_month(struct tm *changing_tm, const int quantity,
+                   const enum month_day_policy policy) {
+    return tm_add_months(changing_tm, quantity, policy);
+}
 
-    if ( quantity < 0 ) {
-        tm_increment_minute(changing_tm, -quantity);
-    } else {
-        int num_mins = quantity;
-
-        if ( num_mins >= mins_in_hour || num_mins > changing_tm->tm_min ) {
-            int num_hours = quantity / mins_in_hour;
-            num_mins -= num_hours * mins_in_hour;
-            if ( num_mins > changing_tm->tm_min ) {
-                ++num_hours;
-                num_mins -= changing_tm->tm_min;
-                changing_tm->tm_min = mins_in_hour;
-            }
-            tm_decrement_hour(changing_tm, num_hours);
-        }
 
-        changing_tm->tm_min -= num_mins;
-    }
-    return changing_tm;
+/*!
+ * \brief               Adds one or more years to a struct tm.
+ * \details             February 29 plus one year is February 28 with
+ * MONTH_DAY_CLAMP, and March 1 with MONTH_DAY_OVERFLOW.
+ * \param changing_tm   A pointer to the struct tm to increment. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of years to add
+ * \param policy        What to do if the date is February 29 and the new
+ * year is not a leap year.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented.
+ */
+
+struct tm *
+tm_increment_year(struct tm *changing_tm, const int quantity,
+                  const enum month_day_policy policy) {
+    static const int months_in_year = 12;
+
+    return tm_add_months(changing_tm, quantity * (int64_t) months_in_year,
+                         policy);
 }
 
 
 /*!
- * \brief               Deducts one or more seconds from a struct tm,
- * decrementing the minute, hour, day, month and/or the year as necessary.
- * \param changing_tm   A pointer to the struct tm struct to decrement. The
+ * \brief               Subtracts one or more months from a struct tm,
+ * decrementing the year as necessary.
+ * \details             March 31 minus one month is February 28 or 29 with
+ * MONTH_DAY_CLAMP, and March 3 or 2 with MONTH_DAY_OVERFLOW.
+ * \param changing_tm   A pointer to the struct tm to decrement. The
  * struct referred to by the pointer is modified by the function.
- * \param quantity      The number of seconds to deduct
- * \returns             A pointer to the same struct tm.
+ * \param quantity      The number of months to subtract
+ * \param policy        What to do if the day of the month does not exist
+ * in the new month.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented.
  */
 
-struct tm*
-tm_decrement_second(struct tm *changing_tm, const int quantity) {
-    static const int secs_in_min = 60;
+struct tm *
+tm_decrement_month(struct tm *changing_tm, const int quantity,
+                   const enum month_day_policy policy) {
+    return tm_add_months(changing_tm, -(int64_t) quantity, policy);
+}
 
-    if ( quantity < 0 ) {
-        tm_increment_second(changing_tm, -quantity);
-    } else {
-        int num_secs = quantity;
-
-        if ( num_secs >= secs_in_min || num_secs > changing_tm->tm_sec ) {
-            int num_mins = quantity / secs_in_min;
-            num_secs -= num_mins * secs_in_min;
-            if ( num_secs > changing_tm->tm_sec ) {
-                ++num_mins;
-                num_secs -= changing_tm->tm_sec;
-                changing_tm->tm_sec = secs_in_min;
-            }
-            tm_decrement_minute(changing_tm, num_mins);
-        }
 
-        changing_tm->tm_sec -= num_secs;
-    }
+/*!
+ * \brief               Subtracts one or more years from a struct tm.
+ * \details             February 29 minus one year is February 28 with
+ * MONTH_DAY_CLAMP, and March 1 with MONTH_DAY_OVERFLOW.
+ * \param changing_tm   A pointer to the struct tm to decrement. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of years to subtract
+ * \param policy        What to do if the date is February 29 and the new
+ * year is not a leap year.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented.
+ */
 
-    return changing_tm;
+struct tm *
+tm_decrement_year(struct tm *changing_tm, const int quantity,
+                  const enum month_day_policy policy) {
+    static const int months_in_year = 12;
+
+    return tm_add_months(changing_tm, -(quantity * (int64_t) months_in_year),
+                         policy);
 }
 
 
 /*!
- * \brief           Gets a time_t timestamp for a requested UTC time.
+ * \brief           Calculates a time_t timestamp for a UTC time.
+ * \details         This does the work of get_utc_timestamp() and
+ * get_utc_timestamp_checked(), without validating the date. It is also
+ * used by the other source files, whose conversions accept the same
+ * times as get_utc_timestamp() but must report failure rather than exit.
  * \param utc_tm    A pointer to a struct tm containing the UTC time.
- * \returns         A time_t timestamp for the requested UTC time.
+ * \param result    Modified to contain the timestamp.
+ * \returns         PGTIME_OK on success, or the reason for failure, in
+ * which case `result` is unchanged.
  */
 
-time_t
-get_utc_timestamp(const struct tm *utc_tm) {
+enum pgtime_status
+pgtime_utc_timestamp(const struct tm *utc_tm, time_t *result) {
+#ifdef PGTIME_POSIX_TIME_T
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
+
+    const time_t utc_ts =
+        (time_t) (days_from_civil(utc_tm->tm_year + (int64_t) 1900,
+                                  (int64_t) utc_tm->tm_mon + 1,
+                                  utc_tm->tm_mday) * secs_in_day +
+                  utc_tm->tm_hour * (int64_t) secs_in_hour +
+                  utc_tm->tm_min * (int64_t) secs_in_min +
+                  utc_tm->tm_sec);
+
+#ifdef PGTIME_VERIFY_UTC
+    if ( validate_date(utc_tm) ) {
+        int secs_diff;
+
+        PGTIME_COUNT(PGTIME_COUNTER_GMTIME);
+        const struct tm *ptm = gmtime(&utc_ts);
+        if ( ptm == 0 ) {
+            return PGTIME_OUT_OF_RANGE;
+        }
+        if ( compare_utc_tm(ptm, &secs_diff, utc_tm) != PGTIME_OK ) {
+            return PGTIME_INACCURATE;
+        }
+    }
+#endif
+
+    *result = utc_ts;
+    return PGTIME_OK;
+#else
+    struct tm utc_buf;
+    time_t one_sec;
+    int secs_diff;
+
+    enum pgtime_status status = get_sec_diff_checked(&one_sec);
+    if ( status != PGTIME_OK ) {
+        return status;
+    }
 
     //  Get a timestamp close to (i.e. within 24 hours of) the
     //  desired UTC time.
 
     struct tm copy_tm = *utc_tm;
+    PGTIME_COUNT(PGTIME_COUNTER_MKTIME);
     time_t utc_ts = mktime(&copy_tm);
     if ( utc_ts == -1 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return PGTIME_NO_CALENDAR;
     }
 
     //  Compute the difference with the desired UTC time...
 
-    int secs_diff = get_utc_timestamp_sec_diff(utc_ts, &copy_tm);
+    status = get_utc_timestamp_sec_diff_checked(utc_ts, &copy_tm, &utc_buf,
+                                                &secs_diff);
+    if ( status != PGTIME_OK ) {
+        return status;
+    }
 
     //  ...and adjust the timestamp, if needed.
 
     if ( secs_diff ) {
-        const time_t one_sec = get_sec_diff();
         utc_ts -= one_sec * secs_diff;
 
-        secs_diff = get_utc_timestamp_sec_diff(utc_ts, &copy_tm);
+        PGTIME_COUNT(PGTIME_COUNTER_TIMESTAMP_PROBE);
+        status = get_utc_timestamp_sec_diff_checked(utc_ts, &copy_tm,
+                                                    &utc_buf, &secs_diff);
+        if ( status != PGTIME_OK ) {
+            return status;
+        }
 
         if ( secs_diff ) {
 
             //  We're pretty unlucky if we get here, but let's check
             //  for a leap second on either side, and give up if not.
 
-            if ( get_utc_timestamp_sec_diff(utc_ts + one_sec, &copy_tm) == 0 ) {
-               utc_ts += one_sec;
-            } else if ( get_utc_timestamp_sec_diff(utc_ts - one_sec,
-                                     &copy_tm) == 0 ) {
-               utc_ts -= one_sec;
-            } else { 
-                fprintf(stderr, "pgtime:%s:%d: couldn't get calendar time.\n",
-                        __FILE__, __LINE__);
-                exit(EXIT_FAILURE);
+            PGTIME_COUNT(PGTIME_COUNTER_LEAP_PROBE);
+            if ( get_utc_timestamp_sec_diff_checked(utc_ts + one_sec,
+                                                    &copy_tm, &utc_buf,
+                                                    &secs_diff) ==
+                     PGTIME_OK && secs_diff == 0 ) {
+                utc_ts += one_sec;
+            } else if ( get_utc_timestamp_sec_diff_checked(utc_ts - one_sec,
+                                                           &copy_tm,
+                                                           &utc_buf,
+                                                           &secs_diff) ==
+                            PGTIME_OK && secs_diff == 0 ) {
+                utc_ts -= one_sec;
+            } else {
+                return PGTIME_NO_CALENDAR;
             }
         }
     }
 
+    *result = utc_ts;
+    return PGTIME_OK;
+#endif
+}
+
+
+/*!
+ * \brief           Gets a time_t timestamp for a requested UTC time.
+ * \details         Where time_t is known to count seconds since the POSIX
+ * epoch, the timestamp is calculated directly from the fields of `utc_tm`
+ * without calling mktime() or gmtime(), and without touching any global
+ * state. If the library is built with `PGTIME_VERIFY_UTC` defined, the
+ * result for a valid date is also checked against gmtime(). On other
+ * platforms the timestamp is found by adjusting the result of mktime()
+ * until gmtime() agrees with it. The program exits if the timestamp
+ * cannot be found or fails the check; get_utc_timestamp_checked() reports
+ * that instead.
+ * \param utc_tm    A pointer to a struct tm containing the UTC time.
+ * \returns         A time_t timestamp for the requested UTC time.
+ */
+
+time_t
+get_utc_timestamp(const struct tm *utc_tm) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TIMESTAMP);
+    time_t utc_ts;
+    const enum pgtime_status status = pgtime_utc_timestamp(utc_tm, &utc_ts);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TIMESTAMP, start);
+    if ( status != PGTIME_OK ) {
+        fail(__FILE__, __LINE__, status);
+    }
     return utc_ts;
 }
 
 
+/*!
+ * \brief           Gets a time_t timestamp for a requested UTC time, and
+ * returns a status code.
+ * \details         Unlike get_utc_timestamp(), the date is checked with
+ * validate_date() first, and nothing is printed and the program never
+ * exits, so a batch caller can skip a bad row and carry on. On POSIX
+ * systems a bad date costs no more than a good one.
+ * \param utc_tm    A pointer to a struct tm containing the UTC time.
+ * \param result    Modified to contain the timestamp.
+ * \returns         PGTIME_OK on success, PGTIME_INVALID_DATE if the date
+ * is not valid, or another status if the timestamp could not be found,
+ * in which case `result` is unchanged.
+ */
+
+enum pgtime_status
+get_utc_timestamp_checked(const struct tm *utc_tm, time_t *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TIMESTAMP);
+    enum pgtime_status status = PGTIME_INVALID_DATE;
+
+    if ( validate_date(utc_tm) ) {
+        status = pgtime_utc_timestamp(utc_tm, result);
+    } else {
+        PGTIME_COUNT(PGTIME_COUNTER_INVALID_DATE);
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TIMESTAMP, start);
+    return status;
+}
+
+
+/*!
+ * \brief           Does the work of get_utc_tm().
+ * \param utc_ts    The time_t timestamp.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+static struct tm *
+break_down_utc(const time_t utc_ts, struct tm *result) {
+#ifdef PGTIME_POSIX_TIME_T
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
+
+    //  The date is set first, since it fails for any timestamp so far
+    //  from the epoch that the seconds of the day could overflow.
+
+    const int64_t days = floor_div(utc_ts, secs_in_day);
+    if ( !tm_set_date(result, days) ) {
+        return 0;
+    }
+
+    const int secs_of_day = (int) (utc_ts - days * secs_in_day);
+
+    result->tm_hour = secs_of_day / secs_in_hour;
+    result->tm_min = secs_of_day % secs_in_hour / secs_in_min;
+    result->tm_sec = secs_of_day % secs_in_min;
+    result->tm_isdst = 0;
+
+    return result;
+#else
+    PGTIME_COUNT(PGTIME_COUNTER_GMTIME);
+
+    //  Prefer a library function which writes into `result`, since
+    //  gmtime() returns a pointer to storage shared by all threads.
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 202311L
+    return gmtime_r(&utc_ts, result);
+#elif defined(__STDC_LIB_EXT1__)
+    return gmtime_s(&utc_ts, result);
+#else
+    struct tm *ptm = gmtime(&utc_ts);
+    if ( ptm == 0 ) {
+        return 0;
+    }
+    *result = *ptm;
+    return result;
+#endif
+#endif
+}
+
+
+/*!
+ * \brief           Breaks down a time_t timestamp into UTC time.
+ * \details         This does the same job as gmtime_r(), but where time_t
+ * is known to count seconds since the POSIX epoch it is calculated
+ * directly, without taking any libc locks or consulting timezone state.
+ * All fields of `result` are set, including `tm_wday` and `tm_yday`, and
+ * `tm_isdst` is set to zero. Elsewhere it calls gmtime_r() from C23 or
+ * gmtime_s() from Annex K of C11. Failing both, it copies the result of
+ * gmtime(). It is then not safe to call from more than one thread at
+ * once, and neither are the functions which call it.
+ * \param utc_ts    The time_t timestamp.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+struct tm*
+get_utc_tm(const time_t utc_ts, struct tm *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TM);
+    struct tm *const utc_tm = break_down_utc(utc_ts, result);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TM, start);
+    return utc_tm;
+}
+
+
 /*!
  * \brief               Checks a time_t timestamp against a UTC time, and
  * returns the difference in seconds.
@@ -748,7 +1609,8 @@ get_utc_timestamp(const struct tm *utc_tm) {
  * may also return a bad value if a leap second or other unpredictable
  * calendar change falls between the desired UTC time and the provided
  * time stamp. The result should therefore always be checked with
- * check_utc_timestamp(), or by calling this function again.
+ * check_utc_timestamp(), or by calling this function again. The program
+ * exits if gmtime() fails.
  * \param check_time    The time_t timestamp to check
  * \param utc_tm        A pointer to a struct tm against which to check.
  * \returns             The difference, if any, represented in seconds.
@@ -756,19 +1618,82 @@ get_utc_timestamp(const struct tm *utc_tm) {
 
 int
 get_utc_timestamp_sec_diff(const time_t check_time, const struct tm *utc_tm) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_SEC_DIFF);
 
     //  Get a struct tm representing UTC time for the provided
     //  timestamp.
 
+    PGTIME_COUNT(PGTIME_COUNTER_GMTIME);
     struct tm* ptm = gmtime(&check_time);
     if ( ptm == 0 ) {
-        fprintf(stderr, "pgtime:%s:%d: couldn't get UTC time.\n",
-                __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        fail(__FILE__, __LINE__, PGTIME_OUT_OF_RANGE);
     }
     struct tm check_tm = *ptm;
 
     //  Compare the two and return the difference.
 
-    return tm_intraday_secs_diff(utc_tm, &check_tm);
+    const int secs_diff = tm_intraday_secs_diff(utc_tm, &check_tm);
+    PGTIME_PROBE_END(PGTIME_PROBE_SEC_DIFF, start);
+    return secs_diff;
+}
+
+
+/*!
+ * \brief               Checks a time_t timestamp against a UTC time, and
+ * returns the difference in seconds, without using any shared storage.
+ * \details             This is a reentrant version of
+ * get_utc_timestamp_sec_diff(), which breaks the timestamp down with
+ * get_utc_tm() into the caller-supplied `utc_buf` rather than with
+ * gmtime(). The same caveats about the range of the timestamp apply, and
+ * it is only as safe to call from several threads as get_utc_tm() is.
+ * \param check_time    The time_t timestamp to check
+ * \param utc_tm        A pointer to a struct tm against which to check.
+ * \param utc_buf       Modified to contain the UTC time for `check_time`.
+ * \returns             The difference, if any, represented in seconds.
+ */
+
+int
+get_utc_timestamp_sec_diff_r(const time_t check_time, const struct tm *utc_tm,
+                             struct tm *utc_buf) {
+    int secs_diff;
+    const enum pgtime_status status =
+        get_utc_timestamp_sec_diff_checked(check_time, utc_tm, utc_buf,
+                                           &secs_diff);
+    if ( status != PGTIME_OK ) {
+        fail(__FILE__, __LINE__, status);
+    }
+
+    return secs_diff;
+}
+
+
+/*!
+ * \brief               Checks a time_t timestamp against a UTC time, and
+ * returns a status code.
+ * \details             This is get_utc_timestamp_sec_diff_r(), but never
+ * prints or exits.
+ * \param check_time    The time_t timestamp to check
+ * \param check_tm      A pointer to a struct tm against which to check.
+ * \param utc_buf       Modified to contain the UTC time for `check_time`.
+ * \param secs_diff     Modified to contain the difference, if any,
+ * represented in seconds.
+ * \returns             PGTIME_OK on success, or PGTIME_OUT_OF_RANGE if
+ * the timestamp cannot be broken down, in which case `secs_diff` is
+ * unchanged.
+ */
+
+enum pgtime_status
+get_utc_timestamp_sec_diff_checked(const time_t check_time,
+                                   const struct tm *check_tm,
+                                   struct tm *utc_buf, int *secs_diff) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_SEC_DIFF);
+    enum pgtime_status status = PGTIME_OUT_OF_RANGE;
+
+    if ( get_utc_tm(check_time, utc_buf) ) {
+        *secs_diff = tm_intraday_secs_diff(check_tm, utc_buf);
+        status = PGTIME_OK;
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_SEC_DIFF, start);
+    return status;
 }
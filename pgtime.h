@@ -12,6 +12,44 @@
 
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+
+/*!
+ * \brief       A date and time packed into 64 bits.
+ * \details     Created with pack_tm(). Packed values sort in chronological
+ * order when compared as ordinary unsigned integers, and take 8 bytes
+ * rather than the 36 or more of a struct tm.
+ */
+
+typedef uint64_t packed_tm;
+
+
+/*!
+ * \brief       What month and year arithmetic does with a day of the month
+ * that does not exist in the new month.
+ */
+
+enum month_day_policy {
+    MONTH_DAY_CLAMP,        /*!<  Use the last day of the new month  */
+    MONTH_DAY_OVERFLOW      /*!<  Carry the extra days into the next month  */
+};
+
+
+/*!
+ * \brief       The result of a function in the checked interface.
+ * \details     The `_checked` functions return one of these rather than
+ * printing a message and exiting as the functions they shadow do, so a
+ * bad input can be skipped without ending the process.
+ */
+
+enum pgtime_status {
+    PGTIME_OK,              /*!<  Success  */
+    PGTIME_INVALID_DATE,    /*!<  The date failed validate_date()  */
+    PGTIME_OUT_OF_RANGE,    /*!<  The time cannot be represented  */
+    PGTIME_NO_CALENDAR,     /*!<  mktime() could not convert the time  */
+    PGTIME_INACCURATE       /*!<  A timestamp disagrees with its time  */
+};
 
 
 /*  Function prototypes  */
@@ -23,12 +61,18 @@ extern "C" {
 time_t get_day_diff(void);
 time_t get_hour_diff(void);
 time_t get_sec_diff(void);
+enum pgtime_status get_day_diff_checked(time_t *result);
+enum pgtime_status get_hour_diff_checked(time_t *result);
+enum pgtime_status get_sec_diff_checked(time_t *result);
+const char *pgtime_status_message(const enum pgtime_status status);
+
+/*  These are defined in pgtime_inline.h, as static inline functions if
+ *  PGTIME_INLINE is defined  */
 
+#ifndef PGTIME_INLINE
+bool is_leap_year(const int year);
 bool validate_date(const struct tm *check_tm);
 int tm_compare(const struct tm *first, const struct tm *second);
-int tm_intraday_secs_diff(const struct tm *first, const struct tm *second);
-bool is_leap_year(const int year);
-
 struct tm *tm_increment_day(struct tm *changing_tm, const int quantity);
 struct tm *tm_increment_hour(struct tm *changing_tm, const int quantity);
 struct tm *tm_increment_minute(struct tm *changing_tm, const int quantity);
@@ -37,16 +81,66 @@ struct tm *tm_decrement_day(struct tm *changing_tm, const int quantity);
 struct tm *tm_decrement_hour(struct tm *changing_tm, const int quantity);
 struct tm *tm_decrement_minute(struct tm *changing_tm, const int quantity);
 struct tm *tm_decrement_second(struct tm *changing_tm, const int quantity);
+#endif
+
+packed_tm pack_tm(const struct tm *src);
+struct tm *unpack_tm(const packed_tm packed, struct tm *result);
+int packed_tm_compare(const packed_tm first, const packed_tm second);
+int tm_intraday_secs_diff(const struct tm *first, const struct tm *second);
+int64_t tm_secs_diff(const struct tm *first, const struct tm *second);
+int64_t tm_days_diff(const struct tm *first, const struct tm *second);
+int64_t days_from_civil(const int64_t year, const int64_t month,
+                        const int day);
+void civil_from_days(const int64_t days, int64_t *year, int *month, int *day);
+bool date_table_init(const int64_t first_year, const int64_t last_year);
+void date_table_free(void);
+int day_of_week(const int64_t year, const int month, const int day);
+int day_of_year(const int64_t year, const int month, const int day);
+int iso_week_number(const int64_t year, const int month, const int day,
+                    int64_t *iso_year);
+
+struct tm *tm_add_seconds(struct tm *changing_tm, const int64_t num_secs);
+struct tm *tm_add_duration(struct tm *changing_tm, const int64_t days,
+                           const int64_t hours, const int64_t minutes,
+                           const int64_t seconds);
+struct tm *tm_increment_month(struct tm *changing_tm, const int quantity,
+                              const enum month_day_policy policy);
+struct tm *tm_increment_year(struct tm *changing_tm, const int quantity,
+                             const enum month_day_policy policy);
+struct tm *tm_decrement_month(struct tm *changing_tm, const int quantity,
+                              const enum month_day_policy policy);
+struct tm *tm_decrement_year(struct tm *changing_tm, const int quantity,
+                             const enum month_day_policy policy);
 
 bool check_utc_timestamp(const time_t check_time, int *secs_diff,
                          const struct tm *check_tm);
+bool check_utc_timestamp_r(const time_t check_time, int *secs_diff,
+                           const struct tm *check_tm, struct tm *utc_buf);
 time_t get_utc_timestamp(const struct tm *utc_tm);
+struct tm *get_utc_tm(const time_t utc_ts, struct tm *result);
 int get_utc_timestamp_sec_diff(const time_t check_time,
                                const struct tm *check_tm);
+int get_utc_timestamp_sec_diff_r(const time_t check_time,
+                                 const struct tm *check_tm,
+                                 struct tm *utc_buf);
+
+enum pgtime_status check_utc_timestamp_checked(const time_t check_time,
+                                               int *secs_diff,
+                                               const struct tm *check_tm,
+                                               struct tm *utc_buf);
+enum pgtime_status get_utc_timestamp_checked(const struct tm *utc_tm,
+                                             time_t *result);
+enum pgtime_status get_utc_timestamp_sec_diff_checked(
+    const time_t check_time, const struct tm *check_tm, struct tm *utc_buf,
+    int *secs_diff);
 
 #ifdef __cplusplus
 }
 #endif
 
+#ifdef PGTIME_INLINE
+#include "pgtime_inline.h"
+#endif
+
 
 #endif          /*  PG_PGTIME_H  */
@@ -0,0 +1,771 @@
+/*!
+ * \file        pgtime.hpp
+ * \brief       Compile-time equivalents of the pgtime date functions, for
+ * C++14 and later.
+ * \details     The functions in namespace `pgtime` take the same arguments
+ * and give the same results as the C functions of the same names in
+ * pgtime.c, but are `constexpr`, so calendar constants such as epoch
+ * offsets and bucket boundaries can be calculated at compile time, and
+ * calls in loops can be inlined. They always calculate, and never use the
+ * date table, libc or any other state. Timestamps count seconds since the
+ * POSIX epoch, as get_utc_timestamp() does where time_t is a POSIX
+ * timestamp. Calls should be qualified with `pgtime::`, since the C
+ * functions are found too by argument-dependent lookup on `std::tm`. The
+ * static_assert tests at the end of this file check them against known
+ * dates whenever it is compiled.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_HPP
+#define PG_PGTIME_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include "pgtime.h"
+
+
+namespace pgtime {
+
+namespace detail {
+
+/*  Days in the year before the start of each month, in common and in
+ *  leap years  */
+
+constexpr int days_before_month[2][12] = {
+    {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334},
+    {0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335}
+};
+
+/*  Day of the week offsets for each month, for day_of_week(), with
+ *  January and February counted at the end of the previous year  */
+
+constexpr int month_wday_offsets[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+
+/*  Largest span in days that tm_add_seconds() and tm_add_duration()
+ *  accept, as in pgtime.c  */
+
+constexpr std::int64_t max_shift_days = std::int64_t(1) << 40;
+
+constexpr int secs_in_day = 86400;
+constexpr int secs_in_hour = 3600;
+constexpr int secs_in_min = 60;
+
+
+/*!
+ * \brief           Divides two integers, rounding towards negative infinity.
+ * \param dividend  The dividend.
+ * \param divisor   The divisor, which must be positive.
+ * \returns         The quotient, rounded down.
+ */
+
+constexpr std::int64_t
+floor_div(const std::int64_t dividend, const std::int64_t divisor) {
+    const std::int64_t quotient = dividend / divisor;
+    return quotient - (dividend % divisor < 0);
+}
+
+}       //  namespace detail
+
+
+/*!
+ * \brief           Checks if the supplied year is a leap year.
+ * \param year      A year
+ * \returns         `true` if `year` is a leap year, `false` otherwise.
+ */
+
+constexpr bool
+is_leap_year(const std::int64_t year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+
+/*!
+ * \brief           Checks whether a supplied date is valid.
+ * \details         This function does not support leap seconds, and will
+ * return false if `check_tm->tm_sec == 60`. Years are astronomical, so
+ * year 0 is valid, as are negative years.
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \returns         true if the date if valid, false otherwise.
+ */
+
+constexpr bool
+validate_date(const std::tm *check_tm) {
+    constexpr int days_in_month[12] = {31, 28, 31, 30, 31, 30,
+                                       31, 31, 30, 31, 30, 31};
+
+    return check_tm->tm_mon >= 0 && check_tm->tm_mon <= 11 &&
+           check_tm->tm_mday >= 1 &&
+           ( check_tm->tm_mday <= days_in_month[check_tm->tm_mon] ||
+             (check_tm->tm_mon == 1 && check_tm->tm_mday == 29 &&
+              is_leap_year(check_tm->tm_year + std::int64_t(1900))) ) &&
+           check_tm->tm_hour >= 0 && check_tm->tm_hour <= 23 &&
+           check_tm->tm_min >= 0 && check_tm->tm_min <= 59 &&
+           check_tm->tm_sec >= 0 && check_tm->tm_sec <= 59;
+}
+
+
+/*!
+ * \brief       Compares two struct tm structs.
+ * \details     Only the year, month, day, hour, minute and second are
+ * compared. Any timezone or DST information is ignored.
+ * \param first The first struct tm struct.
+ * \param second The second struct tm struct.
+ * \returns     -1 if `first` is earlier than `second`, 1 if `first` is later
+ * than `second`, and 0 if `first` is equal to `second`.
+ */
+
+constexpr int
+tm_compare(const std::tm *first, const std::tm *second) {
+    return first->tm_year != second->tm_year ?
+               (first->tm_year > second->tm_year ? 1 : -1) :
+           first->tm_mon != second->tm_mon ?
+               (first->tm_mon > second->tm_mon ? 1 : -1) :
+           first->tm_mday != second->tm_mday ?
+               (first->tm_mday > second->tm_mday ? 1 : -1) :
+           first->tm_hour != second->tm_hour ?
+               (first->tm_hour > second->tm_hour ? 1 : -1) :
+           first->tm_min != second->tm_min ?
+               (first->tm_min > second->tm_min ? 1 : -1) :
+           first->tm_sec != second->tm_sec ?
+               (first->tm_sec > second->tm_sec ? 1 : -1) : 0;
+}
+
+
+/*!
+ * \brief           Returns the serial day number of a civil date.
+ * \details         The serial day number is the number of days since
+ * 1970-01-01 in the proleptic Gregorian calendar. The month is not
+ * required to be in range, and is carried into the year. It is 64 bits
+ * wide, so that `tm_mon + 1` can be passed for any `tm_mon`.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The serial day number, which is negative for dates
+ * before 1970-01-01.
+ */
+
+constexpr std::int64_t
+days_from_civil(const std::int64_t year, const std::int64_t month,
+                const int day) {
+    constexpr int months_in_year = 12;
+    constexpr int days_in_era = 146097;
+    constexpr int years_in_era = 400;
+    constexpr int epoch_offset = 719468;
+
+    const std::int64_t carry = detail::floor_div(month - 1, months_in_year);
+    const int m = static_cast<int>(month - 1 - carry * months_in_year) + 1;
+
+    //  Count years from March, so that February's leap day is always
+    //  the last day of the year.
+
+    const std::int64_t y = year + carry - (m <= 2);
+    const std::int64_t era = detail::floor_div(y, years_in_era);
+    const std::int64_t yoe = y - era * years_in_era;
+    const std::int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 +
+                             day - 1;
+    const std::int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * days_in_era + doe - epoch_offset;
+}
+
+
+/*!
+ * \brief           Returns the civil date for a serial day number.
+ * \param days      The number of days since 1970-01-01.
+ * \param year      Modified to contain the year, e.g. 2013.
+ * \param month     Modified to contain the month, from 1 to 12.
+ * \param day       Modified to contain the day of the month, from 1 to 31.
+ */
+
+constexpr void
+civil_from_days(const std::int64_t days, std::int64_t *year, int *month,
+                int *day) {
+    constexpr int days_in_era = 146097;
+    constexpr int years_in_era = 400;
+    constexpr int epoch_offset = 719468;
+
+    const std::int64_t z = days + epoch_offset;
+    const std::int64_t era = detail::floor_div(z, days_in_era);
+    const std::int64_t doe = z - era * days_in_era;
+    const std::int64_t yoe = (doe - doe / 1460 + doe / 36524 -
+                              doe / 146096) / 365;
+    const std::int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const std::int64_t mp = (5 * doy + 2) / 153;
+    const int m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+
+    *day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    *month = m;
+    *year = yoe + era * years_in_era + (m <= 2);
+}
+
+
+/*!
+ * \brief           Returns the day of the week of a civil date.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The day of the week, from 0 for Sunday to 6 for
+ * Saturday, as in `tm_wday`.
+ */
+
+constexpr int
+day_of_week(const std::int64_t year, const int month, const int day) {
+    constexpr int days_in_week = 7;
+
+    //  Count January and February as months of the previous year, so
+    //  that a leap day comes at the end.
+
+    const std::int64_t y = year - (month < 3);
+    const std::int64_t sum = y + detail::floor_div(y, 4) -
+                             detail::floor_div(y, 100) +
+                             detail::floor_div(y, 400) +
+                             detail::month_wday_offsets[month - 1] + day;
+
+    return static_cast<int>(sum - detail::floor_div(sum, days_in_week) *
+                                  days_in_week);
+}
+
+
+/*!
+ * \brief           Returns the day of the year of a civil date.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \returns         The day of the year, from 0 for January 1 to 365, as in
+ * `tm_yday`.
+ */
+
+constexpr int
+day_of_year(const std::int64_t year, const int month, const int day) {
+    return detail::days_before_month[is_leap_year(year)][month - 1] +
+           day - 1;
+}
+
+
+namespace detail {
+
+/*!
+ * \brief           Sets the date of a struct tm from a serial day number.
+ * \details         Sets `tm_year`, `tm_mon`, `tm_mday`, `tm_wday` and
+ * `tm_yday`.
+ * \param date      The struct tm to set.
+ * \param days      The number of days since 1970-01-01.
+ * \returns         `true` on success, or `false` if the year cannot be
+ * represented in a struct tm, in which case `date` is unchanged.
+ */
+
+constexpr bool
+tm_set_date(std::tm *date, const std::int64_t days) {
+    constexpr int days_in_week = 7;
+
+    //  1970-01-01 was a Thursday.
+
+    constexpr int epoch_wday = 4;
+
+    std::int64_t year = 0;
+    int month = 0;
+    int day = 0;
+
+    civil_from_days(days, &year, &month, &day);
+    if ( year - 1900 > std::numeric_limits<int>::max() ||
+         year - 1900 < std::numeric_limits<int>::min() ) {
+        return false;
+    }
+
+    date->tm_year = static_cast<int>(year - 1900);
+    date->tm_mon = month - 1;
+    date->tm_mday = day;
+    date->tm_wday = static_cast<int>(days + epoch_wday -
+                                     floor_div(days + epoch_wday,
+                                               days_in_week) *
+                                     days_in_week);
+    date->tm_yday = day_of_year(year, month, day);
+
+    return true;
+}
+
+}       //  namespace detail
+
+
+/*!
+ * \brief               Adds a signed number of seconds to a struct tm.
+ * \details             The members of `changing_tm` need not be in their
+ * normal ranges, and `tm_wday` and `tm_yday` are updated too.
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param num_secs      The number of seconds to add, negative to subtract.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing_tm` is unchanged.
+ */
+
+constexpr std::tm *
+tm_add_seconds(std::tm *changing_tm, const std::int64_t num_secs) {
+    using namespace detail;
+
+    //  Reject spans that must overflow tm_year before doing any
+    //  arithmetic that might overflow int64_t.
+
+    if ( num_secs < -max_shift_days * secs_in_day ||
+         num_secs > max_shift_days * secs_in_day ) {
+        return nullptr;
+    }
+
+    const std::int64_t secs = changing_tm->tm_hour *
+                              std::int64_t(secs_in_hour) +
+                              changing_tm->tm_min *
+                              std::int64_t(secs_in_min) +
+                              changing_tm->tm_sec + num_secs;
+    const std::int64_t num_days = floor_div(secs, secs_in_day);
+    const int secs_of_day = static_cast<int>(secs - num_days * secs_in_day);
+    const std::int64_t year = changing_tm->tm_year + std::int64_t(1900);
+    const std::int64_t month = std::int64_t(changing_tm->tm_mon) + 1;
+    const std::int64_t days = days_from_civil(year, month,
+                                              changing_tm->tm_mday) +
+                              num_days;
+
+    if ( !tm_set_date(changing_tm, days) ) {
+        return nullptr;
+    }
+
+    changing_tm->tm_hour = secs_of_day / secs_in_hour;
+    changing_tm->tm_min = secs_of_day % secs_in_hour / secs_in_min;
+    changing_tm->tm_sec = secs_of_day % secs_in_min;
+
+    return changing_tm;
+}
+
+
+/*!
+ * \brief               Adds a signed duration in mixed units to a struct
+ * tm.
+ * \param changing_tm   A pointer to the struct tm to change.
+ * \param days          The number of days to add.
+ * \param hours         The number of hours to add.
+ * \param minutes       The number of minutes to add.
+ * \param seconds       The number of seconds to add.
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing_tm` is unchanged.
+ */
+
+constexpr std::tm *
+tm_add_duration(std::tm *changing_tm, const std::int64_t days,
+                const std::int64_t hours, const std::int64_t minutes,
+                const std::int64_t seconds) {
+    using namespace detail;
+
+    constexpr int hours_in_day = 24;
+    constexpr int mins_in_day = 1440;
+
+    //  With each unit limited like this the total cannot overflow, and
+    //  any unit beyond its limit would overflow tm_year on its own.
+
+    if ( days < -max_shift_days || days > max_shift_days ||
+         hours < -max_shift_days * hours_in_day ||
+         hours > max_shift_days * hours_in_day ||
+         minutes < -max_shift_days * mins_in_day ||
+         minutes > max_shift_days * mins_in_day ||
+         seconds < -max_shift_days * secs_in_day ||
+         seconds > max_shift_days * secs_in_day ) {
+        return nullptr;
+    }
+
+    return pgtime::tm_add_seconds(changing_tm, days * secs_in_day +
+                                               hours * secs_in_hour +
+                                               minutes * secs_in_min +
+                                               seconds);
+}
+
+
+/*!
+ * \brief               Adds one or more days to a struct tm.
+ * \param changing_tm   A pointer to the struct tm to increment.
+ * \param quantity      The number of days to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_increment_day(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, quantity, 0, 0, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more hours to a struct tm.
+ * \param changing_tm   A pointer to the struct tm to increment.
+ * \param quantity      The number of hours to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_increment_hour(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, 0, quantity, 0, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more minutes to a struct tm.
+ * \param changing_tm   A pointer to the struct tm to increment.
+ * \param quantity      The number of minutes to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_increment_minute(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, 0, 0, quantity, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more seconds to a struct tm.
+ * \param changing_tm   A pointer to the struct tm to increment.
+ * \param quantity      The number of seconds to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_increment_second(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_seconds(changing_tm, quantity);
+}
+
+
+/*!
+ * \brief               Deducts one or more days from a struct tm.
+ * \param changing_tm   A pointer to the struct tm to decrement.
+ * \param quantity      The number of days to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_decrement_day(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, -std::int64_t(quantity),
+                                   0, 0, 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more hours from a struct tm.
+ * \param changing_tm   A pointer to the struct tm to decrement.
+ * \param quantity      The number of hours to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_decrement_hour(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, 0,
+                                   -std::int64_t(quantity), 0, 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more minutes from a struct tm.
+ * \param changing_tm   A pointer to the struct tm to decrement.
+ * \param quantity      The number of minutes to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_decrement_minute(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_duration(changing_tm, 0, 0,
+                                   -std::int64_t(quantity), 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more seconds from a struct tm.
+ * \param changing_tm   A pointer to the struct tm to decrement.
+ * \param quantity      The number of seconds to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+constexpr std::tm *
+tm_decrement_second(std::tm *changing_tm, const int quantity) {
+    return pgtime::tm_add_seconds(changing_tm, -std::int64_t(quantity));
+}
+
+
+/*!
+ * \brief           Calculates a POSIX timestamp for a UTC time.
+ * \details         Unlike the C function, this does not check that the
+ * date is valid. The fields need not be in their normal ranges.
+ * \param utc_tm    A pointer to a struct tm containing the UTC time.
+ * \returns         The number of seconds since 1970-01-01 00:00:00 UTC,
+ * not counting leap seconds.
+ */
+
+constexpr std::int64_t
+get_utc_timestamp(const std::tm *utc_tm) {
+    using namespace detail;
+
+    return days_from_civil(utc_tm->tm_year + std::int64_t(1900),
+                           std::int64_t(utc_tm->tm_mon) + 1, utc_tm->tm_mday) *
+           secs_in_day +
+           utc_tm->tm_hour * std::int64_t(secs_in_hour) +
+           utc_tm->tm_min * std::int64_t(secs_in_min) + utc_tm->tm_sec;
+}
+
+
+/*!
+ * \brief           Breaks down a POSIX timestamp into UTC time.
+ * \details         All fields of `result` are set, including `tm_wday`
+ * and `tm_yday`, and `tm_isdst` is set to zero.
+ * \param utc_ts    The number of seconds since 1970-01-01 00:00:00 UTC.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+constexpr std::tm *
+get_utc_tm(const std::int64_t utc_ts, std::tm *result) {
+    using namespace detail;
+
+    //  The date is set first, since it fails for any timestamp so far
+    //  from the epoch that the seconds of the day could overflow.
+
+    const std::int64_t days = floor_div(utc_ts, secs_in_day);
+    if ( !tm_set_date(result, days) ) {
+        return nullptr;
+    }
+
+    const int secs_of_day = static_cast<int>(utc_ts - days * secs_in_day);
+
+    result->tm_hour = secs_of_day / secs_in_hour;
+    result->tm_min = secs_of_day % secs_in_hour / secs_in_min;
+    result->tm_sec = secs_of_day % secs_in_min;
+    result->tm_isdst = 0;
+
+    return result;
+}
+
+
+/*!
+ * \brief           Returns a struct tm for a UTC date and time.
+ * \details         This has no C equivalent, and is for writing constants,
+ * since a struct tm cannot be initialized by member name before C++20.
+ * `tm_wday` and `tm_yday` are set, and the other fields are zero.
+ * \param year      The year, e.g. 2013.
+ * \param month     The month, from 1 to 12.
+ * \param day       The day of the month, from 1 to 31.
+ * \param hour      The hour, from 0 to 23.
+ * \param minute    The minute, from 0 to 59.
+ * \param second    The second, from 0 to 59.
+ * \returns         The struct tm.
+ */
+
+constexpr std::tm
+make_utc_tm(const int year, const int month, const int day,
+            const int hour = 0, const int minute = 0, const int second = 0) {
+    std::tm result{};
+
+    result.tm_year = year - 1900;
+    result.tm_mon = month - 1;
+    result.tm_mday = day;
+    result.tm_hour = hour;
+    result.tm_min = minute;
+    result.tm_sec = second;
+    result.tm_wday = day_of_week(year, month, day);
+    result.tm_yday = day_of_year(year, month, day);
+
+    return result;
+}
+
+
+/*
+ *  Tests, which run whenever this file is compiled. The expected values
+ *  were checked against timegm() and gmtime_r().
+ */
+
+namespace detail {
+
+/*!
+ * \brief           Returns a UTC time after adding a number of seconds.
+ * \param utc_tm    The UTC time.
+ * \param num_secs  The number of seconds to add.
+ * \returns         The result of tm_add_seconds(), or a struct tm with
+ * `tm_mon` of -1 if it failed.
+ */
+
+constexpr std::tm
+test_add_seconds(std::tm utc_tm, const std::int64_t num_secs) {
+    if ( !pgtime::tm_add_seconds(&utc_tm, num_secs) ) {
+        utc_tm.tm_mon = -1;
+    }
+    return utc_tm;
+}
+
+
+/*!
+ * \brief           Returns the UTC time of a timestamp.
+ * \param utc_ts    The timestamp.
+ * \returns         The result of get_utc_tm(), or a struct tm with
+ * `tm_mon` of -1 if it failed.
+ */
+
+constexpr std::tm
+test_utc_tm(const std::int64_t utc_ts) {
+    std::tm result{};
+    if ( !pgtime::get_utc_tm(utc_ts, &result) ) {
+        result.tm_mon = -1;
+    }
+    return result;
+}
+
+
+/*!
+ * \brief           Checks that two struct tm hold the same date and time,
+ * day of the week and day of the year.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         `true` if they match, `false` otherwise.
+ */
+
+constexpr bool
+test_same_tm(const std::tm &first, const std::tm &second) {
+    return pgtime::tm_compare(&first, &second) == 0 &&
+           first.tm_wday == second.tm_wday &&
+           first.tm_yday == second.tm_yday;
+}
+
+
+/*!
+ * \brief           Checks whether a date is valid.
+ * \param check_tm  The date.
+ * \returns         The result of validate_date().
+ */
+
+constexpr bool
+test_valid(const std::tm check_tm) {
+    return pgtime::validate_date(&check_tm);
+}
+
+
+/*!
+ * \brief           Returns the timestamp of a UTC time.
+ * \param utc_tm    The UTC time.
+ * \returns         The result of get_utc_timestamp().
+ */
+
+constexpr std::int64_t
+test_timestamp(const std::tm utc_tm) {
+    return pgtime::get_utc_timestamp(&utc_tm);
+}
+
+
+/*!
+ * \brief           Compares two struct tm.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         The result of tm_compare().
+ */
+
+constexpr int
+test_compare(const std::tm first, const std::tm second) {
+    return pgtime::tm_compare(&first, &second);
+}
+
+
+/*!
+ * \brief           Checks that every day for 800 years either side of
+ * 1970 survives a round trip through civil_from_days().
+ * \returns         `true` if they all do, `false` otherwise.
+ */
+
+constexpr bool
+test_civil_round_trip() {
+    for ( std::int64_t days = -292194; days <= 292194; days += 97 ) {
+        std::int64_t year = 0;
+        int month = 0;
+        int day = 0;
+
+        civil_from_days(days, &year, &month, &day);
+        if ( days_from_civil(year, month, day) != days ||
+             day_of_week(year, month, day) !=
+                 test_utc_tm(days * secs_in_day).tm_wday ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(is_leap_year(2000) && is_leap_year(2012) &&
+              !is_leap_year(1900) && !is_leap_year(2013) &&
+              is_leap_year(-4) && !is_leap_year(-100),
+              "is_leap_year() is wrong");
+
+static_assert(days_from_civil(1970, 1, 1) == 0 &&
+              days_from_civil(2000, 3, 1) == 11017 &&
+              days_from_civil(1969, 12, 31) == -1 &&
+              days_from_civil(1, 1, 1) == -719162 &&
+              days_from_civil(2013, 13, 1) == days_from_civil(2014, 1, 1),
+              "days_from_civil() is wrong");
+
+static_assert(test_civil_round_trip(), "civil_from_days() is wrong");
+
+static_assert(day_of_week(1970, 1, 1) == 4 &&
+              day_of_week(2000, 2, 29) == 2 &&
+              day_of_year(2012, 12, 31) == 365 &&
+              day_of_year(2013, 3, 1) == 59,
+              "day_of_week() or day_of_year() is wrong");
+
+static_assert(test_valid(make_utc_tm(2012, 2, 29, 23, 59, 59)) &&
+              !test_valid(make_utc_tm(2013, 2, 29)) &&
+              !test_valid(make_utc_tm(2013, 4, 31)) &&
+              !test_valid(make_utc_tm(2013, 1, 1, 0, 0, 60)) &&
+              test_valid(make_utc_tm(0, 2, 29)),
+              "validate_date() is wrong");
+
+static_assert(test_timestamp(make_utc_tm(1970, 1, 1)) == 0 &&
+              test_timestamp(make_utc_tm(2013, 7, 4, 12, 30, 15)) ==
+                  1372941015 &&
+              test_timestamp(make_utc_tm(1901, 12, 13, 20, 45, 52)) ==
+                  -2147483648LL &&
+              test_timestamp(make_utc_tm(2038, 1, 19, 3, 14, 8)) ==
+                  2147483648LL,
+              "get_utc_timestamp() is wrong");
+
+static_assert(test_same_tm(test_utc_tm(1372941015),
+                           make_utc_tm(2013, 7, 4, 12, 30, 15)) &&
+              test_same_tm(test_utc_tm(-1),
+                           make_utc_tm(1969, 12, 31, 23, 59, 59)) &&
+              test_same_tm(test_utc_tm(951782400), make_utc_tm(2000, 2, 29)),
+              "get_utc_tm() is wrong");
+
+static_assert(test_same_tm(test_add_seconds(make_utc_tm(2012, 12, 31,
+                                                        23, 59, 59), 1),
+                           make_utc_tm(2013, 1, 1)) &&
+              test_same_tm(test_add_seconds(make_utc_tm(2012, 2, 28), -86400),
+                           make_utc_tm(2012, 2, 27)) &&
+              test_same_tm(test_add_seconds(make_utc_tm(2012, 2, 28),
+                                            365 * 86400LL),
+                           make_utc_tm(2013, 2, 27)) &&
+              test_add_seconds(make_utc_tm(2013, 1, 1),
+                               max_shift_days * secs_in_day + 1).tm_mon ==
+                  -1,
+              "tm_add_seconds() is wrong");
+
+static_assert(test_compare(make_utc_tm(2013, 1, 1),
+                           make_utc_tm(2012, 12, 31, 23)) == 1 &&
+              test_compare(make_utc_tm(2013, 1, 1, 0, 0, 1),
+                           make_utc_tm(2013, 1, 1, 0, 0, 2)) == -1 &&
+              test_compare(make_utc_tm(2013, 1, 1),
+                           make_utc_tm(2013, 1, 1)) == 0,
+              "tm_compare() is wrong");
+
+}       //  namespace detail
+
+}       //  namespace pgtime
+
+
+#endif          /*  PG_PGTIME_HPP  */
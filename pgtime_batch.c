@@ -0,0 +1,1068 @@
+/*!
+ * \file        pgtime_batch.c
+ * \brief       Implementation of array versions of the pgtime conversions.
+ * \details     Each conversion has a portable scalar kernel and, on x86-64,
+ * SIMD kernels. The best kernel the CPU supports is chosen at
+ * run time, unless the caller selects one with batch_select_kernel().
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_batch.h"
+#include "pgtime_internal.h"
+
+#ifdef PGTIME_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+/*  Number of struct tms copied into columns at a time  */
+
+#define BATCH_BLOCK_SIZE 64
+
+/*
+ *  The SIMD kernels calculate in double precision, which is exact for
+ *  every intermediate value as long as the year stays within this many
+ *  years of 1900. Times outside the range go through the scalar code.
+ */
+
+#define SIMD_MAX_TM_YEAR (1 << 24)
+
+
+/*  Read-only view of a set of columns  */
+
+struct const_columns {
+    const int *tm_year;
+    const int *tm_mon;
+    const int *tm_mday;
+    const int *tm_hour;
+    const int *tm_min;
+    const int *tm_sec;
+};
+
+/*  Storage for a block of struct tms copied into columns  */
+
+struct column_block {
+    int tm_year[BATCH_BLOCK_SIZE];
+    int tm_mon[BATCH_BLOCK_SIZE];
+    int tm_mday[BATCH_BLOCK_SIZE];
+    int tm_hour[BATCH_BLOCK_SIZE];
+    int tm_min[BATCH_BLOCK_SIZE];
+    int tm_sec[BATCH_BLOCK_SIZE];
+};
+
+/*  Columns written by the decomposition kernels  */
+
+struct fields_out {
+    int *tm_year;
+    int *tm_mon;
+    int *tm_mday;
+    int *tm_hour;
+    int *tm_min;
+    int *tm_sec;
+    int *tm_wday;           /*  Null if not wanted, with tm_yday  */
+    int *tm_yday;
+};
+
+/*  The date of the most recent timestamp decomposed  */
+
+struct day_cache {
+    bool valid;
+    int64_t days;
+    int tm_year;
+    int tm_mon;
+    int tm_mday;
+    int tm_wday;
+    int tm_yday;
+};
+
+typedef bool (*timestamps_kernel)(const struct const_columns *cols,
+                                  time_t *results, const size_t count);
+typedef bool (*fields_kernel)(const time_t *utc_ts,
+                              const struct fields_out *out,
+                              const size_t count);
+
+static _Atomic int selected_kernel = BATCH_KERNEL_AUTO;
+
+
+/*!
+ * \brief           Checks whether the CPU can run a kernel.
+ * \param kernel    The kernel to check.
+ * \returns         `true` if the kernel can be used, `false` otherwise.
+ */
+
+static bool
+kernel_supported(const enum batch_kernel kernel) {
+    switch ( kernel ) {
+        case BATCH_KERNEL_AUTO:
+        case BATCH_KERNEL_SCALAR:
+            return true;
+
+#ifdef PGTIME_X86_SIMD
+        case BATCH_KERNEL_SSE41:
+            return __builtin_cpu_supports("sse4.1");
+
+        case BATCH_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+
+        default:
+            return false;
+    }
+}
+
+
+/*!
+ * \brief           Selects the kernel used by the batch functions.
+ * \details         This is mainly useful for benchmarking and testing,
+ * since by default the best kernel the CPU supports is used. The
+ * selection applies to all threads.
+ * \param kernel    The kernel to use, or `BATCH_KERNEL_AUTO` to go back
+ * to choosing automatically.
+ * \returns         `true` if the kernel was selected, `false` if it is not
+ * supported on this CPU or platform.
+ */
+
+bool
+batch_select_kernel(const enum batch_kernel kernel) {
+    if ( !kernel_supported(kernel) ) {
+        return false;
+    }
+
+    atomic_store_explicit(&selected_kernel, kernel, memory_order_relaxed);
+    return true;
+}
+
+
+/*!
+ * \brief           Returns the kernel the batch functions are using.
+ * \returns         The kernel in use. This is never `BATCH_KERNEL_AUTO`.
+ */
+
+enum batch_kernel
+batch_active_kernel(void) {
+    const enum batch_kernel kernel =
+        atomic_load_explicit(&selected_kernel, memory_order_relaxed);
+
+    if ( kernel != BATCH_KERNEL_AUTO ) {
+        return kernel;
+    } else if ( kernel_supported(BATCH_KERNEL_AVX2) ) {
+        return BATCH_KERNEL_AVX2;
+    } else if ( kernel_supported(BATCH_KERNEL_SSE41) ) {
+        return BATCH_KERNEL_SSE41;
+    } else {
+        return BATCH_KERNEL_SCALAR;
+    }
+}
+
+
+/*!
+ * \brief           Converts one row of a set of columns to a timestamp.
+ * \param cols      The columns.
+ * \param index     The row to convert.
+ * \param result    Modified to contain the time_t timestamp for the row,
+ * or -1 if it cannot be found.
+ * \returns         `true` on success, `false` if the timestamp cannot be
+ * found.
+ */
+
+static bool
+timestamp_at(const struct const_columns *cols, const size_t index,
+             time_t *result) {
+    struct tm utc_tm = {0};
+    utc_tm.tm_year = cols->tm_year[index];
+    utc_tm.tm_mon = cols->tm_mon[index];
+    utc_tm.tm_mday = cols->tm_mday[index];
+    utc_tm.tm_hour = cols->tm_hour[index];
+    utc_tm.tm_min = cols->tm_min[index];
+    utc_tm.tm_sec = cols->tm_sec[index];
+
+    if ( pgtime_utc_timestamp(&utc_tm, result) != PGTIME_OK ) {
+        *result = -1;
+        return false;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief           Portable kernel for get_utc_timestamps_columns().
+ * \param cols      The columns to convert.
+ * \param results   The array to receive the timestamps.
+ * \param count     The number of rows to convert.
+ * \returns         `true` if every row was converted, `false` otherwise.
+ */
+
+static bool
+timestamps_scalar(const struct const_columns *cols, time_t *results,
+                  const size_t count) {
+    bool success = true;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        success &= timestamp_at(cols, i, &results[i]);
+    }
+
+    return success;
+}
+
+
+/*!
+ * \brief           Breaks down one timestamp, reusing the date if it falls
+ * on the same day as the previous one.
+ * \param utc_ts    The timestamp to break down.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \param cache     The date of the previous timestamp, updated if the day
+ * changes.
+ * \returns         `true` on success, `false` if the year cannot be
+ * represented in a struct tm.
+ */
+
+static bool
+cached_utc_tm(const time_t utc_ts, struct tm *result,
+              struct day_cache *cache) {
+#ifdef PGTIME_POSIX_TIME_T
+    static const int secs_in_day = 86400;
+    static const int secs_in_hour = 3600;
+    static const int secs_in_min = 60;
+
+    const int64_t days = floor_div(utc_ts, secs_in_day);
+
+    if ( !cache->valid || days != cache->days ) {
+        if ( get_utc_tm(utc_ts, result) == 0 ) {
+            return false;
+        }
+
+        cache->valid = true;
+        cache->days = days;
+        cache->tm_year = result->tm_year;
+        cache->tm_mon = result->tm_mon;
+        cache->tm_mday = result->tm_mday;
+        cache->tm_wday = result->tm_wday;
+        cache->tm_yday = result->tm_yday;
+        return true;
+    }
+
+    const int secs_of_day = (int) (utc_ts - days * secs_in_day);
+
+    result->tm_year = cache->tm_year;
+    result->tm_mon = cache->tm_mon;
+    result->tm_mday = cache->tm_mday;
+    result->tm_hour = secs_of_day / secs_in_hour;
+    result->tm_min = secs_of_day % secs_in_hour / secs_in_min;
+    result->tm_sec = secs_of_day % secs_in_min;
+    result->tm_wday = cache->tm_wday;
+    result->tm_yday = cache->tm_yday;
+    result->tm_isdst = 0;
+
+    return true;
+#else
+    (void) cache;
+    return get_utc_tm(utc_ts, result) != 0;
+#endif
+}
+
+
+/*!
+ * \brief           Breaks down one timestamp into a row of columns.
+ * \param utc_ts    The timestamp to break down.
+ * \param out       The columns to receive the UTC fields.
+ * \param index     The row of `out` to write.
+ * \param cache     The date of the previous timestamp, updated if the day
+ * changes.
+ * \returns         `true` on success, `false` if the year cannot be
+ * represented in an int.
+ */
+
+static bool
+fields_at(const time_t utc_ts, const struct fields_out *out,
+          const size_t index, struct day_cache *cache) {
+    struct tm utc_tm;
+
+    if ( !cached_utc_tm(utc_ts, &utc_tm, cache) ) {
+        return false;
+    }
+
+    out->tm_year[index] = utc_tm.tm_year;
+    out->tm_mon[index] = utc_tm.tm_mon;
+    out->tm_mday[index] = utc_tm.tm_mday;
+    out->tm_hour[index] = utc_tm.tm_hour;
+    out->tm_min[index] = utc_tm.tm_min;
+    out->tm_sec[index] = utc_tm.tm_sec;
+    if ( out->tm_wday ) {
+        out->tm_wday[index] = utc_tm.tm_wday;
+        out->tm_yday[index] = utc_tm.tm_yday;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief           Portable kernel for get_utc_tms_columns().
+ * \details         The date is only recalculated when a timestamp falls
+ * on a different day from the one before it, so sorted input mostly
+ * costs just the time of day.
+ * \param utc_ts    The timestamps to decompose.
+ * \param out       The columns to receive the UTC fields.
+ * \param count     The number of timestamps.
+ * \returns         `true` if every timestamp was decomposed, `false`
+ * otherwise.
+ */
+
+static bool
+fields_scalar(const time_t *utc_ts, const struct fields_out *out,
+              const size_t count) {
+    struct day_cache cache = {0};
+    bool success = true;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        success &= fields_at(utc_ts[i], out, i, &cache);
+    }
+
+    return success;
+}
+
+
+#ifdef PGTIME_X86_SIMD
+
+/*
+ *  The SIMD kernels use the same serial day calculation as
+ *  days_from_civil(), but without splitting the year into 400-year eras:
+ *
+ *      days = 365 * y + floor(y / 4) - floor(y / 100) + floor(y / 400)
+ *             + day_of_year_from_march - 719468
+ *
+ *  where y is the year counted from March. The divisions are done by
+ *  multiplying by the reciprocal and rounding down, which is exact in the
+ *  range we allow, since the double closest to each reciprocal is slightly
+ *  larger than the true value. The final double is converted to a 64-bit
+ *  integer by adding 1.5 * 2^52, which puts the integer in the low bits of
+ *  the mantissa, with SIMD_INT64_MAGIC.
+ */
+
+
+/*!
+ * \brief           SSE4.1 kernel for get_utc_timestamps_columns().
+ * \param cols      The columns to convert.
+ * \param results   The array to receive the timestamps.
+ * \param count     The number of rows to convert.
+ * \returns         `true` if every row was converted, `false` otherwise.
+ */
+
+__attribute__((target("sse4.1")))
+static bool
+timestamps_sse41(const struct const_columns *cols, time_t *results,
+                 const size_t count) {
+    const __m128i min_year = _mm_set1_epi32(-SIMD_MAX_TM_YEAR);
+    const __m128i max_year = _mm_set1_epi32(SIMD_MAX_TM_YEAR);
+    const __m128i max_mon = _mm_set1_epi32(11);
+    const __m128d magic = _mm_set1_pd(SIMD_INT64_MAGIC);
+    bool success = true;
+    size_t i = 0;
+
+    for ( ; i + 2 <= count; i += 2 ) {
+        const __m128i year = _mm_loadl_epi64((const __m128i *)
+                                             (cols->tm_year + i));
+        const __m128i mon = _mm_loadl_epi64((const __m128i *)
+                                            (cols->tm_mon + i));
+        const __m128i bad =
+            _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(mon, _mm_setzero_si128()),
+                                      _mm_cmpgt_epi32(mon, max_mon)),
+                         _mm_or_si128(_mm_cmplt_epi32(year, min_year),
+                                      _mm_cmpgt_epi32(year, max_year)));
+
+        if ( !_mm_testz_si128(bad, bad) ) {
+            success &= timestamp_at(cols, i, &results[i]);
+            success &= timestamp_at(cols, i + 1, &results[i + 1]);
+            continue;
+        }
+
+        const __m128d m0 = _mm_cvtepi32_pd(mon);
+        const __m128d early = _mm_cmplt_pd(m0, _mm_set1_pd(2.0));
+        const __m128d y = _mm_sub_pd(_mm_add_pd(_mm_cvtepi32_pd(year),
+                                                _mm_set1_pd(1900.0)),
+                                     _mm_and_pd(early, _mm_set1_pd(1.0)));
+        const __m128d mp = _mm_add_pd(_mm_sub_pd(m0, _mm_set1_pd(2.0)),
+                                      _mm_and_pd(early, _mm_set1_pd(12.0)));
+        const __m128d mday = _mm_cvtepi32_pd(
+            _mm_loadl_epi64((const __m128i *) (cols->tm_mday + i)));
+        const __m128d hour = _mm_cvtepi32_pd(
+            _mm_loadl_epi64((const __m128i *) (cols->tm_hour + i)));
+        const __m128d min = _mm_cvtepi32_pd(
+            _mm_loadl_epi64((const __m128i *) (cols->tm_min + i)));
+        const __m128d sec = _mm_cvtepi32_pd(
+            _mm_loadl_epi64((const __m128i *) (cols->tm_sec + i)));
+
+        const __m128d doy =
+            _mm_add_pd(_mm_floor_pd(_mm_mul_pd(
+                           _mm_add_pd(_mm_mul_pd(mp, _mm_set1_pd(153.0)),
+                                      _mm_set1_pd(2.0)),
+                           _mm_set1_pd(0.2))),
+                       _mm_sub_pd(mday, _mm_set1_pd(1.0)));
+
+        __m128d days = _mm_mul_pd(y, _mm_set1_pd(365.0));
+        days = _mm_add_pd(days, _mm_floor_pd(_mm_mul_pd(y, _mm_set1_pd(0.25))));
+        days = _mm_sub_pd(days, _mm_floor_pd(_mm_mul_pd(y, _mm_set1_pd(0.01))));
+        days = _mm_add_pd(days,
+                          _mm_floor_pd(_mm_mul_pd(y, _mm_set1_pd(0.0025))));
+        days = _mm_add_pd(days, _mm_sub_pd(doy, _mm_set1_pd(719468.0)));
+
+        __m128d secs = _mm_mul_pd(days, _mm_set1_pd(86400.0));
+        secs = _mm_add_pd(secs, _mm_mul_pd(hour, _mm_set1_pd(3600.0)));
+        secs = _mm_add_pd(secs, _mm_mul_pd(min, _mm_set1_pd(60.0)));
+        secs = _mm_add_pd(secs, sec);
+
+        const __m128i ts = _mm_sub_epi64(
+            _mm_castpd_si128(_mm_add_pd(secs, magic)),
+            _mm_castpd_si128(magic));
+        _mm_storeu_si128((__m128i *) (results + i), ts);
+    }
+
+    for ( ; i < count; ++i ) {
+        success &= timestamp_at(cols, i, &results[i]);
+    }
+
+    return success;
+}
+
+
+/*!
+ * \brief           AVX2 kernel for get_utc_timestamps_columns().
+ * \param cols      The columns to convert.
+ * \param results   The array to receive the timestamps.
+ * \param count     The number of rows to convert.
+ * \returns         `true` if every row was converted, `false` otherwise.
+ */
+
+__attribute__((target("avx2")))
+static bool
+timestamps_avx2(const struct const_columns *cols, time_t *results,
+                const size_t count) {
+    const __m128i min_year = _mm_set1_epi32(-SIMD_MAX_TM_YEAR);
+    const __m128i max_year = _mm_set1_epi32(SIMD_MAX_TM_YEAR);
+    const __m128i max_mon = _mm_set1_epi32(11);
+    const __m256d magic = _mm256_set1_pd(SIMD_INT64_MAGIC);
+    bool success = true;
+    size_t i = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        const __m128i year = _mm_loadu_si128((const __m128i *)
+                                             (cols->tm_year + i));
+        const __m128i mon = _mm_loadu_si128((const __m128i *)
+                                            (cols->tm_mon + i));
+        const __m128i bad =
+            _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(mon, _mm_setzero_si128()),
+                                      _mm_cmpgt_epi32(mon, max_mon)),
+                         _mm_or_si128(_mm_cmplt_epi32(year, min_year),
+                                      _mm_cmpgt_epi32(year, max_year)));
+
+        if ( !_mm_testz_si128(bad, bad) ) {
+            for ( size_t j = i; j < i + 4; ++j ) {
+                success &= timestamp_at(cols, j, &results[j]);
+            }
+            continue;
+        }
+
+        const __m256d m0 = _mm256_cvtepi32_pd(mon);
+        const __m256d early = _mm256_cmp_pd(m0, _mm256_set1_pd(2.0),
+                                            _CMP_LT_OQ);
+        const __m256d y =
+            _mm256_sub_pd(_mm256_add_pd(_mm256_cvtepi32_pd(year),
+                                        _mm256_set1_pd(1900.0)),
+                          _mm256_and_pd(early, _mm256_set1_pd(1.0)));
+        const __m256d mp =
+            _mm256_add_pd(_mm256_sub_pd(m0, _mm256_set1_pd(2.0)),
+                          _mm256_and_pd(early, _mm256_set1_pd(12.0)));
+        const __m256d mday = _mm256_cvtepi32_pd(
+            _mm_loadu_si128((const __m128i *) (cols->tm_mday + i)));
+        const __m256d hour = _mm256_cvtepi32_pd(
+            _mm_loadu_si128((const __m128i *) (cols->tm_hour + i)));
+        const __m256d min = _mm256_cvtepi32_pd(
+            _mm_loadu_si128((const __m128i *) (cols->tm_min + i)));
+        const __m256d sec = _mm256_cvtepi32_pd(
+            _mm_loadu_si128((const __m128i *) (cols->tm_sec + i)));
+
+        const __m256d doy =
+            _mm256_add_pd(_mm256_floor_pd(_mm256_mul_pd(
+                              _mm256_add_pd(_mm256_mul_pd(
+                                                mp, _mm256_set1_pd(153.0)),
+                                            _mm256_set1_pd(2.0)),
+                              _mm256_set1_pd(0.2))),
+                          _mm256_sub_pd(mday, _mm256_set1_pd(1.0)));
+
+        __m256d days = _mm256_mul_pd(y, _mm256_set1_pd(365.0));
+        days = _mm256_add_pd(days, _mm256_floor_pd(
+                                 _mm256_mul_pd(y, _mm256_set1_pd(0.25))));
+        days = _mm256_sub_pd(days, _mm256_floor_pd(
+                                 _mm256_mul_pd(y, _mm256_set1_pd(0.01))));
+        days = _mm256_add_pd(days, _mm256_floor_pd(
+                                 _mm256_mul_pd(y, _mm256_set1_pd(0.0025))));
+        days = _mm256_add_pd(days,
+                             _mm256_sub_pd(doy, _mm256_set1_pd(719468.0)));
+
+        __m256d secs = _mm256_mul_pd(days, _mm256_set1_pd(86400.0));
+        secs = _mm256_add_pd(secs,
+                             _mm256_mul_pd(hour, _mm256_set1_pd(3600.0)));
+        secs = _mm256_add_pd(secs, _mm256_mul_pd(min, _mm256_set1_pd(60.0)));
+        secs = _mm256_add_pd(secs, sec);
+
+        const __m256i ts = _mm256_sub_epi64(
+            _mm256_castpd_si256(_mm256_add_pd(secs, magic)),
+            _mm256_castpd_si256(magic));
+        _mm256_storeu_si256((__m256i *) (results + i), ts);
+    }
+
+    for ( ; i < count; ++i ) {
+        success &= timestamp_at(cols, i, &results[i]);
+    }
+
+    return success;
+}
+
+
+/*
+ *  Beyond this distance from 1970 in either direction, the AVX2
+ *  decomposition kernel passes timestamps to the scalar code.
+ */
+
+#define SIMD_MAX_TIMESTAMP ((int64_t) 1 << 45)
+
+
+/*!
+ * \brief           Rounds down the quotient of a vector of integral
+ * doubles and a positive constant.
+ * \details         Adding a half before multiplying by the reciprocal keeps
+ * the product at least half of 1 / divisor away from an integer, which is
+ * much larger than the rounding error in the range we allow.
+ * \param x         The dividends.
+ * \param divisor   The divisor.
+ * \returns         The quotients, rounded down.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256d
+floor_div_pd(const __m256d x, const double divisor) {
+    return _mm256_floor_pd(_mm256_mul_pd(_mm256_add_pd(x, _mm256_set1_pd(0.5)),
+                                         _mm256_set1_pd(1.0 / divisor)));
+}
+
+
+/*!
+ * \brief           AVX2 kernel for get_utc_tms_columns().
+ * \details         Four timestamps are decomposed at once. If all four
+ * fall on the same day as the previous group, only the time of day is
+ * calculated, so sorted input still benefits from reusing the date.
+ * \param utc_ts    The timestamps to decompose.
+ * \param out       The columns to receive the UTC fields.
+ * \param count     The number of timestamps.
+ * \returns         `true` if every timestamp was decomposed, `false`
+ * otherwise.
+ */
+
+__attribute__((target("avx2")))
+static bool
+fields_avx2(const time_t *utc_ts, const struct fields_out *out,
+            const size_t count) {
+    const __m256i max_ts = _mm256_set1_epi64x(SIMD_MAX_TIMESTAMP);
+    const __m256i min_ts = _mm256_set1_epi64x(-SIMD_MAX_TIMESTAMP);
+    const __m256d magic = _mm256_set1_pd(SIMD_INT64_MAGIC);
+    const __m256d one = _mm256_set1_pd(1.0);
+    struct day_cache cache = {0};
+    __m128i date[5] = {0};
+    bool success = true;
+    size_t i = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        const __m256i ts = _mm256_loadu_si256((const __m256i *) (utc_ts + i));
+        const __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(ts, max_ts),
+                                            _mm256_cmpgt_epi64(min_ts, ts));
+
+        if ( !_mm256_testz_si256(bad, bad) ) {
+            for ( size_t j = i; j < i + 4; ++j ) {
+                success &= fields_at(utc_ts[j], out, j, &cache);
+            }
+            continue;
+        }
+
+        const __m256d t = _mm256_sub_pd(_mm256_castsi256_pd(
+            _mm256_add_epi64(ts, _mm256_castpd_si256(magic))), magic);
+        const __m256d days = floor_div_pd(t, 86400.0);
+        const __m256d sod = _mm256_sub_pd(t, _mm256_mul_pd(
+                                days, _mm256_set1_pd(86400.0)));
+        const __m256d hour = floor_div_pd(sod, 3600.0);
+        const __m256d soh = _mm256_sub_pd(sod, _mm256_mul_pd(
+                                hour, _mm256_set1_pd(3600.0)));
+        const __m256d min = floor_div_pd(soh, 60.0);
+        const __m256d sec = _mm256_sub_pd(soh, _mm256_mul_pd(
+                                min, _mm256_set1_pd(60.0)));
+
+        const __m256d same_day = _mm256_cmp_pd(
+            days, _mm256_set1_pd((double) cache.days), _CMP_EQ_OQ);
+
+        if ( !cache.valid || _mm256_movemask_pd(same_day) != 0xF ) {
+
+            //  The same algorithm as civil_from_days().
+
+            const __m256d z = _mm256_add_pd(days, _mm256_set1_pd(719468.0));
+            const __m256d era = floor_div_pd(z, 146097.0);
+            const __m256d doe = _mm256_sub_pd(z, _mm256_mul_pd(
+                                    era, _mm256_set1_pd(146097.0)));
+            const __m256d yoe = floor_div_pd(
+                _mm256_add_pd(_mm256_sub_pd(doe, floor_div_pd(doe, 1460.0)),
+                              _mm256_sub_pd(floor_div_pd(doe, 36524.0),
+                                            floor_div_pd(doe, 146096.0))),
+                365.0);
+            const __m256d doy = _mm256_sub_pd(doe, _mm256_add_pd(
+                _mm256_mul_pd(yoe, _mm256_set1_pd(365.0)),
+                _mm256_sub_pd(floor_div_pd(yoe, 4.0),
+                              floor_div_pd(yoe, 100.0))));
+            const __m256d mp = floor_div_pd(_mm256_add_pd(
+                _mm256_mul_pd(doy, _mm256_set1_pd(5.0)),
+                _mm256_set1_pd(2.0)), 153.0);
+            const __m256d mday = _mm256_add_pd(_mm256_sub_pd(
+                doy, floor_div_pd(_mm256_add_pd(
+                         _mm256_mul_pd(mp, _mm256_set1_pd(153.0)),
+                         _mm256_set1_pd(2.0)), 5.0)), one);
+            const __m256d jan_feb = _mm256_cmp_pd(mp, _mm256_set1_pd(10.0),
+                                                  _CMP_GE_OQ);
+            const __m256d mon = _mm256_sub_pd(
+                _mm256_add_pd(mp, _mm256_set1_pd(2.0)),
+                _mm256_and_pd(jan_feb, _mm256_set1_pd(12.0)));
+            const __m256d year = _mm256_add_pd(
+                _mm256_add_pd(yoe, _mm256_mul_pd(era, _mm256_set1_pd(400.0))),
+                _mm256_and_pd(jan_feb, one));
+
+            const __m256d y4 = _mm256_sub_pd(year, _mm256_mul_pd(
+                floor_div_pd(year, 4.0), _mm256_set1_pd(4.0)));
+            const __m256d y100 = _mm256_sub_pd(year, _mm256_mul_pd(
+                floor_div_pd(year, 100.0), _mm256_set1_pd(100.0)));
+            const __m256d y400 = _mm256_sub_pd(year, _mm256_mul_pd(
+                floor_div_pd(year, 400.0), _mm256_set1_pd(400.0)));
+            const __m256d zero = _mm256_setzero_pd();
+            const __m256d leap = _mm256_and_pd(
+                _mm256_cmp_pd(y4, zero, _CMP_EQ_OQ),
+                _mm256_or_pd(_mm256_cmp_pd(y100, zero, _CMP_NEQ_OQ),
+                             _mm256_cmp_pd(y400, zero, _CMP_EQ_OQ)));
+            const __m256d yday = _mm256_blendv_pd(
+                _mm256_add_pd(_mm256_add_pd(doy, _mm256_set1_pd(59.0)),
+                              _mm256_and_pd(leap, one)),
+                _mm256_sub_pd(doy, _mm256_set1_pd(306.0)),
+                jan_feb);
+
+            const __m256d wday_days = _mm256_add_pd(days, _mm256_set1_pd(4.0));
+            const __m256d wday = _mm256_sub_pd(wday_days, _mm256_mul_pd(
+                floor_div_pd(wday_days, 7.0), _mm256_set1_pd(7.0)));
+
+            date[0] = _mm256_cvtpd_epi32(_mm256_sub_pd(
+                          year, _mm256_set1_pd(1900.0)));
+            date[1] = _mm256_cvtpd_epi32(mon);
+            date[2] = _mm256_cvtpd_epi32(mday);
+            date[3] = _mm256_cvtpd_epi32(wday);
+            date[4] = _mm256_cvtpd_epi32(yday);
+
+            //  Remember the date of the last lane for the next group.
+
+            int last[5];
+            for ( int f = 0; f < 5; ++f ) {
+                last[f] = _mm_extract_epi32(date[f], 3);
+            }
+            cache.valid = true;
+            cache.days = floor_div(utc_ts[i + 3], 86400);
+            cache.tm_year = last[0];
+            cache.tm_mon = last[1];
+            cache.tm_mday = last[2];
+            cache.tm_wday = last[3];
+            cache.tm_yday = last[4];
+        } else {
+            date[0] = _mm_set1_epi32(cache.tm_year);
+            date[1] = _mm_set1_epi32(cache.tm_mon);
+            date[2] = _mm_set1_epi32(cache.tm_mday);
+            date[3] = _mm_set1_epi32(cache.tm_wday);
+            date[4] = _mm_set1_epi32(cache.tm_yday);
+        }
+
+        _mm_storeu_si128((__m128i *) (out->tm_year + i), date[0]);
+        _mm_storeu_si128((__m128i *) (out->tm_mon + i), date[1]);
+        _mm_storeu_si128((__m128i *) (out->tm_mday + i), date[2]);
+        _mm_storeu_si128((__m128i *) (out->tm_hour + i),
+                         _mm256_cvtpd_epi32(hour));
+        _mm_storeu_si128((__m128i *) (out->tm_min + i),
+                         _mm256_cvtpd_epi32(min));
+        _mm_storeu_si128((__m128i *) (out->tm_sec + i),
+                         _mm256_cvtpd_epi32(sec));
+        if ( out->tm_wday ) {
+            _mm_storeu_si128((__m128i *) (out->tm_wday + i), date[3]);
+            _mm_storeu_si128((__m128i *) (out->tm_yday + i), date[4]);
+        }
+    }
+
+    for ( ; i < count; ++i ) {
+        success &= fields_at(utc_ts[i], out, i, &cache);
+    }
+
+    return success;
+}
+
+#endif          /*  PGTIME_X86_SIMD  */
+
+
+/*!
+ * \brief           Returns the active kernel for get_utc_timestamps().
+ * \returns         The kernel function.
+ */
+
+static timestamps_kernel
+get_timestamps_kernel(void) {
+    switch ( batch_active_kernel() ) {
+#ifdef PGTIME_X86_SIMD
+        case BATCH_KERNEL_AVX2:
+            return timestamps_avx2;
+
+        case BATCH_KERNEL_SSE41:
+            return timestamps_sse41;
+#endif
+
+        default:
+            return timestamps_scalar;
+    }
+}
+
+
+/*!
+ * \brief           Copies a block of struct tms into columns.
+ * \param storage   The storage for the columns.
+ * \param utc_tms   The struct tms to copy.
+ * \param count     The number of struct tms, at most BATCH_BLOCK_SIZE.
+ * \returns         A view of the columns in `storage`.
+ */
+
+static struct const_columns
+load_block(struct column_block *storage, const struct tm *utc_tms,
+           const size_t count) {
+    for ( size_t i = 0; i < count; ++i ) {
+        storage->tm_year[i] = utc_tms[i].tm_year;
+        storage->tm_mon[i] = utc_tms[i].tm_mon;
+        storage->tm_mday[i] = utc_tms[i].tm_mday;
+        storage->tm_hour[i] = utc_tms[i].tm_hour;
+        storage->tm_min[i] = utc_tms[i].tm_min;
+        storage->tm_sec[i] = utc_tms[i].tm_sec;
+    }
+
+    const struct const_columns cols = {
+        storage->tm_year, storage->tm_mon, storage->tm_mday,
+        storage->tm_hour, storage->tm_min, storage->tm_sec
+    };
+    return cols;
+}
+
+
+/*!
+ * \brief           Does the work of get_utc_timestamps().
+ * \param utc_tms   An array of struct tms containing the UTC times.
+ * \param results   An array to receive the timestamps.
+ * \param count     The number of elements in each array.
+ * \returns         `true` if every time was converted, `false` otherwise.
+ */
+
+static bool
+tms_to_timestamps(const struct tm *utc_tms, time_t *results,
+                  const size_t count) {
+    const timestamps_kernel kernel = get_timestamps_kernel();
+    bool success = true;
+
+    if ( kernel == timestamps_scalar ) {
+        for ( size_t i = 0; i < count; ++i ) {
+            if ( pgtime_utc_timestamp(&utc_tms[i], &results[i]) !=
+                     PGTIME_OK ) {
+                results[i] = -1;
+                success = false;
+            }
+        }
+        return success;
+    }
+
+    struct column_block block_storage;
+
+    for ( size_t start = 0; start < count; start += BATCH_BLOCK_SIZE ) {
+        const size_t block = count - start < BATCH_BLOCK_SIZE ?
+                             count - start : BATCH_BLOCK_SIZE;
+        const struct const_columns cols = load_block(&block_storage,
+                                                     utc_tms + start, block);
+
+        success &= kernel(&cols, results + start, block);
+    }
+
+    return success;
+}
+
+
+/*!
+ * \brief           Gets time_t timestamps for an array of UTC times.
+ * \details         Gives the same results as calling get_utc_timestamp()
+ * on each element, but converts several times at once where the CPU
+ * supports it. The times are copied into columns in small blocks, so
+ * get_utc_timestamps_columns() is faster still if the data is already
+ * stored that way. Unlike get_utc_timestamp(), the program never exits; a
+ * time whose timestamp cannot be found gets -1, and the others are still
+ * converted.
+ * \param utc_tms   An array of struct tms containing the UTC times.
+ * \param results   An array to receive the timestamps.
+ * \param count     The number of elements in each array.
+ * \returns         `true` if every time was converted, `false` otherwise.
+ */
+
+bool
+get_utc_timestamps(const struct tm *utc_tms, time_t *results,
+                   const size_t count) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TIMESTAMPS);
+    const bool success = tms_to_timestamps(utc_tms, results, count);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TIMESTAMPS, start);
+    return success;
+}
+
+
+/*!
+ * \brief               Gets time_t timestamps for UTC times stored as
+ * columns.
+ * \details             Gives the same results as calling
+ * get_utc_timestamp() on each row, except that a row whose timestamp
+ * cannot be found gets -1, as for get_utc_timestamps().
+ * \param utc_columns   The columns containing the UTC times.
+ * \param results       An array to receive the timestamps.
+ * \param count         The number of rows to convert.
+ * \returns             `true` if every row was converted, `false`
+ * otherwise.
+ */
+
+bool
+get_utc_timestamps_columns(const struct tm_columns *utc_columns,
+                           time_t *results, const size_t count) {
+    const struct const_columns cols = {
+        utc_columns->tm_year, utc_columns->tm_mon, utc_columns->tm_mday,
+        utc_columns->tm_hour, utc_columns->tm_min, utc_columns->tm_sec
+    };
+
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TIMESTAMPS);
+    const bool success = get_timestamps_kernel()(&cols, results, count);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TIMESTAMPS, start);
+    return success;
+}
+
+
+/*!
+ * \brief           Does the work of tm_secs_diffs().
+ * \param first     The first array of struct tms.
+ * \param second    The second array of struct tms.
+ * \param results   An array to receive the differences, positive where
+ * the element of `first` is earlier than the element of `second`.
+ * \param count     The number of elements in each array.
+ */
+
+static void
+secs_diffs(const struct tm *first, const struct tm *second,
+           int64_t *results, const size_t count) {
+    const timestamps_kernel kernel = get_timestamps_kernel();
+
+    if ( kernel == timestamps_scalar ) {
+        for ( size_t i = 0; i < count; ++i ) {
+            results[i] = tm_secs_diff(&first[i], &second[i]);
+        }
+        return;
+    }
+
+    //  The SIMD kernels are only built where time_t is POSIX seconds, so
+    //  the timestamps are serial seconds and their difference is exact. A
+    //  block with a row the kernel could not convert is done the slow way.
+
+    struct column_block first_storage;
+    struct column_block second_storage;
+    time_t first_ts[BATCH_BLOCK_SIZE];
+    time_t second_ts[BATCH_BLOCK_SIZE];
+
+    for ( size_t start = 0; start < count; start += BATCH_BLOCK_SIZE ) {
+        const size_t block = count - start < BATCH_BLOCK_SIZE ?
+                             count - start : BATCH_BLOCK_SIZE;
+        const struct const_columns first_cols =
+            load_block(&first_storage, first + start, block);
+        const struct const_columns second_cols =
+            load_block(&second_storage, second + start, block);
+
+        if ( !kernel(&first_cols, first_ts, block) ||
+             !kernel(&second_cols, second_ts, block) ) {
+            for ( size_t i = 0; i < block; ++i ) {
+                results[start + i] = tm_secs_diff(&first[start + i],
+                                                  &second[start + i]);
+            }
+            continue;
+        }
+
+        for ( size_t i = 0; i < block; ++i ) {
+            results[start + i] = (int64_t) second_ts[i] - first_ts[i];
+        }
+    }
+}
+
+
+/*!
+ * \brief           Gets the exact differences in seconds between two
+ * arrays of struct tms.
+ * \details         Gives the same results as calling tm_secs_diff() on
+ * each pair of elements. Where the CPU supports it, both arrays are
+ * converted to serial seconds several times at a time with the same
+ * kernels as get_utc_timestamps(), and subtracted.
+ * \param first     The first array of struct tms.
+ * \param second    The second array of struct tms.
+ * \param results   An array to receive the differences, positive where
+ * the element of `first` is earlier than the element of `second`.
+ * \param count     The number of elements in each array.
+ */
+
+void
+tm_secs_diffs(const struct tm *first, const struct tm *second,
+              int64_t *results, const size_t count) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TM_SECS_DIFFS);
+    secs_diffs(first, second, results, count);
+    PGTIME_PROBE_END(PGTIME_PROBE_TM_SECS_DIFFS, start);
+}
+
+
+/*!
+ * \brief           Returns the active kernel for get_utc_tms().
+ * \details         Only an AVX2 kernel is provided for this conversion, so
+ * the scalar kernel is used when SSE4.1 is selected.
+ * \returns         The kernel function.
+ */
+
+static fields_kernel
+get_fields_kernel(void) {
+    switch ( batch_active_kernel() ) {
+#ifdef PGTIME_X86_SIMD
+        case BATCH_KERNEL_AVX2:
+            return fields_avx2;
+#endif
+
+        default:
+            return fields_scalar;
+    }
+}
+
+
+/*!
+ * \brief           Does the work of get_utc_tms().
+ * \param utc_ts    An array of time_t timestamps.
+ * \param results   An array of struct tms to receive the UTC times.
+ * \param count     The number of elements in each array.
+ * \returns         `true` if every timestamp was broken down, `false` if
+ * the year of any of them cannot be represented in a struct tm, in which
+ * case the contents of the corresponding elements are unspecified.
+ */
+
+static bool
+timestamps_to_tms(const time_t *utc_ts, struct tm *results,
+                  const size_t count) {
+    const fields_kernel kernel = get_fields_kernel();
+
+    if ( kernel == fields_scalar ) {
+        struct day_cache cache = {0};
+        bool success = true;
+
+        for ( size_t i = 0; i < count; ++i ) {
+            success &= cached_utc_tm(utc_ts[i], &results[i], &cache);
+        }
+        return success;
+    }
+
+    int year[BATCH_BLOCK_SIZE];
+    int mon[BATCH_BLOCK_SIZE];
+    int mday[BATCH_BLOCK_SIZE];
+    int hour[BATCH_BLOCK_SIZE];
+    int min[BATCH_BLOCK_SIZE];
+    int sec[BATCH_BLOCK_SIZE];
+    int wday[BATCH_BLOCK_SIZE];
+    int yday[BATCH_BLOCK_SIZE];
+    const struct fields_out out = {year, mon, mday, hour, min, sec,
+                                   wday, yday};
+    bool success = true;
+
+    for ( size_t start = 0; start < count; start += BATCH_BLOCK_SIZE ) {
+        const size_t block = count - start < BATCH_BLOCK_SIZE ?
+                             count - start : BATCH_BLOCK_SIZE;
+
+        success &= kernel(utc_ts + start, &out, block);
+
+        for ( size_t i = 0; i < block; ++i ) {
+            struct tm *utc_tm = &results[start + i];
+            utc_tm->tm_year = year[i];
+            utc_tm->tm_mon = mon[i];
+            utc_tm->tm_mday = mday[i];
+            utc_tm->tm_hour = hour[i];
+            utc_tm->tm_min = min[i];
+            utc_tm->tm_sec = sec[i];
+            utc_tm->tm_wday = wday[i];
+            utc_tm->tm_yday = yday[i];
+            utc_tm->tm_isdst = 0;
+        }
+    }
+
+    return success;
+}
+
+
+/*!
+ * \brief           Breaks down an array of timestamps into UTC times.
+ * \details         Gives the same results as calling get_utc_tm() on each
+ * element. While consecutive timestamps fall on the same day the date is
+ * reused rather than recalculated, so sorted input is especially cheap.
+ * \param utc_ts    An array of time_t timestamps.
+ * \param results   An array of struct tms to receive the UTC times.
+ * \param count     The number of elements in each array.
+ * \returns         `true` if every timestamp was broken down, `false` if
+ * the year of any of them cannot be represented in a struct tm, in which
+ * case the contents of the corresponding elements are unspecified.
+ */
+
+bool
+get_utc_tms(const time_t *utc_ts, struct tm *results, const size_t count) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TMS);
+    const bool success = timestamps_to_tms(utc_ts, results, count);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TMS, start);
+    return success;
+}
+
+
+/*!
+ * \brief               Breaks down an array of timestamps into UTC times
+ * stored as columns.
+ * \details             Gives the same results as get_utc_tms(), but writes
+ * each field to its own column, without the day of the week or year.
+ * \param utc_ts        An array of time_t timestamps.
+ * \param utc_columns   The columns to receive the UTC times.
+ * \param count         The number of timestamps.
+ * \returns             `true` if every timestamp was broken down, `false`
+ * if the year of any of them cannot be represented in an int, in which
+ * case the contents of the corresponding rows are unspecified.
+ */
+
+bool
+get_utc_tms_columns(const time_t *utc_ts,
+                    const struct tm_columns *utc_columns, const size_t count) {
+    const struct fields_out out = {
+        utc_columns->tm_year, utc_columns->tm_mon, utc_columns->tm_mday,
+        utc_columns->tm_hour, utc_columns->tm_min, utc_columns->tm_sec,
+        0, 0
+    };
+
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TMS);
+    const bool success = get_fields_kernel()(utc_ts, &out, count);
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TMS, start);
+    return success;
+}
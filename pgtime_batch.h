@@ -0,0 +1,76 @@
+/*!
+ * \file        pgtime_batch.h
+ * \brief       Interface to array versions of the pgtime conversions.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_BATCH_H
+#define PG_PGTIME_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdbool.h>
+
+
+/*!
+ * \brief       Broken-down times stored as separate columns.
+ * \details     Each member points to an array holding one field for every
+ * time in the batch, with the same meaning as the struct tm member of the
+ * same name.
+ */
+
+struct tm_columns {
+    int *tm_year;           /*!<  Years since 1900  */
+    int *tm_mon;            /*!<  Months since January, 0 to 11  */
+    int *tm_mday;           /*!<  Day of the month, 1 to 31  */
+    int *tm_hour;           /*!<  Hours since midnight, 0 to 23  */
+    int *tm_min;            /*!<  Minutes after the hour, 0 to 59  */
+    int *tm_sec;            /*!<  Seconds after the minute, 0 to 60  */
+};
+
+
+/*!
+ * \brief       The kernels available for batch conversions.
+ */
+
+enum batch_kernel {
+    BATCH_KERNEL_AUTO,      /*!<  Best kernel the CPU supports  */
+    BATCH_KERNEL_SCALAR,    /*!<  Portable C  */
+    BATCH_KERNEL_SSE41,     /*!<  x86-64 SSE4.1, two times at once  */
+    BATCH_KERNEL_AVX2       /*!<  x86-64 AVX2, four times at once  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool batch_select_kernel(const enum batch_kernel kernel);
+enum batch_kernel batch_active_kernel(void);
+
+bool get_utc_timestamps(const struct tm *utc_tms, time_t *results,
+                        const size_t count);
+bool get_utc_timestamps_columns(const struct tm_columns *utc_columns,
+                                time_t *results, const size_t count);
+
+void tm_secs_diffs(const struct tm *first, const struct tm *second,
+                   int64_t *results, const size_t count);
+
+bool get_utc_tms(const time_t *utc_ts, struct tm *results,
+                 const size_t count);
+bool get_utc_tms_columns(const time_t *utc_ts,
+                         const struct tm_columns *utc_columns,
+                         const size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_BATCH_H  */
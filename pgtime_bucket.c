@@ -0,0 +1,801 @@
+/*!
+ * \file        pgtime_bucket.c
+ * \brief       Implementation of rounding times to intervals, and of
+ * counting times in buckets.
+ * \details     Fixed-width intervals are handled with integer arithmetic
+ * on the timestamp, and on x86-64 with AVX2 the bucket index of four
+ * timestamps is calculated at once. Months and years are handled with a
+ * table of bucket boundaries built once per call from days_from_civil(),
+ * so each timestamp costs a comparison or two rather than a calendar
+ * calculation. Like pgtime_tz, this module assumes that time_t counts
+ * POSIX seconds.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_batch.h"
+#include "pgtime_bucket.h"
+#include "pgtime_internal.h"
+
+#ifdef PGTIME_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+/*  Seconds in a day, and the offset from 1970-01-01, a Thursday, back to
+ *  the Monday before it  */
+
+#define SECS_IN_DAY 86400
+#define WEEK_EPOCH_OFFSET (3 * SECS_IN_DAY)
+
+/*  Number of timestamps converted from struct tms at a time  */
+
+#define BUCKET_BLOCK_SIZE 256
+
+/*  Most buckets given a boundary table. More buckets than this are
+ *  counted with calendar arithmetic on each timestamp instead.  */
+
+#define MAX_TABLE_BUCKETS ((size_t) 1 << 20)
+
+/*
+ *  Bucket indices are found by multiplying the offset from the origin by
+ *  the reciprocal of the interval in double precision, which is exact
+ *  after a correction of at most one when the buckets together span less
+ *  than this many seconds. Wider spans, and origins near the limits of
+ *  time_t, need a 64-bit division for every timestamp.
+ */
+
+#define RECIPROCAL_MAX_SPAN (INT64_C(1) << 50)
+
+
+/*  Length in seconds of the units with a fixed length  */
+
+static const int64_t unit_secs[] = {1, 60, 3600, SECS_IN_DAY,
+                                    7 * SECS_IN_DAY};
+
+
+/*!
+ * \brief       How to find the bucket of a timestamp.
+ */
+
+struct bucket_plan {
+    enum calendar_unit unit;    /*!<  The calendar unit  */
+    time_t origin;              /*!<  The start of the first bucket  */
+    int64_t interval;           /*!<  Width of fixed-width buckets  */
+    int64_t first_index;        /*!<  Calendar index of the first bucket  */
+    int64_t *bounds;            /*!<  Bucket boundaries, or null  */
+    size_t hint;                /*!<  The bucket last found in `bounds`  */
+};
+
+
+/*!
+ * \brief           Rounds a timestamp down to a multiple of an interval.
+ * \details         Intervals are counted from 1970-01-01 00:00:00 UTC, so
+ * an interval of 3600 rounds down to the start of the hour, and an
+ * interval of 86400 to midnight UTC.
+ * \param utc_ts    The UTC timestamp.
+ * \param interval  The interval in seconds, which must be positive.
+ * \returns         The latest multiple of `interval` which is not later
+ * than `utc_ts`. The result must be representable in a time_t.
+ */
+
+time_t
+utc_floor(const time_t utc_ts, const int64_t interval) {
+    int64_t remainder = (int64_t) utc_ts % interval;
+    if ( remainder < 0 ) {
+        remainder += interval;
+    }
+    return utc_ts - (time_t) remainder;
+}
+
+
+/*!
+ * \brief           Rounds a timestamp up to a multiple of an interval.
+ * \param utc_ts    The UTC timestamp.
+ * \param interval  The interval in seconds, which must be positive.
+ * \returns         The earliest multiple of `interval`, counted from
+ * 1970-01-01 00:00:00 UTC, which is not earlier than `utc_ts`. The result
+ * must be representable in a time_t.
+ */
+
+time_t
+utc_ceil(const time_t utc_ts, const int64_t interval) {
+    const time_t floor = utc_floor(utc_ts, interval);
+    return floor == utc_ts ? floor : floor + (time_t) interval;
+}
+
+
+/*!
+ * \brief           Returns the index of the month or year containing a
+ * serial day number.
+ * \param days      The number of days since 1970-01-01.
+ * \param unit      `CALENDAR_MONTH` or `CALENDAR_YEAR`.
+ * \returns         The number of whole months or years from year 0.
+ */
+
+static int64_t
+calendar_index(const int64_t days, const enum calendar_unit unit) {
+    int64_t year;
+    int month;
+    int day;
+
+    civil_from_days(days, &year, &month, &day);
+    return unit == CALENDAR_MONTH ? year * 12 + month - 1 : year;
+}
+
+
+/*!
+ * \brief           Returns the start of a month or year.
+ * \param index     The number of whole months or years from year 0, as
+ * returned by calendar_index().
+ * \param unit      `CALENDAR_MONTH` or `CALENDAR_YEAR`.
+ * \returns         The UTC timestamp of midnight on the first day, clamped
+ * to the range of time_t.
+ */
+
+static time_t
+calendar_start(const int64_t index, const enum calendar_unit unit) {
+    int64_t days;
+
+    if ( unit == CALENDAR_MONTH ) {
+        const int64_t year = floor_div(index, 12);
+        days = days_from_civil(year, index - year * 12 + 1, 1);
+    } else {
+        days = days_from_civil(index, 1, 1);
+    }
+
+    if ( days < INT64_MIN / SECS_IN_DAY ) {
+        return (time_t) INT64_MIN;
+    } else if ( days > INT64_MAX / SECS_IN_DAY ) {
+        return (time_t) INT64_MAX;
+    }
+    return (time_t) (days * SECS_IN_DAY);
+}
+
+
+/*!
+ * \brief           Returns how far a timestamp is into a unit with a
+ * fixed length.
+ * \details         The remainder is taken before the offset of the week
+ * is added, so that nothing overflows near the limits of time_t.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      A calendar unit up to `CALENDAR_WEEK`.
+ * \returns         The number of seconds since the start of the unit.
+ */
+
+static int64_t
+unit_excess(const time_t utc_ts, const enum calendar_unit unit) {
+    int64_t remainder = (int64_t) utc_ts % unit_secs[unit];
+    if ( remainder < 0 ) {
+        remainder += unit_secs[unit];
+    }
+
+    if ( unit == CALENDAR_WEEK ) {
+        remainder = (remainder + WEEK_EPOCH_OFFSET) % unit_secs[unit];
+    }
+    return remainder;
+}
+
+
+/*!
+ * \brief           Rounds a timestamp down to the start of a calendar
+ * unit.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      The calendar unit.
+ * \returns         The UTC timestamp of the start of the second, minute,
+ * hour, day, week, month or year containing `utc_ts`, or the earliest
+ * time_t if that start is earlier.
+ */
+
+time_t
+utc_floor_calendar(const time_t utc_ts, const enum calendar_unit unit) {
+    if ( unit == CALENDAR_MONTH || unit == CALENDAR_YEAR ) {
+        return calendar_start(calendar_index(floor_div(utc_ts, SECS_IN_DAY),
+                                             unit), unit);
+    }
+
+    const int64_t excess = unit_excess(utc_ts, unit);
+    return utc_ts < INT64_MIN + excess ? (time_t) INT64_MIN :
+                                         utc_ts - (time_t) excess;
+}
+
+
+/*!
+ * \brief           Rounds a timestamp up to the start of a calendar unit.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      The calendar unit.
+ * \returns         `utc_ts` if it is the start of a unit, otherwise the
+ * UTC timestamp of the start of the next unit, or the latest time_t if
+ * that start is later.
+ */
+
+time_t
+utc_ceil_calendar(const time_t utc_ts, const enum calendar_unit unit) {
+    if ( unit == CALENDAR_MONTH || unit == CALENDAR_YEAR ) {
+        const int64_t index = calendar_index(floor_div(utc_ts, SECS_IN_DAY),
+                                             unit);
+        const time_t floor = calendar_start(index, unit);
+        return floor == utc_ts ? floor : calendar_start(index + 1, unit);
+    }
+
+    const int64_t excess = unit_excess(utc_ts, unit);
+    if ( excess == 0 ) {
+        return utc_ts;
+    }
+
+    const int64_t shortfall = unit_secs[unit] - excess;
+    return utc_ts > INT64_MAX - shortfall ? (time_t) INT64_MAX :
+                                            utc_ts + (time_t) shortfall;
+}
+
+
+/*!
+ * \brief           Rounds a struct tm down to the start of a calendar unit.
+ * \details         The members of `date` need not be in their normal
+ * ranges. The result is normalized, including `tm_wday` and `tm_yday`.
+ * \param date      A pointer to the struct tm to round.
+ * \param unit      The calendar unit.
+ * \returns         A pointer to the same struct tm, or a null pointer if
+ * the resulting year cannot be represented in a struct tm, in which case
+ * `date` is unchanged.
+ */
+
+struct tm *
+tm_floor(struct tm *date, const enum calendar_unit unit) {
+    struct tm floor = *date;
+    if ( !tm_add_seconds(&floor, 0) ) {
+        return 0;
+    }
+
+    if ( unit >= CALENDAR_MINUTE ) {
+        floor.tm_sec = 0;
+    }
+    if ( unit >= CALENDAR_HOUR ) {
+        floor.tm_min = 0;
+    }
+    if ( unit >= CALENDAR_DAY ) {
+        floor.tm_hour = 0;
+    }
+    if ( unit == CALENDAR_WEEK ) {
+
+        //  Days since Monday, with Sunday as the last day of the week.
+
+        const int wday = day_of_week(floor.tm_year + INT64_C(1900),
+                                     floor.tm_mon + 1, floor.tm_mday);
+        if ( !tm_add_seconds(&floor, -(int64_t) ((wday + 6) % 7) *
+                                     SECS_IN_DAY) ) {
+            return 0;
+        }
+    } else {
+        if ( unit >= CALENDAR_MONTH ) {
+            floor.tm_mday = 1;
+        }
+        if ( unit == CALENDAR_YEAR ) {
+            floor.tm_mon = 0;
+        }
+        if ( !tm_add_seconds(&floor, 0) ) {
+            return 0;
+        }
+    }
+
+    *date = floor;
+    return date;
+}
+
+
+/*!
+ * \brief           Rounds a struct tm up to the start of a calendar unit.
+ * \details         The members of `date` need not be in their normal
+ * ranges. The result is normalized, including `tm_wday` and `tm_yday`.
+ * \param date      A pointer to the struct tm to round.
+ * \param unit      The calendar unit.
+ * \returns         A pointer to the same struct tm, or a null pointer if
+ * the resulting year cannot be represented in a struct tm, in which case
+ * `date` is unchanged.
+ */
+
+struct tm *
+tm_ceil(struct tm *date, const enum calendar_unit unit) {
+    struct tm normal = *date;
+    if ( !tm_add_seconds(&normal, 0) ) {
+        return 0;
+    }
+
+    struct tm floor = normal;
+    if ( !tm_floor(&floor, unit) ) {
+        return 0;
+    } else if ( tm_compare(&floor, &normal) == 0 ) {
+        *date = normal;
+        return date;
+    } else if ( unit == CALENDAR_MONTH &&
+                !tm_increment_month(&floor, 1, MONTH_DAY_CLAMP) ) {
+        return 0;
+    } else if ( unit == CALENDAR_YEAR &&
+                !tm_increment_year(&floor, 1, MONTH_DAY_CLAMP) ) {
+        return 0;
+    } else if ( unit < CALENDAR_MONTH &&
+                !tm_add_seconds(&floor, unit_secs[unit]) ) {
+        return 0;
+    }
+
+    *date = floor;
+    return date;
+}
+
+
+/*!
+ * \brief               Kernel for fixed-width buckets which divides
+ * exactly.
+ * \details             This works for any buckets, however wide, and
+ * any origin.
+ * \param utc_ts        The timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        The start of the first bucket.
+ * \param interval      The width of each bucket in seconds.
+ * \param counts        The bucket counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+static size_t
+count_fixed_divide(const time_t *utc_ts, const size_t count,
+                   const time_t origin, const int64_t interval,
+                   uint64_t *counts, const size_t num_buckets) {
+    size_t counted = 0;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        if ( utc_ts[i] < origin ) {
+            continue;
+        }
+
+        //  The offset can exceed INT64_MAX, but not UINT64_MAX.
+
+        const uint64_t index = ((uint64_t) utc_ts[i] - (uint64_t) origin) /
+                               (uint64_t) interval;
+        if ( index < num_buckets ) {
+            ++counts[index];
+            ++counted;
+        }
+    }
+
+    return counted;
+}
+
+
+/*!
+ * \brief               Scalar kernel for fixed-width buckets.
+ * \details             The bucket index is estimated with the reciprocal
+ * of the interval, and corrected by one if the exact remainder shows the
+ * rounding went the wrong way. The caller must make sure the buckets span
+ * at most RECIPROCAL_MAX_SPAN seconds, and that the origin is at least
+ * that far from the limits of time_t, so that times before the origin
+ * wrap round to offsets beyond the last bucket.
+ * \param utc_ts        The timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        The start of the first bucket.
+ * \param interval      The width of each bucket in seconds.
+ * \param counts        The bucket counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+static size_t
+count_fixed_scalar(const time_t *utc_ts, const size_t count,
+                   const time_t origin, const int64_t interval,
+                   uint64_t *counts, const size_t num_buckets) {
+    const uint64_t span = (uint64_t) interval * num_buckets;
+    const double inverse = 1.0 / (double) interval;
+    size_t counted = 0;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        const uint64_t offset = (uint64_t) utc_ts[i] - (uint64_t) origin;
+        if ( offset >= span ) {
+            continue;
+        }
+
+        int64_t index = (int64_t) ((double) (int64_t) offset * inverse);
+        const int64_t remainder = (int64_t) offset - index * interval;
+        index -= remainder < 0;
+        index += remainder >= interval;
+        ++counts[index];
+        ++counted;
+    }
+
+    return counted;
+}
+
+
+#ifdef PGTIME_X86_SIMD
+
+/*!
+ * \brief               AVX2 kernel for fixed-width buckets.
+ * \details             Four bucket indices are calculated at once, by
+ * multiplying the offset from the origin by the reciprocal of the
+ * interval, and then corrected by one if the exact remainder shows the
+ * rounding went the wrong way. Timestamps outside the buckets are masked
+ * out before the counts are updated. When all four fall in the same
+ * bucket, as they mostly do for sorted input, the count is updated once.
+ * The caller must make sure of the same conditions as for
+ * count_fixed_scalar().
+ * \param utc_ts        The timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        The start of the first bucket.
+ * \param interval      The width of each bucket in seconds.
+ * \param counts        The bucket counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+__attribute__((target("avx2")))
+static size_t
+count_fixed_avx2(const time_t *utc_ts, const size_t count,
+                 const time_t origin, const int64_t interval,
+                 uint64_t *counts, const size_t num_buckets) {
+    const __m256i before = _mm256_set1_epi64x(origin - 1);
+    const __m256i end = _mm256_set1_epi64x(origin +
+                                           interval * (int64_t) num_buckets);
+    const __m256i start = _mm256_set1_epi64x(origin);
+    const __m256d magic = _mm256_set1_pd(SIMD_INT64_MAGIC);
+    const __m256d width = _mm256_set1_pd((double) interval);
+    const __m256d inverse = _mm256_set1_pd(1.0 / (double) interval);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t counted = 0;
+    size_t i = 0;
+
+    for ( ; i + 4 <= count; i += 4 ) {
+        const __m256i ts = _mm256_loadu_si256((const __m256i *) (utc_ts + i));
+        const int in_range = _mm256_movemask_pd(_mm256_castsi256_pd(
+            _mm256_and_si256(_mm256_cmpgt_epi64(ts, before),
+                             _mm256_cmpgt_epi64(end, ts))));
+
+        if ( !in_range ) {
+            continue;
+        }
+
+        //  Lanes out of range may hold any value from here on, but they
+        //  are never used.
+
+        const __m256d offset = _mm256_sub_pd(_mm256_castsi256_pd(
+            _mm256_add_epi64(_mm256_sub_epi64(ts, start),
+                             _mm256_castpd_si256(magic))), magic);
+        __m256d index = _mm256_floor_pd(_mm256_mul_pd(offset, inverse));
+        const __m256d remainder = _mm256_sub_pd(offset,
+                                                _mm256_mul_pd(index, width));
+        index = _mm256_sub_pd(index, _mm256_and_pd(
+            _mm256_cmp_pd(remainder, zero, _CMP_LT_OQ), one));
+        index = _mm256_add_pd(index, _mm256_and_pd(
+            _mm256_cmp_pd(remainder, width, _CMP_GE_OQ), one));
+
+        const int same = _mm256_movemask_pd(_mm256_cmp_pd(
+            index, _mm256_permute4x64_pd(index, 0), _CMP_EQ_OQ));
+        int64_t indices[4];
+        _mm256_storeu_si256((__m256i *) indices, _mm256_sub_epi64(
+            _mm256_castpd_si256(_mm256_add_pd(index, magic)),
+            _mm256_castpd_si256(magic)));
+
+        if ( in_range == 0xF && same == 0xF ) {
+            counts[indices[0]] += 4;
+            counted += 4;
+        } else {
+            for ( int lane = 0; lane < 4; ++lane ) {
+                if ( in_range & (1 << lane) ) {
+                    ++counts[indices[lane]];
+                    ++counted;
+                }
+            }
+        }
+    }
+
+    return counted + count_fixed_scalar(utc_ts + i, count - i, origin,
+                                        interval, counts, num_buckets);
+}
+
+#endif          /*  PGTIME_X86_SIMD  */
+
+
+/*!
+ * \brief               Counts timestamps in fixed-width buckets.
+ * \param utc_ts        The timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        The start of the first bucket.
+ * \param interval      The width of each bucket in seconds.
+ * \param counts        The bucket counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+static size_t
+count_fixed(const time_t *utc_ts, const size_t count, const time_t origin,
+            const int64_t interval, uint64_t *counts,
+            const size_t num_buckets) {
+    if ( (uint64_t) num_buckets >
+             (uint64_t) RECIPROCAL_MAX_SPAN / interval ||
+         origin >= INT64_MAX - RECIPROCAL_MAX_SPAN ||
+         origin <= INT64_MIN + RECIPROCAL_MAX_SPAN ) {
+        return count_fixed_divide(utc_ts, count, origin, interval, counts,
+                                  num_buckets);
+    }
+
+#ifdef PGTIME_X86_SIMD
+    if ( batch_active_kernel() == BATCH_KERNEL_AVX2 ) {
+        return count_fixed_avx2(utc_ts, count, origin, interval, counts,
+                                num_buckets);
+    }
+#endif
+
+    return count_fixed_scalar(utc_ts, count, origin, interval, counts,
+                              num_buckets);
+}
+
+
+/*!
+ * \brief               Returns the bucket containing a timestamp, from a
+ * table of boundaries.
+ * \details             The bucket found last time is tried first, so
+ * sorted input rarely needs more. Otherwise the bucket is estimated from
+ * the average length of a month or year, which is never more than a
+ * bucket or two out, and the estimate is corrected against the table.
+ * \param plan          The bucket plan, with a boundary table.
+ * \param utc_ts        The timestamp, which must be within the table.
+ * \param num_buckets   The number of buckets.
+ * \returns             The index of the bucket.
+ */
+
+static size_t
+table_bucket(struct bucket_plan *plan, const time_t utc_ts,
+             const size_t num_buckets) {
+    static const double average_secs[] = {2629746.0, 31556952.0};
+    const int64_t *bounds = plan->bounds;
+    size_t index = plan->hint;
+
+    if ( bounds[index] <= utc_ts && utc_ts < bounds[index + 1] ) {
+        return index;
+    }
+
+    index = (size_t) ((double) (utc_ts - bounds[0]) /
+                      average_secs[plan->unit == CALENDAR_YEAR]);
+    if ( index >= num_buckets ) {
+        index = num_buckets - 1;
+    }
+    while ( bounds[index] > utc_ts ) {
+        --index;
+    }
+    while ( bounds[index + 1] <= utc_ts ) {
+        ++index;
+    }
+
+    return plan->hint = index;
+}
+
+
+/*!
+ * \brief               Prepares to count timestamps in calendar buckets.
+ * \details             For months and years, a table of the boundaries is
+ * built, unless there are too many buckets, the buckets reach the latest
+ * time_t, or there is not enough memory, in which case each timestamp is
+ * converted to a calendar date instead.
+ * \param plan          The plan to prepare.
+ * \param origin        A time in the first bucket.
+ * \param unit          The calendar unit.
+ * \param num_buckets   The number of buckets.
+ */
+
+static void
+plan_init(struct bucket_plan *plan, const time_t origin,
+          const enum calendar_unit unit, const size_t num_buckets) {
+    plan->unit = unit;
+    plan->origin = utc_floor_calendar(origin, unit);
+    plan->interval = unit < CALENDAR_MONTH ? unit_secs[unit] : 0;
+    plan->first_index = 0;
+    plan->bounds = 0;
+    plan->hint = 0;
+
+    if ( unit < CALENDAR_MONTH ) {
+        return;
+    }
+
+    //  A last boundary clamped to the latest time_t would leave that time
+    //  out of the last bucket, so those buckets are not given a table.
+
+    plan->first_index = calendar_index(floor_div(origin, SECS_IN_DAY), unit);
+    if ( num_buckets == 0 || num_buckets > MAX_TABLE_BUCKETS ||
+         calendar_start(plan->first_index + (int64_t) num_buckets, unit) ==
+             (time_t) INT64_MAX ) {
+        return;
+    }
+
+    plan->bounds = malloc((num_buckets + 1) * sizeof *plan->bounds);
+    if ( plan->bounds ) {
+        for ( size_t i = 0; i <= num_buckets; ++i ) {
+            plan->bounds[i] = calendar_start(plan->first_index +
+                                             (int64_t) i, unit);
+        }
+    }
+}
+
+
+/*!
+ * \brief               Counts timestamps in the buckets of a plan.
+ * \param plan          The bucket plan.
+ * \param utc_ts        The timestamps to count.
+ * \param count         The number of timestamps.
+ * \param counts        The bucket counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+static size_t
+plan_count(struct bucket_plan *plan, const time_t *utc_ts,
+           const size_t count, uint64_t *counts, const size_t num_buckets) {
+    size_t counted = 0;
+
+    if ( plan->interval ) {
+        return count_fixed(utc_ts, count, plan->origin, plan->interval,
+                           counts, num_buckets);
+    } else if ( plan->bounds ) {
+        const time_t first = plan->bounds[0];
+        const time_t last = plan->bounds[num_buckets];
+
+        for ( size_t i = 0; i < count; ++i ) {
+            if ( utc_ts[i] >= first && utc_ts[i] < last ) {
+                ++counts[table_bucket(plan, utc_ts[i], num_buckets)];
+                ++counted;
+            }
+        }
+    } else {
+        for ( size_t i = 0; i < count; ++i ) {
+            const int64_t index = calendar_index(floor_div(utc_ts[i],
+                                                           SECS_IN_DAY),
+                                                 plan->unit) -
+                                  plan->first_index;
+            if ( index >= 0 && (uint64_t) index < num_buckets ) {
+                ++counts[index];
+                ++counted;
+            }
+        }
+    }
+
+    return counted;
+}
+
+
+/*!
+ * \brief               Counts timestamps in fixed-width buckets.
+ * \details             Bucket `i` holds the timestamps from
+ * `origin + i * interval` up to but not including the start of the next
+ * bucket. Timestamps outside every bucket are ignored. The counts are
+ * added to, so a histogram can be built up over several calls. The input
+ * need not be sorted, although sorted input is counted faster.
+ * \param utc_ts        The UTC timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        The start of the first bucket.
+ * \param interval      The width of each bucket in seconds, which must be
+ * positive.
+ * \param counts        An array of `num_buckets` counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket,
+ * or zero if `interval` is not positive.
+ */
+
+size_t
+bucket_count(const time_t *utc_ts, const size_t count, const time_t origin,
+             const int64_t interval, uint64_t *counts,
+             const size_t num_buckets) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_BUCKET_COUNT);
+    size_t counted = 0;
+
+    if ( interval > 0 ) {
+        counted = count_fixed(utc_ts, count, origin, interval, counts,
+                              num_buckets);
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_BUCKET_COUNT, start);
+    return counted;
+}
+
+
+/*!
+ * \brief               Counts timestamps in calendar buckets.
+ * \details             The first bucket is the calendar unit containing
+ * `origin`, and each following bucket is the next unit, so with
+ * `CALENDAR_MONTH` the buckets are consecutive calendar months.
+ * Timestamps outside every bucket are ignored, and the counts are added
+ * to, as for bucket_count(). A bucket which would start before the
+ * earliest time_t, or end after the latest, is clamped to it.
+ * \param utc_ts        The UTC timestamps to count.
+ * \param count         The number of timestamps.
+ * \param origin        A UTC timestamp in the first bucket.
+ * \param unit          The calendar unit.
+ * \param counts        An array of `num_buckets` counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of timestamps which fell in a bucket.
+ */
+
+size_t
+bucket_count_calendar(const time_t *utc_ts, const size_t count,
+                      const time_t origin, const enum calendar_unit unit,
+                      uint64_t *counts, const size_t num_buckets) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_BUCKET_COUNT);
+    struct bucket_plan plan;
+    plan_init(&plan, origin, unit, num_buckets);
+    const size_t counted = plan_count(&plan, utc_ts, count, counts,
+                                      num_buckets);
+    free(plan.bounds);
+    PGTIME_PROBE_END(PGTIME_PROBE_BUCKET_COUNT, start);
+    return counted;
+}
+
+
+/*!
+ * \brief           Converts a block of struct tms one at a time, keeping
+ * only the timestamps which can be found.
+ * \param utc_tms   The UTC struct tms to convert.
+ * \param block     An array to receive the timestamps.
+ * \param count     The number of struct tms.
+ * \returns         The number of timestamps stored at the start of
+ * `block`.
+ */
+
+static size_t
+convertible_timestamps(const struct tm *utc_tms, time_t *block,
+                       const size_t count) {
+    size_t kept = 0;
+
+    for ( size_t i = 0; i < count; ++i ) {
+        if ( pgtime_utc_timestamp(&utc_tms[i], &block[kept]) == PGTIME_OK ) {
+            ++kept;
+        }
+    }
+
+    return kept;
+}
+
+
+/*!
+ * \brief               Counts UTC struct tms in calendar buckets.
+ * \details             The struct tms are converted to timestamps in
+ * blocks with get_utc_timestamps(), and then counted as for
+ * bucket_count_calendar(). A struct tm whose timestamp cannot be found is
+ * not counted.
+ * \param utc_tms       The UTC struct tms to count.
+ * \param count         The number of struct tms.
+ * \param origin        A UTC timestamp in the first bucket.
+ * \param unit          The calendar unit.
+ * \param counts        An array of `num_buckets` counts to add to.
+ * \param num_buckets   The number of buckets.
+ * \returns             The number of struct tms which fell in a bucket.
+ */
+
+size_t
+bucket_count_tms(const struct tm *utc_tms, const size_t count,
+                 const time_t origin, const enum calendar_unit unit,
+                 uint64_t *counts, const size_t num_buckets) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_BUCKET_COUNT);
+    struct bucket_plan plan;
+    time_t block[BUCKET_BLOCK_SIZE];
+    size_t counted = 0;
+
+    plan_init(&plan, origin, unit, num_buckets);
+    for ( size_t i = 0; i < count; i += BUCKET_BLOCK_SIZE ) {
+        size_t block_count = count - i < BUCKET_BLOCK_SIZE ?
+                             count - i : BUCKET_BLOCK_SIZE;
+        if ( !get_utc_timestamps(utc_tms + i, block, block_count) ) {
+            block_count = convertible_timestamps(utc_tms + i, block,
+                                                 block_count);
+        }
+        counted += plan_count(&plan, block, block_count, counts,
+                              num_buckets);
+    }
+    free(plan.bounds);
+
+    PGTIME_PROBE_END(PGTIME_PROBE_BUCKET_COUNT, start);
+    return counted;
+}
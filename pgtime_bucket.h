@@ -0,0 +1,67 @@
+/*!
+ * \file        pgtime_bucket.h
+ * \brief       Interface to rounding times to intervals, and to counting
+ * times in buckets.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_BUCKET_H
+#define PG_PGTIME_BUCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+
+/*!
+ * \brief       Calendar units for rounding and bucketing.
+ * \details     Units up to `CALENDAR_WEEK` have a fixed length in UTC.
+ * Weeks start on Monday, as in ISO 8601. Months and years have a variable
+ * length, and start at midnight on the first day of the month or year.
+ */
+
+enum calendar_unit {
+    CALENDAR_SECOND,        /*!<  One second  */
+    CALENDAR_MINUTE,        /*!<  One minute  */
+    CALENDAR_HOUR,          /*!<  One hour  */
+    CALENDAR_DAY,           /*!<  One day, starting at midnight  */
+    CALENDAR_WEEK,          /*!<  One week, starting on Monday  */
+    CALENDAR_MONTH,         /*!<  One calendar month  */
+    CALENDAR_YEAR           /*!<  One calendar year  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+time_t utc_floor(const time_t utc_ts, const int64_t interval);
+time_t utc_ceil(const time_t utc_ts, const int64_t interval);
+time_t utc_floor_calendar(const time_t utc_ts, const enum calendar_unit unit);
+time_t utc_ceil_calendar(const time_t utc_ts, const enum calendar_unit unit);
+
+struct tm *tm_floor(struct tm *date, const enum calendar_unit unit);
+struct tm *tm_ceil(struct tm *date, const enum calendar_unit unit);
+
+size_t bucket_count(const time_t *utc_ts, const size_t count,
+                    const time_t origin, const int64_t interval,
+                    uint64_t *counts, const size_t num_buckets);
+size_t bucket_count_calendar(const time_t *utc_ts, const size_t count,
+                             const time_t origin,
+                             const enum calendar_unit unit,
+                             uint64_t *counts, const size_t num_buckets);
+size_t bucket_count_tms(const struct tm *utc_tms, const size_t count,
+                        const time_t origin, const enum calendar_unit unit,
+                        uint64_t *counts, const size_t num_buckets);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_BUCKET_H  */
@@ -0,0 +1,421 @@
+/*!
+ * \file        pgtime_chrono.hpp
+ * \brief       Conversions between the pgtime representations and the
+ * C++20 std::chrono calendar types.
+ * \details     The conversions calculate directly with the `constexpr`
+ * functions of pgtime.hpp, so there are no calls to gmtime_r(), timegm()
+ * or any other libc function, and no struct tm is built unless one is
+ * asked for. Like pgtime.hpp, timestamps count seconds since the POSIX
+ * epoch, which is what `std::chrono::system_clock` counts. The span
+ * versions convert whole arrays in one call, and write straight into the
+ * caller's storage. The static_assert tests at the end of this file check
+ * them whenever it is compiled.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_CHRONO_HPP
+#define PG_PGTIME_CHRONO_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <span>
+#include "pgtime.hpp"
+#include "pgtime_precise.h"
+
+
+namespace pgtime {
+
+/*!
+ * \brief           Returns the day of a struct tm.
+ * \details         The date need not be in its normal ranges, and the time
+ * of day is ignored.
+ * \param date      A pointer to the struct tm.
+ * \returns         The day.
+ */
+
+constexpr std::chrono::sys_days
+to_sys_days(const std::tm *date) {
+    return std::chrono::sys_days{std::chrono::days{
+        days_from_civil(date->tm_year + std::int64_t(1900),
+                        std::int64_t(date->tm_mon) + 1, date->tm_mday)}};
+}
+
+
+/*!
+ * \brief           Returns the date of a struct tm.
+ * \details         The date need not be in its normal ranges, but the year
+ * must be one std::chrono::year can hold, from -32767 to 32767. The time
+ * of day is ignored.
+ * \param date      A pointer to the struct tm.
+ * \returns         The date.
+ */
+
+constexpr std::chrono::year_month_day
+to_year_month_day(const std::tm *date) {
+    return std::chrono::year_month_day{to_sys_days(date)};
+}
+
+
+/*!
+ * \brief           Returns the time of day of a struct tm.
+ * \param time      A pointer to the struct tm, with the time of day in
+ * its normal ranges.
+ * \returns         The time of day.
+ */
+
+constexpr std::chrono::hh_mm_ss<std::chrono::seconds>
+to_hh_mm_ss(const std::tm *time) {
+    return std::chrono::hh_mm_ss<std::chrono::seconds>{
+        std::chrono::hours{time->tm_hour} +
+        std::chrono::minutes{time->tm_min} +
+        std::chrono::seconds{time->tm_sec}};
+}
+
+
+/*!
+ * \brief           Returns the time point of a UTC time.
+ * \details         This gives the same result as get_utc_timestamp(),
+ * without validating the date. The fields need not be in their normal
+ * ranges.
+ * \param utc_tm    A pointer to a struct tm containing the UTC time.
+ * \returns         The time point.
+ */
+
+constexpr std::chrono::sys_seconds
+to_sys_seconds(const std::tm *utc_tm) {
+    return std::chrono::sys_seconds{
+        std::chrono::seconds{pgtime::get_utc_timestamp(utc_tm)}};
+}
+
+
+/*!
+ * \brief           Returns the time point of a precise UTC time.
+ * \details         The time point can only hold times within about 292
+ * years of 1970.
+ * \param utc_tm    A pointer to a precise_tm containing the UTC time.
+ * \returns         The time point.
+ */
+
+constexpr std::chrono::sys_time<std::chrono::nanoseconds>
+to_sys_time(const precise_tm *utc_tm) {
+    return to_sys_seconds(&utc_tm->tm) +
+           std::chrono::nanoseconds{utc_tm->nanoseconds};
+}
+
+
+/*!
+ * \brief           Breaks down a time point into UTC time.
+ * \details         This gives the same result as get_utc_tm(). All fields
+ * of `result` are set, including `tm_wday` and `tm_yday`, and `tm_isdst`
+ * is set to zero.
+ * \param utc_time  The time point.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+constexpr std::tm *
+to_tm(const std::chrono::sys_seconds utc_time, std::tm *result) {
+    return pgtime::get_utc_tm(utc_time.time_since_epoch().count(), result);
+}
+
+
+/*!
+ * \brief           Sets a struct tm to a date and time.
+ * \param date      The date.
+ * \param time      The time of day, which is added to the date, and so
+ * may be negative or longer than a day.
+ * \param result    A pointer to a struct tm to receive the date and time.
+ * All fields are set, as for get_utc_tm().
+ * \returns         `result`, or a null pointer if `date` is not a valid
+ * date.
+ */
+
+constexpr std::tm *
+to_tm(const std::chrono::year_month_day date,
+      const std::chrono::hh_mm_ss<std::chrono::seconds> time,
+      std::tm *result) {
+    if ( !date.ok() ) {
+        return nullptr;
+    }
+    return to_tm(std::chrono::sys_days{date} + time.to_duration(), result);
+}
+
+
+/*!
+ * \brief           Sets a struct tm to midnight on a date.
+ * \param date      The date.
+ * \param result    A pointer to a struct tm to receive the date. All
+ * fields are set, as for get_utc_tm().
+ * \returns         `result`, or a null pointer if `date` is not a valid
+ * date.
+ */
+
+constexpr std::tm *
+to_tm(const std::chrono::year_month_day date, std::tm *result) {
+    return to_tm(date, std::chrono::hh_mm_ss<std::chrono::seconds>{},
+                 result);
+}
+
+
+/*!
+ * \brief           Breaks down a time point into precise UTC time.
+ * \details         The time point is rounded down to the nanosecond, so
+ * times before 1970 are handled in the same way as by
+ * get_utc_precise_tm().
+ * \param utc_time  The time point.
+ * \param result    A pointer to a precise_tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+template <typename Duration>
+constexpr precise_tm *
+to_precise_tm(const std::chrono::sys_time<Duration> utc_time,
+              precise_tm *result) {
+    const auto secs = std::chrono::floor<std::chrono::seconds>(utc_time);
+    const auto nsecs = std::chrono::floor<std::chrono::nanoseconds>(
+        utc_time - secs);
+
+    if ( !to_tm(secs, &result->tm) ) {
+        return nullptr;
+    }
+    result->nanoseconds = static_cast<long>(nsecs.count());
+    return result;
+}
+
+
+/*!
+ * \brief           Converts an array of UTC times to time points.
+ * \param utc_tms   The UTC times, which are not validated.
+ * \param results   Modified to contain the time points, and at least as
+ * long as `utc_tms`.
+ * \returns         `true` on success, or `false` if `results` is too
+ * short, in which case nothing is converted.
+ */
+
+constexpr bool
+to_sys_seconds(const std::span<const std::tm> utc_tms,
+               const std::span<std::chrono::sys_seconds> results) {
+    if ( results.size() < utc_tms.size() ) {
+        return false;
+    }
+    for ( std::size_t i = 0; i < utc_tms.size(); ++i ) {
+        results[i] = to_sys_seconds(&utc_tms[i]);
+    }
+    return true;
+}
+
+
+/*!
+ * \brief           Converts an array of time points to UTC times.
+ * \param utc_times The time points.
+ * \param results   Modified to contain the UTC times, and at least as long
+ * as `utc_times`.
+ * \returns         `true` on success, or `false` if `results` is too short,
+ * in which case nothing is converted, or if any year cannot be represented
+ * in a struct tm, in which case the other times are still converted, as
+ * with get_utc_tms().
+ */
+
+constexpr bool
+to_tm(const std::span<const std::chrono::sys_seconds> utc_times,
+      const std::span<std::tm> results) {
+    if ( results.size() < utc_times.size() ) {
+        return false;
+    }
+
+    bool all_converted = true;
+    for ( std::size_t i = 0; i < utc_times.size(); ++i ) {
+        all_converted &= to_tm(utc_times[i], &results[i]) != nullptr;
+    }
+    return all_converted;
+}
+
+
+/*!
+ * \brief           Converts an array of struct tm to days.
+ * \param dates     The dates. The times of day are ignored.
+ * \param results   Modified to contain the days, and at least as long as
+ * `dates`.
+ * \returns         `true` on success, or `false` if `results` is too
+ * short, in which case nothing is converted.
+ */
+
+constexpr bool
+to_sys_days(const std::span<const std::tm> dates,
+            const std::span<std::chrono::sys_days> results) {
+    if ( results.size() < dates.size() ) {
+        return false;
+    }
+    for ( std::size_t i = 0; i < dates.size(); ++i ) {
+        results[i] = to_sys_days(&dates[i]);
+    }
+    return true;
+}
+
+
+/*!
+ * \brief           Converts an array of days to struct tm at midnight.
+ * \param days      The days.
+ * \param results   Modified to contain the dates, and at least as long as
+ * `days`.
+ * \returns         `true` on success, or `false` if `results` is too short,
+ * in which case nothing is converted, or if any year cannot be represented
+ * in a struct tm, in which case the other dates are still converted.
+ */
+
+constexpr bool
+to_tm(const std::span<const std::chrono::sys_days> days,
+      const std::span<std::tm> results) {
+    if ( results.size() < days.size() ) {
+        return false;
+    }
+
+    bool all_converted = true;
+    for ( std::size_t i = 0; i < days.size(); ++i ) {
+        all_converted &= to_tm(std::chrono::sys_seconds{days[i]},
+                               &results[i]) != nullptr;
+    }
+    return all_converted;
+}
+
+
+/*
+ *  Tests, which run whenever this file is compiled.
+ */
+
+namespace detail {
+
+/*!
+ * \brief           Checks that a date and time survive a round trip
+ * through the chrono types.
+ * \param utc_tm    The date and time, in their normal ranges.
+ * \returns         `true` if they do, `false` otherwise.
+ */
+
+constexpr bool
+test_chrono_round_trip(const std::tm utc_tm) {
+    std::tm from_seconds{};
+    std::tm from_fields{};
+
+    return to_tm(to_sys_seconds(&utc_tm), &from_seconds) &&
+           to_tm(to_year_month_day(&utc_tm), to_hh_mm_ss(&utc_tm),
+                 &from_fields) &&
+           test_same_tm(from_seconds, utc_tm) &&
+           test_same_tm(from_fields, utc_tm);
+}
+
+
+/*!
+ * \brief           Checks the conversions of dates out of their normal
+ * ranges.
+ * \returns         `true` if a month past the end of the year is carried
+ * into the next, and an invalid year_month_day is rejected, `false`
+ * otherwise.
+ */
+
+constexpr bool
+test_chrono_dates() {
+    std::tm date{};
+    date.tm_year = 112;
+    date.tm_mon = 13;
+    date.tm_mday = 1;
+
+    return to_year_month_day(&date) == std::chrono::year{2013} / 2 / 1 &&
+           to_tm(std::chrono::year{2013} / 2 / 28, &date) &&
+           !to_tm(std::chrono::year{2013} / 2 / 29, &date) &&
+           date.tm_mon == 1 && date.tm_mday == 28;
+}
+
+
+/*!
+ * \brief           Checks the span conversions over a run of days.
+ * \returns         `true` if every day converts back to itself, `false`
+ * otherwise.
+ */
+
+constexpr bool
+test_chrono_spans() {
+    constexpr std::size_t count = 64;
+    std::chrono::sys_seconds times[count]{};
+    std::chrono::sys_days days[count]{};
+    std::tm utc_tms[count]{};
+    std::tm too_short[count - 1]{};
+
+    for ( std::size_t i = 0; i < count; ++i ) {
+        times[i] = std::chrono::sys_seconds{std::chrono::seconds{
+            -3000000000 + static_cast<std::int64_t>(i) * 97654321}};
+    }
+
+    if ( to_tm(times, too_short) || !to_tm(times, utc_tms) ) {
+        return false;
+    }
+    std::chrono::sys_seconds round_trip[count]{};
+    if ( !to_sys_seconds(utc_tms, round_trip) ||
+         !to_sys_days(utc_tms, days) ) {
+        return false;
+    }
+    for ( std::size_t i = 0; i < count; ++i ) {
+        if ( round_trip[i] != times[i] ||
+             days[i] != std::chrono::floor<std::chrono::days>(times[i]) ) {
+            return false;
+        }
+    }
+
+    return to_tm(days, utc_tms) && utc_tms[0].tm_hour == 0 &&
+           to_sys_seconds(&utc_tms[count - 1]) == days[count - 1];
+}
+
+
+/*!
+ * \brief           Checks a precise time against a time point.
+ * \param utc_time  The time point.
+ * \param expected  The expected precise time.
+ * \returns         `true` if to_precise_tm() gives `expected` and
+ * to_sys_time() gives back `utc_time`, `false` otherwise.
+ */
+
+constexpr bool
+test_precise(const std::chrono::sys_time<std::chrono::nanoseconds> utc_time,
+             const precise_tm expected) {
+    precise_tm result{};
+
+    return to_precise_tm(utc_time, &result) &&
+           test_same_tm(result.tm, expected.tm) &&
+           result.nanoseconds == expected.nanoseconds &&
+           to_sys_time(&result) == utc_time;
+}
+
+static_assert(test_chrono_round_trip(make_utc_tm(2013, 7, 4, 12, 30, 15)) &&
+              test_chrono_round_trip(make_utc_tm(1969, 12, 31, 23, 59, 59)) &&
+              test_chrono_round_trip(make_utc_tm(2000, 2, 29)) &&
+              test_chrono_round_trip(make_utc_tm(-1, 3, 1, 6)),
+              "chrono round trip is wrong");
+
+static_assert(test_chrono_dates(), "to_year_month_day() or to_tm() is wrong");
+
+static_assert(test_chrono_spans(), "span conversions are wrong");
+
+static_assert(test_precise(std::chrono::sys_time<std::chrono::nanoseconds>{
+                               std::chrono::nanoseconds{-1}},
+                           precise_tm{make_utc_tm(1969, 12, 31, 23, 59, 59),
+                                      999999999}) &&
+              test_precise(std::chrono::sys_days{
+                               std::chrono::year{2013} / 7 / 4} +
+                               std::chrono::nanoseconds{45296000000123},
+                           precise_tm{make_utc_tm(2013, 7, 4, 12, 34, 56),
+                                      123}),
+              "to_precise_tm() or to_sys_time() is wrong");
+
+}       //  namespace detail
+
+}       //  namespace pgtime
+
+
+#endif          /*  PG_PGTIME_CHRONO_HPP  */
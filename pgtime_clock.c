@@ -0,0 +1,363 @@
+/*!
+ * \file        pgtime_clock.c
+ * \brief       Implementation of a cached clock for reading the current
+ * time cheaply.
+ * \details     The current time is read, broken down and formatted once
+ * per tick, by an updater thread or by the caller, and published as a
+ * snapshot under a sequence lock. Readers copy the snapshot without
+ * locking or making system calls, and retry if a tick overwrote it while
+ * they were copying. The snapshot is stored as an array of atomic words,
+ * so that the racing reads are not data races in the C11 memory model.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_clock.h"
+#include "pgtime_iso.h"
+#include "pgtime_internal.h"
+
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif
+
+
+/*  Nanoseconds in a second, and the default resolution  */
+
+#define NSECS_IN_SEC 1000000000L
+#define DEFAULT_RESOLUTION 1000000L
+
+/*  Number of 64-bit words needed to hold a snapshot  */
+
+#define SNAPSHOT_WORDS \
+    ((sizeof(struct clock_snapshot) + sizeof(uint64_t) - 1) / \
+     sizeof(uint64_t))
+
+
+/*
+ *  The sequence number is odd while a tick is writing the snapshot, and
+ *  zero until the first tick has finished.
+ */
+
+static _Atomic uint64_t snapshot_sequence;
+static _Atomic uint64_t snapshot_words[SNAPSHOT_WORDS];
+
+static _Atomic long clock_resolution = DEFAULT_RESOLUTION;
+
+#ifndef __STDC_NO_THREADS__
+static atomic_bool updater_running;
+static thrd_t updater_thread;
+#endif
+
+
+/*!
+ * \brief               Sets the resolution of the clock.
+ * \details             The resolution sets how often the updater thread
+ * ticks, and how many fractional digits the ISO 8601 string has: three
+ * for a resolution of a millisecond, none for a second. It takes effect
+ * from the next tick, or for the updater thread, from the one after.
+ * \param resolution_ns The resolution in nanoseconds, from 1 to
+ * 1000000000. The default is 1000000, one millisecond.
+ * \returns             `true` on success, `false` if `resolution_ns` is
+ * out of range.
+ */
+
+bool
+coarse_clock_set_resolution(const long resolution_ns) {
+    if ( resolution_ns < 1 || resolution_ns > NSECS_IN_SEC ) {
+        return false;
+    }
+
+    atomic_store(&clock_resolution, resolution_ns);
+    return true;
+}
+
+
+/*!
+ * \brief           Does the work of coarse_clock_tick().
+ * \returns         `true` on success, `false` if the current time could
+ * not be read or broken down.
+ */
+
+static bool
+refresh_snapshot(void) {
+
+    //  Claim the snapshot by making the sequence number odd, unless
+    //  another tick already has.
+
+    uint64_t sequence = atomic_load_explicit(&snapshot_sequence,
+                                             memory_order_relaxed);
+    if ( (sequence & 1) ||
+         !atomic_compare_exchange_strong_explicit(&snapshot_sequence,
+                                                  &sequence, sequence + 1,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed) ) {
+        return true;
+    }
+    atomic_thread_fence(memory_order_release);
+
+    struct clock_snapshot snapshot = {0};
+    struct timespec now;
+
+    if ( timespec_get(&now, TIME_UTC) != TIME_UTC ||
+         !get_utc_tm(now.tv_sec, &snapshot.utc_tm) ) {
+
+        //  Nothing was written, so the previous sequence number still
+        //  describes the snapshot.
+
+        atomic_store_explicit(&snapshot_sequence, sequence,
+                              memory_order_release);
+        return false;
+    }
+    snapshot.utc_ts = now.tv_sec;
+    snapshot.nanoseconds = now.tv_nsec;
+
+    //  One fractional digit for each power of ten finer than a second
+    //  that the resolution resolves.
+
+    int precision = 9;
+    for ( long r = atomic_load(&clock_resolution); r >= 10; r /= 10 ) {
+        --precision;
+    }
+    format_iso8601(snapshot.iso8601, sizeof snapshot.iso8601,
+                   &snapshot.utc_tm, snapshot.nanoseconds, precision, 0,
+                   ISO_FORMAT_RFC3339);
+
+    uint64_t words[SNAPSHOT_WORDS] = {0};
+    memcpy(words, &snapshot, sizeof snapshot);
+
+    for ( size_t i = 0; i < SNAPSHOT_WORDS; ++i ) {
+        atomic_store_explicit(&snapshot_words[i], words[i],
+                              memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&snapshot_sequence, sequence + 2,
+                          memory_order_release);
+    return true;
+}
+
+
+/*!
+ * \brief           Refreshes the snapshot of the current time.
+ * \details         Call this periodically to drive the clock without an
+ * updater thread, for instance once per iteration of an event loop. If
+ * another thread is ticking at the same moment, this call returns without
+ * waiting, since the snapshot is being refreshed anyway. The current time
+ * is read only once the snapshot has been claimed, so ticks publish their
+ * times in the order they read them and the clock never goes backwards.
+ * \returns         `true` on success, `false` if the current time could
+ * not be read or broken down.
+ */
+
+bool
+coarse_clock_tick(void) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_COARSE_CLOCK_TICK);
+    const bool success = refresh_snapshot();
+    PGTIME_PROBE_END(PGTIME_PROBE_COARSE_CLOCK_TICK, start);
+    return success;
+}
+
+
+#ifndef __STDC_NO_THREADS__
+
+/*!
+ * \brief           Updater thread function.
+ * \details         Ticks the clock once per resolution until stopped.
+ * \param arg       Not used.
+ * \returns         Zero.
+ */
+
+static int
+updater(void *arg) {
+    (void) arg;
+
+    while ( atomic_load(&updater_running) ) {
+        coarse_clock_tick();
+
+        const long resolution = atomic_load(&clock_resolution);
+        struct timespec delay = {resolution / NSECS_IN_SEC,
+                                 resolution % NSECS_IN_SEC};
+        thrd_sleep(&delay, 0);
+    }
+
+    return 0;
+}
+
+#endif          /*  __STDC_NO_THREADS__  */
+
+
+/*!
+ * \brief               Starts a thread which ticks the clock.
+ * \details             coarse_clock_start() and coarse_clock_stop() should
+ * be called from one thread only, such as the main thread.
+ * \param resolution_ns The resolution in nanoseconds, as for
+ * coarse_clock_set_resolution().
+ * \returns             `true` if the thread was started, `false` if
+ * `resolution_ns` is out of range, the thread is already running, the
+ * current time could not be read, or threads are not supported.
+ */
+
+bool
+coarse_clock_start(const long resolution_ns) {
+#ifndef __STDC_NO_THREADS__
+    if ( atomic_load(&updater_running) ||
+         !coarse_clock_set_resolution(resolution_ns) ||
+         !coarse_clock_tick() ) {
+        return false;
+    }
+
+    atomic_store(&updater_running, true);
+    if ( thrd_create(&updater_thread, updater, 0) != thrd_success ) {
+        atomic_store(&updater_running, false);
+        return false;
+    }
+
+    return true;
+#else
+    (void) resolution_ns;
+    return false;
+#endif
+}
+
+
+/*!
+ * \brief           Stops the thread started by coarse_clock_start().
+ * \details         Waits for the thread to finish, which can take up to
+ * one resolution. The last snapshot stays readable, and the clock can
+ * still be driven with coarse_clock_tick().
+ */
+
+void
+coarse_clock_stop(void) {
+#ifndef __STDC_NO_THREADS__
+    if ( atomic_load(&updater_running) ) {
+        atomic_store(&updater_running, false);
+        thrd_join(updater_thread, 0);
+    }
+#endif
+}
+
+
+/*!
+ * \brief           Does the work of coarse_clock_now().
+ * \param snapshot  Modified to contain the snapshot.
+ * \returns         A pointer to `snapshot`, or a null pointer if the clock
+ * had never ticked and the current time could not be read.
+ */
+
+static struct clock_snapshot *
+read_snapshot(struct clock_snapshot *snapshot) {
+    uint64_t words[SNAPSHOT_WORDS];
+    uint64_t before;
+    uint64_t after;
+
+    do {
+        before = atomic_load_explicit(&snapshot_sequence,
+                                      memory_order_acquire);
+        if ( before == 0 ) {
+            if ( !coarse_clock_tick() ) {
+                return 0;
+            }
+            after = before + 1;
+            continue;
+        }
+
+        for ( size_t i = 0; i < SNAPSHOT_WORDS; ++i ) {
+            words[i] = atomic_load_explicit(&snapshot_words[i],
+                                            memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&snapshot_sequence,
+                                     memory_order_relaxed);
+    } while ( (before & 1) || before != after );
+
+    memcpy(snapshot, words, sizeof *snapshot);
+    return snapshot;
+}
+
+
+/*!
+ * \brief           Copies the latest snapshot of the current time.
+ * \details         No locks are taken and, once the clock has ticked, no
+ * system calls are made, so this is safe to call from any number of
+ * threads at once. The snapshot is always consistent: every member
+ * describes the same instant. If the clock has never ticked, this ticks
+ * it first.
+ * \param snapshot  Modified to contain the snapshot.
+ * \returns         A pointer to `snapshot`, or a null pointer if the clock
+ * had never ticked and the current time could not be read.
+ */
+
+struct clock_snapshot *
+coarse_clock_now(struct clock_snapshot *snapshot) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_COARSE_CLOCK_NOW);
+    struct clock_snapshot *const result = read_snapshot(snapshot);
+    PGTIME_PROBE_END(PGTIME_PROBE_COARSE_CLOCK_NOW, start);
+    return result;
+}
+
+
+/*!
+ * \brief           Does the work of coarse_clock_time().
+ * \returns         The UTC timestamp, or -1 if the clock had never ticked
+ * and the current time could not be read.
+ */
+
+static time_t
+read_time(void) {
+    uint64_t word;
+    uint64_t before;
+    uint64_t after;
+
+    do {
+        before = atomic_load_explicit(&snapshot_sequence,
+                                      memory_order_acquire);
+        if ( before == 0 ) {
+            if ( !coarse_clock_tick() ) {
+                return (time_t) -1;
+            }
+            after = before + 1;
+            continue;
+        }
+
+        word = atomic_load_explicit(
+            &snapshot_words[offsetof(struct clock_snapshot, utc_ts) /
+                            sizeof(uint64_t)], memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&snapshot_sequence,
+                                     memory_order_relaxed);
+    } while ( (before & 1) || before != after );
+
+    time_t utc_ts;
+    memcpy(&utc_ts, &word, sizeof utc_ts);
+    return utc_ts;
+}
+
+
+/*!
+ * \brief           Returns the UTC timestamp of the latest snapshot.
+ * \details         Reads only the timestamp, so this is cheaper than
+ * coarse_clock_now() when nothing else is needed. Like coarse_clock_now(),
+ * this retries while a tick is in progress, and ticks the clock first if
+ * it has never ticked.
+ * \returns         The UTC timestamp, or -1 if the clock had never ticked
+ * and the current time could not be read.
+ */
+
+time_t
+coarse_clock_time(void) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_COARSE_CLOCK_TIME);
+    const time_t utc_ts = read_time();
+    PGTIME_PROBE_END(PGTIME_PROBE_COARSE_CLOCK_TIME, start);
+    return utc_ts;
+}
@@ -0,0 +1,54 @@
+/*!
+ * \file        pgtime_clock.h
+ * \brief       Interface to a cached clock for reading the current time
+ * cheaply.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_CLOCK_H
+#define PG_PGTIME_CLOCK_H
+
+#include <time.h>
+#include <stdbool.h>
+#include "pgtime_iso.h"
+
+
+/*!
+ * \brief       A snapshot of the current time.
+ */
+
+struct clock_snapshot {
+    time_t utc_ts;          /*!<  UTC timestamp  */
+    long nanoseconds;       /*!<  Fraction of a second, 0 to 999999999  */
+    struct tm utc_tm;       /*!<  UTC broken-down time, with `tm_wday` and
+                                  `tm_yday` set  */
+    char iso8601[PGTIME_ISO8601_BUFSIZE];
+                            /*!<  RFC 3339 UTC timestamp, with as many
+                                  fractional digits as the resolution
+                                  supports  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool coarse_clock_set_resolution(const long resolution_ns);
+bool coarse_clock_start(const long resolution_ns);
+void coarse_clock_stop(void);
+bool coarse_clock_tick(void);
+
+struct clock_snapshot *coarse_clock_now(struct clock_snapshot *snapshot);
+time_t coarse_clock_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_CLOCK_H  */
@@ -0,0 +1,253 @@
+/*!
+ * \file        pgtime_inline.h
+ * \brief       Definitions of the small pgtime functions.
+ * \details     With `PGTIME_INLINE` defined before pgtime.h is included,
+ * pgtime.h includes this file to define these functions as `static
+ * inline`, so that calls to them in loops can be inlined and vectorized
+ * rather than going through the PLT of the shared library. Otherwise
+ * pgtime.c includes it with `PGTIME_INLINE_LINKAGE` defined as nothing, to
+ * give the library its ordinary definitions. It should not be included
+ * directly.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_INLINE_H
+#define PG_PGTIME_INLINE_H
+
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PGTIME_INLINE_LINKAGE
+#define PGTIME_INLINE_LINKAGE static inline
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * \brief           Checks if the supplied year is a leap year.
+ * \details         The tests are combined without short circuits, so that
+ * a loop over many years has no branches to mispredict and can be
+ * vectorized.
+ * \param year      A year
+ * \returns         `true` if `year` is a leap year, `false` otherwise.
+ */
+
+PGTIME_INLINE_LINKAGE bool
+is_leap_year(const int year) {
+    return (year % 4 == 0) & ((year % 100 != 0) | (year % 400 == 0));
+}
+
+
+/*!
+ * \brief           Checks whether a supplied date is valid.
+ * \details         This function does not support leap seconds, and will
+ * return false if `check_tm->tm_sec == 60`. Years are astronomical, so
+ * year 0 is valid, as are negative years. The length of the month is
+ * calculated rather than looked up, and the tests are combined without
+ * short circuits, so that a loop over many dates has no branches to
+ * mispredict and can be vectorized.
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \returns         true if the date if valid, false otherwise.
+ */
+
+PGTIME_INLINE_LINKAGE bool
+validate_date(const struct tm *check_tm) {
+    //  The month is unsigned, so that adding 1 cannot overflow for any
+    //  tm_mon, and a negative tm_mon becomes too large to be valid.
+
+    const unsigned mon = (unsigned) check_tm->tm_mon + 1u;
+
+    //  30 or 31 days, alternating and then switching after July, with
+    //  February corrected to 28 or 29. The result for an invalid month
+    //  does not matter, since the month test fails anyway. The year is
+    //  reduced modulo 400 first, which keeps whether it is a leap year,
+    //  so that adding 1900 cannot overflow.
+
+    const bool leap = is_leap_year(check_tm->tm_year % 400 + 1900);
+    const int month_len = 30 + (int) ((mon + (mon >> 3)) & 1u) -
+                          (mon == 2u) * (2 - leap);
+
+    return (mon >= 1u) & (mon <= 12u) &
+           (check_tm->tm_mday >= 1) & (check_tm->tm_mday <= month_len) &
+           (check_tm->tm_hour >= 0) & (check_tm->tm_hour <= 23) &
+           (check_tm->tm_min >= 0) & (check_tm->tm_min <= 59) &
+           (check_tm->tm_sec >= 0) & (check_tm->tm_sec <= 59);
+}
+
+
+/*!
+ * \brief       Compares two struct tm structs.
+ * \details     Compares two struct tm structs. Only the year, month, day,
+ * hour, minute and second are compared. Any timezone or DST information
+ * is ignored.
+ * \param first The first struct tm struct.
+ * \param second The second struct tm struct.
+ * \returns     -1 if `first` is earlier than `second`, 1 if `first` is later
+ * than `second`, and 0 if `first` is equal to `second`.
+ */
+
+PGTIME_INLINE_LINKAGE int
+tm_compare(const struct tm *first, const struct tm *second) {
+    int compare_result;
+
+    if ( first->tm_year != second->tm_year ) {
+        compare_result = first->tm_year > second->tm_year ? 1 : -1;
+    } else if ( first->tm_mon != second->tm_mon ) {
+        compare_result = first->tm_mon > second->tm_mon ? 1 : -1;
+    } else if ( first->tm_mday != second->tm_mday ) {
+        compare_result = first->tm_mday > second->tm_mday ? 1 : -1;
+    } else if ( first->tm_hour != second->tm_hour ) {
+        compare_result = first->tm_hour > second->tm_hour ? 1 : -1;
+    } else if ( first->tm_min != second->tm_min ) {
+        compare_result = first->tm_min > second->tm_min ? 1 : -1;
+    } else if ( first->tm_sec != second->tm_sec ) {
+        compare_result = first->tm_sec > second->tm_sec ? 1 : -1;
+    } else {
+        compare_result = 0;
+    }
+
+    return compare_result;
+}
+
+
+/*!
+ * \brief               Adds one or more days to a struct tm, incrementing
+ * the month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to increment. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of days to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_increment_day(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, quantity, 0, 0, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more hours to a struct tm, incrementing
+ * the day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to increment. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of hours to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_increment_hour(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, 0, quantity, 0, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more minutes to a struct tm, incrementing
+ * the hour, day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to increment. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of minutes to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_increment_minute(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, 0, 0, quantity, 0);
+}
+
+
+/*!
+ * \brief               Adds one or more seconds to a struct tm, incrementing
+ * the minute, hour, day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to increment. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of seconds to add
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_increment_second(struct tm *changing_tm, const int quantity) {
+    return tm_add_seconds(changing_tm, quantity);
+}
+
+
+/*!
+ * \brief               Deducts one or more days from a struct tm,
+ * decrementing the month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to decrement. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of days to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_decrement_day(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, -(int64_t) quantity, 0, 0, 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more hours from a struct tm,
+ * decrementing the day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to decrement. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of hours to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_decrement_hour(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, 0, -(int64_t) quantity, 0, 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more minutes from a struct tm,
+ * decrementing the hour, day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm to decrement. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of minutes to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_decrement_minute(struct tm *changing_tm, const int quantity) {
+    return tm_add_duration(changing_tm, 0, 0, -(int64_t) quantity, 0);
+}
+
+
+/*!
+ * \brief               Deducts one or more seconds from a struct tm,
+ * decrementing the minute, hour, day, month and/or the year as necessary.
+ * \param changing_tm   A pointer to the struct tm struct to decrement. The
+ * struct referred to by the pointer is modified by the function.
+ * \param quantity      The number of seconds to deduct
+ * \returns             A pointer to the same struct tm, or a null pointer
+ * if the resulting year cannot be represented, as for tm_add_seconds().
+ */
+
+PGTIME_INLINE_LINKAGE struct tm *
+tm_decrement_second(struct tm *changing_tm, const int quantity) {
+    return tm_add_seconds(changing_tm, -(int64_t) quantity);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_INLINE_H  */
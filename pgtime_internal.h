@@ -0,0 +1,207 @@
+/*!
+ * \file        pgtime_internal.h
+ * \brief       Internal definitions shared between the pgtime source files.
+ * \details     This header is not installed, and is not part of the
+ * public interface.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_INTERNAL_H
+#define PG_PGTIME_INTERNAL_H
+
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+
+
+/*
+ *  On POSIX systems and on Windows, time_t is a count of seconds since
+ *  1970-01-01 00:00:00 UTC, not counting leap seconds, and we can
+ *  calculate with it directly. Elsewhere we have to go through mktime().
+ */
+
+#if defined(__unix__) || defined(__unix) || \
+    (defined(__APPLE__) && defined(__MACH__)) || defined(_WIN32)
+#define PGTIME_POSIX_TIME_T
+#endif
+
+/*
+ *  The SIMD kernels are written with GCC/Clang target attributes and
+ *  intrinsics, and are selected at run time with __builtin_cpu_supports(),
+ *  so they are only built for x86-64 with a compatible compiler. They also
+ *  rely on time_t being 64-bit POSIX seconds.
+ */
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(PGTIME_POSIX_TIME_T)
+#define PGTIME_X86_SIMD
+#endif
+
+/*
+ *  Adding 1.5 * 2^52 to a double holding an integer of magnitude less
+ *  than 2^51 puts the integer in the low bits of the mantissa, so the SIMD
+ *  kernels can convert between 64-bit integers and doubles with an
+ *  integer add and a floating-point subtract, or the other way round.
+ */
+
+#define SIMD_INT64_MAGIC 6755399441055744.0
+
+/*
+ *  Marks a function as rarely called, so that the compiler moves it and
+ *  the code leading to it out of the way of the hot paths.
+ */
+
+#if defined(__GNUC__)
+#define PGTIME_COLD __attribute__((cold, noinline))
+#else
+#define PGTIME_COLD
+#endif
+
+
+/*
+ *  Instrumentation hooks. With PGTIME_INSTRUMENT defined, each thread
+ *  counts events and calls in its own block of counters, registered with
+ *  pgtime_stats.c the first time it is used, and times one call in every
+ *  PGTIME_INSTRUMENT_SAMPLE to keep the overhead down. Otherwise the hooks
+ *  compile to nothing.
+ */
+
+#ifdef PGTIME_INSTRUMENT
+
+#include <stdatomic.h>
+#include <time.h>
+#include "pgtime_stats.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#ifndef PGTIME_INSTRUMENT_SAMPLE
+#define PGTIME_INSTRUMENT_SAMPLE 64
+#endif
+
+/*!
+ * \brief       The counters kept by one thread.
+ * \details     Only the owning thread writes them, so they are updated
+ * with a plain load and store rather than a locked add, and are atomic
+ * only so that pgtime_stats_snapshot() can read them from another thread.
+ */
+
+struct pgtime_thread_stats {
+    _Atomic uint64_t counters[PGTIME_NUM_COUNTERS];
+    _Atomic uint64_t calls[PGTIME_NUM_PROBES];
+    _Atomic uint64_t histograms[PGTIME_NUM_PROBES][PGTIME_HISTOGRAM_BUCKETS];
+};
+
+#ifndef __STDC_NO_THREADS__
+extern _Thread_local struct pgtime_thread_stats *pgtime_local_stats;
+#else
+extern struct pgtime_thread_stats *pgtime_local_stats;
+#endif
+
+struct pgtime_thread_stats *pgtime_stats_register(void);
+void pgtime_stats_record(const enum pgtime_probe probe, const uint64_t start);
+
+
+/*!
+ * \brief           Returns the current time in ticks for the histograms.
+ * \returns         The time stamp counter on x86-64, or the time in
+ * nanoseconds elsewhere.
+ */
+
+static inline uint64_t
+pgtime_ticks(void) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+/*!
+ * \brief           Returns the counters for the calling thread.
+ * \returns         A pointer to the counters.
+ */
+
+static inline struct pgtime_thread_stats *
+pgtime_thread_stats(void) {
+    struct pgtime_thread_stats *stats = pgtime_local_stats;
+    return stats ? stats : pgtime_stats_register();
+}
+
+
+/*!
+ * \brief           Adds one to a counter owned by the calling thread.
+ * \param value     The counter.
+ * \returns         The value of the counter before the addition.
+ */
+
+static inline uint64_t
+pgtime_stats_add(_Atomic uint64_t *value) {
+    const uint64_t old = atomic_load_explicit(value, memory_order_relaxed);
+    atomic_store_explicit(value, old + 1, memory_order_relaxed);
+    return old;
+}
+
+
+/*!
+ * \brief           Counts a call to an entry point.
+ * \param probe     The entry point.
+ * \returns         The time the call started if it is to be timed, or
+ * zero if not.
+ */
+
+static inline uint64_t
+pgtime_stats_begin(const enum pgtime_probe probe) {
+    const uint64_t calls = pgtime_stats_add(&pgtime_thread_stats()->
+                                            calls[probe]);
+    return calls % PGTIME_INSTRUMENT_SAMPLE ? 0 : pgtime_ticks();
+}
+
+#define PGTIME_COUNT(counter) \
+    ((void) pgtime_stats_add(&pgtime_thread_stats()->counters[counter]))
+#define PGTIME_PROBE_BEGIN(probe) pgtime_stats_begin(probe)
+#define PGTIME_PROBE_END(probe, start) \
+    ((start) ? pgtime_stats_record((probe), (start)) : (void) 0)
+
+#else
+
+#define PGTIME_COUNT(counter) ((void) 0)
+#define PGTIME_PROBE_BEGIN(probe) ((uint64_t) 0)
+#define PGTIME_PROBE_END(probe, start) ((void) (start))
+
+#endif          /*  PGTIME_INSTRUMENT  */
+
+
+/*
+ *  Calculates a timestamp without validating the date, as
+ *  get_utc_timestamp() does, but returns a status instead of exiting.
+ */
+
+enum pgtime_status pgtime_utc_timestamp(const struct tm *utc_tm,
+                                        time_t *result);
+
+
+/*!
+ * \brief           Divides two integers, rounding towards negative infinity.
+ * \details         C division truncates towards zero, which gives the wrong
+ * answer for calendar calculations on negative values. The remainder
+ * corrects the truncated quotient, so this cannot overflow.
+ * \param dividend  The dividend.
+ * \param divisor   The divisor, which must be positive.
+ * \returns         The quotient, rounded down.
+ */
+
+static inline int64_t
+floor_div(const int64_t dividend, const int64_t divisor) {
+    const int64_t quotient = dividend / divisor;
+    return quotient - (dividend % divisor < 0);
+}
+
+
+#endif          /*  PG_PGTIME_INTERNAL_H  */
@@ -0,0 +1,851 @@
+/*!
+ * \file        pgtime_iso.c
+ * \brief       Implementation of ISO 8601 and RFC 3339 timestamp functions.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_iso.h"
+#include "pgtime_internal.h"
+
+#ifdef PGTIME_X86_SIMD
+#include <emmintrin.h>
+#endif
+
+
+/*  Length of the fixed-width part, "YYYY-MM-DDTHH:MM:SS"  */
+
+#define ISO_FIXED_LEN 19
+
+/*  Indices into the array of fields parsed from the fixed-width part  */
+
+enum iso_field {
+    ISO_YEAR, ISO_MON, ISO_MDAY, ISO_HOUR, ISO_MIN, ISO_SEC, ISO_NUM_FIELDS
+};
+
+/*  Fewest and most digits in a year, the most being enough for any
+ *  tm_year; more than four need a sign, as the formatter writes them  */
+
+#define ISO_MIN_YEAR_DIGITS 4
+#define ISO_MAX_YEAR_DIGITS 10
+
+/*  Length of the longest date and time part written by the formatter,
+ *  a sign and ten digit year followed by "-MM-DDTHH:MM:SS"  */
+
+#define ISO_MAX_DATE_TIME_LEN 26
+
+/*  Digit pairs "00" to "99", for writing two digits at a time  */
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+#ifndef __STDC_NO_THREADS__
+
+/*!
+ * \brief       Per-thread cache of the last second formatted by
+ * format_iso8601_timestamp().
+ * \details     Consecutive log timestamps usually fall in the same second,
+ * so the date and time part is kept and only the fraction and UTC offset
+ * are written again.
+ */
+
+static _Thread_local struct {
+    bool valid;                 /*!<  `true` once `text` has been written  */
+    time_t utc_ts;              /*!<  The second formatted in `text`  */
+    enum iso_format format;     /*!<  The format used for `text`  */
+    size_t len;                 /*!<  The length of `text`  */
+    char text[ISO_MAX_DATE_TIME_LEN];   /*!<  The date and time part  */
+} format_cache;
+
+#endif          /*  __STDC_NO_THREADS__  */
+
+
+#ifndef PGTIME_X86_SIMD
+
+/*!
+ * \brief           Parses the fixed-width part of a timestamp one character
+ * at a time.
+ * \details         The date and time separator at index 10 is not checked.
+ * \param str       The string to parse, at least ISO_FIXED_LEN characters.
+ * \param fields    Modified to contain the parsed fields, indexed by
+ * enum iso_field.
+ * \returns         `true` if the digits and separators are all present,
+ * `false` otherwise.
+ */
+
+static bool
+parse_fixed_scalar(const char *str, int *fields) {
+    static const char template[] = "dddd-dd-dd?dd:dd:dd";
+    int digits[ISO_FIXED_LEN];
+
+    for ( int i = 0; i < ISO_FIXED_LEN; ++i ) {
+        if ( template[i] == 'd' ) {
+            digits[i] = str[i] - '0';
+            if ( digits[i] < 0 || digits[i] > 9 ) {
+                return false;
+            }
+        } else if ( template[i] != '?' && str[i] != template[i] ) {
+            return false;
+        }
+    }
+
+    fields[ISO_YEAR] = digits[0] * 1000 + digits[1] * 100 +
+                       digits[2] * 10 + digits[3];
+    fields[ISO_MON] = digits[5] * 10 + digits[6];
+    fields[ISO_MDAY] = digits[8] * 10 + digits[9];
+    fields[ISO_HOUR] = digits[11] * 10 + digits[12];
+    fields[ISO_MIN] = digits[14] * 10 + digits[15];
+    fields[ISO_SEC] = digits[17] * 10 + digits[18];
+
+    return true;
+}
+
+#else           /*  PGTIME_X86_SIMD  */
+
+/*!
+ * \brief           Parses the fixed-width part of a timestamp with SSE2.
+ * \details         The string is read as two overlapping 16-byte blocks,
+ * at offsets 0 and 3. Every digit and separator is checked at once, and
+ * digit pairs are converted with a multiply-add of adjacent bytes. The
+ * offsets are chosen so that every two-digit field starts at an even
+ * position in one block or the other. SSE2 is part of x86-64, so no run
+ * time check is needed. The date and time separator at index 10 is not
+ * checked.
+ * \param str       The string to parse, at least ISO_FIXED_LEN characters.
+ * \param fields    Modified to contain the parsed fields, indexed by
+ * enum iso_field.
+ * \returns         `true` if the digits and separators are all present,
+ * `false` otherwise.
+ */
+
+static bool
+parse_fixed_sse2(const char *str, int *fields) {
+
+    //  Bit masks of the digit and separator positions in each block.
+
+    static const int digits_a = 0xDB6F;
+    static const int seps_a = 0x2090;
+    static const int digits_b = 0xC000;
+    static const int seps_b = 0x2000;
+
+    const __m128i a = _mm_loadu_si128((const __m128i *) str);
+    const __m128i b = _mm_loadu_si128((const __m128i *) (str + 3));
+    const __m128i zeros = _mm_set1_epi8('0');
+    const __m128i nines = _mm_set1_epi8(9);
+    const __m128i seps = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-',
+                                       0, 0, 0, 0, 0, ':', 0, 0);
+    const __m128i seps_at_b = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 0, 0, ':', 0, 0);
+
+    const __m128i da = _mm_sub_epi8(a, zeros);
+    const __m128i db = _mm_sub_epi8(b, zeros);
+    const int is_digit_a = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(da, nines), da));
+    const int is_digit_b = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(db, nines), db));
+    const int is_sep_a = _mm_movemask_epi8(_mm_cmpeq_epi8(a, seps));
+    const int is_sep_b = _mm_movemask_epi8(_mm_cmpeq_epi8(b, seps_at_b));
+
+    if ( (is_digit_a & digits_a) != digits_a ||
+         (is_sep_a & seps_a) != seps_a ||
+         (is_digit_b & digits_b) != digits_b ||
+         (is_sep_b & seps_b) != seps_b ) {
+        return false;
+    }
+
+    //  Multiply-add each pair of bytes as 10 * first + second.
+
+    const __m128i tens = _mm_set1_epi32(0x0001000A);
+    const __m128i zero = _mm_setzero_si128();
+    int32_t pairs_a_lo[4];
+    int32_t pairs_a_hi[4];
+    int32_t pairs_b_lo[4];
+    int32_t pairs_b_hi[4];
+
+    _mm_storeu_si128((__m128i *) pairs_a_lo,
+                     _mm_madd_epi16(_mm_unpacklo_epi8(da, zero), tens));
+    _mm_storeu_si128((__m128i *) pairs_a_hi,
+                     _mm_madd_epi16(_mm_unpackhi_epi8(da, zero), tens));
+    _mm_storeu_si128((__m128i *) pairs_b_lo,
+                     _mm_madd_epi16(_mm_unpacklo_epi8(db, zero), tens));
+    _mm_storeu_si128((__m128i *) pairs_b_hi,
+                     _mm_madd_epi16(_mm_unpackhi_epi8(db, zero), tens));
+
+    fields[ISO_YEAR] = pairs_a_lo[0] * 100 + pairs_a_lo[1];
+    fields[ISO_MON] = pairs_b_lo[1];
+    fields[ISO_MDAY] = pairs_a_hi[0];
+    fields[ISO_HOUR] = pairs_b_hi[0];
+    fields[ISO_MIN] = pairs_a_hi[3];
+    fields[ISO_SEC] = pairs_b_hi[3];
+
+    return true;
+}
+
+#endif          /*  PGTIME_X86_SIMD  */
+
+
+/*!
+ * \brief           Parses exactly two digits.
+ * \param str       The string to parse.
+ * \param value     Modified to contain the value of the digits.
+ * \returns         `true` if both characters are digits, `false` otherwise.
+ */
+
+static bool
+parse_two_digits(const char *str, int *value) {
+    const int tens = str[0] - '0';
+    const int units = str[1] - '0';
+
+    if ( tens < 0 || tens > 9 || units < 0 || units > 9 ) {
+        return false;
+    }
+
+    *value = tens * 10 + units;
+    return true;
+}
+
+
+/*!
+ * \brief           Parses the date and time part of a timestamp in any
+ * form the formatter writes.
+ * \details         This handles what the fixed-width parser cannot: the
+ * basic format, `YYYYMMDDTHHMMSS`, and years in the expanded
+ * representation, with a sign and from four to ten digits, in either
+ * format. In the basic format the month and day follow the year with no
+ * separator, so the year is whatever precedes the last four digits of the
+ * date. The date and time must both be in the same format.
+ * \param str       The string to parse.
+ * \param end       A pointer to the character after the end of `str`.
+ * \param year      Modified to contain the year.
+ * \param fields    Modified to contain the parsed fields other than the
+ * year, indexed by enum iso_field.
+ * \returns         A pointer to the first character after the seconds, or
+ * a null pointer if the digits and separators are not all present or the
+ * year cannot be represented in a struct tm.
+ */
+
+static const char *
+parse_date_time_slow(const char *str, const char *end, int64_t *year,
+                     int *fields) {
+    static const char extended_template[] = "-dd-dd?dd:dd:dd";
+    static const char basic_template[] = "dddd?dddddd";
+    static const int tm_year_base = 1900;
+    const char *p = str;
+
+    const bool is_signed = p < end && (*p == '+' || *p == '-');
+    const bool negative = is_signed && *p == '-';
+    if ( is_signed ) {
+        ++p;
+    }
+
+    const char *const digits = p;
+    while ( p < end && *p >= '0' && *p <= '9' ) {
+        ++p;
+    }
+
+    const bool extended = p < end && *p == '-';
+    const ptrdiff_t year_digits = (p - digits) - (extended ? 0 : 4);
+    if ( is_signed ? year_digits < ISO_MIN_YEAR_DIGITS ||
+                     year_digits > ISO_MAX_YEAR_DIGITS :
+                     year_digits != ISO_MIN_YEAR_DIGITS ) {
+        return 0;
+    }
+
+    int64_t value = 0;
+    for ( p = digits; p < digits + year_digits; ++p ) {
+        value = value * 10 + (*p - '0');
+    }
+    *year = negative ? -value : value;
+    if ( *year - tm_year_base < INT_MIN || *year - tm_year_base > INT_MAX ) {
+        return 0;
+    }
+
+    //  The rest of the date, the separator and the time, with each pair
+    //  of digits going into the next field.
+
+    int field = ISO_MON;
+    for ( const char *t = extended ? extended_template : basic_template;
+          *t; ++t ) {
+        if ( *t == 'd' ) {
+            if ( end - p < 2 || !parse_two_digits(p, &fields[field++]) ) {
+                return 0;
+            }
+            p += 2;
+            ++t;
+        } else if ( p == end ||
+                    (*t == '?' ? *p != 'T' && *p != 't' && *p != ' ' :
+                                 *p != *t) ) {
+            return 0;
+        } else {
+            ++p;
+        }
+    }
+
+    return p;
+}
+
+
+/*!
+ * \brief           Does the work of parse_iso8601().
+ * \param str       The string to parse. It need not be null-terminated.
+ * \param len       The number of characters available in `str`.
+ * \param result    A pointer to a struct tm to receive the date and time
+ * exactly as written, before any UTC offset is applied. `tm_wday` and
+ * `tm_yday` are set, and `tm_isdst` is set to zero.
+ * \param nanoseconds If not null, modified to contain the fraction of a
+ * second in nanoseconds, or zero if there is none.
+ * \param utc_offset If not null, modified to contain the UTC offset in
+ * seconds, positive east of Greenwich. A timestamp with no offset is
+ * taken to be in UTC.
+ * \returns         A pointer to the first character after the timestamp,
+ * or a null pointer if `str` does not start with a valid timestamp.
+ */
+
+static const char *
+parse_timestamp(const char *str, const size_t len, struct tm *result,
+                long *nanoseconds, int *utc_offset) {
+    static const int days_in_month[] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+    const char *const end = str + len;
+    const char *p;
+    int fields[ISO_NUM_FIELDS];
+    int64_t year;
+
+    //  Most timestamps are in the extended format with a four digit
+    //  year, and go through the fixed-width parser.
+
+    bool fixed = len >= ISO_FIXED_LEN;
+#ifdef PGTIME_X86_SIMD
+    fixed = fixed && parse_fixed_sse2(str, fields);
+#else
+    fixed = fixed && parse_fixed_scalar(str, fields);
+#endif
+
+    if ( fixed ) {
+        if ( str[10] != 'T' && str[10] != 't' && str[10] != ' ' ) {
+            return 0;
+        }
+        year = fields[ISO_YEAR];
+        p = str + ISO_FIXED_LEN;
+    } else {
+        p = parse_date_time_slow(str, end, &year, fields);
+        if ( !p ) {
+            return 0;
+        }
+    }
+
+    const bool leap = is_leap_year((int) (year % 400));
+    if ( fields[ISO_MON] < 1 || fields[ISO_MON] > 12 ||
+         fields[ISO_MDAY] < 1 ||
+         fields[ISO_MDAY] > days_in_month[fields[ISO_MON] - 1] +
+                            (fields[ISO_MON] == 2 && leap) ||
+         fields[ISO_HOUR] > 23 || fields[ISO_MIN] > 59 ||
+         fields[ISO_SEC] > 59 ) {
+        return 0;
+    }
+
+    //  Optional fraction of a second.
+
+    long nsec = 0;
+    if ( p < end && (*p == '.' || *p == ',') ) {
+        long scale = 100000000;
+        const char *digits = ++p;
+
+        while ( p < end && *p >= '0' && *p <= '9' ) {
+            nsec += (*p - '0') * scale;
+            scale /= 10;
+            ++p;
+        }
+
+        if ( p == digits ) {
+            return 0;
+        }
+    }
+
+    //  Optional UTC offset.
+
+    int offset = 0;
+    if ( p < end && (*p == 'Z' || *p == 'z') ) {
+        ++p;
+    } else if ( p < end && (*p == '+' || *p == '-') ) {
+        const int sign = *p == '-' ? -1 : 1;
+        int offset_hours;
+        int offset_mins = 0;
+
+        if ( end - p < 3 || !parse_two_digits(p + 1, &offset_hours) ) {
+            return 0;
+        }
+        p += 3;
+
+        if ( end - p >= 3 && *p == ':' ) {
+            if ( !parse_two_digits(p + 1, &offset_mins) ) {
+                return 0;
+            }
+            p += 3;
+        } else if ( end - p >= 2 && *p >= '0' && *p <= '9' ) {
+            if ( !parse_two_digits(p, &offset_mins) ) {
+                return 0;
+            }
+            p += 2;
+        }
+
+        if ( offset_hours > 23 || offset_mins > 59 ) {
+            return 0;
+        }
+
+        offset = sign * (offset_hours * 3600 + offset_mins * 60);
+    }
+
+    result->tm_year = (int) (year - 1900);
+    result->tm_mon = fields[ISO_MON] - 1;
+    result->tm_mday = fields[ISO_MDAY];
+    result->tm_hour = fields[ISO_HOUR];
+    result->tm_min = fields[ISO_MIN];
+    result->tm_sec = fields[ISO_SEC];
+    result->tm_wday = day_of_week(year, fields[ISO_MON], fields[ISO_MDAY]);
+    result->tm_yday = day_of_year(year, fields[ISO_MON], fields[ISO_MDAY]);
+    result->tm_isdst = 0;
+
+    if ( nanoseconds ) {
+        *nanoseconds = nsec;
+    }
+    if ( utc_offset ) {
+        *utc_offset = offset;
+    }
+
+    return p;
+}
+
+
+/*!
+ * \brief           Parses an ISO 8601 / RFC 3339 timestamp into a struct tm.
+ * \details         The accepted format is `YYYY-MM-DDTHH:MM:SS`, or the
+ * basic format `YYYYMMDDTHHMMSS`, where the `T` may also be a lower case
+ * `t` or a space, optionally followed by a decimal fraction of a second
+ * introduced by `.` or `,`, and optionally followed by `Z`, `z`, or a UTC
+ * offset of the form `+hh:mm`, `+hhmm` or `+hh` (or with `-`). The year
+ * may also be written with a sign and up to ten digits, as
+ * format_iso8601() writes years outside 0 to 9999, so anything it writes
+ * can be read back. The date and time are validated as they are parsed,
+ * with the same rules as validate_date(), so there is no need to call it
+ * on the result. Only the first nine digits of the fraction are
+ * significant. On x86-64 the fixed-width part of the usual format is
+ * checked and converted with SSE2.
+ * \param str       The string to parse. It need not be null-terminated.
+ * \param len       The number of characters available in `str`.
+ * \param result    A pointer to a struct tm to receive the date and time
+ * exactly as written, before any UTC offset is applied. `tm_wday` and
+ * `tm_yday` are set, and `tm_isdst` is set to zero.
+ * \param nanoseconds If not null, modified to contain the fraction of a
+ * second in nanoseconds, or zero if there is none.
+ * \param utc_offset If not null, modified to contain the UTC offset in
+ * seconds, positive east of Greenwich. A timestamp with no offset is
+ * taken to be in UTC.
+ * \returns         A pointer to the first character after the timestamp,
+ * or a null pointer if `str` does not start with a valid timestamp.
+ */
+
+const char *
+parse_iso8601(const char *str, const size_t len, struct tm *result,
+              long *nanoseconds, int *utc_offset) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_PARSE_ISO8601);
+    const char *const end = parse_timestamp(str, len, result, nanoseconds,
+                                            utc_offset);
+    PGTIME_PROBE_END(PGTIME_PROBE_PARSE_ISO8601, start);
+    return end;
+}
+
+
+/*!
+ * \brief           Parses an ISO 8601 / RFC 3339 timestamp into a time_t.
+ * \details         Accepts the same formats as parse_iso8601(), and applies
+ * the UTC offset, if any, to give a UTC timestamp.
+ * \param str       The string to parse. It need not be null-terminated.
+ * \param len       The number of characters available in `str`.
+ * \param result    Modified to contain the UTC timestamp.
+ * \param nanoseconds If not null, modified to contain the fraction of a
+ * second in nanoseconds, or zero if there is none.
+ * \returns         A pointer to the first character after the timestamp,
+ * or a null pointer if `str` does not start with a valid timestamp or the
+ * timestamp cannot be found, in which case `result` is unchanged.
+ */
+
+const char *
+parse_iso8601_timestamp(const char *str, const size_t len, time_t *result,
+                        long *nanoseconds) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_PARSE_ISO8601);
+    struct tm parsed_tm;
+    int utc_offset;
+
+    const char *end = parse_timestamp(str, len, &parsed_tm, nanoseconds,
+                                      &utc_offset);
+    if ( end ) {
+        time_t utc_ts;
+        time_t one_sec;
+
+        if ( pgtime_utc_timestamp(&parsed_tm, &utc_ts) == PGTIME_OK &&
+             get_sec_diff_checked(&one_sec) == PGTIME_OK ) {
+            *result = utc_ts - one_sec * utc_offset;
+        } else {
+            end = 0;
+        }
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_PARSE_ISO8601, start);
+    return end;
+}
+
+
+/*!
+ * \brief           Writes two digits from the digit pair table.
+ * \param out       The buffer to write to.
+ * \param value     The value to write, 0 to 99.
+ * \returns         A pointer to the character after the digits.
+ */
+
+static char *
+write_two_digits(char *out, const int value) {
+    memcpy(out, &digit_pairs[value * 2], 2);
+    return out + 2;
+}
+
+
+/*!
+ * \brief           Writes the date and time part of a timestamp.
+ * \details         Years outside 0 to 9999 are written in the ISO 8601
+ * expanded representation, with a sign and at least four digits.
+ * \param out       The buffer to write to, at least ISO_MAX_DATE_TIME_LEN
+ * characters.
+ * \param tm        The time to write, with every field in range.
+ * \param format    The format to write.
+ * \returns         The number of characters written.
+ */
+
+static size_t
+write_date_time(char *out, const struct tm *tm, const enum iso_format format) {
+    const bool extended = format != ISO_FORMAT_BASIC;
+    const int64_t year = (int64_t) tm->tm_year + 1900;
+    char *p = out;
+
+    if ( year >= 0 && year <= 9999 ) {
+        p = write_two_digits(p, (int) (year / 100));
+        p = write_two_digits(p, (int) (year % 100));
+    } else {
+        uint64_t magnitude = year < 0 ? (uint64_t) -year : (uint64_t) year;
+        char digits[20];
+        int num_digits = 0;
+
+        while ( magnitude || num_digits < 4 ) {
+            digits[num_digits++] = (char) ('0' + magnitude % 10);
+            magnitude /= 10;
+        }
+
+        *p++ = year < 0 ? '-' : '+';
+        while ( num_digits ) {
+            *p++ = digits[--num_digits];
+        }
+    }
+
+    if ( extended ) {
+        *p++ = '-';
+    }
+    p = write_two_digits(p, tm->tm_mon + 1);
+    if ( extended ) {
+        *p++ = '-';
+    }
+    p = write_two_digits(p, tm->tm_mday);
+    *p++ = 'T';
+    p = write_two_digits(p, tm->tm_hour);
+    if ( extended ) {
+        *p++ = ':';
+    }
+    p = write_two_digits(p, tm->tm_min);
+    if ( extended ) {
+        *p++ = ':';
+    }
+    p = write_two_digits(p, tm->tm_sec);
+
+    return (size_t) (p - out);
+}
+
+
+/*!
+ * \brief               Writes the fraction of a second and the UTC offset.
+ * \param out           The buffer to write to.
+ * \param nanoseconds   The fraction of a second in nanoseconds.
+ * \param precision     The number of fractional digits to write, 0 to 9.
+ * With 0, no decimal point is written.
+ * \param utc_offset    The UTC offset in seconds.
+ * \param format        The format to write.
+ * \returns             A pointer to the character after the last one
+ * written.
+ */
+
+static char *
+write_fraction_and_offset(char *out, const long nanoseconds,
+                          const int precision, const int utc_offset,
+                          const enum iso_format format) {
+    static const long divisors[] = {1000000000, 100000000, 10000000,
+                                    1000000, 100000, 10000, 1000, 100, 10, 1};
+    char *p = out;
+
+    if ( precision > 0 ) {
+        long value = nanoseconds / divisors[precision];
+        char *digit = p + 1 + precision;
+
+        *p = '.';
+        p = digit;
+
+        //  Write the digits from the right, two at a time.
+
+        for ( int remaining = precision; remaining > 0; remaining -= 2 ) {
+            if ( remaining == 1 ) {
+                *--digit = (char) ('0' + value);
+            } else {
+                digit -= 2;
+                write_two_digits(digit, (int) (value % 100));
+                value /= 100;
+            }
+        }
+    }
+
+    if ( format == ISO_FORMAT_EXTENDED ) {
+        return p;
+    } else if ( utc_offset == 0 ) {
+        *p++ = 'Z';
+        return p;
+    }
+
+    const int offset_mins = (utc_offset < 0 ? -utc_offset : utc_offset) / 60;
+    *p++ = utc_offset < 0 ? '-' : '+';
+    p = write_two_digits(p, offset_mins / 60);
+    if ( format == ISO_FORMAT_RFC3339 ) {
+        *p++ = ':';
+    }
+    p = write_two_digits(p, offset_mins % 60);
+
+    return p;
+}
+
+
+/*!
+ * \brief           Copies a formatted timestamp to the caller's buffer.
+ * \param buffer    The caller's buffer.
+ * \param size      The size of the caller's buffer.
+ * \param text      The formatted timestamp.
+ * \param len       The length of the formatted timestamp.
+ * \returns         `len`, or zero if the buffer is too small.
+ */
+
+static size_t
+copy_formatted(char *buffer, const size_t size, const char *text,
+               const size_t len) {
+    if ( len >= size ) {
+        return 0;
+    }
+
+    memcpy(buffer, text, len);
+    buffer[len] = '\0';
+    return len;
+}
+
+
+/*!
+ * \brief               Does the work of format_iso8601().
+ * \param buffer        The buffer to write to.
+ * \param size          The size of `buffer`. PGTIME_ISO8601_BUFSIZE is
+ * always large enough.
+ * \param tm            The time to format.
+ * \param nanoseconds   The fraction of a second in nanoseconds, 0 to
+ * 999999999.
+ * \param precision     The number of fractional digits to write, 0 to 9.
+ * The fraction is truncated, not rounded. With 0, no decimal point is
+ * written.
+ * \param utc_offset    The UTC offset of `tm` in seconds, positive east of
+ * Greenwich, and less than a day in magnitude. Any seconds beyond a whole
+ * minute are dropped, as with the `%z` conversion of strftime(). A zero
+ * offset is written as `Z`. Ignored for ISO_FORMAT_EXTENDED.
+ * \param format        The format to write.
+ * \returns             The number of characters written, not including
+ * the terminating null character, or zero if an argument is out of range
+ * or `buffer` is too small, in which case the contents of `buffer` are
+ * unchanged.
+ */
+
+static size_t
+format_tm(char *buffer, const size_t size, const struct tm *tm,
+          const long nanoseconds, const int precision,
+          const int utc_offset, const enum iso_format format) {
+    static const int secs_in_day = 86400;
+    char text[PGTIME_ISO8601_BUFSIZE];
+
+    if ( (unsigned) tm->tm_mon > 11 || tm->tm_mday < 1 ||
+         tm->tm_mday > 31 || (unsigned) tm->tm_hour > 23 ||
+         (unsigned) tm->tm_min > 59 || (unsigned) tm->tm_sec > 60 ||
+         nanoseconds < 0 || nanoseconds > 999999999 ||
+         precision < 0 || precision > 9 ||
+         utc_offset <= -secs_in_day || utc_offset >= secs_in_day ) {
+        return 0;
+    }
+
+    const size_t len = write_date_time(text, tm, format);
+    const char *end = write_fraction_and_offset(text + len, nanoseconds,
+                                                precision, utc_offset, format);
+
+    return copy_formatted(buffer, size, text, (size_t) (end - text));
+}
+
+
+/*!
+ * \brief               Formats a struct tm as an ISO 8601 / RFC 3339
+ * timestamp.
+ * \details             This does not depend on the locale, and is much
+ * faster than strftime(). Every member of `tm` used must be in its normal
+ * range, although `tm_mday` is not checked against the length of the
+ * month, and `tm_sec` may be 60 for a leap second.
+ * \param buffer        The buffer to write to.
+ * \param size          The size of `buffer`. PGTIME_ISO8601_BUFSIZE is
+ * always large enough.
+ * \param tm            The time to format.
+ * \param nanoseconds   The fraction of a second in nanoseconds, 0 to
+ * 999999999.
+ * \param precision     The number of fractional digits to write, 0 to 9.
+ * The fraction is truncated, not rounded. With 0, no decimal point is
+ * written.
+ * \param utc_offset    The UTC offset of `tm` in seconds, positive east of
+ * Greenwich, and less than a day in magnitude. Any seconds beyond a whole
+ * minute are dropped, as with the `%z` conversion of strftime(). A zero
+ * offset is written as `Z`. Ignored for ISO_FORMAT_EXTENDED.
+ * \param format        The format to write.
+ * \returns             The number of characters written, not including
+ * the terminating null character, or zero if an argument is out of range
+ * or `buffer` is too small, in which case the contents of `buffer` are
+ * unchanged.
+ */
+
+size_t
+format_iso8601(char *buffer, const size_t size, const struct tm *tm,
+               const long nanoseconds, const int precision,
+               const int utc_offset, const enum iso_format format) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_FORMAT_ISO8601);
+    const size_t written = format_tm(buffer, size, tm, nanoseconds,
+                                     precision, utc_offset, format);
+    PGTIME_PROBE_END(PGTIME_PROBE_FORMAT_ISO8601, start);
+    return written;
+}
+
+
+/*!
+ * \brief               Does the work of format_iso8601_timestamp().
+ * \param buffer        The buffer to write to.
+ * \param size          The size of `buffer`. PGTIME_ISO8601_BUFSIZE is
+ * always large enough.
+ * \param utc_ts        The UTC timestamp to format.
+ * \param nanoseconds   The fraction of a second in nanoseconds, 0 to
+ * 999999999.
+ * \param precision     The number of fractional digits to write, 0 to 9.
+ * The fraction is truncated, not rounded. With 0, no decimal point is
+ * written.
+ * \param format        The format to write. ISO_FORMAT_RFC3339 and
+ * ISO_FORMAT_BASIC end in `Z`.
+ * \returns             The number of characters written, not including
+ * the terminating null character, or zero if an argument is out of range,
+ * `utc_ts` cannot be represented in a struct tm, or `buffer` is too small,
+ * in which case the contents of `buffer` are unchanged.
+ */
+
+static size_t
+format_timestamp(char *buffer, const size_t size,
+                 const time_t utc_ts, const long nanoseconds,
+                 const int precision, const enum iso_format format) {
+    char text[PGTIME_ISO8601_BUFSIZE];
+    size_t len;
+
+    if ( nanoseconds < 0 || nanoseconds > 999999999 ||
+         precision < 0 || precision > 9 ) {
+        return 0;
+    }
+
+#ifndef __STDC_NO_THREADS__
+    if ( !format_cache.valid || format_cache.utc_ts != utc_ts ||
+         format_cache.format != format ) {
+        struct tm utc_tm;
+        if ( !get_utc_tm(utc_ts, &utc_tm) ) {
+            return 0;
+        }
+
+        format_cache.len = write_date_time(format_cache.text, &utc_tm, format);
+        format_cache.utc_ts = utc_ts;
+        format_cache.format = format;
+        format_cache.valid = true;
+    }
+
+    len = format_cache.len;
+    memcpy(text, format_cache.text, len);
+#else
+    struct tm utc_tm;
+    if ( !get_utc_tm(utc_ts, &utc_tm) ) {
+        return 0;
+    }
+
+    len = write_date_time(text, &utc_tm, format);
+#endif
+
+    const char *end = write_fraction_and_offset(text + len, nanoseconds,
+                                                precision, 0, format);
+
+    return copy_formatted(buffer, size, text, (size_t) (end - text));
+}
+
+
+/*!
+ * \brief               Formats a time_t as an ISO 8601 / RFC 3339 UTC
+ * timestamp.
+ * \details             The date and time part of the last second formatted
+ * is cached per thread, so when successive calls fall in the same second,
+ * as they do when stamping log lines, only the fraction is written again.
+ * \param buffer        The buffer to write to.
+ * \param size          The size of `buffer`. PGTIME_ISO8601_BUFSIZE is
+ * always large enough.
+ * \param utc_ts        The UTC timestamp to format.
+ * \param nanoseconds   The fraction of a second in nanoseconds, 0 to
+ * 999999999.
+ * \param precision     The number of fractional digits to write, 0 to 9.
+ * The fraction is truncated, not rounded. With 0, no decimal point is
+ * written.
+ * \param format        The format to write. ISO_FORMAT_RFC3339 and
+ * ISO_FORMAT_BASIC end in `Z`.
+ * \returns             The number of characters written, not including
+ * the terminating null character, or zero if an argument is out of range,
+ * `utc_ts` cannot be represented in a struct tm, or `buffer` is too small,
+ * in which case the contents of `buffer` are unchanged.
+ */
+
+size_t
+format_iso8601_timestamp(char *buffer, const size_t size,
+                         const time_t utc_ts, const long nanoseconds,
+                         const int precision, const enum iso_format format) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_FORMAT_ISO8601);
+    const size_t written = format_timestamp(buffer, size, utc_ts,
+                                            nanoseconds, precision, format);
+    PGTIME_PROBE_END(PGTIME_PROBE_FORMAT_ISO8601, start);
+    return written;
+}
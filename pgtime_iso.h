@@ -0,0 +1,61 @@
+/*!
+ * \file        pgtime_iso.h
+ * \brief       Interface to ISO 8601 and RFC 3339 timestamp functions.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_ISO_H
+#define PG_PGTIME_ISO_H
+
+#include <stddef.h>
+#include <time.h>
+
+
+/*!
+ * \brief       Size of a buffer large enough for any formatted timestamp,
+ * including the terminating null character.
+ */
+
+#define PGTIME_ISO8601_BUFSIZE 48
+
+
+/*!
+ * \brief       The output formats available for timestamps.
+ */
+
+enum iso_format {
+    ISO_FORMAT_EXTENDED,    /*!<  `YYYY-MM-DDTHH:MM:SS`, no UTC offset  */
+    ISO_FORMAT_RFC3339,     /*!<  `YYYY-MM-DDTHH:MM:SSZ` or `+hh:mm`  */
+    ISO_FORMAT_BASIC        /*!<  `YYYYMMDDTHHMMSSZ` or `+hhmm`  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *parse_iso8601(const char *str, const size_t len,
+                          struct tm *result, long *nanoseconds,
+                          int *utc_offset);
+const char *parse_iso8601_timestamp(const char *str, const size_t len,
+                                    time_t *result, long *nanoseconds);
+
+size_t format_iso8601(char *buffer, const size_t size, const struct tm *tm,
+                      const long nanoseconds, const int precision,
+                      const int utc_offset, const enum iso_format format);
+size_t format_iso8601_timestamp(char *buffer, const size_t size,
+                                const time_t utc_ts, const long nanoseconds,
+                                const int precision,
+                                const enum iso_format format);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_ISO_H  */
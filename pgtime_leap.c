@@ -0,0 +1,509 @@
+/*!
+ * \file        pgtime_leap.c
+ * \brief       Implementation of leap seconds, and of the TAI and GPS time
+ * scales.
+ * \details     A leap second table lists each UTC time at which TAI - UTC
+ * changed, with its new value. The table is small and sorted, so lookups
+ * are binary searches, and times after the last leap second, which is
+ * where nearly all lookups fall, are answered before searching at all.
+ * A TAI timestamp here counts SI seconds from 1970-01-01 00:00:00 TAI, so
+ * it is the POSIX timestamp plus TAI - UTC, which is taken to be 10
+ * seconds before 1972 when leap seconds began. A GPS timestamp counts
+ * seconds from 1980-01-06 00:00:00 UTC, the GPS epoch, and is always 19
+ * seconds behind TAI. Like pgtime_tz, this module assumes that time_t
+ * counts POSIX seconds.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_leap.h"
+#include "pgtime_internal.h"
+
+
+/*  The system leap second file, and the longest line we read from it  */
+
+#define LEAP_DEFAULT_FILE "/usr/share/zoneinfo/leap-seconds.list"
+#define LEAP_MAX_LINE 256
+
+/*  The most leap second entries a file can have  */
+
+#define LEAP_MAX_ENTRIES 256
+
+/*  Seconds from the NTP epoch, 1900-01-01, to the POSIX epoch  */
+
+#define NTP_EPOCH_OFFSET INT64_C(2208988800)
+
+/*  The GPS epoch as a POSIX timestamp, and TAI - GPS  */
+
+#define GPS_EPOCH INT64_C(315964800)
+#define GPS_TAI_OFFSET 19
+
+
+/*!
+ * \brief       A change in TAI - UTC.
+ */
+
+struct leap_entry {
+    int64_t utc_ts;         /*!<  POSIX timestamp the change takes effect  */
+    int64_t tai_offset;     /*!<  TAI - UTC from then on, in seconds  */
+};
+
+
+/*!
+ * \brief       A table of leap seconds.
+ */
+
+struct leap_table {
+    const struct leap_entry *entries;   /*!<  Changes, sorted by time  */
+    size_t count;                       /*!<  Number of entries  */
+    time_t expiry;                      /*!<  When the table expires  */
+};
+
+
+/*  Leap seconds announced up to IERS Bulletin C 71, which expires on
+ *  2026-06-28  */
+
+static const struct leap_entry builtin_entries[] = {
+    {63072000, 10}, {78796800, 11}, {94694400, 12}, {126230400, 13},
+    {157766400, 14}, {189302400, 15}, {220924800, 16}, {252460800, 17},
+    {283996800, 18}, {315532800, 19}, {362793600, 20}, {394329600, 21},
+    {425865600, 22}, {489024000, 23}, {567993600, 24}, {631152000, 25},
+    {662688000, 26}, {709948800, 27}, {741484800, 28}, {773020800, 29},
+    {820454400, 30}, {867715200, 31}, {915148800, 32}, {1136073600, 33},
+    {1230768000, 34}, {1341100800, 35}, {1435708800, 36}, {1483228800, 37}
+};
+
+static const struct leap_table builtin_table = {
+    builtin_entries,
+    sizeof builtin_entries / sizeof builtin_entries[0],
+    1782604800
+};
+
+
+/*!
+ * \brief           Returns the table to use for a table argument.
+ * \param table     The table passed in, or a null pointer.
+ * \returns         `table`, or the built-in table if `table` is null.
+ */
+
+static const struct leap_table *
+table_or_builtin(const struct leap_table *table) {
+    return table ? table : &builtin_table;
+}
+
+
+/*!
+ * \brief           Finds the entry in effect at a UTC time.
+ * \param table     The leap second table.
+ * \param utc_ts    The POSIX timestamp.
+ * \returns         The index of the last entry taking effect at or before
+ * `utc_ts`, or zero if `utc_ts` is before the first entry.
+ */
+
+static size_t
+find_utc_entry(const struct leap_table *table, const int64_t utc_ts) {
+    const struct leap_entry *entries = table->entries;
+    size_t low = 0;
+    size_t high = table->count;
+
+    if ( utc_ts >= entries[high - 1].utc_ts ) {
+        return high - 1;
+    }
+
+    while ( high - low > 1 ) {
+        const size_t mid = low + (high - low) / 2;
+        if ( entries[mid].utc_ts <= utc_ts ) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+
+/*!
+ * \brief           Finds the entry in effect at a TAI time.
+ * \details         TAI has no gaps or repeats, so the TAI times at which
+ * the entries take effect are sorted too.
+ * \param table     The leap second table.
+ * \param tai_ts    The TAI timestamp.
+ * \returns         The index of the last entry taking effect at or before
+ * `tai_ts`, or zero if `tai_ts` is before the first entry.
+ */
+
+static size_t
+find_tai_entry(const struct leap_table *table, const int64_t tai_ts) {
+    const struct leap_entry *entries = table->entries;
+    size_t low = 0;
+    size_t high = table->count;
+
+    if ( tai_ts >= entries[high - 1].utc_ts + entries[high - 1].tai_offset ) {
+        return high - 1;
+    }
+
+    while ( high - low > 1 ) {
+        const size_t mid = low + (high - low) / 2;
+        if ( entries[mid].utc_ts + entries[mid].tai_offset <= tai_ts ) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+
+/*!
+ * \brief           Parses a leap second file.
+ * \details         Reads the format of the IERS and NIST
+ * `leap-seconds.list` file: lines starting with `#` are comments, except
+ * that `#@` gives the expiry time, and every other line holds an NTP
+ * timestamp and the value of TAI - UTC from then on. The SHA-1 hash on
+ * the `#h` line is not checked.
+ * \param file      The open file.
+ * \returns         A pointer to the table, or a null pointer if the file
+ * is malformed or memory could not be allocated.
+ */
+
+static struct leap_table *
+parse_leap_file(FILE *file) {
+    struct leap_entry entries[LEAP_MAX_ENTRIES];
+    char line[LEAP_MAX_LINE];
+    size_t count = 0;
+    int64_t expiry = 0;
+
+    while ( fgets(line, sizeof line, file) ) {
+        char *end;
+
+        if ( line[0] == '#' ) {
+            if ( line[1] == '@' ) {
+                expiry = strtoll(line + 2, &end, 10) - NTP_EPOCH_OFFSET;
+                if ( end == line + 2 ) {
+                    return 0;
+                }
+            }
+            continue;
+        }
+
+        const int64_t ntp_ts = strtoll(line, &end, 10);
+        if ( end == line ) {
+
+            //  Allow blank lines.
+
+            if ( strspn(line, " \t\r\n") == strlen(line) ) {
+                continue;
+            }
+            return 0;
+        }
+
+        char *const offset_start = end;
+        const int64_t tai_offset = strtoll(offset_start, &end, 10);
+        if ( end == offset_start || count == LEAP_MAX_ENTRIES ||
+             (count > 0 &&
+              ntp_ts - NTP_EPOCH_OFFSET <= entries[count - 1].utc_ts) ) {
+            return 0;
+        }
+
+        entries[count].utc_ts = ntp_ts - NTP_EPOCH_OFFSET;
+        entries[count].tai_offset = tai_offset;
+        ++count;
+    }
+
+    if ( ferror(file) || count == 0 ) {
+        return 0;
+    }
+
+    //  The table and its entries share one block, so tables are freed
+    //  with a single call to free().
+
+    struct leap_table *table = malloc(sizeof *table +
+                                      count * sizeof entries[0]);
+    if ( !table ) {
+        return 0;
+    }
+
+    struct leap_entry *const table_entries = (struct leap_entry *) (table + 1);
+    memcpy(table_entries, entries, count * sizeof entries[0]);
+    table->entries = table_entries;
+    table->count = count;
+    table->expiry = (time_t) expiry;
+
+    return table;
+}
+
+
+/*!
+ * \brief           Loads a leap second table from a file.
+ * \param path      The path of a file in `leap-seconds.list` format, or a
+ * null pointer for the system file in `/usr/share/zoneinfo`.
+ * \returns         A pointer to the table, which should be freed with
+ * leap_table_free(), or a null pointer if it could not be loaded.
+ */
+
+struct leap_table *
+leap_table_load(const char *path) {
+    FILE *file = fopen(path ? path : LEAP_DEFAULT_FILE, "r");
+    if ( !file ) {
+        return 0;
+    }
+
+    struct leap_table *table = parse_leap_file(file);
+    fclose(file);
+
+    return table;
+}
+
+
+/*!
+ * \brief           Frees a leap second table.
+ * \param table     The table returned by leap_table_load(), or a null
+ * pointer.
+ */
+
+void
+leap_table_free(struct leap_table *table) {
+    free(table);
+}
+
+
+/*!
+ * \brief           Returns the leap second table compiled into the
+ * library.
+ * \details         The table must not be freed. Leap seconds are announced
+ * about six months ahead, so for times after its expiry, load the system
+ * table with leap_table_load() instead.
+ * \returns         A pointer to the built-in table.
+ */
+
+const struct leap_table *
+leap_table_builtin(void) {
+    return &builtin_table;
+}
+
+
+/*!
+ * \brief           Returns the expiry time of a leap second table.
+ * \details         The table is known to be complete up to this time. It
+ * may still be used after it, but a leap second announced later would be
+ * missing.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \returns         The expiry time, or zero if the file gave none.
+ */
+
+time_t
+leap_table_expiry(const struct leap_table *table) {
+    return table_or_builtin(table)->expiry;
+}
+
+
+/*!
+ * \brief           Returns TAI - UTC at a UTC time.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param utc_ts    The UTC time.
+ * \returns         TAI - UTC in seconds. Before the first entry of the
+ * table, the value of the first entry is returned.
+ */
+
+int
+leap_tai_offset(const struct leap_table *table, const time_t utc_ts) {
+    table = table_or_builtin(table);
+    return (int) table->entries[find_utc_entry(table, utc_ts)].tai_offset;
+}
+
+
+/*!
+ * \brief           Checks whether a UTC time is a leap second.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param utc_tm    The UTC time, with `tm_year`, `tm_mon` and `tm_mday` in
+ * their normal ranges.
+ * \returns         `true` if `utc_tm` is 23:59:60 on a day which ended
+ * with an inserted leap second, `false` otherwise.
+ */
+
+bool
+is_leap_second(const struct leap_table *table, const struct tm *utc_tm) {
+    if ( utc_tm->tm_sec != 60 || utc_tm->tm_min != 59 ||
+         utc_tm->tm_hour != 23 ) {
+        return false;
+    }
+
+    //  The leap second ends the day, so look for an increase in TAI - UTC
+    //  at the following midnight.
+
+    table = table_or_builtin(table);
+    const int64_t midnight = (days_from_civil(utc_tm->tm_year +
+                                              (int64_t) 1900,
+                                              (int64_t) utc_tm->tm_mon + 1,
+                                              utc_tm->tm_mday) + 1) * 86400;
+    const size_t index = find_utc_entry(table, midnight);
+
+    return index > 0 && table->entries[index].utc_ts == midnight &&
+           table->entries[index].tai_offset >
+           table->entries[index - 1].tai_offset;
+}
+
+
+/*!
+ * \brief           Checks whether a supplied date is valid, allowing real
+ * leap seconds.
+ * \details         This is validate_date(), except that `tm_sec` may be 60
+ * when, and only when, the time is a leap second in the table.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \returns         `true` if the date is valid, `false` otherwise.
+ */
+
+bool
+validate_date_leap(const struct leap_table *table,
+                   const struct tm *check_tm) {
+    if ( check_tm->tm_sec != 60 ) {
+        return validate_date(check_tm);
+    }
+
+    struct tm copy_tm = *check_tm;
+    copy_tm.tm_sec = 59;
+    return validate_date(&copy_tm) && is_leap_second(table, check_tm);
+}
+
+
+/*!
+ * \brief           Converts a UTC time to a TAI timestamp.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param utc_tm    The UTC time. If `tm_sec` is 60, the time is taken to
+ * be a leap second, and gets its own TAI timestamp one second after
+ * 23:59:59.
+ * \param result    Modified to contain the TAI timestamp.
+ * \returns         `true` on success, `false` if the POSIX timestamp of the
+ * time cannot be found, in which case `result` is unchanged.
+ */
+
+bool
+utc_to_tai(const struct leap_table *table, const struct tm *utc_tm,
+           int64_t *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_UTC_TO_TAI);
+    time_t utc_ts;
+    const bool success = pgtime_utc_timestamp(utc_tm, &utc_ts) == PGTIME_OK;
+
+    //  During a leap second the POSIX timestamp is already that of the
+    //  following midnight, but TAI - UTC has not changed yet.
+
+    if ( success ) {
+        *result = (int64_t) utc_ts +
+                  leap_tai_offset(table, utc_ts -
+                                  (utc_tm->tm_sec >= 60 ? 1 : 0));
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_UTC_TO_TAI, start);
+    return success;
+}
+
+
+/*!
+ * \brief           Does the work of tai_to_utc().
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param tai_ts    The TAI timestamp.
+ * \param result    A pointer to a struct tm to receive the UTC time.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+static struct tm *
+utc_from_tai(const struct leap_table *table, const int64_t tai_ts,
+             struct tm *result) {
+    table = table_or_builtin(table);
+    const size_t index = find_tai_entry(table, tai_ts);
+    const struct leap_entry *entry = &table->entries[index];
+
+    //  The TAI seconds between the end of this entry in UTC and the start
+    //  of the next one are inserted leap seconds, which UTC counts as 60
+    //  and up on the last minute of the day.
+
+    if ( index + 1 < table->count ) {
+        const int64_t next_utc = entry[1].utc_ts;
+        const int64_t leap = tai_ts - (next_utc + entry->tai_offset);
+        if ( leap >= 0 ) {
+            PGTIME_COUNT(PGTIME_COUNTER_LEAP_SECOND);
+            if ( !get_utc_tm((time_t) (next_utc - 1), result) ) {
+                return 0;
+            }
+            result->tm_sec += (int) leap + 1;
+            return result;
+        }
+    }
+
+    return get_utc_tm((time_t) (tai_ts - entry->tai_offset), result);
+}
+
+
+/*!
+ * \brief           Converts a TAI timestamp to UTC time.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param tai_ts    The TAI timestamp.
+ * \param result    A pointer to a struct tm to receive the UTC time. During
+ * a leap second, `tm_sec` is 60.
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+struct tm *
+tai_to_utc(const struct leap_table *table, const int64_t tai_ts,
+           struct tm *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TAI_TO_UTC);
+    struct tm *const utc_tm = utc_from_tai(table, tai_ts, result);
+    PGTIME_PROBE_END(PGTIME_PROBE_TAI_TO_UTC, start);
+    return utc_tm;
+}
+
+
+/*!
+ * \brief           Converts a UTC time to a GPS timestamp.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param utc_tm    The UTC time, as for utc_to_tai().
+ * \param result    Modified to contain the number of seconds since the GPS
+ * epoch, counting leap seconds.
+ * \returns         `true` on success, `false` if the POSIX timestamp of the
+ * time cannot be found, in which case `result` is unchanged.
+ */
+
+bool
+utc_to_gps(const struct leap_table *table, const struct tm *utc_tm,
+           int64_t *result) {
+    int64_t tai_ts;
+
+    if ( !utc_to_tai(table, utc_tm, &tai_ts) ) {
+        return false;
+    }
+
+    *result = tai_ts - GPS_TAI_OFFSET - GPS_EPOCH;
+    return true;
+}
+
+
+/*!
+ * \brief           Converts a GPS timestamp to UTC time.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param gps_ts    The number of seconds since the GPS epoch.
+ * \param result    A pointer to a struct tm to receive the UTC time, as for
+ * tai_to_utc().
+ * \returns         `result`, or a null pointer if the year cannot be
+ * represented in a struct tm.
+ */
+
+struct tm *
+gps_to_utc(const struct leap_table *table, const int64_t gps_ts,
+           struct tm *result) {
+    return tai_to_utc(table, gps_ts + GPS_TAI_OFFSET + GPS_EPOCH, result);
+}
@@ -0,0 +1,60 @@
+/*!
+ * \file        pgtime_leap.h
+ * \brief       Interface to leap seconds, and to the TAI and GPS time
+ * scales.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_LEAP_H
+#define PG_PGTIME_LEAP_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*!
+ * \brief       A table of leap seconds.
+ * \details     The structure is opaque. A table is never modified once
+ * loaded, so any number of threads can use it at once without locking.
+ * Every function which takes a table uses the table compiled into the
+ * library when passed a null pointer.
+ */
+
+struct leap_table;
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct leap_table *leap_table_load(const char *path);
+void leap_table_free(struct leap_table *table);
+const struct leap_table *leap_table_builtin(void);
+time_t leap_table_expiry(const struct leap_table *table);
+
+int leap_tai_offset(const struct leap_table *table, const time_t utc_ts);
+bool is_leap_second(const struct leap_table *table, const struct tm *utc_tm);
+bool validate_date_leap(const struct leap_table *table,
+                        const struct tm *check_tm);
+
+bool utc_to_tai(const struct leap_table *table, const struct tm *utc_tm,
+                int64_t *result);
+struct tm *tai_to_utc(const struct leap_table *table, const int64_t tai_ts,
+                      struct tm *result);
+bool utc_to_gps(const struct leap_table *table, const struct tm *utc_tm,
+                int64_t *result);
+struct tm *gps_to_utc(const struct leap_table *table, const int64_t gps_ts,
+                      struct tm *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_LEAP_H  */
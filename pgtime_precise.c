@@ -0,0 +1,473 @@
+/*!
+ * \file        pgtime_precise.c
+ * \brief       Implementation of date and time functions with nanosecond
+ * precision.
+ * \details     Each function splits any nanoseconds into whole seconds
+ * and a fraction first, and passes the whole seconds to the functions
+ * for struct tm in one go, so a carry out of the fraction costs nothing
+ * extra however far it reaches.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_precise.h"
+#include "pgtime_internal.h"
+
+
+/*  Nanoseconds in a second, a millisecond and a microsecond  */
+
+#define NSECS_IN_SEC INT64_C(1000000000)
+#define NSECS_IN_MSEC INT64_C(1000000)
+#define NSECS_IN_USEC INT64_C(1000)
+
+
+/*!
+ * \brief               Splits a number of nanoseconds into whole seconds
+ * and a fraction.
+ * \details             Unlike floor_div(), this cannot overflow for any
+ * value of `nanoseconds`.
+ * \param nanoseconds   The number of nanoseconds, which may be negative.
+ * \param seconds       Modified to contain the whole seconds, rounded
+ * down.
+ * \returns             The remaining nanoseconds, from 0 to 999999999.
+ */
+
+static int64_t
+split_nanoseconds(const int64_t nanoseconds, int64_t *seconds) {
+    int64_t quotient = nanoseconds / NSECS_IN_SEC;
+    int64_t remainder = nanoseconds % NSECS_IN_SEC;
+
+    if ( remainder < 0 ) {
+        remainder += NSECS_IN_SEC;
+        --quotient;
+    }
+
+    *seconds = quotient;
+    return remainder;
+}
+
+
+/*!
+ * \brief           Compares two precise_tm structs.
+ * \details         The date and time are compared as for tm_compare(), and
+ * then the nanoseconds, which must be in their normal range.
+ * \param first     The first precise_tm.
+ * \param second    The second precise_tm.
+ * \returns         -1 if `first` is earlier than `second`, 1 if `first` is
+ * later than `second`, and 0 if `first` is equal to `second`.
+ */
+
+int
+precise_tm_compare(const struct precise_tm *first,
+                   const struct precise_tm *second) {
+    const int compare_result = tm_compare(&first->tm, &second->tm);
+
+    if ( compare_result ) {
+        return compare_result;
+    }
+    return (first->nanoseconds > second->nanoseconds) -
+           (first->nanoseconds < second->nanoseconds);
+}
+
+
+/*!
+ * \brief           Does the work of precise_tm_diff().
+ * \param first     The first precise_tm.
+ * \param second    The second precise_tm.
+ * \param result    Modified to contain `second` minus `first`, with
+ * `tv_nsec` from 0 to 999999999 and `tv_sec` negative if `second` is
+ * earlier.
+ * \returns         `result`.
+ */
+
+static struct timespec *
+timespec_diff(const struct precise_tm *first,
+              const struct precise_tm *second, struct timespec *result) {
+    int64_t seconds = tm_secs_diff(&first->tm, &second->tm);
+    long nanoseconds = second->nanoseconds - first->nanoseconds;
+
+    if ( nanoseconds < 0 ) {
+        nanoseconds += (long) NSECS_IN_SEC;
+        --seconds;
+    }
+
+    result->tv_sec = (time_t) seconds;
+    result->tv_nsec = nanoseconds;
+    return result;
+}
+
+
+/*!
+ * \brief           Returns the exact time between two precise_tm structs.
+ * \details         The whole seconds are found with tm_secs_diff(), so the
+ * result is exact for any two times that fit in a struct tm. The
+ * nanoseconds must be in their normal range.
+ * \param first     The first precise_tm.
+ * \param second    The second precise_tm.
+ * \param result    Modified to contain `second` minus `first`, with
+ * `tv_nsec` from 0 to 999999999 and `tv_sec` negative if `second` is
+ * earlier.
+ * \returns         `result`.
+ */
+
+struct timespec *
+precise_tm_diff(const struct precise_tm *first,
+                const struct precise_tm *second, struct timespec *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_PRECISE_TM_DIFF);
+    struct timespec *const diff = timespec_diff(first, second, result);
+    PGTIME_PROBE_END(PGTIME_PROBE_PRECISE_TM_DIFF, start);
+    return diff;
+}
+
+
+/*!
+ * \brief           Does the work of precise_tm_nsecs_diff().
+ * \param first     The first precise_tm.
+ * \param second    The second precise_tm.
+ * \returns         `second` minus `first` in nanoseconds, so the result is
+ * positive if `first` is earlier. If the difference does not fit,
+ * INT64_MAX or INT64_MIN is returned.
+ */
+
+static int64_t
+nsecs_diff(const struct precise_tm *first,
+           const struct precise_tm *second) {
+    struct timespec diff;
+    timespec_diff(first, second, &diff);
+
+    const int64_t seconds = diff.tv_sec;
+    const int64_t nanoseconds = diff.tv_nsec;
+
+    //  For negative differences, borrow a second so that the product
+    //  cannot overflow before the fraction is added.
+
+    if ( seconds >= 0 ) {
+        if ( seconds > (INT64_MAX - nanoseconds) / NSECS_IN_SEC ) {
+            return INT64_MAX;
+        }
+        return seconds * NSECS_IN_SEC + nanoseconds;
+    } else {
+        const int64_t borrow = NSECS_IN_SEC - nanoseconds;
+        if ( seconds + 1 < (INT64_MIN + borrow) / NSECS_IN_SEC ) {
+            return INT64_MIN;
+        }
+        return (seconds + 1) * NSECS_IN_SEC - borrow;
+    }
+}
+
+
+/*!
+ * \brief           Returns the number of nanoseconds between two
+ * precise_tm structs.
+ * \details         A 64-bit count of nanoseconds covers about 292 years
+ * either way. For times further apart, use precise_tm_diff().
+ * \param first     The first precise_tm.
+ * \param second    The second precise_tm.
+ * \returns         `second` minus `first` in nanoseconds, so the result is
+ * positive if `first` is earlier. If the difference does not fit,
+ * INT64_MAX or INT64_MIN is returned.
+ */
+
+int64_t
+precise_tm_nsecs_diff(const struct precise_tm *first,
+                      const struct precise_tm *second) {
+    const uint64_t start =
+        PGTIME_PROBE_BEGIN(PGTIME_PROBE_PRECISE_TM_NSECS_DIFF);
+    const int64_t diff = nsecs_diff(first, second);
+    PGTIME_PROBE_END(PGTIME_PROBE_PRECISE_TM_NSECS_DIFF, start);
+    return diff;
+}
+
+
+/*!
+ * \brief       Packs a precise_tm into a packed_precise_tm.
+ * \details     The date and time are packed as for pack_tm(), with the
+ * same requirements, and the nanoseconds must be in their normal range.
+ * \param src   The precise_tm to pack.
+ * \returns     The packed date and time.
+ */
+
+struct packed_precise_tm
+pack_precise_tm(const struct precise_tm *src) {
+    const packed_tm packed = pack_tm(&src->tm);
+    const struct packed_precise_tm result = {
+        (uint32_t) (packed >> 32),
+        (uint32_t) packed,
+        (uint32_t) src->nanoseconds
+    };
+    return result;
+}
+
+
+/*!
+ * \brief           Unpacks a packed_precise_tm into a precise_tm.
+ * \details         The date and time are unpacked as for unpack_tm().
+ * \param packed    The packed date and time.
+ * \param result    A pointer to a precise_tm to receive the unpacked time.
+ * \returns         `result`.
+ */
+
+struct precise_tm *
+unpack_precise_tm(const struct packed_precise_tm packed,
+                  struct precise_tm *result) {
+    unpack_tm((packed_tm) packed.high << 32 | packed.low, &result->tm);
+    result->nanoseconds = (long) packed.nanoseconds;
+    return result;
+}
+
+
+/*!
+ * \brief           Compares two packed_precise_tm values.
+ * \details         This gives the same result as precise_tm_compare() on
+ * the unpacked values.
+ * \param first     The first packed_precise_tm.
+ * \param second    The second packed_precise_tm.
+ * \returns         -1 if `first` is earlier than `second`, 1 if `first` is
+ * later than `second`, and 0 if `first` is equal to `second`.
+ */
+
+int
+packed_precise_tm_compare(const struct packed_precise_tm first,
+                          const struct packed_precise_tm second) {
+    const packed_tm first_tm = (packed_tm) first.high << 32 | first.low;
+    const packed_tm second_tm = (packed_tm) second.high << 32 | second.low;
+
+    if ( first_tm != second_tm ) {
+        return first_tm > second_tm ? 1 : -1;
+    }
+    return (first.nanoseconds > second.nanoseconds) -
+           (first.nanoseconds < second.nanoseconds);
+}
+
+
+/*!
+ * \brief               Does the work of precise_tm_add().
+ * \param changing      A pointer to the precise_tm to change.
+ * \param seconds       The number of seconds to add, negative to subtract.
+ * \param nanoseconds   The number of nanoseconds to add, negative to
+ * subtract. This may be a second or more.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing` is unchanged.
+ */
+
+static struct precise_tm *
+add_precise(struct precise_tm *changing, const int64_t seconds,
+            const int64_t nanoseconds) {
+    int64_t added_carry;
+    int64_t own_carry;
+    int64_t fraction = split_nanoseconds(nanoseconds, &added_carry) +
+                       split_nanoseconds(changing->nanoseconds, &own_carry);
+
+    //  Each carry is at most about 9.2 billion, so their sum cannot
+    //  overflow, but adding it to the seconds can.
+
+    int64_t carry = added_carry + own_carry;
+    if ( fraction >= NSECS_IN_SEC ) {
+        fraction -= NSECS_IN_SEC;
+        ++carry;
+    }
+    if ( (carry > 0 && seconds > INT64_MAX - carry) ||
+         (carry < 0 && seconds < INT64_MIN - carry) ) {
+        return 0;
+    }
+
+    if ( !tm_add_seconds(&changing->tm, seconds + carry) ) {
+        return 0;
+    }
+    changing->nanoseconds = (long) fraction;
+    return changing;
+}
+
+
+/*!
+ * \brief               Adds a signed number of seconds and nanoseconds to
+ * a precise_tm.
+ * \details             The nanoseconds of the argument and of `changing`
+ * are carried into the seconds first, and the total is passed to
+ * tm_add_seconds() in a single call, so every field is normalized in one
+ * pass. Neither the nanoseconds of `changing` nor the members of its
+ * struct tm need be in their normal ranges.
+ * \param changing      A pointer to the precise_tm to change.
+ * \param seconds       The number of seconds to add, negative to subtract.
+ * \param nanoseconds   The number of nanoseconds to add, negative to
+ * subtract. This may be a second or more.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented in a struct tm, in which
+ * case `changing` is unchanged.
+ */
+
+struct precise_tm *
+precise_tm_add(struct precise_tm *changing, const int64_t seconds,
+               const int64_t nanoseconds) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_PRECISE_TM_ADD);
+    struct precise_tm *const result = add_precise(changing, seconds,
+                                                  nanoseconds);
+    PGTIME_PROBE_END(PGTIME_PROBE_PRECISE_TM_ADD, start);
+    return result;
+}
+
+
+/*!
+ * \brief               Adds one or more milliseconds to a precise_tm.
+ * \param changing      A pointer to the precise_tm to increment.
+ * \param quantity      The number of milliseconds to add.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_increment_millisecond(struct precise_tm *changing,
+                                 const int64_t quantity) {
+    return precise_tm_add(changing, quantity / 1000,
+                          quantity % 1000 * NSECS_IN_MSEC);
+}
+
+
+/*!
+ * \brief               Adds one or more microseconds to a precise_tm.
+ * \param changing      A pointer to the precise_tm to increment.
+ * \param quantity      The number of microseconds to add.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_increment_microsecond(struct precise_tm *changing,
+                                 const int64_t quantity) {
+    return precise_tm_add(changing, quantity / 1000000,
+                          quantity % 1000000 * NSECS_IN_USEC);
+}
+
+
+/*!
+ * \brief               Adds one or more nanoseconds to a precise_tm.
+ * \param changing      A pointer to the precise_tm to increment.
+ * \param quantity      The number of nanoseconds to add.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_increment_nanosecond(struct precise_tm *changing,
+                                const int64_t quantity) {
+    return precise_tm_add(changing, 0, quantity);
+}
+
+
+/*!
+ * \brief               Deducts one or more milliseconds from a
+ * precise_tm.
+ * \param changing      A pointer to the precise_tm to decrement.
+ * \param quantity      The number of milliseconds to deduct.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_decrement_millisecond(struct precise_tm *changing,
+                                 const int64_t quantity) {
+    return precise_tm_add(changing, -(quantity / 1000),
+                          -(quantity % 1000 * NSECS_IN_MSEC));
+}
+
+
+/*!
+ * \brief               Deducts one or more microseconds from a
+ * precise_tm.
+ * \param changing      A pointer to the precise_tm to decrement.
+ * \param quantity      The number of microseconds to deduct.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_decrement_microsecond(struct precise_tm *changing,
+                                 const int64_t quantity) {
+    return precise_tm_add(changing, -(quantity / 1000000),
+                          -(quantity % 1000000 * NSECS_IN_USEC));
+}
+
+
+/*!
+ * \brief               Deducts one or more nanoseconds from a precise_tm.
+ * \param changing      A pointer to the precise_tm to decrement.
+ * \param quantity      The number of nanoseconds to deduct.
+ * \returns             A pointer to the same precise_tm, or a null pointer
+ * if the resulting year cannot be represented, as for precise_tm_add().
+ */
+
+struct precise_tm *
+precise_tm_decrement_nanosecond(struct precise_tm *changing,
+                                const int64_t quantity) {
+
+    //  Negating INT64_MIN would overflow, so split off the seconds first.
+
+    return precise_tm_add(changing, -(quantity / NSECS_IN_SEC),
+                          -(quantity % NSECS_IN_SEC));
+}
+
+
+/*!
+ * \brief           Gets a timespec for a UTC precise_tm.
+ * \details         The seconds are found as for get_utc_timestamp(), and
+ * the nanoseconds, which must be in their normal range, are copied.
+ * \param utc_tm    A pointer to a precise_tm containing the UTC time.
+ * \param result    Modified to contain the timespec.
+ * \returns         `result`, or a null pointer if the timestamp cannot be
+ * found, in which case `result` is unchanged.
+ */
+
+struct timespec *
+get_utc_timespec(const struct precise_tm *utc_tm, struct timespec *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_TIMESPEC);
+    time_t utc_ts;
+    struct timespec *converted = 0;
+
+    if ( pgtime_utc_timestamp(&utc_tm->tm, &utc_ts) == PGTIME_OK ) {
+        result->tv_sec = utc_ts;
+        result->tv_nsec = utc_tm->nanoseconds;
+        converted = result;
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_TIMESPEC, start);
+    return converted;
+}
+
+
+/*!
+ * \brief           Gets a UTC precise_tm for a timespec.
+ * \details         `tv_nsec` need not be in its normal range, and is
+ * carried into the seconds before they are broken down with get_utc_tm().
+ * \param utc_ts    The timespec, counting from the epoch.
+ * \param result    Modified to contain the UTC time.
+ * \returns         `result`, or a null pointer if the time cannot be
+ * represented in a struct tm.
+ */
+
+struct precise_tm *
+get_utc_precise_tm(const struct timespec *utc_ts, struct precise_tm *result) {
+    int64_t carry;
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_GET_UTC_PRECISE_TM);
+    const int64_t fraction = split_nanoseconds(utc_ts->tv_nsec, &carry);
+    const int64_t seconds = utc_ts->tv_sec;
+    struct precise_tm *utc_tm = 0;
+
+    //  The carry can take the seconds past the limits, as in
+    //  add_precise().
+
+    if ( !(carry > 0 && seconds > INT64_MAX - carry) &&
+         !(carry < 0 && seconds < INT64_MIN - carry) &&
+         get_utc_tm((time_t) (seconds + carry), &result->tm) ) {
+        result->nanoseconds = (long) fraction;
+        utc_tm = result;
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_GET_UTC_PRECISE_TM, start);
+    return utc_tm;
+}
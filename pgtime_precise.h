@@ -0,0 +1,93 @@
+/*!
+ * \file        pgtime_precise.h
+ * \brief       Interface to date and time functions with nanosecond
+ * precision.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_PRECISE_H
+#define PG_PGTIME_PRECISE_H
+
+#include <time.h>
+#include <stdint.h>
+#include "pgtime.h"
+
+
+/*!
+ * \brief       A broken-down time with nanoseconds.
+ * \details     `tm` holds the date and time to the second, as for the
+ * rest of the library, and `nanoseconds` the fraction of a second.
+ */
+
+struct precise_tm {
+    struct tm tm;           /*!<  Date and time to the second  */
+    long nanoseconds;       /*!<  Fraction of a second, 0 to 999999999  */
+};
+
+
+/*!
+ * \brief       A precise_tm packed into 12 bytes.
+ * \details     Created with pack_precise_tm(). The first two members hold
+ * a packed_tm, most significant half first, so packed values sort in
+ * chronological order when compared member by member, as
+ * packed_precise_tm_compare() does. Every member is 32 bits, so arrays
+ * need no padding.
+ */
+
+struct packed_precise_tm {
+    uint32_t high;          /*!<  High 32 bits of the packed_tm  */
+    uint32_t low;           /*!<  Low 32 bits of the packed_tm  */
+    uint32_t nanoseconds;   /*!<  Fraction of a second  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int precise_tm_compare(const struct precise_tm *first,
+                       const struct precise_tm *second);
+struct timespec *precise_tm_diff(const struct precise_tm *first,
+                                 const struct precise_tm *second,
+                                 struct timespec *result);
+int64_t precise_tm_nsecs_diff(const struct precise_tm *first,
+                              const struct precise_tm *second);
+
+struct packed_precise_tm pack_precise_tm(const struct precise_tm *src);
+struct precise_tm *unpack_precise_tm(const struct packed_precise_tm packed,
+                                     struct precise_tm *result);
+int packed_precise_tm_compare(const struct packed_precise_tm first,
+                              const struct packed_precise_tm second);
+
+struct precise_tm *precise_tm_add(struct precise_tm *changing,
+                                  const int64_t seconds,
+                                  const int64_t nanoseconds);
+struct precise_tm *precise_tm_increment_millisecond(
+    struct precise_tm *changing, const int64_t quantity);
+struct precise_tm *precise_tm_increment_microsecond(
+    struct precise_tm *changing, const int64_t quantity);
+struct precise_tm *precise_tm_increment_nanosecond(
+    struct precise_tm *changing, const int64_t quantity);
+struct precise_tm *precise_tm_decrement_millisecond(
+    struct precise_tm *changing, const int64_t quantity);
+struct precise_tm *precise_tm_decrement_microsecond(
+    struct precise_tm *changing, const int64_t quantity);
+struct precise_tm *precise_tm_decrement_nanosecond(
+    struct precise_tm *changing, const int64_t quantity);
+
+struct timespec *get_utc_timespec(const struct precise_tm *utc_tm,
+                                  struct timespec *result);
+struct precise_tm *get_utc_precise_tm(const struct timespec *utc_ts,
+                                      struct precise_tm *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_PRECISE_H  */
@@ -0,0 +1,330 @@
+/*!
+ * \file        pgtime_stats.c
+ * \brief       Implementation of instrumentation counters and latency
+ * histograms.
+ * \details     Each thread keeps its own counters, registered in a list
+ * the first time the thread is instrumented, so that counting never takes
+ * a lock or contends for a cache line. A snapshot sums the counters over
+ * the list. Resetting does not write to other threads' counters, which
+ * could lose their updates, but records each thread's current values as a
+ * baseline to subtract in later snapshots. When a thread exits, its counts
+ * since the baseline are added to a running total of retired counts, and
+ * its counters are freed.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgtime_stats.h"
+#include "pgtime_internal.h"
+
+#if defined(PGTIME_INSTRUMENT) && !defined(__STDC_NO_THREADS__)
+#include <threads.h>
+#endif
+
+
+/*  Names of the counters and probes, for exporting  */
+
+static const char *counter_names[PGTIME_NUM_COUNTERS] = {
+    "mktime", "gmtime", "timestamp_probe", "leap_probe", "leap_second",
+    "table_hit", "table_miss", "invalid_date", "overflow"
+};
+
+static const char *probe_names[PGTIME_NUM_PROBES] = {
+    "get_utc_timestamp", "get_utc_tm", "tm_add_seconds", "tm_add_months",
+    "check_utc_timestamp", "get_utc_timestamp_sec_diff", "utc_to_tai",
+    "tai_to_utc", "parse_iso8601", "format_iso8601", "get_utc_timestamps",
+    "tm_secs_diffs", "get_utc_tms", "bucket_count", "tz_local_tm",
+    "tz_utc_offset", "tz_utc_timestamp", "coarse_clock_tick",
+    "coarse_clock_now", "coarse_clock_time", "precise_tm_add",
+    "precise_tm_diff", "precise_tm_nsecs_diff", "get_utc_precise_tm",
+    "get_utc_timespec"
+};
+
+
+#ifdef PGTIME_INSTRUMENT
+
+/*!
+ * \brief       The counters of one thread, with their baseline.
+ */
+
+struct registered_stats {
+    struct pgtime_thread_stats stats;   /*!<  The thread's counters  */
+    struct pgtime_stats baseline;       /*!<  Values at the last reset  */
+    struct registered_stats *next;      /*!<  Next in the list  */
+};
+
+
+/*  Counters shared by any thread which could not register its own, which
+ *  are always at the end of the list, and the counts of exited threads
+ *  since the last reset  */
+
+static struct registered_stats shared_stats;
+static struct registered_stats *registry = &shared_stats;
+static struct pgtime_stats retired_stats;
+
+#ifndef __STDC_NO_THREADS__
+
+_Thread_local struct pgtime_thread_stats *pgtime_local_stats;
+
+static once_flag registry_once = ONCE_FLAG_INIT;
+static bool registry_ready;
+static mtx_t registry_mutex;
+static tss_t registry_key;
+
+#else
+
+struct pgtime_thread_stats *pgtime_local_stats;
+
+#endif
+
+
+/*!
+ * \brief           Adds the counts since the baseline to a total.
+ * \param total     The total to add to.
+ * \param current   The current values.
+ * \param baseline  The values at the last reset, which are set to the
+ * current values if `reset` is `true`.
+ * \param count     The number of values.
+ * \param reset     Whether to reset the baseline.
+ */
+
+static void
+fold_counts(uint64_t *total, _Atomic uint64_t *current, uint64_t *baseline,
+            const size_t count, const bool reset) {
+    for ( size_t i = 0; i < count; ++i ) {
+        const uint64_t value = atomic_load_explicit(&current[i],
+                                                    memory_order_relaxed);
+        total[i] += value - baseline[i];
+        if ( reset ) {
+            baseline[i] = value;
+        }
+    }
+}
+
+
+/*!
+ * \brief           Adds the counts of one thread since its baseline to a
+ * total.
+ * \param total     The total to add to.
+ * \param entry     The thread's counters.
+ * \param reset     Whether to reset the baseline to the current values.
+ */
+
+static void
+fold_entry(struct pgtime_stats *total, struct registered_stats *entry,
+           const bool reset) {
+    fold_counts(total->counters, entry->stats.counters,
+                entry->baseline.counters, PGTIME_NUM_COUNTERS, reset);
+    fold_counts(total->calls, entry->stats.calls, entry->baseline.calls,
+                PGTIME_NUM_PROBES, reset);
+    fold_counts(&total->histograms[0][0], &entry->stats.histograms[0][0],
+                &entry->baseline.histograms[0][0],
+                PGTIME_NUM_PROBES * PGTIME_HISTOGRAM_BUCKETS, reset);
+}
+
+#ifndef __STDC_NO_THREADS__
+
+
+/*!
+ * \brief       Retires the counters of an exiting thread.
+ * \details     Called by tss on thread exit.
+ * \param arg   The thread's struct registered_stats.
+ */
+
+static void
+retire_stats(void *arg) {
+    struct registered_stats *entry = arg;
+
+    mtx_lock(&registry_mutex);
+    fold_entry(&retired_stats, entry, false);
+    for ( struct registered_stats **link = &registry; *link;
+          link = &(*link)->next ) {
+        if ( *link == entry ) {
+            *link = entry->next;
+            break;
+        }
+    }
+    mtx_unlock(&registry_mutex);
+
+    pgtime_local_stats = 0;
+    free(entry);
+}
+
+
+/*!
+ * \brief       Sets up the registry lock and the thread exit hook.
+ */
+
+static void
+init_registry(void) {
+    if ( mtx_init(&registry_mutex, mtx_plain) != thrd_success ) {
+        return;
+    }
+    if ( tss_create(&registry_key, retire_stats) != thrd_success ) {
+        mtx_destroy(&registry_mutex);
+        return;
+    }
+    registry_ready = true;
+}
+
+#endif          /*  __STDC_NO_THREADS__  */
+
+
+/*!
+ * \brief       Registers counters for the calling thread.
+ * \details     Called the first time a thread is instrumented. If the
+ * counters cannot be allocated, the thread uses the shared counters
+ * instead, which may undercount if several threads end up sharing them.
+ * \returns     A pointer to the thread's counters.
+ */
+
+struct pgtime_thread_stats *
+pgtime_stats_register(void) {
+#ifndef __STDC_NO_THREADS__
+    call_once(&registry_once, init_registry);
+
+    struct registered_stats *entry = registry_ready ?
+                                     calloc(1, sizeof *entry) : 0;
+    if ( entry ) {
+        if ( tss_set(registry_key, entry) == thrd_success ) {
+            mtx_lock(&registry_mutex);
+            entry->next = registry;
+            registry = entry;
+            mtx_unlock(&registry_mutex);
+
+            pgtime_local_stats = &entry->stats;
+            return pgtime_local_stats;
+        }
+        free(entry);
+    }
+#endif
+
+    pgtime_local_stats = &shared_stats.stats;
+    return pgtime_local_stats;
+}
+
+
+/*!
+ * \brief           Records the time taken by a sampled call.
+ * \param probe     The entry point.
+ * \param start     The time the call started, from pgtime_ticks().
+ */
+
+void
+pgtime_stats_record(const enum pgtime_probe probe, const uint64_t start) {
+    const uint64_t ticks = pgtime_ticks() - start;
+    int bucket = 0;
+
+    while ( bucket < PGTIME_HISTOGRAM_BUCKETS - 1 && ticks >> bucket ) {
+        ++bucket;
+    }
+
+    pgtime_stats_add(&pgtime_thread_stats()->histograms[probe][bucket]);
+}
+
+#endif          /*  PGTIME_INSTRUMENT  */
+
+
+/*!
+ * \brief       Checks whether the library was built with instrumentation.
+ * \returns     `true` if `PGTIME_INSTRUMENT` was defined, `false`
+ * otherwise.
+ */
+
+bool
+pgtime_stats_enabled(void) {
+#ifdef PGTIME_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/*!
+ * \brief           Takes a snapshot of the counters and histograms.
+ * \details         The counts are summed over all threads, including
+ * threads which have exited, since the last reset. Threads may go on
+ * counting while the snapshot is taken, so the counts are only consistent
+ * with each other to within the calls in progress. This function is safe
+ * to call from any thread, and is cheap enough to call once a second to
+ * export the counts.
+ * \param result    A pointer to a struct pgtime_stats to receive the
+ * snapshot. All zeros if the library was built without instrumentation.
+ * \param reset     `true` to reset the counts to zero after taking the
+ * snapshot, so that the next snapshot counts from now.
+ */
+
+void
+pgtime_stats_snapshot(struct pgtime_stats *result, const bool reset) {
+    memset(result, 0, sizeof *result);
+
+#ifdef PGTIME_INSTRUMENT
+    result->sample_interval = PGTIME_INSTRUMENT_SAMPLE;
+
+#ifndef __STDC_NO_THREADS__
+    call_once(&registry_once, init_registry);
+    if ( registry_ready ) {
+        mtx_lock(&registry_mutex);
+    }
+#endif
+
+    for ( size_t i = 0; i < PGTIME_NUM_COUNTERS; ++i ) {
+        result->counters[i] = retired_stats.counters[i];
+    }
+    for ( size_t i = 0; i < PGTIME_NUM_PROBES; ++i ) {
+        result->calls[i] = retired_stats.calls[i];
+        for ( size_t b = 0; b < PGTIME_HISTOGRAM_BUCKETS; ++b ) {
+            result->histograms[i][b] = retired_stats.histograms[i][b];
+        }
+    }
+    if ( reset ) {
+        memset(&retired_stats, 0, sizeof retired_stats);
+    }
+
+    for ( struct registered_stats *entry = registry; entry;
+          entry = entry->next ) {
+        fold_entry(result, entry, reset);
+    }
+
+#ifndef __STDC_NO_THREADS__
+    if ( registry_ready ) {
+        mtx_unlock(&registry_mutex);
+    }
+#endif
+#else
+    (void) reset;
+#endif
+}
+
+
+/*!
+ * \brief           Returns the name of a counter.
+ * \param counter   The counter.
+ * \returns         A short name in lower case, suitable as a metric name.
+ */
+
+const char *
+pgtime_counter_name(const enum pgtime_counter counter) {
+    return counter < PGTIME_NUM_COUNTERS ? counter_names[counter] :
+                                           "unknown";
+}
+
+
+/*!
+ * \brief           Returns the name of an entry point.
+ * \param probe     The entry point.
+ * \returns         The name of the function, suitable as a metric name.
+ */
+
+const char *
+pgtime_probe_name(const enum pgtime_probe probe) {
+    return probe < PGTIME_NUM_PROBES ? probe_names[probe] : "unknown";
+}
@@ -0,0 +1,141 @@
+/*!
+ * \file        pgtime_stats.h
+ * \brief       Interface to instrumentation counters and latency
+ * histograms.
+ * \details     The counters and histograms are only kept when the library
+ * is built with `PGTIME_INSTRUMENT` defined, for instance with `make
+ * instrument`. Otherwise the instrumentation compiles to nothing, and
+ * these functions report all zeros.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_STATS_H
+#define PG_PGTIME_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*!
+ * \brief       Events counted by the instrumentation, mostly fallbacks to
+ * slower paths.
+ */
+
+enum pgtime_counter {
+    PGTIME_COUNTER_MKTIME,          /*!<  Calls to mktime()  */
+    PGTIME_COUNTER_GMTIME,          /*!<  Calls to gmtime()  */
+    PGTIME_COUNTER_TIMESTAMP_PROBE, /*!<  Extra timestamps tried by
+                                          get_utc_timestamp()  */
+    PGTIME_COUNTER_LEAP_PROBE,      /*!<  Leap second checks made by
+                                          get_utc_timestamp()  */
+    PGTIME_COUNTER_LEAP_SECOND,     /*!<  Leap seconds converted by
+                                          tai_to_utc()  */
+    PGTIME_COUNTER_TABLE_HIT,       /*!<  Dates found in the date table  */
+    PGTIME_COUNTER_TABLE_MISS,      /*!<  Dates outside the date table  */
+    PGTIME_COUNTER_INVALID_DATE,    /*!<  Dates rejected by the checked
+                                          interface  */
+    PGTIME_COUNTER_OVERFLOW,        /*!<  Results whose year did not fit
+                                          in a struct tm  */
+    PGTIME_NUM_COUNTERS
+};
+
+
+/*!
+ * \brief       Entry points whose calls are counted and timed.
+ * \details     The increment and decrement functions, for struct tm and
+ * struct precise_tm, are counted under the add function which does their
+ * work, and the GPS conversions under the TAI conversions they call. The
+ * checked and unchecked forms of an entry point, the row and column forms
+ * of a batch conversion, and the variants of bucket_count() share one
+ * probe, and every other entry point has its own. A call is counted under
+ * every probed function it makes, so a scalar batch conversion also
+ * counts each element under get_utc_timestamp() or get_utc_tm().
+ * Comparisons, packing, time zone loading and the clock's start, stop and
+ * resolution functions are cheap or rare, and are not probed.
+ */
+
+enum pgtime_probe {
+    PGTIME_PROBE_GET_UTC_TIMESTAMP, /*!<  get_utc_timestamp(), checked or
+                                          not  */
+    PGTIME_PROBE_GET_UTC_TM,        /*!<  get_utc_tm()  */
+    PGTIME_PROBE_TM_ADD_SECONDS,    /*!<  Adding days, hours, minutes or
+                                          seconds  */
+    PGTIME_PROBE_TM_ADD_MONTHS,     /*!<  Adding months or years  */
+    PGTIME_PROBE_CHECK_TIMESTAMP,   /*!<  check_utc_timestamp() and its
+                                          variants  */
+    PGTIME_PROBE_SEC_DIFF,          /*!<  get_utc_timestamp_sec_diff() and
+                                          its variants  */
+    PGTIME_PROBE_UTC_TO_TAI,        /*!<  utc_to_tai() and utc_to_gps()  */
+    PGTIME_PROBE_TAI_TO_UTC,        /*!<  tai_to_utc() and gps_to_utc()  */
+    PGTIME_PROBE_PARSE_ISO8601,     /*!<  parse_iso8601() and
+                                          parse_iso8601_timestamp()  */
+    PGTIME_PROBE_FORMAT_ISO8601,    /*!<  format_iso8601() and
+                                          format_iso8601_timestamp()  */
+    PGTIME_PROBE_GET_UTC_TIMESTAMPS, /*!< get_utc_timestamps() and
+                                          get_utc_timestamps_columns()  */
+    PGTIME_PROBE_TM_SECS_DIFFS,     /*!<  tm_secs_diffs()  */
+    PGTIME_PROBE_GET_UTC_TMS,       /*!<  get_utc_tms() and
+                                          get_utc_tms_columns()  */
+    PGTIME_PROBE_BUCKET_COUNT,      /*!<  bucket_count() and its
+                                          variants  */
+    PGTIME_PROBE_TZ_LOCAL_TM,       /*!<  tz_local_tm()  */
+    PGTIME_PROBE_TZ_UTC_OFFSET,     /*!<  tz_utc_offset()  */
+    PGTIME_PROBE_TZ_UTC_TIMESTAMP,  /*!<  tz_utc_timestamp()  */
+    PGTIME_PROBE_COARSE_CLOCK_TICK, /*!<  coarse_clock_tick(), including
+                                          ticks by the updater thread  */
+    PGTIME_PROBE_COARSE_CLOCK_NOW,  /*!<  coarse_clock_now()  */
+    PGTIME_PROBE_COARSE_CLOCK_TIME, /*!<  coarse_clock_time()  */
+    PGTIME_PROBE_PRECISE_TM_ADD,    /*!<  Adding to a struct precise_tm  */
+    PGTIME_PROBE_PRECISE_TM_DIFF,   /*!<  precise_tm_diff()  */
+    PGTIME_PROBE_PRECISE_TM_NSECS_DIFF, /*!< precise_tm_nsecs_diff()  */
+    PGTIME_PROBE_GET_UTC_PRECISE_TM, /*!< get_utc_precise_tm()  */
+    PGTIME_PROBE_GET_UTC_TIMESPEC,  /*!<  get_utc_timespec()  */
+    PGTIME_NUM_PROBES
+};
+
+
+/*  Number of buckets in each latency histogram  */
+
+#define PGTIME_HISTOGRAM_BUCKETS 32
+
+
+/*!
+ * \brief       A snapshot of the counters and histograms, summed over all
+ * threads.
+ * \details     Bucket `b` of a histogram counts sampled calls which took
+ * from 2^(b-1) up to 2^b ticks, with bucket 0 for calls under one tick
+ * and the last bucket also counting anything longer. A tick is a cycle of
+ * the time stamp counter on x86-64, and a nanosecond elsewhere. Only one
+ * call in every `sample_interval` is timed, but every call is counted.
+ */
+
+struct pgtime_stats {
+    uint64_t counters[PGTIME_NUM_COUNTERS];     /*!<  Event counts  */
+    uint64_t calls[PGTIME_NUM_PROBES];          /*!<  Calls to each entry
+                                                      point  */
+    uint64_t histograms[PGTIME_NUM_PROBES][PGTIME_HISTOGRAM_BUCKETS];
+                                                /*!<  Sampled latencies  */
+    uint64_t sample_interval;                   /*!<  Calls per sample  */
+};
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool pgtime_stats_enabled(void);
+void pgtime_stats_snapshot(struct pgtime_stats *result, const bool reset);
+const char *pgtime_counter_name(const enum pgtime_counter counter);
+const char *pgtime_probe_name(const enum pgtime_probe probe);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_STATS_H  */
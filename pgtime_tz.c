@@ -0,0 +1,900 @@
+/*!
+ * \file        pgtime_tz.c
+ * \brief       Implementation of time zone conversions using TZif files.
+ * \details     A TZif file (RFC 8536) is mapped into memory once, and its
+ * transitions are copied into a compact table sorted by UTC time, with a
+ * separate small table of the UTC offsets they switch to. Times after the
+ * last transition use the POSIX TZ rule from the footer of the file. The
+ * conversions only read the table, so they need no locks, and they never
+ * call localtime() or mktime(). The TZif format counts POSIX seconds, so
+ * this module assumes that time_t does too.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pgtime.h"
+#include "pgtime_tz.h"
+#include "pgtime_internal.h"
+
+
+/*  Where to find time zone files  */
+
+#define TZ_DEFAULT_DIR "/usr/share/zoneinfo"
+#define TZ_LOCALTIME_FILE "/etc/localtime"
+#define TZ_MAX_PATH 1024
+
+/*  Length of a TZif header, and of each local time type record  */
+
+#define TZIF_HEADER_LEN 44
+#define TZIF_TYPE_LEN 6
+
+/*  The most local time types a TZif file can have  */
+
+#define TZIF_MAX_TYPES 256
+
+/*  Seconds in a day, and the largest magnitude of time_t handled, which
+ *  leaves room to add a UTC offset without overflow  */
+
+#define SECS_IN_DAY 86400
+#define TZ_MAX_TIMESTAMP (INT64_C(1) << 56)
+
+
+/*!
+ * \brief       A local time type.
+ */
+
+struct tz_type {
+    int32_t utc_offset;     /*!<  Seconds east of UTC  */
+    int32_t is_dst;         /*!<  Nonzero for daylight saving time  */
+};
+
+/*!
+ * \brief       The forms of date in a POSIX TZ rule.
+ */
+
+enum tz_date_kind {
+    TZ_DATE_JULIAN,         /*!<  `Jn`, 1 to 365, never counting Feb 29  */
+    TZ_DATE_DAY_OF_YEAR,    /*!<  `n`, 0 to 365, counting Feb 29  */
+    TZ_DATE_MONTH_WEEK_DAY  /*!<  `Mm.w.d`, day d of week w of month m  */
+};
+
+/*!
+ * \brief       The date and time of a change in a POSIX TZ rule.
+ */
+
+struct tz_rule_date {
+    enum tz_date_kind kind;     /*!<  The form of the date  */
+    int day;                    /*!<  Day of the year, or of the week  */
+    int week;                   /*!<  Week of the month, 1 to 5  */
+    int month;                  /*!<  Month, 1 to 12  */
+    int32_t time;               /*!<  Local time of the change, in seconds
+                                      after midnight, -167 to 167 hours  */
+};
+
+/*!
+ * \brief       A POSIX TZ rule, such as `EST5EDT,M3.2.0,M11.1.0`.
+ */
+
+struct tz_rule {
+    struct tz_type std;         /*!<  Standard time  */
+    struct tz_type dst;         /*!<  Daylight saving time  */
+    bool has_dst;               /*!<  `false` if there is no DST  */
+    struct tz_rule_date start;  /*!<  Start of DST, in standard time  */
+    struct tz_rule_date end;    /*!<  End of DST, in DST  */
+};
+
+/*!
+ * \brief       A loaded time zone.
+ * \details     The structure and its tables are allocated as one block.
+ */
+
+struct time_zone {
+    size_t num_transitions;             /*!<  Number of transitions  */
+    const int64_t *transitions;         /*!<  UTC times, ascending  */
+    const uint8_t *transition_types;    /*!<  Type after each transition  */
+    const struct tz_type *types;        /*!<  Local time types  */
+    bool has_rule;                      /*!<  `true` if there is a rule  */
+    struct tz_rule rule;                /*!<  Rule after the last
+                                              transition  */
+};
+
+/*!
+ * \brief       The counts from a TZif header.
+ */
+
+struct tzif_header {
+    int version;            /*!<  0 for version 1, or '2', '3', '4'  */
+    uint32_t isutcnt;       /*!<  Number of UT/local indicators  */
+    uint32_t isstdcnt;      /*!<  Number of standard/wall indicators  */
+    uint32_t leapcnt;       /*!<  Number of leap second records  */
+    uint32_t timecnt;       /*!<  Number of transitions  */
+    uint32_t typecnt;       /*!<  Number of local time types  */
+    uint32_t charcnt;       /*!<  Length of the abbreviation strings  */
+};
+
+
+/*!
+ * \brief           Reads a big-endian 32-bit integer.
+ * \param data      The bytes to read.
+ * \returns         The integer.
+ */
+
+static uint32_t
+read_be32(const unsigned char *data) {
+    return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 |
+           (uint32_t) data[2] << 8 | (uint32_t) data[3];
+}
+
+
+/*!
+ * \brief           Reads a big-endian 64-bit integer.
+ * \param data      The bytes to read.
+ * \returns         The integer.
+ */
+
+static uint64_t
+read_be64(const unsigned char *data) {
+    return (uint64_t) read_be32(data) << 32 | read_be32(data + 4);
+}
+
+
+/*!
+ * \brief           Reads a TZif header.
+ * \param data      The start of the header.
+ * \param len       The number of bytes available from `data`.
+ * \param header    Modified to contain the header.
+ * \returns         `true` if the header is valid and every count could fit
+ * in the bytes available, `false` otherwise.
+ */
+
+static bool
+read_header(const unsigned char *data, const size_t len,
+            struct tzif_header *header) {
+    if ( len < TZIF_HEADER_LEN || memcmp(data, "TZif", 4) ) {
+        return false;
+    }
+
+    header->version = data[4];
+    header->isutcnt = read_be32(data + 20);
+    header->isstdcnt = read_be32(data + 24);
+    header->leapcnt = read_be32(data + 28);
+    header->timecnt = read_be32(data + 32);
+    header->typecnt = read_be32(data + 36);
+    header->charcnt = read_be32(data + 40);
+
+    return header->isutcnt <= len && header->isstdcnt <= len &&
+           header->leapcnt <= len && header->timecnt <= len &&
+           header->typecnt <= len && header->charcnt <= len;
+}
+
+
+/*!
+ * \brief           Returns the length of a TZif data block.
+ * \param header    The header of the block.
+ * \param time_size The size of a transition time, 4 or 8.
+ * \returns         The length of the data block in bytes.
+ */
+
+static size_t
+data_block_len(const struct tzif_header *header, const size_t time_size) {
+    return (size_t) header->timecnt * (time_size + 1) +
+           (size_t) header->typecnt * TZIF_TYPE_LEN + header->charcnt +
+           (size_t) header->leapcnt * (time_size + 4) +
+           header->isstdcnt + header->isutcnt;
+}
+
+
+/*!
+ * \brief           Parses an unsigned decimal number.
+ * \param str       The string to parse.
+ * \param end       The end of the string.
+ * \param max       The largest value accepted.
+ * \param value     Modified to contain the number.
+ * \returns         A pointer to the character after the number, or a null
+ * pointer if there is no number or it is larger than `max`.
+ */
+
+static const char *
+parse_number(const char *str, const char *end, const int max, int *value) {
+    const char *p = str;
+    int n = 0;
+
+    while ( p < end && *p >= '0' && *p <= '9' ) {
+        n = n * 10 + (*p++ - '0');
+        if ( n > max ) {
+            return 0;
+        }
+    }
+
+    *value = n;
+    return p == str ? 0 : p;
+}
+
+
+/*!
+ * \brief           Parses a time zone abbreviation in a POSIX TZ rule.
+ * \details         The abbreviation is either at least three letters, or
+ * any letters, digits, `+` and `-` between `<` and `>`.
+ * \param str       The string to parse.
+ * \param end       The end of the string.
+ * \returns         A pointer to the character after the abbreviation, or a
+ * null pointer if there is none.
+ */
+
+static const char *
+parse_tz_abbr(const char *str, const char *end) {
+    const char *p = str;
+
+    if ( p < end && *p == '<' ) {
+        while ( ++p < end && *p != '>' ) {
+            if ( !((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') ||
+                   (*p >= '0' && *p <= '9') || *p == '+' || *p == '-') ) {
+                return 0;
+            }
+        }
+        return p < end ? p + 1 : 0;
+    }
+
+    while ( p < end && ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) ) {
+        ++p;
+    }
+
+    return p - str >= 3 ? p : 0;
+}
+
+
+/*!
+ * \brief           Parses a time or offset in a POSIX TZ rule.
+ * \details         The form is `[+|-]hh[:mm[:ss]]`, with hours up to 167
+ * as allowed by RFC 8536.
+ * \param str       The string to parse.
+ * \param end       The end of the string.
+ * \param secs      Modified to contain the time in seconds.
+ * \returns         A pointer to the character after the time, or a null
+ * pointer if there is none.
+ */
+
+static const char *
+parse_tz_time(const char *str, const char *end, int32_t *secs) {
+    const char *p = str;
+    int sign = 1;
+    int hours;
+    int mins = 0;
+    int seconds = 0;
+
+    if ( p < end && (*p == '+' || *p == '-') ) {
+        sign = *p++ == '-' ? -1 : 1;
+    }
+
+    if ( !(p = parse_number(p, end, 167, &hours)) ) {
+        return 0;
+    }
+    if ( p < end && *p == ':' ) {
+        if ( !(p = parse_number(p + 1, end, 59, &mins)) ) {
+            return 0;
+        }
+        if ( p < end && *p == ':' ) {
+            if ( !(p = parse_number(p + 1, end, 59, &seconds)) ) {
+                return 0;
+            }
+        }
+    }
+
+    *secs = sign * (hours * 3600 + mins * 60 + seconds);
+    return p;
+}
+
+
+/*!
+ * \brief           Parses the date and time of a change in a POSIX TZ
+ * rule.
+ * \details         The time defaults to 02:00:00 if it is not given.
+ * \param str       The string to parse.
+ * \param end       The end of the string.
+ * \param date      Modified to contain the date and time.
+ * \returns         A pointer to the character after the date and time, or a
+ * null pointer if there are none.
+ */
+
+static const char *
+parse_tz_date(const char *str, const char *end, struct tz_rule_date *date) {
+    const char *p = str;
+
+    if ( p < end && *p == 'J' ) {
+        date->kind = TZ_DATE_JULIAN;
+        if ( !(p = parse_number(p + 1, end, 365, &date->day)) ||
+             date->day < 1 ) {
+            return 0;
+        }
+    } else if ( p < end && *p == 'M' ) {
+        date->kind = TZ_DATE_MONTH_WEEK_DAY;
+        if ( !(p = parse_number(p + 1, end, 12, &date->month)) ||
+             date->month < 1 || p == end || *p != '.' ||
+             !(p = parse_number(p + 1, end, 5, &date->week)) ||
+             date->week < 1 || p == end || *p != '.' ||
+             !(p = parse_number(p + 1, end, 6, &date->day)) ) {
+            return 0;
+        }
+    } else {
+        date->kind = TZ_DATE_DAY_OF_YEAR;
+        if ( !(p = parse_number(p, end, 365, &date->day)) ) {
+            return 0;
+        }
+    }
+
+    date->time = 7200;
+    if ( p < end && *p == '/' ) {
+        p = parse_tz_time(p + 1, end, &date->time);
+    }
+
+    return p;
+}
+
+
+/*!
+ * \brief           Parses a POSIX TZ rule from the footer of a TZif file.
+ * \details         POSIX offsets are positive west of Greenwich, and are
+ * negated here. If there is DST with no rule for when it starts and ends,
+ * the current United States rule is used, as glibc does.
+ * \param str       The rule to parse.
+ * \param end       The end of the rule.
+ * \param rule      Modified to contain the rule.
+ * \returns         `true` on success, `false` if the rule is invalid.
+ */
+
+static bool
+parse_tz_rule(const char *str, const char *end, struct tz_rule *rule) {
+    static const char default_rule[] = "M3.2.0,M11.1.0";
+    const char *p = str;
+    int32_t offset;
+
+    if ( !(p = parse_tz_abbr(p, end)) ||
+         !(p = parse_tz_time(p, end, &offset)) ) {
+        return false;
+    }
+
+    rule->std.utc_offset = -offset;
+    rule->std.is_dst = 0;
+    rule->has_dst = p < end;
+    if ( !rule->has_dst ) {
+        return true;
+    }
+
+    if ( !(p = parse_tz_abbr(p, end)) ) {
+        return false;
+    }
+
+    rule->dst.utc_offset = rule->std.utc_offset + 3600;
+    rule->dst.is_dst = 1;
+    if ( p < end && *p != ',' ) {
+        if ( !(p = parse_tz_time(p, end, &offset)) ) {
+            return false;
+        }
+        rule->dst.utc_offset = -offset;
+    }
+
+    if ( p == end ) {
+        p = default_rule;
+        end = default_rule + sizeof default_rule - 1;
+    } else if ( *p++ != ',' ) {
+        return false;
+    }
+
+    return (p = parse_tz_date(p, end, &rule->start)) && p < end &&
+           *p == ',' && (p = parse_tz_date(p + 1, end, &rule->end)) &&
+           p == end;
+}
+
+
+/*!
+ * \brief           Builds a time zone from the contents of a TZif file.
+ * \details         Version 1 files are read from their 32-bit data block,
+ * and later versions from their 64-bit data block and footer. Files with
+ * leap second records, such as those under `right/`, count leap seconds
+ * in their transition times and are rejected.
+ * \param data      The contents of the file.
+ * \param len       The length of the file.
+ * \returns         A pointer to the new time zone, or a null pointer if the
+ * file is invalid or memory could not be allocated.
+ */
+
+static struct time_zone *
+parse_tzif(const unsigned char *data, const size_t len) {
+    const unsigned char *const data_end = data + len;
+    struct tzif_header header;
+    size_t time_size = 4;
+
+    if ( !read_header(data, len, &header) ) {
+        return 0;
+    }
+
+    const unsigned char *block = data + TZIF_HEADER_LEN;
+    size_t block_len = data_block_len(&header, time_size);
+
+    if ( header.version >= '2' ) {
+        if ( (size_t) (data_end - block) < block_len ) {
+            return 0;
+        }
+
+        const unsigned char *second_header = block + block_len;
+        if ( !read_header(second_header, data_end - second_header,
+                          &header) ) {
+            return 0;
+        }
+
+        time_size = 8;
+        block = second_header + TZIF_HEADER_LEN;
+        block_len = data_block_len(&header, time_size);
+    }
+
+    if ( (size_t) (data_end - block) < block_len || header.typecnt == 0 ||
+         header.typecnt > TZIF_MAX_TYPES || header.leapcnt != 0 ) {
+        return 0;
+    }
+
+    //  Allocate the structure and its tables as one block, largest
+    //  alignment first.
+
+    const size_t num_transitions = header.timecnt;
+    struct time_zone *tz = malloc(sizeof *tz +
+                                  num_transitions * sizeof(int64_t) +
+                                  header.typecnt * sizeof(struct tz_type) +
+                                  num_transitions);
+    if ( !tz ) {
+        return 0;
+    }
+
+    int64_t *transitions = (int64_t *) (tz + 1);
+    struct tz_type *types = (struct tz_type *) (transitions +
+                                                num_transitions);
+    uint8_t *transition_types = (uint8_t *) (types + header.typecnt);
+
+    const unsigned char *times = block;
+    const unsigned char *indices = times + num_transitions * time_size;
+    const unsigned char *type_records = indices + num_transitions;
+
+    for ( size_t i = 0; i < num_transitions; ++i ) {
+        const unsigned char *time = times + i * time_size;
+        transitions[i] = time_size == 8 ? (int64_t) read_be64(time) :
+                                          (int32_t) read_be32(time);
+        transition_types[i] = indices[i];
+
+        if ( indices[i] >= header.typecnt ||
+             (i > 0 && transitions[i] <= transitions[i - 1]) ) {
+            free(tz);
+            return 0;
+        }
+    }
+
+    for ( size_t i = 0; i < header.typecnt; ++i ) {
+        const unsigned char *record = type_records + i * TZIF_TYPE_LEN;
+        types[i].utc_offset = (int32_t) read_be32(record);
+        types[i].is_dst = record[4] != 0;
+
+        if ( types[i].utc_offset <= -SECS_IN_DAY ||
+             types[i].utc_offset >= SECS_IN_DAY ) {
+            free(tz);
+            return 0;
+        }
+    }
+
+    tz->num_transitions = num_transitions;
+    tz->transitions = transitions;
+    tz->transition_types = transition_types;
+    tz->types = types;
+    tz->has_rule = false;
+
+    //  The footer is a POSIX TZ rule between two newlines, and may be
+    //  empty.
+
+    if ( header.version >= '2' ) {
+        const char *footer = (const char *) block + block_len;
+        const char *footer_end = footer + 1;
+
+        if ( footer >= (const char *) data_end || *footer != '\n' ) {
+            free(tz);
+            return 0;
+        }
+        while ( footer_end < (const char *) data_end && *footer_end != '\n' ) {
+            ++footer_end;
+        }
+        if ( footer_end == (const char *) data_end ) {
+            free(tz);
+            return 0;
+        }
+
+        if ( footer_end > footer + 1 ) {
+            if ( !parse_tz_rule(footer + 1, footer_end, &tz->rule) ) {
+                free(tz);
+                return 0;
+            }
+            tz->has_rule = true;
+        }
+    }
+
+    return tz;
+}
+
+
+/*!
+ * \brief           Returns the UTC time of a change in a POSIX TZ rule.
+ * \param date      The date and time of the change.
+ * \param year      The year, e.g. 2013.
+ * \param utc_offset The UTC offset in effect before the change.
+ * \returns         The UTC time of the change.
+ */
+
+static int64_t
+rule_change_time(const struct tz_rule_date *date, const int64_t year,
+                 const int32_t utc_offset) {
+    static const int days_in_week = 7;
+    static const int epoch_wday = 4;
+    const int64_t jan_first = days_from_civil(year, 1, 1);
+    int64_t days;
+
+    switch ( date->kind ) {
+        case TZ_DATE_JULIAN:
+            days = jan_first + date->day - 1 +
+                   (date->day >= 60 && is_leap_year((int) year));
+            break;
+
+        case TZ_DATE_DAY_OF_YEAR:
+            days = jan_first + date->day;
+            break;
+
+        default: {
+            const int64_t first = days_from_civil(year, date->month, 1);
+            const int64_t month_len = days_from_civil(year, date->month + 1,
+                                                      1) - first;
+            const int first_wday = (int) (first + epoch_wday -
+                                          floor_div(first + epoch_wday,
+                                                    days_in_week) *
+                                          days_in_week);
+
+            //  Find the first such weekday, then step forward by weeks,
+            //  with week 5 meaning the last in the month.
+
+            int64_t offset = (date->day - first_wday + days_in_week) %
+                             days_in_week +
+                             (int64_t) (date->week - 1) * days_in_week;
+            if ( offset >= month_len ) {
+                offset -= days_in_week;
+            }
+            days = first + offset;
+            break;
+        }
+    }
+
+    return days * SECS_IN_DAY + date->time - utc_offset;
+}
+
+
+/*!
+ * \brief           Returns the local time type given by a POSIX TZ rule.
+ * \param rule      The rule.
+ * \param utc_ts    The UTC time.
+ * \returns         The local time type in effect at `utc_ts`.
+ */
+
+static const struct tz_type *
+rule_type(const struct tz_rule *rule, const int64_t utc_ts) {
+    if ( !rule->has_dst ) {
+        return &rule->std;
+    }
+
+    int64_t year;
+    int month;
+    int day;
+    civil_from_days(floor_div(utc_ts + rule->std.utc_offset, SECS_IN_DAY),
+                    &year, &month, &day);
+
+    const int64_t start = rule_change_time(&rule->start, year,
+                                           rule->std.utc_offset);
+    const int64_t end = rule_change_time(&rule->end, year,
+                                         rule->dst.utc_offset);
+
+    //  In the southern hemisphere DST spans the end of the year.
+
+    const bool in_dst = start < end ?
+                        utc_ts >= start && utc_ts < end :
+                        utc_ts >= start || utc_ts < end;
+
+    return in_dst ? &rule->dst : &rule->std;
+}
+
+
+/*!
+ * \brief           Returns the local time type in effect at a UTC time.
+ * \details         Times before the first transition use the first type,
+ * as RFC 8536 specifies, and times from the last transition on use the
+ * rule if there is one. Otherwise the transition is found by binary
+ * search.
+ * \param tz        The time zone.
+ * \param utc_ts    The UTC time.
+ * \returns         The local time type.
+ */
+
+static const struct tz_type *
+find_type(const struct time_zone *tz, const int64_t utc_ts) {
+    const size_t num_transitions = tz->num_transitions;
+
+    if ( num_transitions == 0 || utc_ts < tz->transitions[0] ) {
+        return num_transitions == 0 && tz->has_rule ?
+               rule_type(&tz->rule, utc_ts) : &tz->types[0];
+    }
+
+    if ( tz->has_rule && utc_ts >= tz->transitions[num_transitions - 1] ) {
+        return rule_type(&tz->rule, utc_ts);
+    }
+
+    //  Find the last transition at or before utc_ts.
+
+    size_t low = 0;
+    size_t high = num_transitions;
+    while ( high - low > 1 ) {
+        const size_t mid = low + (high - low) / 2;
+        if ( tz->transitions[mid] <= utc_ts ) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return &tz->types[tz->transition_types[low]];
+}
+
+
+/*!
+ * \brief           Loads a time zone from a TZif file.
+ * \details         The file is mapped into memory only while its table is
+ * built, so the time zone stays valid if the file is later replaced.
+ * \param name      The name of the time zone, such as "Europe/London",
+ * which is looked for under the directory in the `TZDIR` environment
+ * variable, or `/usr/share/zoneinfo` if that is not set; or an absolute
+ * path to a TZif file; or a null pointer for the system local time zone
+ * in `/etc/localtime`. Relative names containing ".." are rejected.
+ * \returns         A pointer to the time zone, which should be freed with
+ * tz_free(), or a null pointer if it could not be loaded.
+ */
+
+struct time_zone *
+tz_load(const char *name) {
+    char path[TZ_MAX_PATH];
+
+    if ( !name ) {
+        name = TZ_LOCALTIME_FILE;
+    }
+
+    if ( name[0] == '/' ) {
+        if ( strlen(name) >= sizeof path ) {
+            return 0;
+        }
+        strcpy(path, name);
+    } else {
+        const char *dir = getenv("TZDIR");
+        if ( !dir || !*dir ) {
+            dir = TZ_DEFAULT_DIR;
+        }
+
+        if ( strstr(name, "..") ||
+             snprintf(path, sizeof path, "%s/%s", dir, name) >=
+             (int) sizeof path ) {
+            return 0;
+        }
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ( fd == -1 ) {
+        return 0;
+    }
+
+    struct stat file_stat;
+    if ( fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode) ||
+         file_stat.st_size < TZIF_HEADER_LEN ) {
+        close(fd);
+        return 0;
+    }
+
+    const size_t len = (size_t) file_stat.st_size;
+    void *data = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        return 0;
+    }
+
+    struct time_zone *tz = parse_tzif(data, len);
+    munmap(data, len);
+
+    return tz;
+}
+
+
+/*!
+ * \brief           Frees a time zone.
+ * \param tz        The time zone, or a null pointer.
+ */
+
+void
+tz_free(struct time_zone *tz) {
+    free(tz);
+}
+
+
+/*!
+ * \brief           Returns the UTC offset of a time zone at a UTC time.
+ * \param tz        The time zone.
+ * \param utc_ts    The UTC time.
+ * \param is_dst    If not null, modified to contain `true` if daylight
+ * saving time is in effect, and `false` otherwise.
+ * \returns         The UTC offset in seconds, positive east of Greenwich.
+ */
+
+int
+tz_utc_offset(const struct time_zone *tz, const time_t utc_ts,
+              bool *is_dst) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TZ_UTC_OFFSET);
+    const struct tz_type *type = find_type(tz, utc_ts);
+
+    if ( is_dst ) {
+        *is_dst = type->is_dst;
+    }
+
+    PGTIME_PROBE_END(PGTIME_PROBE_TZ_UTC_OFFSET, start);
+    return type->utc_offset;
+}
+
+
+/*!
+ * \brief           Does the work of tz_local_tm().
+ * \param tz        The time zone.
+ * \param utc_ts    The UTC time.
+ * \param result    A pointer to a struct tm to receive the local time.
+ * `tm_wday` and `tm_yday` are set, and `tm_isdst` is set to 1 if daylight
+ * saving time is in effect, and 0 otherwise.
+ * \param utc_offset If not null, modified to contain the UTC offset in
+ * seconds, positive east of Greenwich, as format_iso8601() accepts.
+ * \returns         `result`, or a null pointer if the local time cannot
+ * be represented in a struct tm.
+ */
+
+static struct tm *
+to_local_tm(const struct time_zone *tz, const time_t utc_ts,
+            struct tm *result, int *utc_offset) {
+    if ( utc_ts < -TZ_MAX_TIMESTAMP || utc_ts > TZ_MAX_TIMESTAMP ) {
+        return 0;
+    }
+
+    const struct tz_type *type = find_type(tz, utc_ts);
+    if ( !get_utc_tm((time_t) (utc_ts + type->utc_offset), result) ) {
+        return 0;
+    }
+
+    result->tm_isdst = type->is_dst;
+    if ( utc_offset ) {
+        *utc_offset = type->utc_offset;
+    }
+
+    return result;
+}
+
+
+/*!
+ * \brief           Converts a UTC time to local time in a time zone.
+ * \details         This is a thread-safe replacement for localtime_r()
+ * which works with any time zone.
+ * \param tz        The time zone.
+ * \param utc_ts    The UTC time.
+ * \param result    A pointer to a struct tm to receive the local time.
+ * `tm_wday` and `tm_yday` are set, and `tm_isdst` is set to 1 if daylight
+ * saving time is in effect, and 0 otherwise.
+ * \param utc_offset If not null, modified to contain the UTC offset in
+ * seconds, positive east of Greenwich, as format_iso8601() accepts.
+ * \returns         `result`, or a null pointer if the local time cannot
+ * be represented in a struct tm.
+ */
+
+struct tm *
+tz_local_tm(const struct time_zone *tz, const time_t utc_ts,
+            struct tm *result, int *utc_offset) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TZ_LOCAL_TM);
+    struct tm *const local_tm = to_local_tm(tz, utc_ts, result, utc_offset);
+    PGTIME_PROBE_END(PGTIME_PROBE_TZ_LOCAL_TM, start);
+    return local_tm;
+}
+
+
+/*!
+ * \brief           Does the work of tz_utc_timestamp().
+ * \param tz        The time zone.
+ * \param local_tm  The local time.
+ * \param result    Modified to contain the UTC time.
+ * \returns         `true` on success, `false` if the time is out of range.
+ */
+
+static bool
+to_utc_timestamp(const struct time_zone *tz, const struct tm *local_tm,
+                 time_t *result) {
+
+    //  Any UTC time with this local time is within a day of it, so with
+    //  at most one transition in that window the UTC offset is either
+    //  the one a day before or the one a day after.
+
+    static const int64_t window = SECS_IN_DAY + 7200;
+
+    const int64_t year = (int64_t) local_tm->tm_year + 1900;
+    const int64_t month = (int64_t) local_tm->tm_mon + 1;
+    const int64_t local_ts = (days_from_civil(year, month, 1) +
+                              local_tm->tm_mday - 1) * SECS_IN_DAY +
+                             (int64_t) local_tm->tm_hour * 3600 +
+                             (int64_t) local_tm->tm_min * 60 +
+                             local_tm->tm_sec;
+    if ( local_ts < -TZ_MAX_TIMESTAMP || local_ts > TZ_MAX_TIMESTAMP ) {
+        return false;
+    }
+
+    const int32_t before = find_type(tz, local_ts - window)->utc_offset;
+    const int32_t after = find_type(tz, local_ts + window)->utc_offset;
+    const int64_t first = local_ts - before;
+    const int64_t second = local_ts - after;
+    const struct tz_type *first_type = find_type(tz, first);
+    const struct tz_type *second_type = find_type(tz, second);
+    const bool first_valid = first_type->utc_offset == before;
+    const bool second_valid = second_type->utc_offset == after;
+    int64_t utc_ts = first;
+
+    if ( first_valid && second_valid && before != after ) {
+        const bool want_dst = local_tm->tm_isdst > 0;
+        if ( local_tm->tm_isdst >= 0 &&
+             (first_type->is_dst != 0) != (second_type->is_dst != 0) ) {
+            utc_ts = (first_type->is_dst != 0) == want_dst ? first : second;
+        } else {
+            utc_ts = first < second ? first : second;
+        }
+    } else if ( second_valid && !first_valid ) {
+        utc_ts = second;
+    }
+
+    *result = (time_t) utc_ts;
+    return (int64_t) *result == utc_ts;
+}
+
+
+/*!
+ * \brief           Converts a local time in a time zone to UTC.
+ * \details         This is a thread-safe replacement for mktime() which
+ * works with any time zone. The members of `local_tm` need not be in
+ * their normal ranges. When the local time occurs twice, as when clocks go
+ * back, `tm_isdst` chooses between them: positive for the daylight saving
+ * time, zero for standard time, and negative for the earlier of the two.
+ * When the local time is skipped, as when clocks go forward, it is taken
+ * with the UTC offset in effect before the change, which gives a time
+ * after it, as mktime() usually does.
+ * \param tz        The time zone.
+ * \param local_tm  The local time.
+ * \param result    Modified to contain the UTC time.
+ * \returns         `true` on success, `false` if the time is out of range.
+ */
+
+bool
+tz_utc_timestamp(const struct time_zone *tz, const struct tm *local_tm,
+                 time_t *result) {
+    const uint64_t start = PGTIME_PROBE_BEGIN(PGTIME_PROBE_TZ_UTC_TIMESTAMP);
+    const bool success = to_utc_timestamp(tz, local_tm, result);
+    PGTIME_PROBE_END(PGTIME_PROBE_TZ_UTC_TIMESTAMP, start);
+    return success;
+}
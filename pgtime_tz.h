@@ -0,0 +1,49 @@
+/*!
+ * \file        pgtime_tz.h
+ * \brief       Interface to time zone conversions using TZif files.
+ * \author      Paul Griffiths
+ * \copyright   Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#ifndef PG_PGTIME_TZ_H
+#define PG_PGTIME_TZ_H
+
+#include <time.h>
+#include <stdbool.h>
+
+
+/*!
+ * \brief       A time zone loaded from a TZif file.
+ * \details     The structure is opaque. A loaded time zone is never
+ * modified, so any number of threads can use it at once without locking,
+ * and unlike localtime() and mktime() it does not depend on the `TZ`
+ * environment variable.
+ */
+
+struct time_zone;
+
+
+/*  Function prototypes  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct time_zone *tz_load(const char *name);
+void tz_free(struct time_zone *tz);
+
+int tz_utc_offset(const struct time_zone *tz, const time_t utc_ts,
+                  bool *is_dst);
+struct tm *tz_local_tm(const struct time_zone *tz, const time_t utc_ts,
+                       struct tm *result, int *utc_offset);
+bool tz_utc_timestamp(const struct time_zone *tz, const struct tm *local_tm,
+                      time_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif          /*  PG_PGTIME_TZ_H  */
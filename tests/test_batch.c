@@ -0,0 +1,376 @@
+/*!
+ * \file            test_batch.c
+ * \brief           Tests the batch conversions with every kernel against
+ * the scalar functions.
+ * \details         get_utc_tms() and get_utc_tms_columns() are checked
+ * against get_utc_tm() on each element for runs of sorted timestamps,
+ * which reuse the date, random ones from 10000 BCE to 10000 CE, ones on
+ * either side of the range the SIMD kernel handles itself, and ones
+ * beyond the range of tm_year, which must fail without upsetting the
+ * others. get_utc_timestamps(), get_utc_timestamps_columns() and
+ * tm_secs_diffs() are checked against get_utc_timestamp() and
+ * tm_secs_diff() on each element, with each kernel the CPU supports, for
+ * arrays of random lengths, so that every block size and tail is used.
+ * The times are from 10000 BCE to 10000 CE, with members far out of their
+ * normal ranges, years on either side of the range the SIMD kernels
+ * handle themselves, any year at all, and the largest and smallest years
+ * and months. It needs a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_batch.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of arrays to check with each kernel, and the most elements in
+ *  each  */
+
+#define NUM_ARRAYS 5000
+#define MAX_COUNT 300
+
+/*  The range of random timestamps, 10000 BCE to 10000 CE  */
+
+#define MIN_TIMESTAMP INT64_C(-377705116800)
+#define TIMESTAMP_RANGE INT64_C(631139040000)
+
+/*  The largest tm_year the SIMD kernels convert themselves, and the
+ *  largest distance from 1970 in seconds  */
+
+#define SIMD_MAX_TM_YEAR (1 << 24)
+#define SIMD_MAX_TIMESTAMP (INT64_C(1) << 45)
+
+
+/*  The kernels to check  */
+
+static const enum batch_kernel kernels[] = {
+    BATCH_KERNEL_SCALAR, BATCH_KERNEL_SSE41, BATCH_KERNEL_AVX2
+};
+
+static const char *const kernel_names[] = {"scalar", "SSE4.1", "AVX2"};
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param kernel    The name of the kernel in use.
+ * \param index     The element which was wrong.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const char *kernel, const size_t index,
+               long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong with the %s kernel for element %zu\n", name,
+               kernel, index);
+    }
+}
+
+
+/*!
+ * \brief           Makes a random UTC time for a batch conversion.
+ * \details         Most are ordinary times, and the rest have one or more
+ * members far out of range, or years around the largest the SIMD kernels
+ * handle, or any year, or the most extreme years and months.
+ * \param state     The state of the random number generator.
+ * \param result    Modified to contain the time.
+ */
+
+static void
+random_tm(uint64_t *state, struct tm *result) {
+    static const int extremes[] = {INT_MIN, INT_MIN + 1, INT_MAX - 1,
+                                   INT_MAX};
+    const time_t utc_ts = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    get_utc_tm(utc_ts, result);
+
+    switch ( random_in(state, 0, 10) ) {
+        case 0:
+            result->tm_mon = (int) random_in(state, -30, 71);
+            result->tm_mday = (int) random_in(state, -40, 111);
+            break;
+        case 1:
+            result->tm_hour = (int) random_in(state, -50, 101);
+            result->tm_min = (int) random_in(state, -100, 201);
+            result->tm_sec = (int) random_in(state, -100, 201);
+            break;
+        case 2:
+            result->tm_year = (int) random_in(state, -SIMD_MAX_TM_YEAR - 2,
+                                              5);
+            break;
+        case 3:
+            result->tm_year = (int) random_in(state, SIMD_MAX_TM_YEAR - 2, 5);
+            break;
+        case 4:
+            result->tm_year = extremes[random_in(state, 0, 4)];
+            result->tm_mon = (int) random_in(state, 0, 12);
+            break;
+        case 5:
+            result->tm_year = (int) random_in(state, -10000, 20001);
+            result->tm_mon = extremes[random_in(state, 0, 4)];
+            break;
+        case 6:
+            result->tm_year = (int) random_in(state, INT_MIN,
+                                              INT64_C(1) << 32);
+            break;
+        default:
+            break;
+    }
+}
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Makes a random timestamp for a batch conversion.
+ * \details         Most follow on from the one before by up to two hours,
+ * so that runs of them fall on the same day, and the rest are ordinary
+ * times, or around the largest distance from 1970 the SIMD kernel
+ * handles, or so far away that the year cannot be represented.
+ * \param state     The state of the random number generator.
+ * \param previous  The timestamp before this one.
+ * \returns         The timestamp.
+ */
+
+static time_t
+random_ts(uint64_t *state, const time_t previous) {
+    static const int64_t extremes[] = {INT64_MIN, INT64_MIN + 1,
+                                       INT64_MAX - 1, INT64_MAX};
+
+    switch ( random_in(state, 0, 16) ) {
+        case 0:
+            return (time_t) random_in(state, MIN_TIMESTAMP, TIMESTAMP_RANGE);
+        case 1:
+            return (time_t) random_in(state, SIMD_MAX_TIMESTAMP - 2, 5);
+        case 2:
+            return (time_t) random_in(state, -SIMD_MAX_TIMESTAMP - 2, 5);
+        case 3:
+            return (time_t) extremes[random_in(state, 0, 4)];
+        default:
+            if ( previous > INT64_MAX - 7200 ) {
+                return previous;
+            }
+            return (time_t) (previous + random_in(state, 0, 7201));
+    }
+}
+
+
+/*!
+ * \brief           Checks the time_t to struct tm conversions for one
+ * random array.
+ * \param state     The state of the random number generator.
+ * \param kernel    The name of the kernel in use.
+ * \param failures  Incremented for each element which is wrong.
+ */
+
+static void
+check_tms(uint64_t *state, const char *kernel, long *failures) {
+    time_t utc_ts[MAX_COUNT];
+    struct tm results[MAX_COUNT];
+    int columns[6][MAX_COUNT];
+    const struct tm_columns utc_columns = {
+        columns[0], columns[1], columns[2], columns[3], columns[4],
+        columns[5]
+    };
+
+    const size_t count = (size_t) random_in(state, 0, MAX_COUNT + 1);
+    time_t previous = (time_t) random_in(state, MIN_TIMESTAMP,
+                                         TIMESTAMP_RANGE);
+    for ( size_t i = 0; i < count; ++i ) {
+        utc_ts[i] = previous = random_ts(state, previous);
+    }
+
+    struct tm expected[MAX_COUNT];
+    bool valid[MAX_COUNT];
+    bool all_valid = true;
+    for ( size_t i = 0; i < count; ++i ) {
+        valid[i] = get_utc_tm(utc_ts[i], &expected[i]) != 0;
+        all_valid &= valid[i];
+    }
+
+    //  Where a timestamp cannot be broken down, its element is
+    //  unspecified, but the others must still be right.
+
+    if ( get_utc_tms(utc_ts, results, count) != all_valid ) {
+        report_failure("get_utc_tms()", kernel, 0, failures);
+    }
+    if ( get_utc_tms_columns(utc_ts, &utc_columns, count) != all_valid ) {
+        report_failure("get_utc_tms_columns()", kernel, 0, failures);
+    }
+
+    for ( size_t i = 0; i < count; ++i ) {
+        if ( !valid[i] ) {
+            continue;
+        }
+
+        if ( !same_tm(&results[i], &expected[i]) ) {
+            report_failure("get_utc_tms()", kernel, i, failures);
+        }
+        if ( columns[0][i] != expected[i].tm_year ||
+             columns[1][i] != expected[i].tm_mon ||
+             columns[2][i] != expected[i].tm_mday ||
+             columns[3][i] != expected[i].tm_hour ||
+             columns[4][i] != expected[i].tm_min ||
+             columns[5][i] != expected[i].tm_sec ) {
+            report_failure("get_utc_tms_columns()", kernel, i, failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief           Checks the struct tm to time_t conversions for one
+ * random array.
+ * \param state     The state of the random number generator.
+ * \param kernel    The name of the kernel in use.
+ * \param failures  Incremented for each element which is wrong.
+ */
+
+static void
+check_timestamps(uint64_t *state, const char *kernel, long *failures) {
+    struct tm utc_tms[MAX_COUNT];
+    struct tm other_tms[MAX_COUNT];
+    int columns[6][MAX_COUNT];
+    time_t results[MAX_COUNT];
+    time_t column_results[MAX_COUNT];
+    int64_t diffs[MAX_COUNT];
+
+    const size_t count = (size_t) random_in(state, 0, MAX_COUNT + 1);
+    for ( size_t i = 0; i < count; ++i ) {
+        random_tm(state, &utc_tms[i]);
+        random_tm(state, &other_tms[i]);
+        columns[0][i] = utc_tms[i].tm_year;
+        columns[1][i] = utc_tms[i].tm_mon;
+        columns[2][i] = utc_tms[i].tm_mday;
+        columns[3][i] = utc_tms[i].tm_hour;
+        columns[4][i] = utc_tms[i].tm_min;
+        columns[5][i] = utc_tms[i].tm_sec;
+    }
+    const struct tm_columns utc_columns = {
+        columns[0], columns[1], columns[2], columns[3], columns[4],
+        columns[5]
+    };
+
+    if ( !get_utc_timestamps(utc_tms, results, count) ) {
+        report_failure("get_utc_timestamps()", kernel, 0, failures);
+    }
+    if ( !get_utc_timestamps_columns(&utc_columns, column_results, count) ) {
+        report_failure("get_utc_timestamps_columns()", kernel, 0, failures);
+    }
+    tm_secs_diffs(utc_tms, other_tms, diffs, count);
+
+    for ( size_t i = 0; i < count; ++i ) {
+        const time_t expected = get_utc_timestamp(&utc_tms[i]);
+        if ( results[i] != expected ) {
+            report_failure("get_utc_timestamps()", kernel, i, failures);
+        }
+        if ( column_results[i] != expected ) {
+            report_failure("get_utc_timestamps_columns()", kernel, i,
+                           failures);
+        }
+        if ( diffs[i] != tm_secs_diff(&utc_tms[i], &other_tms[i]) ) {
+            report_failure("tm_secs_diffs()", kernel, i, failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+    int num_kernels = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_batch: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( size_t k = 0; k < ARRAY_LEN(kernels); ++k ) {
+        if ( !batch_select_kernel(kernels[k]) ) {
+            printf("test_batch: the %s kernel is not supported.\n",
+                   kernel_names[k]);
+            continue;
+        }
+        if ( batch_active_kernel() != kernels[k] ) {
+            report_failure("batch_active_kernel()", kernel_names[k], 0,
+                           &failures);
+        }
+
+        ++num_kernels;
+        for ( long i = 0; i < NUM_ARRAYS; ++i ) {
+            check_timestamps(&state, kernel_names[k], &failures);
+            check_tms(&state, kernel_names[k], &failures);
+        }
+    }
+    batch_select_kernel(BATCH_KERNEL_AUTO);
+
+    printf("test_batch: %d kernels, %ld arrays, %ld failures\n",
+           num_kernels, (long) num_kernels * NUM_ARRAYS, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
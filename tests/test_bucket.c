@@ -0,0 +1,557 @@
+/*!
+ * \file            test_bucket.c
+ * \brief           Tests the rounding and bucketing functions against
+ * timegm() and gmtime_r().
+ * \details         utc_floor_calendar(), utc_ceil_calendar(), tm_floor()
+ * and tm_ceil() are checked for every unit against rounding done with
+ * gmtime_r() and timegm(), for random times from 10000 BCE to 10000 CE.
+ * bucket_count(), bucket_count_calendar() and bucket_count_tms() are
+ * checked against counting each timestamp on its own, with the best
+ * kernel and the scalar kernel, with sorted and unsorted input, and with
+ * enough buckets that months and years are counted without a table. The
+ * limits of time_t are rounded and counted too, and must neither overflow
+ * nor give a time on the wrong side. It needs a libc which provides
+ * timegm() and gmtime_r() and a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_batch.h"
+#include "pgtime_bucket.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of random times to round, and of random histograms  */
+
+#define NUM_TIMES 200000
+#define NUM_HISTOGRAMS 2000
+
+/*  Number of timestamps in each histogram, and most buckets in one  */
+
+#define HISTOGRAM_TIMES 1000
+#define MAX_BUCKETS 200
+
+/*  Buckets in the histograms too big for a table of boundaries  */
+
+#define UNTABLED_BUCKETS (((size_t) 1 << 20) + 1)
+
+/*  The range of random timestamps, 10000 BCE to 10000 CE  */
+
+#define MIN_TIMESTAMP INT64_C(-377705116800)
+#define TIMESTAMP_RANGE INT64_C(631139040000)
+
+/*  Seconds in a day, and the offset from 1970-01-01, a Thursday, back to
+ *  the Monday before it  */
+
+#define SECS_IN_DAY 86400
+#define WEEK_EPOCH_OFFSET (3 * SECS_IN_DAY)
+
+
+/*  Length in seconds of the units with a fixed length  */
+
+static const int64_t unit_secs[] = {1, 60, 3600, SECS_IN_DAY,
+                                    7 * SECS_IN_DAY};
+
+/*  Names of the units  */
+
+static const char *const unit_names[] = {
+    "second", "minute", "hour", "day", "week", "month", "year"
+};
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Divides, rounding towards negative infinity.
+ * \param dividend  The dividend.
+ * \param divisor   The divisor, which must be positive.
+ * \returns         The quotient.
+ */
+
+static int64_t
+floor_quotient(const int64_t dividend, const int64_t divisor) {
+    return dividend / divisor - (dividend % divisor < 0);
+}
+
+
+/*!
+ * \brief           Compares two timestamps, for qsort().
+ * \param first     The first timestamp.
+ * \param second    The second timestamp.
+ * \returns         Less than, equal to or greater than zero as `first` is
+ * earlier than, the same as or later than `second`.
+ */
+
+static int
+compare_times(const void *first, const void *second) {
+    const time_t a = *(const time_t *) first;
+    const time_t b = *(const time_t *) second;
+    return (a > b) - (a < b);
+}
+
+
+/*!
+ * \brief           Returns the index of the month or year containing a
+ * timestamp.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      `CALENDAR_MONTH` or `CALENDAR_YEAR`.
+ * \returns         The number of whole months or years from 1900.
+ */
+
+static int64_t
+reference_index(const time_t utc_ts, const enum calendar_unit unit) {
+    struct tm utc_tm;
+    gmtime_r(&utc_ts, &utc_tm);
+    return unit == CALENDAR_MONTH ?
+               utc_tm.tm_year * INT64_C(12) + utc_tm.tm_mon :
+               utc_tm.tm_year;
+}
+
+
+/*!
+ * \brief           Rounds a timestamp down, with gmtime_r() and timegm()
+ * for months and years.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      The calendar unit.
+ * \returns         The start of the unit containing `utc_ts`.
+ */
+
+static time_t
+reference_floor(const time_t utc_ts, const enum calendar_unit unit) {
+    if ( unit == CALENDAR_WEEK ) {
+        return (time_t) (floor_quotient(utc_ts + WEEK_EPOCH_OFFSET,
+                                        unit_secs[unit]) *
+                         unit_secs[unit] - WEEK_EPOCH_OFFSET);
+    } else if ( unit < CALENDAR_WEEK ) {
+        return (time_t) (floor_quotient(utc_ts, unit_secs[unit]) *
+                         unit_secs[unit]);
+    }
+
+    struct tm utc_tm;
+    gmtime_r(&utc_ts, &utc_tm);
+    utc_tm.tm_sec = 0;
+    utc_tm.tm_min = 0;
+    utc_tm.tm_hour = 0;
+    utc_tm.tm_mday = 1;
+    if ( unit == CALENDAR_YEAR ) {
+        utc_tm.tm_mon = 0;
+    }
+    return timegm(&utc_tm);
+}
+
+
+/*!
+ * \brief           Rounds a timestamp up, with gmtime_r() and timegm()
+ * for months and years.
+ * \param utc_ts    The UTC timestamp.
+ * \param unit      The calendar unit.
+ * \returns         `utc_ts` if it is the start of a unit, otherwise the
+ * start of the next unit.
+ */
+
+static time_t
+reference_ceil(const time_t utc_ts, const enum calendar_unit unit) {
+    const time_t floor = reference_floor(utc_ts, unit);
+    if ( floor == utc_ts ) {
+        return floor;
+    } else if ( unit < CALENDAR_MONTH ) {
+        return floor + (time_t) unit_secs[unit];
+    }
+
+    struct tm utc_tm;
+    gmtime_r(&floor, &utc_tm);
+    if ( unit == CALENDAR_MONTH ) {
+        ++utc_tm.tm_mon;
+    } else {
+        ++utc_tm.tm_year;
+    }
+    return timegm(&utc_tm);
+}
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param unit      The calendar unit.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const enum calendar_unit unit,
+               const time_t utc_ts, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong for %s and timestamp %lld\n", name,
+               unit_names[unit], (long long) utc_ts);
+    }
+}
+
+
+/*!
+ * \brief           Checks the rounding functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(uint64_t *state, long *failures) {
+    const time_t utc_ts = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    struct tm utc_tm;
+    gmtime_r(&utc_ts, &utc_tm);
+
+    for ( int unit = CALENDAR_SECOND; unit <= CALENDAR_YEAR; ++unit ) {
+        const time_t floor = reference_floor(utc_ts, unit);
+        const time_t ceil = reference_ceil(utc_ts, unit);
+        if ( utc_floor_calendar(utc_ts, unit) != floor ) {
+            report_failure("utc_floor_calendar()", unit, utc_ts, failures);
+        }
+        if ( utc_ceil_calendar(utc_ts, unit) != ceil ) {
+            report_failure("utc_ceil_calendar()", unit, utc_ts, failures);
+        }
+
+        struct tm expected;
+        struct tm result = utc_tm;
+        gmtime_r(&floor, &expected);
+        if ( !tm_floor(&result, unit) || !same_tm(&result, &expected) ) {
+            report_failure("tm_floor()", unit, utc_ts, failures);
+        }
+
+        result = utc_tm;
+        gmtime_r(&ceil, &expected);
+        if ( !tm_ceil(&result, unit) || !same_tm(&result, &expected) ) {
+            report_failure("tm_ceil()", unit, utc_ts, failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief               Checks the bucketing functions for one random
+ * histogram.
+ * \details             The timestamps are spread over a little more than
+ * the buckets, so that some fall before and after them.
+ * \param state         The state of the random number generator.
+ * \param num_buckets   The number of buckets.
+ * \param times         Space for `HISTOGRAM_TIMES` timestamps.
+ * \param tms           Space for `HISTOGRAM_TIMES` struct tms.
+ * \param counts        Space for `num_buckets` counts.
+ * \param expected      Space for `num_buckets` counts.
+ * \param failures      Incremented for each function which is wrong.
+ */
+
+static void
+check_histogram(uint64_t *state, const size_t num_buckets, time_t *times,
+                struct tm *tms, uint64_t *counts, uint64_t *expected,
+                long *failures) {
+    static const int64_t average_secs[] = {2629746, 31556952};
+
+    const enum calendar_unit unit = (enum calendar_unit)
+                                    random_in(state, 0, CALENDAR_YEAR + 1);
+    const time_t origin = (time_t) random_in(state, MIN_TIMESTAMP / 2,
+                                             TIMESTAMP_RANGE / 2);
+    const int64_t interval = unit < CALENDAR_MONTH ?
+                             unit_secs[unit] :
+                             average_secs[unit == CALENDAR_YEAR];
+    const int64_t span = interval * (int64_t) num_buckets;
+    const time_t start = reference_floor(origin, unit);
+
+    for ( size_t i = 0; i < HISTOGRAM_TIMES; ++i ) {
+        times[i] = (time_t) random_in(state, start - span / 8,
+                                      span + span / 4 + 1);
+    }
+    if ( random_in(state, 0, 2) ) {
+        qsort(times, HISTOGRAM_TIMES, sizeof *times, compare_times);
+    }
+
+    //  Each timestamp on its own
+
+    size_t expected_counted = 0;
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        expected[i] = 0;
+    }
+    for ( size_t i = 0; i < HISTOGRAM_TIMES; ++i ) {
+        const int64_t index = unit < CALENDAR_MONTH ?
+                              floor_quotient(times[i] - start, interval) :
+                              reference_index(times[i], unit) -
+                              reference_index(origin, unit);
+        if ( index >= 0 && (uint64_t) index < num_buckets ) {
+            ++expected[index];
+            ++expected_counted;
+        }
+    }
+
+    //  Calendar buckets, from timestamps and from struct tms
+
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        counts[i] = 0;
+    }
+    size_t counted = bucket_count_calendar(times, HISTOGRAM_TIMES, origin,
+                                           unit, counts, num_buckets);
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        if ( counts[i] != expected[i] ) {
+            counted = expected_counted + 1;
+        }
+    }
+    if ( counted != expected_counted ) {
+        report_failure("bucket_count_calendar()", unit, origin, failures);
+    }
+
+    for ( size_t i = 0; i < HISTOGRAM_TIMES; ++i ) {
+        gmtime_r(&times[i], &tms[i]);
+    }
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        counts[i] = 0;
+    }
+    counted = bucket_count_tms(tms, HISTOGRAM_TIMES, origin, unit, counts,
+                               num_buckets);
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        if ( counts[i] != expected[i] ) {
+            counted = expected_counted + 1;
+        }
+    }
+    if ( counted != expected_counted ) {
+        report_failure("bucket_count_tms()", unit, origin, failures);
+    }
+
+    //  Fixed-width buckets from the start of the unit, which are the same
+    //  as calendar buckets for the units with a fixed length
+
+    if ( unit < CALENDAR_MONTH ) {
+        for ( size_t i = 0; i < num_buckets; ++i ) {
+            counts[i] = 0;
+        }
+        counted = bucket_count(times, HISTOGRAM_TIMES, start, interval,
+                               counts, num_buckets);
+        for ( size_t i = 0; i < num_buckets; ++i ) {
+            if ( counts[i] != expected[i] ) {
+                counted = expected_counted + 1;
+            }
+        }
+        if ( counted != expected_counted ) {
+            report_failure("bucket_count()", unit, start, failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief               Checks bucket_count() for one random histogram
+ * with a random interval and origin.
+ * \param state         The state of the random number generator.
+ * \param times         Space for `HISTOGRAM_TIMES` timestamps.
+ * \param counts        Space for `MAX_BUCKETS` counts.
+ * \param expected      Space for `MAX_BUCKETS` counts.
+ * \param failures      Incremented if bucket_count() is wrong.
+ */
+
+static void
+check_fixed(uint64_t *state, time_t *times, uint64_t *counts,
+            uint64_t *expected, long *failures) {
+    const size_t num_buckets = (size_t) random_in(state, 1, MAX_BUCKETS);
+    const int64_t interval = random_in(state, 1, 10000000);
+    const time_t origin = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    const int64_t span = interval * (int64_t) num_buckets;
+
+    for ( size_t i = 0; i < HISTOGRAM_TIMES; ++i ) {
+        times[i] = (time_t) random_in(state, origin - span / 8,
+                                      span + span / 4 + 1);
+    }
+    if ( random_in(state, 0, 2) ) {
+        qsort(times, HISTOGRAM_TIMES, sizeof *times, compare_times);
+    }
+
+    size_t expected_counted = 0;
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        counts[i] = 0;
+        expected[i] = 0;
+    }
+    for ( size_t i = 0; i < HISTOGRAM_TIMES; ++i ) {
+        const int64_t index = floor_quotient(times[i] - origin, interval);
+        if ( index >= 0 && (uint64_t) index < num_buckets ) {
+            ++expected[index];
+            ++expected_counted;
+        }
+    }
+
+    size_t counted = bucket_count(times, HISTOGRAM_TIMES, origin, interval,
+                                  counts, num_buckets);
+    for ( size_t i = 0; i < num_buckets; ++i ) {
+        if ( counts[i] != expected[i] ) {
+            counted = expected_counted + 1;
+        }
+    }
+    if ( counted != expected_counted ) {
+        if ( (*failures)++ < 5 ) {
+            printf("bucket_count() is wrong for interval %lld and origin "
+                   "%lld\n", (long long) interval, (long long) origin);
+        }
+    }
+}
+
+
+/*!
+ * \brief           Checks the rounding and bucketing functions at the
+ * limits of time_t.
+ * \details         A unit starting before the earliest time_t starts at
+ * it, and one ending after the latest time_t ends at it.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_limits(long *failures) {
+    static const int64_t limits[] = {
+        INT64_MIN, INT64_MIN + 1, INT64_MIN + 40 * INT64_C(86400),
+        INT64_MAX - 40 * INT64_C(86400), INT64_MAX - 1, INT64_MAX
+    };
+
+    for ( size_t i = 0; i < ARRAY_LEN(limits); ++i ) {
+        const time_t utc_ts = (time_t) limits[i];
+
+        for ( int unit = CALENDAR_SECOND; unit <= CALENDAR_YEAR; ++unit ) {
+            const time_t floor = utc_floor_calendar(utc_ts, unit);
+            const time_t ceil = utc_ceil_calendar(utc_ts, unit);
+            if ( floor > utc_ts ||
+                 utc_floor_calendar(floor, unit) != floor ) {
+                report_failure("utc_floor_calendar()", unit, utc_ts,
+                               failures);
+            }
+            if ( ceil < utc_ts || utc_ceil_calendar(ceil, unit) != ceil ) {
+                report_failure("utc_ceil_calendar()", unit, utc_ts,
+                               failures);
+            }
+
+            //  The first bucket holds the time, and the second holds the
+            //  time a unit later if there is one.
+
+            uint64_t counts[2] = {0, 0};
+            const size_t counted = bucket_count_calendar(&utc_ts, 1, utc_ts,
+                                                         unit, counts, 2);
+            if ( counted != 1 || counts[0] != 1 ) {
+                report_failure("bucket_count_calendar()", unit, utc_ts,
+                               failures);
+            }
+        }
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    static time_t times[HISTOGRAM_TIMES];
+    static struct tm tms[HISTOGRAM_TIMES];
+    uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_bucket: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    uint64_t *const counts = malloc(UNTABLED_BUCKETS * sizeof *counts);
+    uint64_t *const expected = malloc(UNTABLED_BUCKETS * sizeof *expected);
+    if ( !counts || !expected ) {
+        printf("test_bucket: couldn't allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_time(&state, &failures);
+    }
+
+    //  With the best kernel and then the scalar kernel, and a few times
+    //  with too many buckets for a table
+
+    static const enum batch_kernel kernels[] = {BATCH_KERNEL_AUTO,
+                                                BATCH_KERNEL_SCALAR};
+    for ( size_t k = 0; k < ARRAY_LEN(kernels); ++k ) {
+        batch_select_kernel(kernels[k]);
+        for ( long i = 0; i < NUM_HISTOGRAMS; ++i ) {
+            const size_t num_buckets = (size_t) random_in(&state, 1,
+                                                          MAX_BUCKETS);
+            check_histogram(&state, num_buckets, times, tms, counts,
+                            expected, &failures);
+            check_fixed(&state, times, counts, expected, &failures);
+        }
+        for ( long i = 0; i < 10; ++i ) {
+            check_histogram(&state, UNTABLED_BUCKETS, times, tms, counts,
+                            expected, &failures);
+        }
+    }
+    batch_select_kernel(BATCH_KERNEL_AUTO);
+
+    check_limits(&failures);
+
+    free(counts);
+    free(expected);
+
+    printf("test_bucket: %ld times, %ld histograms, %ld failures\n",
+           (long) NUM_TIMES, 2L * (2 * NUM_HISTOGRAMS + 10), failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,421 @@
+/*!
+ * \file            test_clock.c
+ * \brief           Tests the coarse clock against timespec_get() and the
+ * conversion and ISO 8601 functions.
+ * \details         coarse_clock_set_resolution() must reject resolutions
+ * out of range, and the clock must tick itself the first time it is read.
+ * For resolutions from a second down to a nanosecond, each snapshot taken
+ * after a tick must lie between timespec_get() readings from either side
+ * of it, its broken-down time must agree with get_utc_tm(), and its
+ * ISO 8601 string must have one fractional digit for each power of ten
+ * finer than a second that the resolution resolves, and parse back to its
+ * timestamp and truncated nanoseconds. Then reader threads check that
+ * every snapshot stays consistent and no thread sees the clock go
+ * backwards, while the updater thread and other threads tick it. It needs
+ * a time_t of at least 64 bits, and C11 threads for the updater thread.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_clock.h"
+#include "pgtime_iso.h"
+
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of ticks to check at each resolution  */
+
+#define NUM_TICKS 20000
+
+/*  Number of reader and ticking threads, and how long they run, in
+ *  nanoseconds  */
+
+#define NUM_READERS 4
+#define NUM_TICKERS 2
+#define RUN_NSECS 300000000L
+
+/*  Nanoseconds in a second, and the length of an RFC 3339 UTC timestamp
+ *  without a fraction  */
+
+#define NSECS_IN_SEC 1000000000L
+#define RFC3339_LEN 20
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Compares two times.
+ * \param first_ts  The timestamp of the first time.
+ * \param first_ns  The nanoseconds of the first time.
+ * \param second_ts The timestamp of the second time.
+ * \param second_ns The nanoseconds of the second time.
+ * \returns         true if the first time is earlier than the second,
+ * false otherwise.
+ */
+
+static bool
+is_earlier(const time_t first_ts, const long first_ns,
+           const time_t second_ts, const long second_ns) {
+    return first_ts < second_ts ||
+           (first_ts == second_ts && first_ns < second_ns);
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param detail    What was wrong.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const char *detail, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong: %s\n", name, detail);
+    }
+}
+
+
+/*!
+ * \brief               Checks that a snapshot is consistent.
+ * \param snapshot      The snapshot.
+ * \param precision     The number of fractional digits the ISO 8601
+ * string should have, or -1 if it may have any number, since the
+ * resolution may have changed since the tick.
+ * \returns             A description of what is wrong, or a null pointer
+ * if nothing is.
+ */
+
+static const char *
+check_snapshot(const struct clock_snapshot *snapshot, const int precision) {
+    static const long divisors[] = {
+        1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100,
+        10, 1
+    };
+
+    if ( snapshot->nanoseconds < 0 || snapshot->nanoseconds >= NSECS_IN_SEC ) {
+        return "nanoseconds out of range";
+    }
+
+    struct tm utc_tm;
+    if ( !get_utc_tm(snapshot->utc_ts, &utc_tm) ||
+         !same_tm(&utc_tm, &snapshot->utc_tm) ) {
+        return "broken-down time disagrees with the timestamp";
+    }
+
+    //  The fraction is truncated, not rounded, to the precision.
+
+    const size_t len = strlen(snapshot->iso8601);
+    const int digits = len > RFC3339_LEN ? (int) (len - RFC3339_LEN - 1) : 0;
+    time_t parsed = 0;
+    long nanoseconds = -1;
+    if ( (precision >= 0 && digits != precision) || digits > 9 ||
+         parse_iso8601_timestamp(snapshot->iso8601, len, &parsed,
+                                 &nanoseconds) != snapshot->iso8601 + len ||
+         parsed != snapshot->utc_ts ||
+         nanoseconds != snapshot->nanoseconds / divisors[digits] *
+                        divisors[digits] ) {
+        return "ISO 8601 string disagrees with the timestamp";
+    }
+
+    return 0;
+}
+
+
+/*!
+ * \brief           Checks the resolution and the first read.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_first_read(long *failures) {
+    static const long bad_resolutions[] = {
+        0, -1, -NSECS_IN_SEC, NSECS_IN_SEC + 1
+    };
+    for ( size_t i = 0; i < ARRAY_LEN(bad_resolutions); ++i ) {
+        if ( coarse_clock_set_resolution(bad_resolutions[i]) ||
+             coarse_clock_start(bad_resolutions[i]) ) {
+            report_failure("coarse_clock_set_resolution()",
+                           "accepted a resolution out of range", failures);
+        }
+    }
+
+    //  Nothing has ticked the clock yet, so reading it must.
+
+    struct timespec before;
+    struct timespec after;
+    timespec_get(&before, TIME_UTC);
+    const time_t utc_ts = coarse_clock_time();
+    timespec_get(&after, TIME_UTC);
+    if ( utc_ts < before.tv_sec || utc_ts > after.tv_sec ) {
+        report_failure("coarse_clock_time()", "wrong before the first tick",
+                       failures);
+    }
+
+    struct clock_snapshot snapshot;
+    const char *detail = 0;
+    if ( !coarse_clock_now(&snapshot) ) {
+        detail = "failed before the first tick";
+    } else if ( snapshot.utc_ts != utc_ts ) {
+        detail = "disagrees with coarse_clock_time()";
+    } else {
+        detail = check_snapshot(&snapshot, 3);
+    }
+    if ( detail ) {
+        report_failure("coarse_clock_now()", detail, failures);
+    }
+}
+
+
+/*!
+ * \brief           Checks ticking the clock from one thread.
+ * \param failures  Incremented for each function which is wrong.
+ * \returns         The number of snapshots checked.
+ */
+
+static long
+check_ticks(long *failures) {
+    long snapshots = 0;
+
+    for ( long resolution = NSECS_IN_SEC, precision = 0; resolution >= 1;
+          resolution /= 10, ++precision ) {
+        if ( !coarse_clock_set_resolution(resolution) ) {
+            report_failure("coarse_clock_set_resolution()",
+                           "rejected a resolution in range", failures);
+            continue;
+        }
+
+        struct clock_snapshot last = {0};
+        for ( long i = 0; i < NUM_TICKS; ++i, ++snapshots ) {
+            struct timespec before;
+            struct timespec after;
+            struct clock_snapshot snapshot;
+
+            timespec_get(&before, TIME_UTC);
+            const bool ticked = coarse_clock_tick();
+            timespec_get(&after, TIME_UTC);
+
+            const char *detail = 0;
+            if ( !ticked || !coarse_clock_now(&snapshot) ) {
+                detail = "failed";
+            } else if ( is_earlier(snapshot.utc_ts, snapshot.nanoseconds,
+                                   before.tv_sec, before.tv_nsec) ||
+                        is_earlier(after.tv_sec, after.tv_nsec,
+                                   snapshot.utc_ts, snapshot.nanoseconds) ) {
+                detail = "snapshot is not from the tick";
+            } else if ( is_earlier(snapshot.utc_ts, snapshot.nanoseconds,
+                                   last.utc_ts, last.nanoseconds) ) {
+                detail = "clock went backwards";
+            } else if ( coarse_clock_time() != snapshot.utc_ts ) {
+                detail = "coarse_clock_time() disagrees with the snapshot";
+            } else {
+                detail = check_snapshot(&snapshot, (int) precision);
+            }
+            if ( detail ) {
+                report_failure("coarse_clock_tick()", detail, failures);
+            }
+            last = snapshot;
+        }
+    }
+
+    //  A resolution which is not a power of ten resolves as many digits
+    //  as the next power of ten up.
+
+    struct clock_snapshot snapshot;
+    const char *detail = 0;
+    if ( !coarse_clock_set_resolution(500000) || !coarse_clock_tick() ||
+         !coarse_clock_now(&snapshot) ) {
+        detail = "failed";
+    } else {
+        detail = check_snapshot(&snapshot, 4);
+    }
+    if ( detail ) {
+        report_failure("coarse_clock_tick()", detail, failures);
+    }
+
+    return snapshots + 1;
+}
+
+
+#ifndef __STDC_NO_THREADS__
+
+/*  Arguments passed to each thread  */
+
+struct thread_args {
+    bool tick;                  /*!<  Whether to tick before each read  */
+    long snapshots;             /*!<  Number of snapshots checked  */
+    long failures;              /*!<  Number of failures  */
+};
+
+
+/*!
+ * \brief           Reader thread function.
+ * \details         Reads the clock, and optionally ticks it, until
+ * RUN_NSECS have passed, checking every snapshot and that the clock never
+ * goes backwards.
+ * \param arg       A pointer to a struct thread_args.
+ * \returns         Zero.
+ */
+
+static int
+reader(void *arg) {
+    struct thread_args *const args = arg;
+    struct clock_snapshot last = {0};
+    struct timespec start;
+    struct timespec now;
+
+    timespec_get(&start, TIME_UTC);
+    do {
+        struct clock_snapshot snapshot;
+        if ( args->tick ) {
+            coarse_clock_tick();
+        }
+
+        const char *detail = 0;
+        if ( !coarse_clock_now(&snapshot) ) {
+            detail = "failed";
+        } else if ( is_earlier(snapshot.utc_ts, snapshot.nanoseconds,
+                               last.utc_ts, last.nanoseconds) ) {
+            detail = "clock went backwards";
+        } else if ( coarse_clock_time() < snapshot.utc_ts ) {
+            detail = "coarse_clock_time() went backwards";
+        } else {
+            detail = check_snapshot(&snapshot, -1);
+        }
+        if ( detail ) {
+            report_failure("coarse_clock_now()", detail, &args->failures);
+        }
+
+        last = snapshot;
+        ++args->snapshots;
+        timespec_get(&now, TIME_UTC);
+    } while ( (now.tv_sec - start.tv_sec) * NSECS_IN_SEC +
+              (now.tv_nsec - start.tv_nsec) < RUN_NSECS );
+
+    return 0;
+}
+
+
+/*!
+ * \brief           Checks reading the clock from several threads while
+ * it is ticked.
+ * \param failures  Incremented for each function which is wrong.
+ * \returns         The number of snapshots checked.
+ */
+
+static long
+check_threads(long *failures) {
+    thrd_t threads[NUM_READERS + NUM_TICKERS];
+    struct thread_args args[NUM_READERS + NUM_TICKERS];
+    size_t started = 0;
+    long snapshots = 0;
+
+    if ( !coarse_clock_start(1000000) ) {
+        report_failure("coarse_clock_start()", "failed", failures);
+        return 0;
+    }
+    if ( coarse_clock_start(1000000) ) {
+        report_failure("coarse_clock_start()", "started a second thread",
+                       failures);
+    }
+
+    const time_t first_ts = coarse_clock_time();
+    for ( ; started < ARRAY_LEN(threads); ++started ) {
+        args[started] = (struct thread_args) {started >= NUM_READERS, 0, 0};
+        if ( thrd_create(&threads[started], reader, &args[started]) !=
+             thrd_success ) {
+            report_failure("thrd_create()", "failed", failures);
+            break;
+        }
+    }
+    for ( size_t t = 0; t < started; ++t ) {
+        thrd_join(threads[t], 0);
+        snapshots += args[t].snapshots;
+        *failures += args[t].failures;
+    }
+
+    //  The updater thread was ticking all along, so a second or more has
+    //  passed on the clock once it has been running that long.
+
+    const struct timespec delay = {1, 0};
+    thrd_sleep(&delay, 0);
+    if ( coarse_clock_time() <= first_ts ) {
+        report_failure("coarse_clock_start()", "clock did not advance",
+                       failures);
+    }
+
+    //  Once stopped, the updater thread can be started again.
+
+    coarse_clock_stop();
+    coarse_clock_stop();
+    if ( !coarse_clock_start(1000000) ) {
+        report_failure("coarse_clock_start()", "failed after stopping",
+                       failures);
+    }
+    coarse_clock_stop();
+
+    return snapshots;
+}
+
+#endif          /*  __STDC_NO_THREADS__  */
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    long failures = 0;
+    long snapshots = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_clock: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    check_first_read(&failures);
+    snapshots += check_ticks(&failures);
+#ifndef __STDC_NO_THREADS__
+    snapshots += check_threads(&failures);
+#endif
+
+    printf("test_clock: %ld snapshots, %ld failures\n", snapshots,
+           failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
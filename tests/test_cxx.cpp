@@ -0,0 +1,299 @@
+/*!
+ * \file            test_cxx.cpp
+ * \brief           Tests the constexpr functions in pgtime.hpp against the
+ * C functions.
+ * \details         The functions in namespace `pgtime` are meant to give
+ * the same results as the C functions of the same names. This checks
+ * every member of their results, and whether they fail, for random
+ * times from 10000 BCE to 10000 CE, random additions and random dates
+ * with members out of range. It needs a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "pgtime.hpp"
+
+
+namespace {
+
+/*  Number of random times to check  */
+
+constexpr long num_times = 1000000;
+
+/*  The range of random timestamps, 10000 BCE to 10000 CE  */
+
+constexpr std::int64_t min_timestamp = -377705116800;
+constexpr std::int64_t timestamp_range = 631139040000;
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+std::uint64_t
+next_random(std::uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+std::int64_t
+random_in(std::uint64_t *state, const std::int64_t low,
+          const std::int64_t range) {
+    return low + static_cast<std::int64_t>(
+        next_random(state) % static_cast<std::uint64_t>(range));
+}
+
+
+/*!
+ * \brief           Checks whether two results are identical.
+ * \details         Both results must have failed, or both must have
+ * succeeded with every member the same, including `tm_wday`, `tm_yday`
+ * and `tm_isdst`.
+ * \param c_result  The result of the C function.
+ * \param c_tm      The struct tm the C function changed.
+ * \param cxx_result The result of the C++ function.
+ * \param cxx_tm    The struct tm the C++ function changed.
+ * \returns         true if the results are identical, false otherwise.
+ */
+
+bool
+same_result(const std::tm *c_result, const std::tm &c_tm,
+            const std::tm *cxx_result, const std::tm &cxx_tm) {
+    if ( !c_result || !cxx_result ) {
+        return !c_result && !cxx_result;
+    }
+
+    return c_tm.tm_year == cxx_tm.tm_year && c_tm.tm_mon == cxx_tm.tm_mon &&
+           c_tm.tm_mday == cxx_tm.tm_mday && c_tm.tm_hour == cxx_tm.tm_hour &&
+           c_tm.tm_min == cxx_tm.tm_min && c_tm.tm_sec == cxx_tm.tm_sec &&
+           c_tm.tm_wday == cxx_tm.tm_wday && c_tm.tm_yday == cxx_tm.tm_yday &&
+           c_tm.tm_isdst == cxx_tm.tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave different results.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+void
+report_failure(const char *name, const std::int64_t utc_ts, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        std::printf("pgtime::%s differs for timestamp %lld\n", name,
+                    static_cast<long long>(utc_ts));
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param failures  Incremented for each function which differs.
+ */
+
+void
+check_time(std::uint64_t *state, long *failures) {
+    const std::int64_t utc_ts = random_in(state, min_timestamp,
+                                          timestamp_range);
+
+    //  Breaking down and building up
+
+    std::tm c_tm{};
+    std::tm cxx_tm{};
+    if ( !same_result(::get_utc_tm(static_cast<std::time_t>(utc_ts), &c_tm),
+                      c_tm, pgtime::get_utc_tm(utc_ts, &cxx_tm), cxx_tm) ) {
+        report_failure("get_utc_tm()", utc_ts, failures);
+        return;
+    }
+    if ( static_cast<std::int64_t>(::get_utc_timestamp(&c_tm)) !=
+         pgtime::get_utc_timestamp(&cxx_tm) ) {
+        report_failure("get_utc_timestamp()", utc_ts, failures);
+    }
+
+    //  Adding a random number of seconds, sometimes far beyond the range
+    //  of tm_year, and a random number of each unit
+
+    const std::int64_t num_secs =
+        random_in(state, 0, 8) == 0 ?
+            random_in(state, INT64_MIN / 2, INT64_MAX) :
+            random_in(state, -10000000000, 20000000001);
+    std::tm c_changed = c_tm;
+    std::tm cxx_changed = cxx_tm;
+    if ( !same_result(::tm_add_seconds(&c_changed, num_secs), c_changed,
+                      pgtime::tm_add_seconds(&cxx_changed, num_secs),
+                      cxx_changed) ) {
+        report_failure("tm_add_seconds()", utc_ts, failures);
+    }
+
+    const int quantity = static_cast<int>(random_in(state, -1000000,
+                                                    2000001));
+    const int unit = static_cast<int>(random_in(state, 0, 8));
+    c_changed = c_tm;
+    cxx_changed = cxx_tm;
+    std::tm *c_result = nullptr;
+    std::tm *cxx_result = nullptr;
+    switch ( unit ) {
+        case 0:
+            c_result = ::tm_increment_day(&c_changed, quantity);
+            cxx_result = pgtime::tm_increment_day(&cxx_changed, quantity);
+            break;
+        case 1:
+            c_result = ::tm_increment_hour(&c_changed, quantity);
+            cxx_result = pgtime::tm_increment_hour(&cxx_changed, quantity);
+            break;
+        case 2:
+            c_result = ::tm_increment_minute(&c_changed, quantity);
+            cxx_result = pgtime::tm_increment_minute(&cxx_changed, quantity);
+            break;
+        case 3:
+            c_result = ::tm_increment_second(&c_changed, quantity);
+            cxx_result = pgtime::tm_increment_second(&cxx_changed, quantity);
+            break;
+        case 4:
+            c_result = ::tm_decrement_day(&c_changed, quantity);
+            cxx_result = pgtime::tm_decrement_day(&cxx_changed, quantity);
+            break;
+        case 5:
+            c_result = ::tm_decrement_hour(&c_changed, quantity);
+            cxx_result = pgtime::tm_decrement_hour(&cxx_changed, quantity);
+            break;
+        case 6:
+            c_result = ::tm_decrement_minute(&c_changed, quantity);
+            cxx_result = pgtime::tm_decrement_minute(&cxx_changed, quantity);
+            break;
+        default:
+            c_result = ::tm_decrement_second(&c_changed, quantity);
+            cxx_result = pgtime::tm_decrement_second(&cxx_changed, quantity);
+            break;
+    }
+    if ( !same_result(c_result, c_changed, cxx_result, cxx_changed) ) {
+        report_failure("tm_increment or tm_decrement", utc_ts, failures);
+    }
+
+    c_changed = c_tm;
+    cxx_changed = cxx_tm;
+    if ( !same_result(::tm_add_duration(&c_changed, quantity, -quantity,
+                                        quantity, -quantity), c_changed,
+                      pgtime::tm_add_duration(&cxx_changed, quantity,
+                                              -quantity, quantity,
+                                              -quantity), cxx_changed) ) {
+        report_failure("tm_add_duration()", utc_ts, failures);
+    }
+
+    //  Validating and comparing a date with members out of range
+
+    std::tm check_tm = c_tm;
+    check_tm.tm_mon = static_cast<int>(random_in(state, -1, 14));
+    check_tm.tm_mday = static_cast<int>(random_in(state, -1, 34));
+    check_tm.tm_sec = static_cast<int>(random_in(state, -1, 62));
+    if ( ::validate_date(&check_tm) != pgtime::validate_date(&check_tm) ) {
+        report_failure("validate_date()", utc_ts, failures);
+    }
+    if ( ::tm_compare(&c_tm, &check_tm) !=
+         pgtime::tm_compare(&c_tm, &check_tm) ) {
+        report_failure("tm_compare()", utc_ts, failures);
+    }
+
+    //  Calendar calculations, with the month out of range for
+    //  days_from_civil()
+
+    const std::int64_t year = c_tm.tm_year + std::int64_t(1900);
+    const int month = c_tm.tm_mon + 1;
+    const int day = c_tm.tm_mday;
+    const std::int64_t any_month =
+        random_in(state, 0, 8) == 0 ?
+            static_cast<std::int64_t>(INT_MAX) + random_in(state, -40, 81) :
+            random_in(state, -40, 81);
+    if ( ::is_leap_year(static_cast<int>(year)) !=
+             pgtime::is_leap_year(year) ||
+         ::day_of_week(year, month, day) !=
+             pgtime::day_of_week(year, month, day) ||
+         ::day_of_year(year, month, day) !=
+             pgtime::day_of_year(year, month, day) ||
+         ::days_from_civil(year, any_month, day) !=
+             pgtime::days_from_civil(year, any_month, day) ) {
+        report_failure("calendar functions", utc_ts, failures);
+    }
+}
+
+}       //  namespace
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main() {
+    std::uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(std::time_t) < sizeof(std::int64_t) ) {
+        std::printf("test_cxx: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( long i = 0; i < num_times; ++i ) {
+        check_time(&state, &failures);
+    }
+
+    //  Near the largest year, where the C functions must fail exactly when
+    //  the C++ functions do.
+
+    std::tm c_tm{};
+    c_tm.tm_year = INT_MAX - 1;
+    c_tm.tm_mon = 11;
+    c_tm.tm_mday = 31;
+    std::tm cxx_tm = c_tm;
+    for ( int days = 0; days < 800; days += 7 ) {
+        std::tm c_changed = c_tm;
+        std::tm cxx_changed = cxx_tm;
+        if ( !same_result(::tm_increment_day(&c_changed, days), c_changed,
+                          pgtime::tm_increment_day(&cxx_changed, days),
+                          cxx_changed) ) {
+            report_failure("tm_increment_day()", days, &failures);
+        }
+    }
+
+    //  Months at the ends of the range of an int, which must be widened
+    //  before 1 is added.
+
+    static const int extreme_months[] = {INT_MIN, INT_MIN + 1, INT_MAX - 1,
+                                         INT_MAX};
+    for ( const int month : extreme_months ) {
+        c_tm = std::tm{};
+        c_tm.tm_year = 113;
+        c_tm.tm_mon = month;
+        c_tm.tm_mday = 1;
+        cxx_tm = c_tm;
+        if ( !same_result(::tm_add_seconds(&c_tm, 86400), c_tm,
+                          pgtime::tm_add_seconds(&cxx_tm, 86400), cxx_tm) ) {
+            report_failure("tm_add_seconds()", month, &failures);
+        }
+    }
+
+    std::printf("test_cxx: %ld times, %ld failures\n", num_times, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,468 @@
+/*!
+ * \file            test_iso.c
+ * \brief           Tests the ISO 8601 / RFC 3339 formatter and parser
+ * against strftime(), timegm(), validate_date() and each other.
+ * \details         parse_iso8601() and parse_iso8601_timestamp() are given
+ * random dates with every field sometimes just out of range, in every
+ * accepted spelling of the separator, fraction and UTC offset, and must
+ * accept exactly the dates validate_date() does, giving the same time
+ * and timestamp as timegm(). Malformed and truncated timestamps must be
+ * rejected. format_iso8601() and format_iso8601_timestamp() are
+ * checked against strftime() for random times from 10000 BCE to 10000 CE,
+ * and everything they write in every iso_format, including years in the
+ * expanded representation, must be read back by parse_iso8601() and
+ * parse_iso8601_timestamp() as the same time, fraction and UTC offset.
+ * Years which cannot be represented in a struct tm must not be parsed.
+ * It needs a libc which provides timegm() and gmtime_r() and a time_t of
+ * at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_iso.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of random times to check  */
+
+#define NUM_TIMES 1000000
+
+/*  The range of random timestamps, 10000 BCE to 10000 CE  */
+
+#define MIN_TIMESTAMP INT64_C(-377705116800)
+#define TIMESTAMP_RANGE INT64_C(631139040000)
+
+/*  Nanoseconds in a second, and seconds in a day  */
+
+#define NSECS_IN_SEC 1000000000L
+#define SECS_IN_DAY 86400
+
+
+/*  The formats to check  */
+
+static const enum iso_format formats[] = {
+    ISO_FORMAT_EXTENDED, ISO_FORMAT_RFC3339, ISO_FORMAT_BASIC
+};
+
+/*  Timestamps which must not parse, since they are malformed or
+ *  truncated, or their UTC offsets are out of range  */
+
+static const char *const malformed[] = {
+    "", "2023-11-14T22:13", "2023-11-14T22:13:2", "2023/11/14T22:13:20",
+    "2023-11-14X22:13:20", "2023-11-14T22-13-20", "2023-11-14T22:13:20.",
+    "2023-11-14T22:13:20,Z", "2023-11-14T22:13:20+5", "2023-11-14T22:13:20+",
+    "2023-11-14T22:13:20+24:00", "2023-11-14T22:13:20+05:60",
+    "2023-1a-14T22:13:20", "20231114T2213",
+    "2023-11-14T221320", " 2023-11-14T22:13:20"
+};
+
+/*  Timestamps which must not parse, since their years are beyond the
+ *  range of tm_year, have too many digits, or need a sign  */
+
+static const char *const bad_years[] = {
+    "+2147485548-01-01T00:00:00Z", "-2147481749-12-31T23:59:59Z",
+    "+21474855480101T000000Z", "+10000000000-01-01T00:00:00Z",
+    "10000-01-01T00:00:00Z", "100000101T000000Z", "+999-01-01T00:00:00Z",
+    "-0001-12-31T235959Z", "00011231T23:59:59Z"
+};
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param text      The timestamp it was given or wrote.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const char *text, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong for \"%s\"\n", name, text);
+    }
+}
+
+
+/*!
+ * \brief           Parses one random date, written with random spellings.
+ * \param state     The state of the random number generator.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_parse(uint64_t *state, long *failures) {
+    static const char separators[] = "Tt ";
+    static const char *const fields_formats[] = {
+        "%04d-%02d-%02d%c%02d:%02d:%02d", "%04d%02d%02d%c%02d%02d%02d"
+    };
+    static const char trailer[] = " INFO";
+    char text[80];
+
+    //  Every field is sometimes one beyond its range, so about half of
+    //  the dates are invalid.
+
+    struct tm expected_tm = {0};
+    expected_tm.tm_year = (int) random_in(state, -1900, 10000);
+    expected_tm.tm_mon = (int) random_in(state, -1, 14);
+    expected_tm.tm_mday = (int) random_in(state, 0, 33);
+    expected_tm.tm_hour = (int) random_in(state, 0, 25);
+    expected_tm.tm_min = (int) random_in(state, 0, 61);
+    expected_tm.tm_sec = (int) random_in(state, 0, 61);
+    const bool valid = validate_date(&expected_tm);
+
+    const bool extended = random_in(state, 0, 2);
+    int len = snprintf(text, sizeof text, fields_formats[!extended],
+                       expected_tm.tm_year + 1900, expected_tm.tm_mon + 1,
+                       expected_tm.tm_mday,
+                       separators[random_in(state, 0, 3)],
+                       expected_tm.tm_hour, expected_tm.tm_min,
+                       expected_tm.tm_sec);
+
+    //  A fraction of up to twelve digits, of which only nine count
+
+    long expected_nsecs = 0;
+    const int num_digits = (int) random_in(state, 0, 13);
+    if ( num_digits > 0 ) {
+        text[len++] = random_in(state, 0, 2) ? '.' : ',';
+        for ( int i = 0; i < num_digits; ++i ) {
+            const int digit = (int) random_in(state, 0, 10);
+            text[len++] = (char) ('0' + digit);
+            if ( i < 9 ) {
+                expected_nsecs = expected_nsecs * 10 + digit;
+            }
+        }
+        for ( int i = num_digits; i < 9; ++i ) {
+            expected_nsecs *= 10;
+        }
+    }
+
+    //  No offset, `Z` or `z`, or `+hh:mm`, `+hhmm` or `+hh` with either
+    //  sign
+
+    int expected_offset = 0;
+    const int offset_style = (int) random_in(state, 0, 5);
+    const int sign = random_in(state, 0, 2) ? 1 : -1;
+    const int offset_hours = (int) random_in(state, 0, 24);
+    const int offset_mins = (int) random_in(state, 0, 60);
+    if ( offset_style == 1 ) {
+        text[len++] = random_in(state, 0, 2) ? 'Z' : 'z';
+    } else if ( offset_style > 1 ) {
+        static const char *const offset_formats[] = {
+            "%c%02d:%02d", "%c%02d%02d", "%c%02d"
+        };
+        len += snprintf(text + len, sizeof text - (size_t) len,
+                        offset_formats[offset_style - 2],
+                        sign > 0 ? '+' : '-', offset_hours, offset_mins);
+        expected_offset = sign * (offset_hours * 3600 +
+                                  (offset_style < 4 ? offset_mins * 60 : 0));
+    }
+
+    const char *const end = text + len;
+    memcpy(text + len, trailer, sizeof trailer);
+    len += (int) strlen(trailer);
+
+    struct tm parsed_tm;
+    long parsed_nsecs = -1;
+    int parsed_offset = -1;
+    const char *parsed_end = parse_iso8601(text, (size_t) len, &parsed_tm,
+                                           &parsed_nsecs, &parsed_offset);
+    if ( !valid ) {
+        if ( parsed_end ) {
+            report_failure("parse_iso8601()", text, failures);
+        }
+        return;
+    }
+
+    struct tm copy_tm = expected_tm;
+    const time_t local_ts = timegm(&copy_tm);
+    if ( parsed_end != end || !same_tm(&parsed_tm, &copy_tm) ||
+         parsed_nsecs != expected_nsecs ||
+         parsed_offset != expected_offset ) {
+        report_failure("parse_iso8601()", text, failures);
+    }
+
+    time_t parsed_ts = 0;
+    if ( parse_iso8601_timestamp(text, (size_t) len, &parsed_ts,
+                                 &parsed_nsecs) != end ||
+         parsed_ts != local_ts - expected_offset ||
+         parsed_nsecs != expected_nsecs ) {
+        report_failure("parse_iso8601_timestamp()", text, failures);
+    }
+
+    //  Cut short anywhere inside the date and time, it must be rejected,
+    //  and cut short after the seconds, the rest must be ignored.
+
+    const size_t date_time_len = extended ? 19 : 15;
+    const size_t cut = (size_t) random_in(state, 0, (int64_t) date_time_len);
+    if ( parse_iso8601(text, cut, &parsed_tm, 0, 0) ||
+         parse_iso8601(text, date_time_len, &parsed_tm, &parsed_nsecs,
+                       &parsed_offset) != text + date_time_len ||
+         parsed_nsecs != 0 || parsed_offset != 0 ) {
+        report_failure("parse_iso8601()", text, failures);
+    }
+}
+
+
+/*!
+ * \brief               Formats a time and parses it back.
+ * \param utc_tm        The time to format, with `tm_wday` and `tm_yday`
+ * set.
+ * \param nanoseconds   The fraction of a second in nanoseconds.
+ * \param precision     The number of fractional digits to write.
+ * \param utc_offset    The UTC offset to write.
+ * \param format        The format to write.
+ * \param failures      Incremented if the time read back differs.
+ */
+
+static void
+check_round_trip(const struct tm *utc_tm, const long nanoseconds,
+                 const int precision, const int utc_offset,
+                 const enum iso_format format, long *failures) {
+    static const long divisors[] = {1000000000, 100000000, 10000000,
+                                    1000000, 100000, 10000, 1000, 100, 10, 1};
+    char buffer[PGTIME_ISO8601_BUFSIZE];
+
+    const size_t len = format_iso8601(buffer, sizeof buffer, utc_tm,
+                                      nanoseconds, precision, utc_offset,
+                                      format);
+    if ( len == 0 ) {
+        report_failure("format_iso8601()", "", failures);
+        return;
+    }
+
+    //  The fraction is truncated, and the offset is written in whole
+    //  minutes, or not at all.
+
+    const long written_nsecs = nanoseconds / divisors[precision] *
+                               divisors[precision];
+    const int written_offset = format == ISO_FORMAT_EXTENDED ? 0 :
+                               utc_offset / 60 * 60;
+
+    struct tm parsed_tm;
+    long parsed_nsecs = -1;
+    int parsed_offset = -1;
+    if ( parse_iso8601(buffer, len, &parsed_tm, &parsed_nsecs,
+                       &parsed_offset) != buffer + len ||
+         !same_tm(&parsed_tm, utc_tm) || parsed_nsecs != written_nsecs ||
+         parsed_offset != written_offset ) {
+        report_failure("parse_iso8601()", buffer, failures);
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(uint64_t *state, long *failures) {
+    const time_t utc_ts = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    const long nsecs = (long) random_in(state, 0, NSECS_IN_SEC);
+    const int precision = (int) random_in(state, 0, 10);
+    const int utc_offset = (int) random_in(state, 1 - SECS_IN_DAY,
+                                           2 * SECS_IN_DAY - 1);
+    struct tm utc_tm;
+    gmtime_r(&utc_ts, &utc_tm);
+
+    //  The date and time part against strftime(), where the year has
+    //  exactly four digits.
+
+    char buffer[PGTIME_ISO8601_BUFSIZE];
+    char expected[PGTIME_ISO8601_BUFSIZE];
+    if ( utc_tm.tm_year >= 1000 - 1900 && utc_tm.tm_year <= 9999 - 1900 ) {
+        strftime(expected, sizeof expected, "%Y-%m-%dT%H:%M:%S", &utc_tm);
+        if ( format_iso8601(buffer, sizeof buffer, &utc_tm, nsecs, 0, 0,
+                            ISO_FORMAT_EXTENDED) != strlen(expected) ||
+             strcmp(buffer, expected) != 0 ) {
+            report_failure("format_iso8601()", expected, failures);
+        }
+
+        strftime(expected, sizeof expected, "%Y%m%dT%H%M%SZ", &utc_tm);
+        if ( format_iso8601_timestamp(buffer, sizeof buffer, utc_ts, nsecs,
+                                      0, ISO_FORMAT_BASIC) !=
+                 strlen(expected) ||
+             strcmp(buffer, expected) != 0 ) {
+            report_failure("format_iso8601_timestamp()", expected, failures);
+        }
+    }
+
+    //  And back again, in every format.
+
+    for ( size_t i = 0; i < ARRAY_LEN(formats); ++i ) {
+        check_round_trip(&utc_tm, nsecs, precision, utc_offset, formats[i],
+                         failures);
+
+        //  Twice in the same second, so that the second comes from the
+        //  formatter's cache.
+
+        for ( int repeat = 0; repeat < 2; ++repeat ) {
+            const long repeat_nsecs = (nsecs + repeat * 123456789) %
+                                      NSECS_IN_SEC;
+            const size_t len = format_iso8601_timestamp(buffer,
+                                                        sizeof buffer,
+                                                        utc_ts, repeat_nsecs,
+                                                        9, formats[i]);
+            time_t parsed_ts = 0;
+            long parsed_nsecs = -1;
+            if ( len == 0 ||
+                 parse_iso8601_timestamp(buffer, len, &parsed_ts,
+                                         &parsed_nsecs) != buffer + len ||
+                 parsed_ts != utc_ts || parsed_nsecs != repeat_nsecs ) {
+                report_failure("parse_iso8601_timestamp()", buffer,
+                               failures);
+            }
+        }
+    }
+}
+
+
+/*!
+ * \brief           Checks that malformed timestamps are rejected.
+ * \param failures  Incremented for each one which is parsed.
+ */
+
+static void
+check_malformed(long *failures) {
+    for ( size_t i = 0; i < ARRAY_LEN(malformed); ++i ) {
+        struct tm parsed_tm;
+        if ( parse_iso8601(malformed[i], strlen(malformed[i]), &parsed_tm,
+                           0, 0) ) {
+            report_failure("parse_iso8601()", malformed[i], failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief           Checks the years at the ends of the range of tm_year,
+ * and around the change to the expanded representation.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_years(long *failures) {
+    static const int years[] = {
+        INT_MIN, INT_MIN + 1, -10000 - 1900, -1 - 1900, -1900,
+        9999 - 1900, 10000 - 1900, INT_MAX - 1, INT_MAX
+    };
+
+    for ( size_t i = 0; i < ARRAY_LEN(years); ++i ) {
+        const int64_t year = years[i] + INT64_C(1900);
+        struct tm utc_tm = {0};
+        utc_tm.tm_year = years[i];
+        utc_tm.tm_mon = 11;
+        utc_tm.tm_mday = 31;
+        utc_tm.tm_hour = 23;
+        utc_tm.tm_min = 59;
+        utc_tm.tm_sec = 59;
+        utc_tm.tm_wday = day_of_week(year, 12, 31);
+        utc_tm.tm_yday = day_of_year(year, 12, 31);
+
+        for ( size_t j = 0; j < ARRAY_LEN(formats); ++j ) {
+            check_round_trip(&utc_tm, 999999999, 9, -3600, formats[j],
+                             failures);
+        }
+    }
+
+    for ( size_t i = 0; i < ARRAY_LEN(bad_years); ++i ) {
+        struct tm parsed_tm;
+        if ( parse_iso8601(bad_years[i], strlen(bad_years[i]), &parsed_tm,
+                           0, 0) ) {
+            report_failure("parse_iso8601()", bad_years[i], failures);
+        }
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_iso: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_parse(&state, &failures);
+        check_time(&state, &failures);
+    }
+    check_malformed(&failures);
+    check_years(&failures);
+
+    printf("test_iso: %ld times, %ld failures\n", (long) NUM_TIMES,
+           failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,479 @@
+/*!
+ * \file            test_leap.c
+ * \brief           Tests the leap second functions against a list of the
+ * leap seconds.
+ * \details         leap_tai_offset(), utc_to_tai() and utc_to_gps() are
+ * checked against TAI - UTC found by scanning the list of leap seconds in
+ * this file, for random times from 1960 to 2100 and on either side of
+ * every leap second, and tai_to_utc() and gps_to_utc() must convert their
+ * results back. Every second from 23:59:59 to 00:00:00 around each leap
+ * second gets its own TAI timestamp, and 23:59:60 must be a leap second,
+ * and valid, on those days and no others. The built-in table and the
+ * system `leap-seconds.list`, if there is one, are both checked, and
+ * files which are missing or malformed must not load. It needs a libc
+ * which provides gmtime_r(), timegm() and mkstemp(), and a time_t of at
+ * least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "pgtime.h"
+#include "pgtime_leap.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of random times to check with each table  */
+
+#define NUM_TIMES 1000000
+
+/*  The range of random timestamps, 1960 to 2100  */
+
+#define MIN_TIMESTAMP INT64_C(-315619200)
+#define TIMESTAMP_RANGE INT64_C(4417977600)
+
+/*  TAI - UTC before the first leap second, and the GPS epoch, as a POSIX
+ *  timestamp, with its offset from TAI  */
+
+#define FIRST_TAI_OFFSET 10
+#define GPS_EPOCH INT64_C(315964800)
+#define GPS_TAI_OFFSET 19
+
+
+/*  The days on which TAI - UTC increased, after the leap second which
+ *  ended the previous day  */
+
+static const struct {
+    int year;
+    int month;
+} leap_days[] = {
+    {1972, 7}, {1973, 1}, {1974, 1}, {1975, 1}, {1976, 1}, {1977, 1},
+    {1978, 1}, {1979, 1}, {1980, 1}, {1981, 7}, {1982, 7}, {1983, 7},
+    {1985, 7}, {1988, 1}, {1990, 1}, {1991, 1}, {1992, 7}, {1993, 7},
+    {1994, 7}, {1996, 1}, {1997, 7}, {1999, 1}, {2006, 1}, {2009, 1},
+    {2012, 7}, {2015, 7}, {2017, 1}
+};
+
+/*  The POSIX timestamps of the first second of those days  */
+
+static time_t leap_midnights[ARRAY_LEN(leap_days)];
+
+/*  Leap second files which must not load  */
+
+static const char *const bad_files[] = {
+    "",
+    "# Only comments\n",
+    "2272060800\n",
+    "2272060800 10\n2272060800 11\n",
+    "2287785600 11\n2272060800 10\n",
+    "2272060800 10\nnot a number\n",
+    "#@ never\n2272060800 10\n"
+};
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Returns TAI - UTC by scanning the list of leap seconds.
+ * \param utc_ts    The POSIX timestamp.
+ * \returns         TAI - UTC in seconds.
+ */
+
+static int
+expected_offset(const time_t utc_ts) {
+    int offset = FIRST_TAI_OFFSET;
+    for ( size_t i = 0; i < ARRAY_LEN(leap_midnights); ++i ) {
+        if ( utc_ts >= leap_midnights[i] ) {
+            offset = FIRST_TAI_OFFSET + (int) i + 1;
+        }
+    }
+    return offset;
+}
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param table     The name of the table.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const char *table, const time_t utc_ts,
+               long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong with the %s table for timestamp %lld\n", name,
+               table, (long long) utc_ts);
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one UTC time.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param name      The name of the table.
+ * \param utc_ts    The POSIX timestamp.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(const struct leap_table *table, const char *name,
+           const time_t utc_ts, long *failures) {
+    const int offset = expected_offset(utc_ts);
+    if ( leap_tai_offset(table, utc_ts) != offset ) {
+        report_failure("leap_tai_offset()", name, utc_ts, failures);
+        return;
+    }
+
+    struct tm utc_tm;
+    gmtime_r(&utc_ts, &utc_tm);
+    if ( is_leap_second(table, &utc_tm) ||
+         !validate_date_leap(table, &utc_tm) ) {
+        report_failure("is_leap_second()", name, utc_ts, failures);
+    }
+
+    //  To TAI and back
+
+    const int64_t tai_ts = (int64_t) utc_ts + offset;
+    int64_t result = 0;
+    struct tm back_tm;
+    if ( !utc_to_tai(table, &utc_tm, &result) || result != tai_ts ) {
+        report_failure("utc_to_tai()", name, utc_ts, failures);
+    }
+    if ( !tai_to_utc(table, tai_ts, &back_tm) ||
+         !same_tm(&back_tm, &utc_tm) ) {
+        report_failure("tai_to_utc()", name, utc_ts, failures);
+    }
+
+    //  To GPS time and back
+
+    const int64_t gps_ts = tai_ts - GPS_TAI_OFFSET - GPS_EPOCH;
+    if ( !utc_to_gps(table, &utc_tm, &result) || result != gps_ts ) {
+        report_failure("utc_to_gps()", name, utc_ts, failures);
+    }
+    if ( !gps_to_utc(table, gps_ts, &back_tm) ||
+         !same_tm(&back_tm, &utc_tm) ) {
+        report_failure("gps_to_utc()", name, utc_ts, failures);
+    }
+}
+
+
+/*!
+ * \brief           Checks the seconds around each leap second, and the
+ * same times on days without one.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param name      The name of the table.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_leap_seconds(const struct leap_table *table, const char *name,
+                   long *failures) {
+    for ( size_t i = 0; i < ARRAY_LEN(leap_midnights); ++i ) {
+        const time_t midnight = leap_midnights[i];
+        for ( time_t utc_ts = midnight - 2; utc_ts <= midnight + 1;
+              ++utc_ts ) {
+            check_time(table, name, utc_ts, failures);
+        }
+
+        //  23:59:60 comes one TAI second after 23:59:59 and one before
+        //  midnight.
+
+        struct tm leap_tm;
+        const time_t last_ts = midnight - 1;
+        gmtime_r(&last_ts, &leap_tm);
+        leap_tm.tm_sec = 60;
+
+        const int64_t tai_ts = (int64_t) midnight + FIRST_TAI_OFFSET +
+                               (int64_t) i;
+        int64_t result = 0;
+        struct tm back_tm;
+        if ( !is_leap_second(table, &leap_tm) ||
+             !validate_date_leap(table, &leap_tm) ) {
+            report_failure("is_leap_second()", name, midnight, failures);
+        }
+        if ( !utc_to_tai(table, &leap_tm, &result) || result != tai_ts ) {
+            report_failure("utc_to_tai()", name, midnight, failures);
+        }
+        if ( !tai_to_utc(table, tai_ts, &back_tm) ||
+             !same_tm(&back_tm, &leap_tm) ) {
+            report_failure("tai_to_utc()", name, midnight, failures);
+        }
+        if ( !utc_to_gps(table, &leap_tm, &result) ||
+             result != tai_ts - GPS_TAI_OFFSET - GPS_EPOCH ||
+             !gps_to_utc(table, result, &back_tm) ||
+             !same_tm(&back_tm, &leap_tm) ) {
+            report_failure("utc_to_gps()", name, midnight, failures);
+        }
+
+        //  A second leap second is never valid, nor is one a day early,
+        //  nor one half a year later unless that day had one too.
+
+        leap_tm.tm_sec = 61;
+        if ( is_leap_second(table, &leap_tm) ||
+             validate_date_leap(table, &leap_tm) ) {
+            report_failure("is_leap_second()", name, midnight, failures);
+        }
+
+        struct tm later_tm;
+        gmtime_r(&midnight, &later_tm);
+        later_tm.tm_mon += 6;
+        const time_t other_ts[] = {midnight - 86401, timegm(&later_tm) - 1};
+        for ( size_t j = 0; j < ARRAY_LEN(other_ts); ++j ) {
+            if ( expected_offset(other_ts[j] + 1) !=
+                 expected_offset(other_ts[j]) ) {
+                continue;
+            }
+            gmtime_r(&other_ts[j], &leap_tm);
+            leap_tm.tm_sec = 60;
+            if ( is_leap_second(table, &leap_tm) ||
+                 validate_date_leap(table, &leap_tm) ) {
+                report_failure("is_leap_second()", name, other_ts[j],
+                               failures);
+            }
+        }
+    }
+}
+
+
+/*!
+ * \brief           Checks one table.
+ * \param state     The state of the random number generator.
+ * \param table     The table, or a null pointer for the built-in table.
+ * \param name      The name of the table.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_table(uint64_t *state, const struct leap_table *table,
+            const char *name, long *failures) {
+    check_leap_seconds(table, name, failures);
+
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_time(table, name, (time_t) random_in(state, MIN_TIMESTAMP,
+                                                   TIMESTAMP_RANGE),
+                   failures);
+    }
+
+    //  Known values, and the GPS epoch
+
+    static const struct {
+        time_t utc_ts;
+        int offset;
+    } known[] = {
+        {0, 10}, {63072000, 10}, {78796799, 10}, {78796800, 11},
+        {1483228799, 36}, {1483228800, 37}, {1700000000, 37}
+    };
+    for ( size_t i = 0; i < ARRAY_LEN(known); ++i ) {
+        if ( leap_tai_offset(table, known[i].utc_ts) != known[i].offset ) {
+            report_failure("leap_tai_offset()", name, known[i].utc_ts,
+                           failures);
+        }
+    }
+
+    struct tm gps_tm;
+    if ( !gps_to_utc(table, 0, &gps_tm) || gps_tm.tm_year != 80 ||
+         gps_tm.tm_mon != 0 || gps_tm.tm_mday != 6 || gps_tm.tm_hour ||
+         gps_tm.tm_min || gps_tm.tm_sec ) {
+        report_failure("gps_to_utc()", name, GPS_EPOCH, failures);
+    }
+
+    //  The first entry of the table started TAI - UTC at 10 seconds
+    //  rather than adding a leap second.
+
+    struct tm first_tm = {0};
+    first_tm.tm_year = 71;
+    first_tm.tm_mon = 11;
+    first_tm.tm_mday = 31;
+    first_tm.tm_hour = 23;
+    first_tm.tm_min = 59;
+    first_tm.tm_sec = 60;
+    if ( is_leap_second(table, &first_tm) ||
+         validate_date_leap(table, &first_tm) ) {
+        report_failure("is_leap_second()", name, 63072000, failures);
+    }
+
+    //  A TAI time whose year cannot be represented
+
+    struct tm utc_tm;
+    if ( tai_to_utc(table, INT64_MAX, &utc_tm) ) {
+        report_failure("tai_to_utc()", name, 0, failures);
+    }
+}
+
+
+/*!
+ * \brief           Writes a leap second file and loads it.
+ * \param contents  The contents of the file.
+ * \param loaded    Modified to contain the table, or a null pointer.
+ * \returns         true if the file could be written, false otherwise.
+ */
+
+static bool
+load_contents(const char *contents, struct leap_table **loaded) {
+    char path[] = "/tmp/test_leap_XXXXXX";
+    const int fd = mkstemp(path);
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    const size_t len = strlen(contents);
+    const bool written = write(fd, contents, len) == (ssize_t) len;
+    close(fd);
+    *loaded = written ? leap_table_load(path) : 0;
+    unlink(path);
+
+    return written;
+}
+
+
+/*!
+ * \brief           Checks loading leap second files.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_load(long *failures) {
+    static const char *const bad_paths[] = {"/no/such/file", "/dev/null",
+                                            "/"};
+    for ( size_t i = 0; i < ARRAY_LEN(bad_paths); ++i ) {
+        struct leap_table *const table = leap_table_load(bad_paths[i]);
+        if ( table ) {
+            report_failure("leap_table_load()", bad_paths[i], 0, failures);
+            leap_table_free(table);
+        }
+    }
+
+    for ( size_t i = 0; i < ARRAY_LEN(bad_files); ++i ) {
+        struct leap_table *table = 0;
+        if ( !load_contents(bad_files[i], &table) || table ) {
+            report_failure("leap_table_load()", "malformed", (time_t) i,
+                           failures);
+            leap_table_free(table);
+        }
+    }
+
+    //  A short file, with blank lines, which expires on 2000-01-01
+
+    struct leap_table *table = 0;
+    if ( !load_contents("#@\t3155673600\n\n2272060800\t10\t# 1 Jan 1972\n"
+                        "2287785600\t11\n  \n", &table) || !table ) {
+        report_failure("leap_table_load()", "short", 0, failures);
+        return;
+    }
+    if ( leap_table_expiry(table) != 946684800 ||
+         leap_tai_offset(table, 78796799) != 10 ||
+         leap_tai_offset(table, 1483228800) != 11 ) {
+        report_failure("leap_table_load()", "short", 0, failures);
+    }
+    leap_table_free(table);
+    leap_table_free(0);
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+    int tables = 1;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_leap: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( size_t i = 0; i < ARRAY_LEN(leap_days); ++i ) {
+        struct tm day_tm = {0};
+        day_tm.tm_year = leap_days[i].year - 1900;
+        day_tm.tm_mon = leap_days[i].month - 1;
+        day_tm.tm_mday = 1;
+        leap_midnights[i] = timegm(&day_tm);
+    }
+
+    if ( leap_table_builtin() != leap_table_builtin() ||
+         leap_table_expiry(0) != leap_table_expiry(leap_table_builtin()) ) {
+        report_failure("leap_table_builtin()", "built-in", 0, &failures);
+    }
+    check_table(&state, 0, "built-in", &failures);
+    check_load(&failures);
+
+    //  The system table lists the same leap seconds, unless it has been
+    //  updated since this test was written.
+
+    struct leap_table *const system = leap_table_load(0);
+    if ( system ) {
+        check_table(&state, system, "system", &failures);
+        leap_table_free(system);
+        ++tables;
+    }
+
+    printf("test_leap: %d tables, %ld times, %ld failures\n", tables,
+           (long) tables * NUM_TIMES, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/*!
+ * \file            test_libc.c
+ * \brief           Tests the UTC conversion and arithmetic functions against
+ * timegm() and gmtime_r().
+ * \details         get_utc_tm(), get_utc_timestamp(), tm_add_seconds(),
+ * tm_add_duration(), the day, hour, minute and second increment and
+ * decrement functions, and tm_secs_diff() calculate without libc where
+ * time_t counts POSIX seconds. This checks every member of their results,
+ * including `tm_wday` and `tm_yday`, against timegm() and gmtime_r() for
+ * random times from 10000 BCE to 10000 CE without the date table, and
+ * from 1800 to 2200 with it, so that dates on both sides of its bounds
+ * are checked. It needs a libc which provides timegm() and gmtime_r() and
+ * a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+
+
+/*  Number of random times to check in each pass  */
+
+#define NUM_TIMES 1000000
+
+/*  The ranges of random timestamps, 10000 BCE to 10000 CE, and 1800 to
+ *  2200 around a date table from 1900 to 2100  */
+
+#define WIDE_MIN_TIMESTAMP INT64_C(-377705116800)
+#define WIDE_TIMESTAMP_RANGE INT64_C(631139040000)
+#define TABLE_MIN_TIMESTAMP INT64_C(-5364662400)
+#define TABLE_TIMESTAMP_RANGE INT64_C(12622780800)
+
+/*  Largest random offset added to a time, about 300 years either way  */
+
+#define MAX_OFFSET INT64_C(10000000000)
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Checks whether two struct tms are identical.
+ * \details         Unlike tm_compare(), this also compares `tm_wday`,
+ * `tm_yday` and `tm_isdst`.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const time_t utc_ts, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong for timestamp %lld\n", name, (long long) utc_ts);
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param min_ts    The earliest timestamp to choose.
+ * \param range     The number of timestamps to choose from.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(uint64_t *state, const int64_t min_ts, const int64_t range,
+           long *failures) {
+    const time_t utc_ts = (time_t) random_in(state, min_ts, range);
+    struct tm expected;
+    struct tm result;
+
+    //  Breaking down and building up
+
+    gmtime_r(&utc_ts, &expected);
+    if ( !get_utc_tm(utc_ts, &result) || !same_tm(&result, &expected) ) {
+        report_failure("get_utc_tm()", utc_ts, failures);
+    }
+
+    struct tm copy_tm = expected;
+    if ( get_utc_timestamp(&expected) != timegm(&copy_tm) ) {
+        report_failure("get_utc_timestamp()", utc_ts, failures);
+    }
+
+    //  Adding seconds, and a duration in mixed units
+
+    const int64_t offset = random_in(state, -MAX_OFFSET, 2 * MAX_OFFSET + 1);
+    const time_t shifted_ts = (time_t) (utc_ts + offset);
+    struct tm shifted_tm;
+    gmtime_r(&shifted_ts, &shifted_tm);
+
+    result = expected;
+    if ( !tm_add_seconds(&result, offset) ||
+         !same_tm(&result, &shifted_tm) ) {
+        report_failure("tm_add_seconds()", utc_ts, failures);
+    }
+
+    const int64_t days = offset / 86400;
+    const int64_t hours = offset % 86400 / 3600;
+    const int64_t minutes = offset % 3600 / 60;
+    const int64_t seconds = offset % 60;
+    result = expected;
+    if ( !tm_add_duration(&result, days, hours, minutes, seconds) ||
+         !same_tm(&result, &shifted_tm) ) {
+        report_failure("tm_add_duration()", utc_ts, failures);
+    }
+
+    if ( tm_secs_diff(&expected, &shifted_tm) != offset ) {
+        report_failure("tm_secs_diff()", utc_ts, failures);
+    }
+
+    //  Incrementing and decrementing by a number of each unit, which
+    //  stays well within an int
+
+    static const int unit_secs[] = {86400, 3600, 60, 1};
+    static const char *names[] = {
+        "tm_increment_day()", "tm_increment_hour()", "tm_increment_minute()",
+        "tm_increment_second()", "tm_decrement_day()", "tm_decrement_hour()",
+        "tm_decrement_minute()", "tm_decrement_second()"
+    };
+
+    const int unit = (int) random_in(state, 0, 8);
+    const int quantity = (int) random_in(state, -1000000, 2000001);
+    const int sign = unit < 4 ? 1 : -1;
+    const time_t moved_ts = (time_t) (utc_ts + (int64_t) sign * quantity *
+                                               unit_secs[unit % 4]);
+    struct tm moved_tm;
+    gmtime_r(&moved_ts, &moved_tm);
+
+    result = expected;
+    struct tm *moved = 0;
+    switch ( unit ) {
+        case 0:
+            moved = tm_increment_day(&result, quantity);
+            break;
+        case 1:
+            moved = tm_increment_hour(&result, quantity);
+            break;
+        case 2:
+            moved = tm_increment_minute(&result, quantity);
+            break;
+        case 3:
+            moved = tm_increment_second(&result, quantity);
+            break;
+        case 4:
+            moved = tm_decrement_day(&result, quantity);
+            break;
+        case 5:
+            moved = tm_decrement_hour(&result, quantity);
+            break;
+        case 6:
+            moved = tm_decrement_minute(&result, quantity);
+            break;
+        default:
+            moved = tm_decrement_second(&result, quantity);
+            break;
+    }
+    if ( !moved || !same_tm(&result, &moved_tm) ) {
+        report_failure(names[unit], utc_ts, failures);
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_libc: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_time(&state, WIDE_MIN_TIMESTAMP, WIDE_TIMESTAMP_RANGE,
+                   &failures);
+    }
+
+    if ( !date_table_init(1900, 2100) ) {
+        printf("test_libc: couldn't build the date table.\n");
+        return EXIT_FAILURE;
+    }
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_time(&state, TABLE_MIN_TIMESTAMP, TABLE_TIMESTAMP_RANGE,
+                   &failures);
+    }
+    date_table_free();
+
+    //  The extreme timestamps are far beyond the range of tm_year, and
+    //  must fail rather than overflow.
+
+    static const int64_t extremes[] = {INT64_MIN, INT64_MIN + 1,
+                                       INT64_MAX - 1, INT64_MAX};
+    for ( size_t i = 0; i < sizeof extremes / sizeof *extremes; ++i ) {
+        struct tm result;
+        if ( get_utc_tm((time_t) extremes[i], &result) ) {
+            report_failure("get_utc_tm()", (time_t) extremes[i], &failures);
+        }
+    }
+
+    printf("test_libc: %ld times, %ld failures\n", 2L * NUM_TIMES, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
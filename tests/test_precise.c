@@ -0,0 +1,318 @@
+/*!
+ * \file            test_precise.c
+ * \brief           Tests the nanosecond-precision functions against
+ * gmtime_r() and 64-bit arithmetic.
+ * \details         get_utc_precise_tm() and get_utc_timespec() are checked
+ * against gmtime_r() for random times from 10000 BCE to 10000 CE, with
+ * `tv_nsec` sometimes seconds out of its normal range. precise_tm_add()
+ * and the millisecond, microsecond and nanosecond increment and decrement
+ * functions are checked against adding nanoseconds to a timestamp, the
+ * differences against subtracting them, and comparison and packing
+ * against each other. Times whose carry takes them past the limits of
+ * time_t must fail rather than overflow. It needs a libc which provides
+ * gmtime_r() and a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_precise.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of random times to check  */
+
+#define NUM_TIMES 1000000
+
+/*  The range of random timestamps, 10000 BCE to 10000 CE  */
+
+#define MIN_TIMESTAMP INT64_C(-377705116800)
+#define TIMESTAMP_RANGE INT64_C(631139040000)
+
+/*  Nanoseconds in a second, and the most nanoseconds added at once,
+ *  about 117 years  */
+
+#define NSECS_IN_SEC INT64_C(1000000000)
+#define MAX_NSECS (INT64_MAX / 10 * 4)
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Checks whether a precise_tm is a time.
+ * \details         Unlike precise_tm_compare(), this also compares
+ * `tm_wday`, `tm_yday` and `tm_isdst`.
+ * \param precise   The precise_tm.
+ * \param seconds   The timestamp of the time.
+ * \param nsecs     The nanoseconds of the time, from 0 to 999999999.
+ * \returns         true if every member is right, false otherwise.
+ */
+
+static bool
+is_time(const struct precise_tm *precise, const time_t seconds,
+        const long nsecs) {
+    struct tm expected;
+    gmtime_r(&seconds, &expected);
+    return precise->tm.tm_year == expected.tm_year &&
+           precise->tm.tm_mon == expected.tm_mon &&
+           precise->tm.tm_mday == expected.tm_mday &&
+           precise->tm.tm_hour == expected.tm_hour &&
+           precise->tm.tm_min == expected.tm_min &&
+           precise->tm.tm_sec == expected.tm_sec &&
+           precise->tm.tm_wday == expected.tm_wday &&
+           precise->tm.tm_yday == expected.tm_yday &&
+           precise->tm.tm_isdst == expected.tm_isdst &&
+           precise->nanoseconds == nsecs;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const time_t utc_ts, long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong for timestamp %lld\n", name, (long long) utc_ts);
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(uint64_t *state, long *failures) {
+    const time_t utc_ts = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    const long nsecs = (long) random_in(state, 0, NSECS_IN_SEC);
+
+    //  Converting, with the nanoseconds sometimes out of range
+
+    const int64_t extra = random_in(state, -3, 7);
+    const struct timespec spec = {utc_ts - (time_t) extra,
+                                  (long) (nsecs + extra * NSECS_IN_SEC)};
+    struct precise_tm precise;
+    if ( !get_utc_precise_tm(&spec, &precise) ||
+         !is_time(&precise, utc_ts, nsecs) ) {
+        report_failure("get_utc_precise_tm()", utc_ts, failures);
+        return;
+    }
+
+    struct timespec back;
+    if ( !get_utc_timespec(&precise, &back) || back.tv_sec != utc_ts ||
+         back.tv_nsec != nsecs ) {
+        report_failure("get_utc_timespec()", utc_ts, failures);
+    }
+
+    //  Adding seconds and nanoseconds, which may carry, up to about 120
+    //  years so that the difference in nanoseconds fits
+
+    const int64_t add_secs = random_in(state, -4000000000, 8000000001);
+    const int64_t add_nsecs = random_in(state, -5 * NSECS_IN_SEC,
+                                        10 * NSECS_IN_SEC + 1);
+    const int64_t total_nsecs = nsecs + add_nsecs % NSECS_IN_SEC +
+                                NSECS_IN_SEC;
+    const time_t sum_ts = (time_t) (utc_ts + add_secs +
+                                    add_nsecs / NSECS_IN_SEC +
+                                    total_nsecs / NSECS_IN_SEC - 1);
+    const long sum_nsecs = (long) (total_nsecs % NSECS_IN_SEC);
+
+    struct precise_tm sum = precise;
+    if ( !precise_tm_add(&sum, add_secs, add_nsecs) ||
+         !is_time(&sum, sum_ts, sum_nsecs) ) {
+        report_failure("precise_tm_add()", utc_ts, failures);
+    }
+
+    //  Comparing, subtracting and packing
+
+    const int sign = (sum_ts > utc_ts || (sum_ts == utc_ts &&
+                                          sum_nsecs > nsecs)) -
+                     (sum_ts < utc_ts || (sum_ts == utc_ts &&
+                                          sum_nsecs < nsecs));
+    if ( precise_tm_compare(&sum, &precise) != sign ||
+         packed_precise_tm_compare(pack_precise_tm(&sum),
+                                   pack_precise_tm(&precise)) != sign ) {
+        report_failure("precise_tm_compare()", utc_ts, failures);
+    }
+
+    struct precise_tm unpacked;
+    unpack_precise_tm(pack_precise_tm(&sum), &unpacked);
+    if ( !is_time(&unpacked, sum_ts, sum_nsecs) ) {
+        report_failure("unpack_precise_tm()", utc_ts, failures);
+    }
+
+    struct timespec diff;
+    const int64_t diff_secs = (int64_t) (sum_ts - utc_ts) -
+                              (sum_nsecs < nsecs);
+    const long diff_nsecs = sum_nsecs - nsecs +
+                            (sum_nsecs < nsecs ? (long) NSECS_IN_SEC : 0);
+    precise_tm_diff(&precise, &sum, &diff);
+    if ( diff.tv_sec != diff_secs || diff.tv_nsec != diff_nsecs ) {
+        report_failure("precise_tm_diff()", utc_ts, failures);
+    }
+    if ( precise_tm_nsecs_diff(&precise, &sum) !=
+         diff_secs * NSECS_IN_SEC + diff_nsecs ) {
+        report_failure("precise_tm_nsecs_diff()", utc_ts, failures);
+    }
+
+    //  Incrementing and decrementing by a number of each unit
+
+    static const int64_t unit_nsecs[] = {1000000, 1000, 1};
+    static const char *names[] = {
+        "precise_tm_increment_millisecond()",
+        "precise_tm_increment_microsecond()",
+        "precise_tm_increment_nanosecond()",
+        "precise_tm_decrement_millisecond()",
+        "precise_tm_decrement_microsecond()",
+        "precise_tm_decrement_nanosecond()"
+    };
+
+    const int unit = (int) random_in(state, 0, 6);
+    const int64_t quantity = random_in(state, -MAX_NSECS, 2 * MAX_NSECS + 1) /
+                             unit_nsecs[unit % 3];
+    const int64_t moved_nsecs = (unit < 3 ? quantity : -quantity) *
+                                unit_nsecs[unit % 3];
+    const int64_t moved_total = nsecs + moved_nsecs % NSECS_IN_SEC +
+                                NSECS_IN_SEC;
+    const time_t moved_ts = (time_t) (utc_ts + moved_nsecs / NSECS_IN_SEC +
+                                      moved_total / NSECS_IN_SEC - 1);
+    const long moved_fraction = (long) (moved_total % NSECS_IN_SEC);
+
+    struct precise_tm moved = precise;
+    struct precise_tm *result = 0;
+    switch ( unit ) {
+        case 0:
+            result = precise_tm_increment_millisecond(&moved, quantity);
+            break;
+        case 1:
+            result = precise_tm_increment_microsecond(&moved, quantity);
+            break;
+        case 2:
+            result = precise_tm_increment_nanosecond(&moved, quantity);
+            break;
+        case 3:
+            result = precise_tm_decrement_millisecond(&moved, quantity);
+            break;
+        case 4:
+            result = precise_tm_decrement_microsecond(&moved, quantity);
+            break;
+        default:
+            result = precise_tm_decrement_nanosecond(&moved, quantity);
+            break;
+    }
+    if ( !result || !is_time(&moved, moved_ts, moved_fraction) ) {
+        report_failure(names[unit], utc_ts, failures);
+    }
+}
+
+
+/*!
+ * \brief           Checks that times carried past the limits of time_t
+ * fail.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_limits(long *failures) {
+    static const struct timespec beyond[] = {
+        {INT64_MAX, 1000000000}, {INT64_MAX, 999999999999},
+        {INT64_MAX - 1, 2000000000}, {INT64_MIN, -1},
+        {INT64_MIN, -999999999999}, {INT64_MIN + 1, -1000000001}
+    };
+
+    for ( size_t i = 0; i < ARRAY_LEN(beyond); ++i ) {
+        struct precise_tm precise;
+        if ( get_utc_precise_tm(&beyond[i], &precise) ) {
+            report_failure("get_utc_precise_tm()", beyond[i].tv_sec,
+                           failures);
+        }
+    }
+
+    struct precise_tm precise = {{0}, 999999999};
+    precise.tm.tm_year = 70;
+    precise.tm.tm_mday = 1;
+    if ( precise_tm_add(&precise, INT64_MAX, 1) ||
+         precise_tm_add(&precise, INT64_MIN, -NSECS_IN_SEC) ) {
+        report_failure("precise_tm_add()", 0, failures);
+    }
+
+    //  A thousand years is too many nanoseconds for an int64_t.
+
+    struct precise_tm later = precise;
+    later.tm.tm_year += 1000;
+    if ( precise_tm_nsecs_diff(&precise, &later) != INT64_MAX ||
+         precise_tm_nsecs_diff(&later, &precise) != INT64_MIN ) {
+        report_failure("precise_tm_nsecs_diff()", 0, failures);
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_precise: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    for ( long i = 0; i < NUM_TIMES; ++i ) {
+        check_time(&state, &failures);
+    }
+    check_limits(&failures);
+
+    printf("test_precise: %ld times, %ld failures\n", (long) NUM_TIMES,
+           failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
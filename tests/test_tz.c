@@ -0,0 +1,245 @@
+/*!
+ * \file            test_tz.c
+ * \brief           Tests the time zone functions against localtime_r().
+ * \details         tz_load() reads TZif files itself, and tz_local_tm(),
+ * tz_utc_offset() and tz_utc_timestamp() never call libc. This checks
+ * every member of their results, the UTC offset and the daylight saving
+ * time flag against localtime_r() with the same zone in `TZ`, for random
+ * times from 1850 to 2400 in zones with daylight saving time in either
+ * hemisphere, offsets which are not whole hours, and rules which changed.
+ * The times after the last transition in each file come from the POSIX
+ * TZ rule in its footer. Each local time is converted back, and must give
+ * the same UTC time unless it occurs twice with the same daylight saving
+ * time flag. It also checks that names which are not TZif files are
+ * rejected. It needs the system time zone files, a libc whose struct tm
+ * has `tm_gmtoff`, and a time_t of at least 64 bits.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include "pgtime.h"
+#include "pgtime_tz.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+/*  Number of random times to check in each zone  */
+
+#define NUM_TIMES 200000
+
+/*  The range of random timestamps, 1850 to 2400  */
+
+#define MIN_TIMESTAMP INT64_C(-3786825600)
+#define TIMESTAMP_RANGE INT64_C(17356377600)
+
+
+/*  The zones to check  */
+
+static const char *const zones[] = {
+    "UTC", "Europe/London", "Europe/Dublin", "America/New_York",
+    "America/St_Johns", "America/Sao_Paulo", "Australia/Sydney",
+    "Asia/Kolkata", "Pacific/Chatham", "Pacific/Apia"
+};
+
+/*  Names which must not load  */
+
+static const char *const bad_names[] = {
+    "No/Such_Zone", "../zoneinfo/UTC", "zone1970.tab", "/dev/null"
+};
+
+
+/*!
+ * \brief           Returns a random number.
+ * \param state     The state of the generator, which is updated.
+ * \returns         A random 64-bit number.
+ */
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state = *state * UINT64_C(6364136223846793005) +
+             UINT64_C(1442695040888963407);
+    return *state >> 16 ^ *state << 48;
+}
+
+
+/*!
+ * \brief           Returns a random number in a range.
+ * \param state     The state of the generator, which is updated.
+ * \param low       The lowest number to return.
+ * \param range     The number of values to choose from.
+ * \returns         A random number from `low` to `low + range - 1`.
+ */
+
+static int64_t
+random_in(uint64_t *state, const int64_t low, const int64_t range) {
+    return low + (int64_t) (next_random(state) % (uint64_t) range);
+}
+
+
+/*!
+ * \brief           Checks whether two local times are identical.
+ * \param first     The first struct tm.
+ * \param second    The second struct tm.
+ * \returns         true if every member is the same, false otherwise.
+ */
+
+static bool
+same_tm(const struct tm *first, const struct tm *second) {
+    return first->tm_year == second->tm_year &&
+           first->tm_mon == second->tm_mon &&
+           first->tm_mday == second->tm_mday &&
+           first->tm_hour == second->tm_hour &&
+           first->tm_min == second->tm_min &&
+           first->tm_sec == second->tm_sec &&
+           first->tm_wday == second->tm_wday &&
+           first->tm_yday == second->tm_yday &&
+           first->tm_isdst == second->tm_isdst;
+}
+
+
+/*!
+ * \brief           Reports a mismatch.
+ * \param name      The name of the function which gave the wrong result.
+ * \param zone      The name of the zone.
+ * \param utc_ts    The timestamp of the time it was given.
+ * \param failures  The number of failures so far, which is incremented.
+ * Only the first few are printed.
+ */
+
+static void
+report_failure(const char *name, const char *zone, const time_t utc_ts,
+               long *failures) {
+    if ( (*failures)++ < 5 ) {
+        printf("%s is wrong in %s for timestamp %lld\n", name, zone,
+               (long long) utc_ts);
+    }
+}
+
+
+/*!
+ * \brief           Checks the functions for one random time.
+ * \param state     The state of the random number generator.
+ * \param tz        The time zone, which is also in `TZ`.
+ * \param zone      The name of the zone.
+ * \param failures  Incremented for each function which is wrong.
+ */
+
+static void
+check_time(uint64_t *state, const struct time_zone *tz, const char *zone,
+           long *failures) {
+    const time_t utc_ts = (time_t) random_in(state, MIN_TIMESTAMP,
+                                             TIMESTAMP_RANGE);
+    struct tm expected;
+    struct tm result;
+    int utc_offset = 0;
+    bool is_dst = false;
+
+    //  From UTC to local time
+
+    localtime_r(&utc_ts, &expected);
+    if ( !tz_local_tm(tz, utc_ts, &result, &utc_offset) ||
+         !same_tm(&result, &expected) || utc_offset != expected.tm_gmtoff ) {
+        report_failure("tz_local_tm()", zone, utc_ts, failures);
+        return;
+    }
+    if ( tz_utc_offset(tz, utc_ts, &is_dst) != expected.tm_gmtoff ||
+         is_dst != (expected.tm_isdst > 0) ) {
+        report_failure("tz_utc_offset()", zone, utc_ts, failures);
+    }
+
+    //  And back again. When the local time occurs twice with the same
+    //  daylight saving time flag, `tm_isdst` cannot choose between them,
+    //  and the earlier is given.
+
+    time_t back_ts = 0;
+    struct tm back_tm;
+    if ( !tz_utc_timestamp(tz, &expected, &back_ts) ||
+         (back_ts != utc_ts &&
+          (back_ts > utc_ts ||
+           !tz_local_tm(tz, back_ts, &back_tm, &utc_offset) ||
+           !same_tm(&back_tm, &expected))) ) {
+        report_failure("tz_utc_timestamp()", zone, utc_ts, failures);
+    }
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    uint64_t state = 1;
+    long failures = 0;
+
+    if ( sizeof(time_t) < sizeof(int64_t) ) {
+        printf("test_tz: skipped, since time_t is too narrow.\n");
+        return EXIT_SUCCESS;
+    }
+
+    struct time_zone *const utc = tz_load("UTC");
+    if ( !utc ) {
+        printf("test_tz: skipped, since there are no time zone files.\n");
+        return EXIT_SUCCESS;
+    }
+
+    //  Months at the ends of the range of an int, which must be widened
+    //  before 1 is added, and which UTC converts as timegm() does.
+
+    static const int extreme_months[] = {INT_MIN, INT_MIN + 1, INT_MAX - 1,
+                                         INT_MAX};
+    for ( size_t i = 0; i < ARRAY_LEN(extreme_months); ++i ) {
+        struct tm local_tm = {0};
+        local_tm.tm_year = 113;
+        local_tm.tm_mon = extreme_months[i];
+        local_tm.tm_mday = 1;
+        struct tm copy_tm = local_tm;
+        time_t utc_ts = 0;
+        if ( !tz_utc_timestamp(utc, &local_tm, &utc_ts) ||
+             utc_ts != timegm(&copy_tm) ) {
+            report_failure("tz_utc_timestamp()", "UTC", extreme_months[i],
+                           &failures);
+        }
+    }
+    tz_free(utc);
+
+    for ( size_t i = 0; i < ARRAY_LEN(bad_names); ++i ) {
+        struct time_zone *const tz = tz_load(bad_names[i]);
+        if ( tz ) {
+            report_failure("tz_load()", bad_names[i], 0, &failures);
+            tz_free(tz);
+        }
+    }
+
+    for ( size_t i = 0; i < ARRAY_LEN(zones); ++i ) {
+        struct time_zone *const tz = tz_load(zones[i]);
+        if ( !tz ) {
+            report_failure("tz_load()", zones[i], 0, &failures);
+            continue;
+        }
+
+        setenv("TZ", zones[i], 1);
+        tzset();
+        for ( long j = 0; j < NUM_TIMES; ++j ) {
+            check_time(&state, tz, zones[i], &failures);
+        }
+        tz_free(tz);
+    }
+
+    printf("test_tz: %ld zones, %ld times, %ld failures\n",
+           (long) ARRAY_LEN(zones), (long) ARRAY_LEN(zones) * NUM_TIMES,
+           failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*!
+ * \file            test_validate.c
+ * \brief           Tests validate_date() and is_leap_year() against their
+ * original implementations.
+ * \details         validate_date() calculates the length of the month and
+ * combines its tests without branches, and is_leap_year() combines its
+ * tests without short circuits. This checks that they agree with the
+ * original table-driven versions for every combination of edge values of
+ * each member, including years too close to INT_MIN or INT_MAX to have
+ * 1900 added in an int. The original also rejected year 0, but the
+ * calendar is astronomical and year 0 is now valid, so the reference
+ * here accepts it.
+ * \author          Paul Griffiths
+ * \copyright       Copyright 2013 Paul Griffiths. Distributed under the terms
+ * of the GNU General Public License. <http://www.gnu.org/licenses/>
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include "pgtime.h"
+
+
+/*  Number of elements in an array  */
+
+#define ARRAY_LEN(array) (sizeof (array) / sizeof *(array))
+
+
+/*  Edge values for each member of a struct tm  */
+
+static const int years[] = {
+    INT_MIN, INT_MIN + 1, INT_MIN + 1900, -2000, -1901, -1900, -1899, -1800,
+    -1500, -1, 0, 1, 70, 72, 100, 104, 200, 300, 500, 600,
+    INT_MAX - 2000, INT_MAX - 1900, INT_MAX - 1, INT_MAX
+};
+static const int months[] = {
+    INT_MIN, -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, INT_MAX
+};
+static const int days[] = {
+    INT_MIN, -1, 0, 1, 27, 28, 29, 30, 31, 32, INT_MAX
+};
+static const int hours[] = {INT_MIN, -1, 0, 1, 23, 24, INT_MAX};
+static const int minutes[] = {INT_MIN, -1, 0, 1, 59, 60, INT_MAX};
+static const int seconds[] = {INT_MIN, -1, 0, 1, 59, 60, 61, INT_MAX};
+
+
+/*!
+ * \brief           Checks whether a year is a leap year, as originally.
+ * \param year      The year to check.
+ * \returns         true if `year` is a leap year, false otherwise.
+ */
+
+static bool
+reference_is_leap_year(const int64_t year) {
+    if ( (year % 4 == 0 && year % 100 != 0) || year % 400 == 0 ) {
+        return true;
+    }
+    return false;
+}
+
+
+/*!
+ * \brief           Checks whether a date is valid, as originally.
+ * \details         The year is widened before 1900 is added, so that this
+ * gives the intended answer for every year.
+ * \param check_tm  A pointer to a struct tm containing the date to check.
+ * \returns         true if the date if valid, false otherwise.
+ */
+
+static bool
+reference_validate_date(const struct tm *check_tm) {
+    static const int days_in_month[] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+
+    if ( ( check_tm->tm_mon < 0 || check_tm->tm_mon > 11 ) ||
+         ( check_tm->tm_mday < 1 ) ||
+         ( check_tm->tm_mday > days_in_month[check_tm->tm_mon] &&
+                !(check_tm->tm_mon == 1 &&
+                  check_tm->tm_mday == 29 &&
+                  reference_is_leap_year(check_tm->tm_year +
+                                         (int64_t) 1900)) ) ||
+         ( check_tm->tm_hour < 0 || check_tm->tm_hour > 23 ) ||
+         ( check_tm->tm_min < 0 || check_tm->tm_min > 59 ) ||
+         ( check_tm->tm_sec < 0 || check_tm->tm_sec > 59 ) ) {
+        return false;
+    }
+    return true;
+}
+
+
+/*!
+ * \brief           Compares is_leap_year() with the original.
+ * \details         Checks every year within 100000 of zero, and every
+ * year within 1000 of INT_MIN and INT_MAX.
+ * \param checked   Incremented by the number of years checked.
+ * \returns         The number of years on which they disagree.
+ */
+
+static long
+check_leap_years(long *checked) {
+    static const int64_t spans[][2] = {
+        {-100000, 100000},
+        {INT_MIN, INT_MIN + 1000},
+        {INT_MAX - 1000, INT_MAX}
+    };
+    long failures = 0;
+
+    for ( size_t s = 0; s < ARRAY_LEN(spans); ++s ) {
+        for ( int64_t year = spans[s][0]; year <= spans[s][1]; ++year ) {
+            if ( is_leap_year((int) year) != reference_is_leap_year(year) ) {
+                if ( failures++ < 5 ) {
+                    printf("is_leap_year(%lld) is wrong\n", (long long) year);
+                }
+            }
+            ++*checked;
+        }
+    }
+
+    return failures;
+}
+
+
+/*!
+ * \brief           Compares validate_date() with the original.
+ * \param checked   Incremented by the number of dates checked.
+ * \returns         The number of dates on which they disagree.
+ */
+
+static long
+check_dates(long *checked) {
+    const size_t num_dates = ARRAY_LEN(years) * ARRAY_LEN(months) *
+                             ARRAY_LEN(days) * ARRAY_LEN(hours) *
+                             ARRAY_LEN(minutes) * ARRAY_LEN(seconds);
+    long failures = 0;
+
+    for ( size_t i = 0; i < num_dates; ++i ) {
+
+        //  Each date is a different combination of edge values, chosen by
+        //  the digits of `i` in a mixed radix.
+
+        struct tm check_tm = {0};
+        size_t rest = i;
+        check_tm.tm_sec = seconds[rest % ARRAY_LEN(seconds)];
+        rest /= ARRAY_LEN(seconds);
+        check_tm.tm_min = minutes[rest % ARRAY_LEN(minutes)];
+        rest /= ARRAY_LEN(minutes);
+        check_tm.tm_hour = hours[rest % ARRAY_LEN(hours)];
+        rest /= ARRAY_LEN(hours);
+        check_tm.tm_mday = days[rest % ARRAY_LEN(days)];
+        rest /= ARRAY_LEN(days);
+        check_tm.tm_mon = months[rest % ARRAY_LEN(months)];
+        rest /= ARRAY_LEN(months);
+        check_tm.tm_year = years[rest];
+
+        if ( validate_date(&check_tm) !=
+             reference_validate_date(&check_tm) ) {
+            if ( failures++ < 5 ) {
+                printf("validate_date() is wrong for %d-%d-%d %d:%d:%d\n",
+                       check_tm.tm_year, check_tm.tm_mon, check_tm.tm_mday,
+                       check_tm.tm_hour, check_tm.tm_min, check_tm.tm_sec);
+            }
+        }
+        ++*checked;
+    }
+
+    return failures;
+}
+
+
+/*!
+ * \brief       Main function.
+ * \returns     Exit status.
+ */
+
+int main(void) {
+    long years_checked = 0;
+    long dates_checked = 0;
+    const long failures = check_leap_years(&years_checked) +
+                          check_dates(&dates_checked);
+
+    printf("test_validate: %ld years, %ld dates, %ld failures\n",
+           years_checked, dates_checked, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}